@@ -0,0 +1,25 @@
+#ifndef _NFTNL_ARENA_H_
+#define _NFTNL_ARENA_H_
+
+#include <stddef.h>
+#include "linux_list.h"
+
+/* Memory is carved out of large chunks and released all at once when the
+ * arena is freed, there is no way to release a single allocation.
+ */
+struct nftnl_arena {
+	struct list_head	chunks;
+	char			*cur;
+	size_t			avail;
+	size_t			chunk_size;
+};
+
+#define NFTNL_ARENA_CHUNK_SIZE	65536
+
+struct nftnl_arena *nftnl_arena_alloc(size_t chunk_size);
+void nftnl_arena_free(struct nftnl_arena *a);
+void *nftnl_arena_zalloc(struct nftnl_arena *a, size_t size);
+void *nftnl_arena_memdup(struct nftnl_arena *a, const void *data, size_t len);
+char *nftnl_arena_strdup(struct nftnl_arena *a, const char *str);
+
+#endif
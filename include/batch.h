@@ -0,0 +1,11 @@
+#ifndef _LIBNFTNL_BATCH_INTERNAL_H_
+#define _LIBNFTNL_BATCH_INTERNAL_H_
+
+#include <stdint.h>
+
+struct nftnl_batch;
+
+uint32_t nftnl_batch_buffer_room(const struct nftnl_batch *batch);
+int nftnl_batch_buffer_reserve(struct nftnl_batch *batch, uint32_t len);
+
+#endif
@@ -1,17 +1,30 @@
 #ifndef _NFTNL_BUFFER_H_
 #define _NFTNL_BUFFER_H_
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 struct nftnl_expr;
 
+enum nftnl_buf_sink {
+	NFTNL_BUF_SINK_NONE	= 0,	/* fixed size, output is truncated */
+	NFTNL_BUF_SINK_FILE,
+	NFTNL_BUF_SINK_ALLOC,	/* grown on demand, see nftnl_buf_init_alloc() */
+};
+
 struct nftnl_buf {
 	char		*buf;
 	size_t		size;
 	size_t		len;
 	uint32_t	off;
 	bool		fail;
+	/* With a sink, the buffer is flushed or grown on demand instead of
+	 * truncating the output, so objects are formatted only once.
+	 */
+	uint32_t	sink;
+	bool		owned;
+	FILE		*fp;
 };
 
 #define NFTNL_BUF_INIT(__b, __buf, __len)			\
@@ -23,6 +36,19 @@ struct nftnl_buf {
 int nftnl_buf_update(struct nftnl_buf *b, int ret);
 int nftnl_buf_done(struct nftnl_buf *b);
 
+void nftnl_buf_init_file(struct nftnl_buf *b, char *buf, size_t len, FILE *fp);
+void nftnl_buf_init_alloc(struct nftnl_buf *b);
+int nftnl_buf_reserve(struct nftnl_buf *b, size_t len);
+int nftnl_buf_flush(struct nftnl_buf *b);
+void nftnl_buf_release(struct nftnl_buf *b);
+
+int nftnl_buf_put(struct nftnl_buf *b, const char *fmt, ...);
+int nftnl_buf_snprintf(struct nftnl_buf *b, const void *obj, uint32_t cmd,
+		       uint32_t type, uint32_t flags,
+		       int (*snprintf_cb)(char *buf, size_t bufsiz,
+					  const void *obj, uint32_t cmd,
+					  uint32_t type, uint32_t flags));
+
 union nftnl_data_reg;
 
 int nftnl_buf_open(struct nftnl_buf *b, int type, const char *tag);
@@ -16,17 +16,20 @@ struct nftnl_parse_err {
 enum nftnl_parse_input {
 	NFTNL_PARSE_BUFFER,
 	NFTNL_PARSE_FILE,
+	NFTNL_PARSE_STREAM,
 };
 
 #include <stdio.h>
 
+struct nftnl_buf;
+
 int nftnl_cmd_header_snprintf(char *buf, size_t bufsize, uint32_t cmd,
 			   uint32_t format, uint32_t flags);
-int nftnl_cmd_header_fprintf(FILE *fp, uint32_t cmd, uint32_t format,
-			  uint32_t flags);
+int nftnl_cmd_header_buf(struct nftnl_buf *b, uint32_t cmd, uint32_t format,
+			 uint32_t flags);
 int nftnl_cmd_footer_snprintf(char *buf, size_t bufsize, uint32_t cmd,
 			   uint32_t format, uint32_t flags);
-int nftnl_cmd_footer_fprintf(FILE *fp, uint32_t cmd, uint32_t format,
-			  uint32_t flags);
+int nftnl_cmd_footer_buf(struct nftnl_buf *b, uint32_t cmd, uint32_t format,
+			 uint32_t flags);
 
 #endif
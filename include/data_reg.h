@@ -30,9 +30,22 @@ int nftnl_data_reg_snprintf(char *buf, size_t size,
 			    int reg_type);
 bool nftnl_data_reg_cmp(const union nftnl_data_reg *r1,
 		        const union nftnl_data_reg *r2, int reg_type);
+uint64_t nftnl_data_reg_hash(const union nftnl_data_reg *reg, int reg_type,
+			     uint64_t h);
 struct nlattr;
 
 int nftnl_parse_data(union nftnl_data_reg *data, struct nlattr *attr, int *type);
+
+/* Value or verdict that points to the netlink message it was parsed from. */
+struct nftnl_data_ref {
+	const void	*val;
+	uint32_t	len;
+	int		verdict;
+	const char	*chain;
+};
+
+int nftnl_parse_data_ref(struct nftnl_data_ref *ref, const struct nlattr *attr,
+			 int *type);
 void nftnl_free_verdict(const union nftnl_data_reg *data);
 
 #endif
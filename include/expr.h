@@ -14,6 +14,8 @@ struct nlmsghdr;
 
 void nftnl_expr_build_payload(struct nlmsghdr *nlh, struct nftnl_expr *expr);
 struct nftnl_expr *nftnl_expr_parse(struct nlattr *attr);
+int nftnl_expr_do_snprintf(char *buf, size_t size, const void *e,
+			   uint32_t cmd, uint32_t type, uint32_t flags);
 
 
 #endif
@@ -14,6 +14,7 @@ struct expr_ops {
 	int	max_attr;
 	void	(*free)(const struct nftnl_expr *e);
 	bool    (*cmp)(const struct nftnl_expr *e1, const struct nftnl_expr *e2);
+	uint64_t (*hash)(const struct nftnl_expr *e, uint64_t h);
 	int	(*set)(struct nftnl_expr *e, uint16_t type, const void *data, uint32_t data_len);
 	const void *(*get)(const struct nftnl_expr *e, uint16_t type, uint32_t *data_len);
 	int 	(*parse)(struct nftnl_expr *e, struct nlattr *attr);
@@ -24,6 +25,7 @@ struct expr_ops {
 };
 
 struct expr_ops *nftnl_expr_ops_lookup(const char *name);
+struct expr_ops *nftnl_expr_ops_lookup_type(uint32_t type);
 
 #define nftnl_expr_data(ops) (void *)ops->data
 
@@ -9,9 +9,12 @@
 #include "json.h"
 #include "linux_list.h"
 #include "set.h"
+#include "rule.h"
 #include "set_elem.h"
 #include "expr.h"
 #include "expr_ops.h"
+#include "batch.h"
 #include "buffer.h"
+#include "str_pool.h"
 
 #endif /* _LIBNFTNL_INTERNAL_H_ */
@@ -3,6 +3,7 @@
 
 #ifdef JSON_PARSING
 #include <jansson.h>
+#include <stdio.h>
 #include <stdbool.h>
 #include "common.h"
 
@@ -49,6 +50,38 @@ int nftnl_jansson_parse_set(struct nftnl_set *s, json_t *tree,
 int nftnl_jansson_parse_elem(struct nftnl_set *s, json_t *tree,
 			   struct nftnl_parse_err *err);
 
+struct nftnl_jansson_stream {
+	FILE		*fp;
+	char		buf[4096];
+	/* either buf, or the whole document if it is already in memory */
+	const char	*cur;
+	size_t		pos;
+	size_t		end;
+	int		line;
+	int		column;
+	/* last value read, before it is decoded */
+	char		*data;
+	size_t		len;
+	size_t		size;
+};
+
+void nftnl_jansson_stream_init(struct nftnl_jansson_stream *s, FILE *fp);
+void nftnl_jansson_stream_init_buffer(struct nftnl_jansson_stream *s,
+				      const char *data, size_t len);
+void nftnl_jansson_stream_release(struct nftnl_jansson_stream *s);
+int nftnl_jansson_stream_open(struct nftnl_jansson_stream *s, int open,
+			      int close, struct nftnl_parse_err *err);
+int nftnl_jansson_stream_next(struct nftnl_jansson_stream *s, int close,
+			      struct nftnl_parse_err *err);
+char *nftnl_jansson_stream_key(struct nftnl_jansson_stream *s,
+			       struct nftnl_parse_err *err);
+json_t *nftnl_jansson_stream_value(struct nftnl_jansson_stream *s,
+				   struct nftnl_parse_err *err);
+int nftnl_jansson_stream_skip(struct nftnl_jansson_stream *s,
+			      struct nftnl_parse_err *err);
+const char *nftnl_jansson_stream_span(struct nftnl_jansson_stream *s,
+				      size_t *len, struct nftnl_parse_err *err);
+
 int nftnl_data_reg_json_parse(union nftnl_data_reg *reg, json_t *data,
 			    struct nftnl_parse_err *err);
 #else
@@ -5,9 +5,16 @@
 
 struct nftnl_batch;
 
+enum {
+	NFTNL_BATCH_F_NOCOPY	= (1 << 0),
+};
+
 struct nftnl_batch *nftnl_batch_alloc(uint32_t pg_size, uint32_t pg_overrun_size);
 int nftnl_batch_update(struct nftnl_batch *batch);
 void nftnl_batch_free(struct nftnl_batch *batch);
+void nftnl_batch_reset(struct nftnl_batch *batch);
+void nftnl_batch_set_pool_size(struct nftnl_batch *batch, uint32_t num_pages);
+void nftnl_batch_set_flags(struct nftnl_batch *batch, uint32_t flags);
 
 void *nftnl_batch_buffer(struct nftnl_batch *batch);
 uint32_t nftnl_batch_buffer_len(struct nftnl_batch *batch);
@@ -15,4 +22,7 @@ uint32_t nftnl_batch_buffer_len(struct nftnl_batch *batch);
 int nftnl_batch_iovec_len(struct nftnl_batch *batch);
 void nftnl_batch_iovec(struct nftnl_batch *batch, struct iovec *iov, uint32_t iovlen);
 
+struct msghdr;
+const struct msghdr *nftnl_batch_msghdr(struct nftnl_batch *batch);
+
 #endif
@@ -78,6 +78,8 @@ int nftnl_chain_list_foreach(struct nftnl_chain_list *chain_list, int (*cb)(stru
 void nftnl_chain_list_add(struct nftnl_chain *r, struct nftnl_chain_list *list);
 void nftnl_chain_list_add_tail(struct nftnl_chain *r, struct nftnl_chain_list *list);
 void nftnl_chain_list_del(struct nftnl_chain *c);
+int nftnl_chain_list_hash_enable(struct nftnl_chain_list *list);
+struct nftnl_chain *nftnl_chain_list_lookup_byname(const struct nftnl_chain_list *list, uint32_t family, const char *table, const char *name);
 
 struct nftnl_chain_list_iter;
 
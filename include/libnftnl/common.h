@@ -48,6 +48,12 @@ struct nftnl_parse_err *nftnl_parse_err_alloc(void);
 void nftnl_parse_err_free(struct nftnl_parse_err *);
 int nftnl_parse_perror(const char *str, struct nftnl_parse_err *err);
 
+struct nftnl_str_pool;
+
+struct nftnl_str_pool *nftnl_str_pool_alloc(void);
+void nftnl_str_pool_free(struct nftnl_str_pool *pool);
+struct nftnl_str_pool *nftnl_str_pool_attach(struct nftnl_str_pool *pool);
+
 int nftnl_batch_is_supported(void);
 struct nlmsghdr *nftnl_batch_begin(char *buf, uint32_t seq);
 struct nlmsghdr *nftnl_batch_end(char *buf, uint32_t seq);
@@ -16,9 +16,57 @@ enum {
 	NFTNL_EXPR_BASE,
 };
 
+enum nftnl_expr_type {
+	NFTNL_EXPR_TYPE_BITWISE	= 0,
+	NFTNL_EXPR_TYPE_BYTEORDER,
+	NFTNL_EXPR_TYPE_CMP,
+	NFTNL_EXPR_TYPE_COUNTER,
+	NFTNL_EXPR_TYPE_CT,
+	NFTNL_EXPR_TYPE_DUP,
+	NFTNL_EXPR_TYPE_DYNSET,
+	NFTNL_EXPR_TYPE_EXTHDR,
+	NFTNL_EXPR_TYPE_FIB,
+	NFTNL_EXPR_TYPE_FWD,
+	NFTNL_EXPR_TYPE_HASH,
+	NFTNL_EXPR_TYPE_IMMEDIATE,
+	NFTNL_EXPR_TYPE_LIMIT,
+	NFTNL_EXPR_TYPE_LOG,
+	NFTNL_EXPR_TYPE_LOOKUP,
+	NFTNL_EXPR_TYPE_MASQ,
+	NFTNL_EXPR_TYPE_MATCH,
+	NFTNL_EXPR_TYPE_META,
+	NFTNL_EXPR_TYPE_NAT,
+	NFTNL_EXPR_TYPE_NG,
+	NFTNL_EXPR_TYPE_NOTRACK,
+	NFTNL_EXPR_TYPE_OBJREF,
+	NFTNL_EXPR_TYPE_PAYLOAD,
+	NFTNL_EXPR_TYPE_QUEUE,
+	NFTNL_EXPR_TYPE_QUOTA,
+	NFTNL_EXPR_TYPE_RANGE,
+	NFTNL_EXPR_TYPE_REDIR,
+	NFTNL_EXPR_TYPE_REJECT,
+	NFTNL_EXPR_TYPE_RT,
+	NFTNL_EXPR_TYPE_TARGET,
+	__NFTNL_EXPR_TYPE_MAX
+};
+#define NFTNL_EXPR_TYPE_MAX (__NFTNL_EXPR_TYPE_MAX - 1)
+
 struct nftnl_expr *nftnl_expr_alloc(const char *name);
+struct nftnl_expr *nftnl_expr_alloc_type(uint32_t type);
 void nftnl_expr_free(const struct nftnl_expr *expr);
 
+enum {
+	NFTNL_EXPR_CACHE_ALLOC	= 0,
+	NFTNL_EXPR_CACHE_MALLOC,
+	NFTNL_EXPR_CACHE_FREE,
+	NFTNL_EXPR_CACHE_OBJS,
+	__NFTNL_EXPR_CACHE_MAX
+};
+
+void nftnl_expr_cache_set_size(uint32_t size);
+void nftnl_expr_cache_flush(void);
+uint64_t nftnl_expr_cache_get_u64(uint16_t attr);
+
 bool nftnl_expr_is_set(const struct nftnl_expr *expr, uint16_t type);
 int nftnl_expr_set(struct nftnl_expr *expr, uint16_t type, const void *data, uint32_t data_len);
 #define nftnl_expr_set_data nftnl_expr_set
@@ -37,6 +85,7 @@ uint64_t nftnl_expr_get_u64(const struct nftnl_expr *expr, uint16_t type);
 const char *nftnl_expr_get_str(const struct nftnl_expr *expr, uint16_t type);
 
 bool nftnl_expr_cmp(const struct nftnl_expr *e1, const struct nftnl_expr *e2);
+uint64_t nftnl_expr_hash(const struct nftnl_expr *e);
 
 int nftnl_expr_snprintf(char *buf, size_t buflen, const struct nftnl_expr *expr, uint32_t type, uint32_t flags);
 int nftnl_expr_fprintf(FILE *fp, const struct nftnl_expr *expr, uint32_t type, uint32_t flags);
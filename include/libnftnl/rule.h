@@ -52,6 +52,7 @@ uint64_t nftnl_rule_get_u64(const struct nftnl_rule *r, uint16_t attr);
 void nftnl_rule_add_expr(struct nftnl_rule *r, struct nftnl_expr *expr);
 
 bool nftnl_rule_cmp(const struct nftnl_rule *r1, const struct nftnl_rule *r2);
+uint64_t nftnl_rule_hash(const struct nftnl_rule *r);
 
 struct nlmsghdr;
 
@@ -66,6 +67,7 @@ int nftnl_rule_fprintf(FILE *fp, const struct nftnl_rule *r, uint32_t type, uint
 
 #define nftnl_rule_nlmsg_build_hdr	nftnl_nlmsg_build_hdr
 int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *t);
+int nftnl_rule_nlmsg_parse_lazy(const struct nlmsghdr *nlh, struct nftnl_rule *t);
 
 int nftnl_expr_foreach(struct nftnl_rule *r,
 			  int (*cb)(struct nftnl_expr *e, void *data),
@@ -85,8 +87,28 @@ int nftnl_rule_list_is_empty(const struct nftnl_rule_list *list);
 void nftnl_rule_list_add(struct nftnl_rule *r, struct nftnl_rule_list *list);
 void nftnl_rule_list_add_tail(struct nftnl_rule *r, struct nftnl_rule_list *list);
 void nftnl_rule_list_del(struct nftnl_rule *r);
+int nftnl_rule_list_hash_enable(struct nftnl_rule_list *list);
+struct nftnl_rule *nftnl_rule_list_lookup_byhandle(const struct nftnl_rule_list *list, uint32_t family, const char *table, uint64_t handle);
+int nftnl_rule_list_chain_foreach(struct nftnl_rule_list *list, uint32_t family, const char *table, const char *chain, int (*cb)(struct nftnl_rule *r, void *data), void *data);
 int nftnl_rule_list_foreach(struct nftnl_rule_list *rule_list, int (*cb)(struct nftnl_rule *t, void *data), void *data);
 
+struct nftnl_batch;
+int nftnl_rule_list_diff_batch(struct nftnl_batch *batch,
+			       struct nftnl_rule_list *cur,
+			       struct nftnl_rule_list *want,
+			       uint32_t family, const char *table,
+			       const char *chain, uint32_t *seq);
+
+struct nftnl_rule_tmpl;
+
+struct nftnl_rule_tmpl *nftnl_rule_tmpl_alloc(void);
+void nftnl_rule_tmpl_free(struct nftnl_rule_tmpl *t);
+int nftnl_rule_tmpl_add_hole(struct nftnl_rule_tmpl *t, struct nftnl_expr *e, uint16_t attr);
+int nftnl_rule_tmpl_build(struct nftnl_rule_tmpl *t, struct nftnl_rule *r);
+int nftnl_rule_tmpl_nlmsg_build_payload(struct nlmsghdr *nlh, const struct nftnl_rule_tmpl *t);
+int nftnl_rule_tmpl_nlmsg_patch(struct nlmsghdr *nlh, const struct nftnl_rule_tmpl *t, uint32_t hole, const void *data, uint32_t data_len);
+int nftnl_rule_tmpl_nlmsg_patch_u32(struct nlmsghdr *nlh, const struct nftnl_rule_tmpl *t, uint32_t hole, uint32_t val);
+
 struct nftnl_rule_list_iter;
 
 struct nftnl_rule_list_iter *nftnl_rule_list_iter_create(const struct nftnl_rule_list *l);
@@ -60,6 +60,9 @@ uint32_t nftnl_ruleset_ctx_get_u32(const struct nftnl_parse_ctx *ctx,
 int nftnl_ruleset_parse_file_cb(enum nftnl_parse_type type, FILE *fp,
 			      struct nftnl_parse_err *err, void *data,
 			      int (*cb)(const struct nftnl_parse_ctx *ctx));
+int nftnl_ruleset_parse_file_stream_cb(enum nftnl_parse_type type, FILE *fp,
+				       struct nftnl_parse_err *err, void *data,
+				       int (*cb)(const struct nftnl_parse_ctx *ctx));
 int nftnl_ruleset_parse_buffer_cb(enum nftnl_parse_type type, const char *buffer,
 				struct nftnl_parse_err *err, void *data,
 				int (*cb)(const struct nftnl_parse_ctx *ctx));
@@ -67,8 +70,32 @@ int nftnl_ruleset_parse(struct nftnl_ruleset *rs, enum nftnl_parse_type type,
 		      const char *data, struct nftnl_parse_err *err);
 int nftnl_ruleset_parse_file(struct nftnl_ruleset *rs, enum nftnl_parse_type type,
 			   FILE *fp, struct nftnl_parse_err *err);
+int nftnl_ruleset_parse_parallel(struct nftnl_ruleset *rs,
+				 enum nftnl_parse_type type, const char *data,
+				 struct nftnl_parse_err *err,
+				 uint32_t num_threads);
+int nftnl_ruleset_parse_file_parallel(struct nftnl_ruleset *rs,
+				      enum nftnl_parse_type type, FILE *fp,
+				      struct nftnl_parse_err *err,
+				      uint32_t num_threads);
+struct nlmsghdr;
+int nftnl_ruleset_nlmsg_apply(struct nftnl_ruleset *rs, const struct nlmsghdr *nlh);
+int nftnl_ruleset_nlmsg_parse_cb(const struct nlmsghdr *nlh, void *data,
+				 int (*cb)(const struct nftnl_parse_ctx *ctx));
+struct nftnl_batch;
+int nftnl_ruleset_diff_batch(struct nftnl_batch *batch, struct nftnl_ruleset *cur,
+			     struct nftnl_ruleset *want, uint32_t *seq);
+int nftnl_ruleset_parse_file_batch(enum nftnl_parse_type type, FILE *fp,
+				   struct nftnl_parse_err *err,
+				   struct nftnl_batch *batch, uint32_t *seq);
+int nftnl_ruleset_parse_buffer_batch(enum nftnl_parse_type type,
+				     const char *buffer,
+				     struct nftnl_parse_err *err,
+				     struct nftnl_batch *batch, uint32_t *seq);
+
 int nftnl_ruleset_snprintf(char *buf, size_t size, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags);
 int nftnl_ruleset_fprintf(FILE *fp, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags);
+int nftnl_ruleset_asprintf(char **buf, const struct nftnl_ruleset *rs, uint32_t type, uint32_t flags);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -52,14 +52,20 @@ uint32_t nftnl_set_get_u32(const struct nftnl_set *s, uint16_t attr);
 uint64_t nftnl_set_get_u64(const struct nftnl_set *s, uint16_t attr);
 
 struct nlmsghdr;
+struct nftnl_set_elem;
 
 #define nftnl_set_nlmsg_build_hdr	nftnl_nlmsg_build_hdr
 void nftnl_set_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_set *s);
 int nftnl_set_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s);
 int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s);
+int nftnl_set_elems_nlmsg_foreach(const struct nlmsghdr *nlh,
+				  int (*cb)(struct nftnl_set_elem *e,
+					    void *data),
+				  void *data);
 
 int nftnl_set_snprintf(char *buf, size_t size, const struct nftnl_set *s, uint32_t type, uint32_t flags);
 int nftnl_set_fprintf(FILE *fp, const struct nftnl_set *s, uint32_t type, uint32_t flags);
+int nftnl_set_asprintf(char **buf, const struct nftnl_set *s, uint32_t type, uint32_t flags);
 
 struct nftnl_set_list;
 
@@ -69,6 +75,8 @@ int nftnl_set_list_is_empty(const struct nftnl_set_list *list);
 void nftnl_set_list_add(struct nftnl_set *s, struct nftnl_set_list *list);
 void nftnl_set_list_add_tail(struct nftnl_set *s, struct nftnl_set_list *list);
 void nftnl_set_list_del(struct nftnl_set *s);
+int nftnl_set_list_hash_enable(struct nftnl_set_list *list);
+struct nftnl_set *nftnl_set_list_lookup_byname(const struct nftnl_set_list *list, const char *name);
 int nftnl_set_list_foreach(struct nftnl_set_list *set_list, int (*cb)(struct nftnl_set *t, void *data), void *data);
 
 struct nftnl_set_list_iter;
@@ -107,6 +115,14 @@ void nftnl_set_elem_free(struct nftnl_set_elem *s);
 struct nftnl_set_elem *nftnl_set_elem_clone(struct nftnl_set_elem *elem);
 
 void nftnl_set_elem_add(struct nftnl_set *s, struct nftnl_set_elem *elem);
+void nftnl_set_elem_del(struct nftnl_set *s, struct nftnl_set_elem *elem);
+
+int nftnl_set_elem_hash_enable(struct nftnl_set *s);
+int nftnl_set_elem_arena_enable(struct nftnl_set *s);
+struct nftnl_set_elem *nftnl_set_elem_lookup(const struct nftnl_set *s,
+					     const void *key, uint32_t key_len);
+int nftnl_set_elem_del_key(struct nftnl_set *s, const void *key,
+			   uint32_t key_len);
 
 void nftnl_set_elem_unset(struct nftnl_set_elem *s, uint16_t attr);
 int nftnl_set_elem_set(struct nftnl_set_elem *s, uint16_t attr, const void *data, uint32_t data_len);
@@ -143,4 +159,10 @@ void nftnl_set_elems_iter_destroy(struct nftnl_set_elems_iter *iter);
 int nftnl_set_elems_nlmsg_build_payload_iter(struct nlmsghdr *nlh,
 					   struct nftnl_set_elems_iter *iter);
 
+struct nftnl_batch;
+int nftnl_set_elems_diff_batch(struct nftnl_batch *batch,
+			       const struct nftnl_set *cur,
+			       const struct nftnl_set *want,
+			       uint16_t flags, uint32_t *seq);
+
 #endif /* _LIBNFTNL_SET_H_ */
@@ -0,0 +1,43 @@
+#ifndef _LIBNFTNL_SNAPSHOT_H_
+#define _LIBNFTNL_SNAPSHOT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nftnl_ruleset;
+struct nftnl_batch;
+struct nftnl_parse_ctx;
+struct nftnl_snapshot;
+struct iovec;
+
+int nftnl_snapshot_write(FILE *fp, const struct nftnl_ruleset *rs);
+int nftnl_snapshot_write_batch(FILE *fp, struct nftnl_batch *batch);
+
+struct nftnl_snapshot *nftnl_snapshot_map(int fd);
+void nftnl_snapshot_unmap(struct nftnl_snapshot *snap);
+
+uint32_t nftnl_snapshot_num_msgs(const struct nftnl_snapshot *snap);
+uint16_t nftnl_snapshot_msg_type(const struct nftnl_snapshot *snap,
+				 uint32_t index);
+struct nlmsghdr;
+const struct nlmsghdr *nftnl_snapshot_msg(const struct nftnl_snapshot *snap,
+					  uint32_t index);
+
+int nftnl_snapshot_iovec_len(const struct nftnl_snapshot *snap);
+void nftnl_snapshot_iovec(const struct nftnl_snapshot *snap, struct iovec *iov,
+			  uint32_t iovlen);
+
+int nftnl_snapshot_ruleset(const struct nftnl_snapshot *snap,
+			   struct nftnl_ruleset *rs);
+int nftnl_snapshot_parse_cb(const struct nftnl_snapshot *snap, void *data,
+			    int (*cb)(const struct nftnl_parse_ctx *ctx));
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _LIBNFTNL_SNAPSHOT_H_ */
@@ -19,6 +19,7 @@ struct nftnl_obj {
 	uint32_t		use;
 
 	uint32_t		flags;
+	uint32_t		interned;
 
 	union {
 		struct nftnl_obj_counter {
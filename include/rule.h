@@ -0,0 +1,24 @@
+#ifndef _LIBNFTNL_RULE_INTERNAL_H_
+#define _LIBNFTNL_RULE_INTERNAL_H_
+
+struct nftnl_rule;
+struct nftnl_rule_list;
+
+void nftnl_rule_reset(struct nftnl_rule *r);
+void nftnl_rule_list_insert(struct nftnl_rule_list *list, struct nftnl_rule *r,
+			    struct nftnl_rule *prev);
+
+struct nftnl_batch;
+int __nftnl_rule_list_diff_batch(struct nftnl_batch *batch,
+				 struct nftnl_rule_list *cur,
+				 struct nftnl_rule_list *want,
+				 uint32_t family, const char *table,
+				 const char *chain, uint32_t *seq,
+				 int (*check)(struct nftnl_rule *r, void *data),
+				 void *data);
+
+struct nftnl_buf;
+int nftnl_rule_buf_snprintf(struct nftnl_buf *b, const void *obj, uint32_t cmd,
+			    uint32_t type, uint32_t flags);
+
+#endif
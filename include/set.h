@@ -3,8 +3,14 @@
 
 #include <linux/netfilter/nf_tables.h>
 
+struct nftnl_arena;
+struct nftnl_set_list;
+
 struct nftnl_set {
 	struct list_head	head;
+	struct hlist_node	name_hnode;
+	/* list whose name index holds this set */
+	struct nftnl_set_list	*name_list;
 
 	uint32_t		family;
 	uint32_t		set_flags;
@@ -25,15 +31,33 @@ struct nftnl_set {
 		uint32_t	size;
 	} desc;
 	struct list_head	element_list;
+	struct {
+		struct hlist_head	*buckets;
+		uint32_t		size;
+		uint32_t		count;
+	} elem_hash;
+	struct nftnl_arena	*elem_arena;
 
 	uint32_t		flags;
+	uint32_t		interned;
 	uint32_t		gc_interval;
 	uint64_t		timeout;
 };
 
+struct nftnl_set_elem;
+void nftnl_set_elem_hash_add(struct nftnl_set *s, struct nftnl_set_elem *e);
+void nftnl_set_elem_hash_free(struct nftnl_set *s);
+
 struct nftnl_set_list;
+struct nftnl_set *nftnl_set_list_lookup(const struct nftnl_set_list *list,
+					uint32_t family, const char *table,
+					const char *name);
 struct nftnl_expr;
 int nftnl_set_lookup_id(struct nftnl_expr *e, struct nftnl_set_list *set_list,
 		      uint32_t *set_id);
 
+struct nftnl_buf;
+int nftnl_set_buf_snprintf(struct nftnl_buf *b, const void *obj, uint32_t cmd,
+			   uint32_t type, uint32_t flags);
+
 #endif
@@ -3,20 +3,64 @@
 
 #include <data_reg.h>
 
-struct nftnl_set_elem {
-	struct list_head	head;
-	uint32_t		set_elem_flags;
-	union nftnl_data_reg	key;
-	union nftnl_data_reg	data;
-	struct nftnl_expr	*expr;
-	uint32_t		flags;
+/* Attributes that most elements do not use, allocated on demand. */
+struct nftnl_set_elem_ext {
 	uint64_t		timeout;
 	uint64_t		expiration;
+	struct nftnl_expr	*expr;
 	const char		*objref;
+	const char		*chain;
 	struct {
 		void		*data;
 		uint32_t	len;
 	} user;
 };
 
+/* Key and data are stored in @buf, right after the element, with room for
+ * @key_size and @data_size bytes. If a longer key or data is set later on,
+ * it is moved to a separate buffer of NFT_DATA_VALUE_MAXLEN bytes. Verdicts
+ * are stored in the first word of the data.
+ */
+struct nftnl_set_elem {
+	struct list_head	head;
+	struct hlist_node	hnode;
+	uint32_t		flags;
+	uint32_t		set_elem_flags;
+	uint8_t			key_len;
+	uint8_t			key_size;
+	uint8_t			data_len;
+	uint8_t			data_size;
+	uint32_t		arena_flags;
+	uint32_t		*key;
+	uint32_t		*data;
+	struct nftnl_set_elem_ext *ext;
+	uint32_t		buf[];
+};
+
+/* Storage owned by the arena of the set, see nftnl_set_elem_arena_enable() */
+enum {
+	NFTNL_SET_ELEM_ARENA_ELEM	= (1 << 0),
+	NFTNL_SET_ELEM_ARENA_EXT	= (1 << 1),
+	NFTNL_SET_ELEM_ARENA_CHAIN	= (1 << 2),
+	NFTNL_SET_ELEM_ARENA_USERDATA	= (1 << 3),
+	NFTNL_SET_ELEM_ARENA_OBJREF	= (1 << 4),
+};
+
+struct nftnl_arena;
+
+struct nftnl_set_elem *nftnl_set_elem_alloc_size(struct nftnl_arena *arena,
+						 uint32_t key_size,
+						 uint32_t data_size);
+
+struct nftnl_set_elem *nftnl_set_elem_lookup_id(const struct nftnl_set *s,
+						const struct nftnl_set_elem *e);
+bool nftnl_set_elems_eq(const struct nftnl_set *s1, const struct nftnl_set *s2);
+
+struct nftnl_batch;
+int nftnl_set_elems_batch(struct nftnl_batch *batch, const struct nftnl_set *s,
+			  uint16_t type, uint16_t flags, uint32_t *seq);
+
+int nftnl_set_elem_do_snprintf(char *buf, size_t size, const void *e,
+			       uint32_t cmd, uint32_t type, uint32_t flags);
+
 #endif
@@ -0,0 +1,14 @@
+#ifndef _NFTNL_STR_POOL_H_
+#define _NFTNL_STR_POOL_H_
+
+#include <stdint.h>
+
+/* Names are interned when a string pool is attached to the calling thread,
+ * otherwise they are duplicated. The bit for @attr in @interned tells which
+ * one it was, interned strings belong to the pool and are never released.
+ */
+const char *nftnl_str_intern(const char *str, uint32_t *interned,
+			     uint16_t attr);
+void nftnl_str_release(const char *str, uint32_t interned, uint16_t attr);
+
+#endif
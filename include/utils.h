@@ -83,10 +83,34 @@ uint32_t nftnl_str2cmd(const char *cmd);
 
 enum nftnl_cmd_type nftnl_flag2cmd(uint32_t flags);
 
+#define NFTNL_FMT_HEX32_LEN	8
+#define NFTNL_FMT_U64_LEN	20
+
+int nftnl_fmt_hex32(char *out, uint32_t val);
+int nftnl_fmt_u64(char *out, uint64_t val);
+int nftnl_fmt_copy(char *buf, size_t size, const char *str, int len);
+
+uint32_t nftnl_hash(const void *data, size_t len, uint32_t seed);
+uint64_t nftnl_hash64(const void *data, size_t len, uint64_t seed);
+uint32_t nftnl_name_hash(uint32_t family, const char *table, const char *name);
+
 int nftnl_fprintf(FILE *fpconst, const void *obj, uint32_t cmd, uint32_t type,
 		  uint32_t flags,
 		  int (*snprintf_cb)(char *buf, size_t bufsiz, const void *obj,
 			  	     uint32_t cmd, uint32_t type,
 				     uint32_t flags));
 
+struct nftnl_buf;
+
+int nftnl_fprintf_buf(FILE *fp, const void *obj, uint32_t cmd, uint32_t type,
+		      uint32_t flags,
+		      int (*buf_cb)(struct nftnl_buf *b, const void *obj,
+				    uint32_t cmd, uint32_t type,
+				    uint32_t flags));
+int nftnl_asprintf_buf(char **buf, const void *obj, uint32_t cmd,
+		       uint32_t type, uint32_t flags,
+		       int (*buf_cb)(struct nftnl_buf *b, const void *obj,
+				     uint32_t cmd, uint32_t type,
+				     uint32_t flags));
+
 #endif
@@ -0,0 +1,104 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "internal.h"
+#include "arena.h"
+
+struct nftnl_arena_chunk {
+	struct list_head	head;
+	char			buf[];
+};
+
+#define NFTNL_ARENA_ALIGN	sizeof(uint64_t)
+
+struct nftnl_arena *nftnl_arena_alloc(size_t chunk_size)
+{
+	struct nftnl_arena *a;
+
+	a = calloc(1, sizeof(struct nftnl_arena));
+	if (a == NULL)
+		return NULL;
+
+	INIT_LIST_HEAD(&a->chunks);
+	a->chunk_size = chunk_size;
+
+	return a;
+}
+
+void nftnl_arena_free(struct nftnl_arena *a)
+{
+	struct nftnl_arena_chunk *chunk, *next;
+
+	list_for_each_entry_safe(chunk, next, &a->chunks, head)
+		xfree(chunk);
+
+	xfree(a);
+}
+
+static struct nftnl_arena_chunk *nftnl_arena_chunk_alloc(size_t size)
+{
+	/* Chunks are zeroed once, allocations never hand out used memory. */
+	return calloc(1, sizeof(struct nftnl_arena_chunk) + size);
+}
+
+void *nftnl_arena_zalloc(struct nftnl_arena *a, size_t size)
+{
+	struct nftnl_arena_chunk *chunk;
+	void *ptr;
+
+	size = div_round_up(size, NFTNL_ARENA_ALIGN) * NFTNL_ARENA_ALIGN;
+
+	if (size <= a->avail) {
+		ptr = a->cur;
+		a->cur += size;
+		a->avail -= size;
+		return ptr;
+	}
+
+	/* Large allocations get a chunk of their own, so the room left in the
+	 * current chunk is not wasted.
+	 */
+	if (size > a->chunk_size / 4) {
+		chunk = nftnl_arena_chunk_alloc(size);
+		if (chunk == NULL)
+			return NULL;
+
+		list_add_tail(&chunk->head, &a->chunks);
+		return chunk->buf;
+	}
+
+	chunk = nftnl_arena_chunk_alloc(a->chunk_size);
+	if (chunk == NULL)
+		return NULL;
+
+	list_add(&chunk->head, &a->chunks);
+	a->cur = chunk->buf + size;
+	a->avail = a->chunk_size - size;
+
+	return chunk->buf;
+}
+
+void *nftnl_arena_memdup(struct nftnl_arena *a, const void *data, size_t len)
+{
+	void *ptr;
+
+	ptr = nftnl_arena_zalloc(a, len);
+	if (ptr == NULL)
+		return NULL;
+
+	memcpy(ptr, data, len);
+	return ptr;
+}
+
+char *nftnl_arena_strdup(struct nftnl_arena *a, const char *str)
+{
+	return nftnl_arena_memdup(a, str, strlen(str) + 1);
+}
@@ -8,6 +8,9 @@
 
 #include "internal.h"
 #include <errno.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 #include <libmnl/libmnl.h>
 #include <libnftnl/batch.h>
 
@@ -17,44 +20,91 @@ struct nftnl_batch {
 	uint32_t		page_size;
 	uint32_t		page_overrun_size;
 	struct list_head	page_list;
+	uint32_t		pool_size;
+	uint32_t		pool_max;
+	struct list_head	page_pool;
+	uint32_t		flags;
+	struct iovec		*iov;
+	uint32_t		iov_size;
+	struct sockaddr_nl	snl;
+	struct msghdr		msg;
 };
 
 struct nftnl_batch_page {
 	struct list_head	head;
-	struct mnl_nlmsg_batch	*batch;
+	uint32_t		len;
+	char			buf[];
 };
 
 static struct nftnl_batch_page *nftnl_batch_page_alloc(struct nftnl_batch *batch)
 {
 	struct nftnl_batch_page *page;
-	char *buf;
 
-	page = malloc(sizeof(struct nftnl_batch_page));
+	page = malloc(sizeof(struct nftnl_batch_page) +
+		      batch->page_size + batch->page_overrun_size);
 	if (page == NULL)
 		return NULL;
 
-	buf = malloc(batch->page_size + batch->page_overrun_size);
-	if (buf == NULL)
-		goto err1;
+	page->len = 0;
+	return page;
+}
 
-	page->batch = mnl_nlmsg_batch_start(buf, batch->page_size);
-	if (page->batch == NULL)
-		goto err2;
+static void nftnl_batch_page_free(struct nftnl_batch_page *page)
+{
+	free(page);
+}
+
+static struct nftnl_batch_page *nftnl_batch_page_get(struct nftnl_batch *batch)
+{
+	struct nftnl_batch_page *page;
+
+	if (list_empty(&batch->page_pool))
+		return nftnl_batch_page_alloc(batch);
+
+	page = list_entry(batch->page_pool.next, struct nftnl_batch_page, head);
+	list_del(&page->head);
+	batch->pool_size--;
 
 	return page;
-err2:
-	free(buf);
-err1:
-	free(page);
-	return NULL;
 }
 
-static void nftnl_batch_add_page(struct nftnl_batch_page *page,
-			       struct nftnl_batch *batch)
+static void nftnl_batch_page_put(struct nftnl_batch_page *page,
+				 struct nftnl_batch *batch)
 {
+	if (batch->pool_size >= batch->pool_max) {
+		nftnl_batch_page_free(page);
+		return;
+	}
+
+	page->len = 0;
+	list_add(&page->head, &batch->page_pool);
+	batch->pool_size++;
+}
+
+static int nftnl_batch_add_page(struct nftnl_batch_page *page,
+				struct nftnl_batch *batch)
+{
+	struct iovec *iov;
+	uint32_t size;
+
+	if (batch->num_pages == batch->iov_size) {
+		size = batch->iov_size ? batch->iov_size * 2 : 8;
+		iov = realloc(batch->iov, size * sizeof(struct iovec));
+		if (iov == NULL)
+			return -1;
+
+		batch->iov = iov;
+		batch->iov_size = size;
+	}
+
+	batch->iov[batch->num_pages].iov_base = page->buf;
+	batch->iov[batch->num_pages].iov_len = page->len;
+
 	batch->current_page = page;
 	batch->num_pages++;
 	list_add_tail(&page->head, &batch->page_list);
+
+	return 0;
 }
 
 EXPORT_SYMBOL(nftnl_batch_alloc);
@@ -69,14 +119,24 @@ struct nftnl_batch *nftnl_batch_alloc(uint32_t pg_size, uint32_t pg_overrun_size
 
 	batch->page_size = pg_size;
 	batch->page_overrun_size = pg_overrun_size;
+	batch->pool_max = UINT32_MAX;
 	INIT_LIST_HEAD(&batch->page_list);
+	INIT_LIST_HEAD(&batch->page_pool);
+
+	batch->snl.nl_family = AF_NETLINK;
+	batch->msg.msg_name = &batch->snl;
+	batch->msg.msg_namelen = sizeof(batch->snl);
 
 	page = nftnl_batch_page_alloc(batch);
 	if (page == NULL)
 		goto err1;
 
-	nftnl_batch_add_page(page, batch);
+	if (nftnl_batch_add_page(page, batch) < 0)
+		goto err2;
+
 	return batch;
+err2:
+	nftnl_batch_page_free(page);
 err1:
 	free(batch);
 	return NULL;
@@ -87,50 +147,155 @@ void nftnl_batch_free(struct nftnl_batch *batch)
 {
 	struct nftnl_batch_page *page, *next;
 
+	list_for_each_entry_safe(page, next, &batch->page_list, head)
+		nftnl_batch_page_free(page);
+
+	list_for_each_entry_safe(page, next, &batch->page_pool, head)
+		nftnl_batch_page_free(page);
+
+	xfree(batch->iov);
+	free(batch);
+}
+
+EXPORT_SYMBOL(nftnl_batch_reset);
+void nftnl_batch_reset(struct nftnl_batch *batch)
+{
+	struct nftnl_batch_page *first, *page, *next;
+
+	first = list_entry(batch->page_list.next, struct nftnl_batch_page, head);
+
 	list_for_each_entry_safe(page, next, &batch->page_list, head) {
-		free(mnl_nlmsg_batch_head(page->batch));
-		mnl_nlmsg_batch_stop(page->batch);
-		free(page);
+		if (page == first)
+			continue;
+
+		list_del(&page->head);
+		nftnl_batch_page_put(page, batch);
 	}
+	first->len = 0;
+	batch->iov[0].iov_len = 0;
 
-	free(batch);
+	batch->current_page = first;
+	batch->num_pages = 1;
+}
+
+EXPORT_SYMBOL(nftnl_batch_set_pool_size);
+void nftnl_batch_set_pool_size(struct nftnl_batch *batch, uint32_t num_pages)
+{
+	struct nftnl_batch_page *page;
+
+	batch->pool_max = num_pages;
+
+	while (batch->pool_size > num_pages) {
+		page = list_entry(batch->page_pool.next,
+				  struct nftnl_batch_page, head);
+		list_del(&page->head);
+		nftnl_batch_page_free(page);
+		batch->pool_size--;
+	}
+}
+
+EXPORT_SYMBOL(nftnl_batch_set_flags);
+void nftnl_batch_set_flags(struct nftnl_batch *batch, uint32_t flags)
+{
+	batch->flags = flags;
 }
 
 EXPORT_SYMBOL(nftnl_batch_update);
 int nftnl_batch_update(struct nftnl_batch *batch)
 {
-	struct nftnl_batch_page *page;
+	struct nftnl_batch_page *page, *cur = batch->current_page;
 	struct nlmsghdr *last_nlh;
 
-	if (mnl_nlmsg_batch_next(batch->current_page->batch))
+	last_nlh = nftnl_batch_buffer(batch);
+
+	if (cur->len + last_nlh->nlmsg_len <= batch->page_size) {
+		cur->len += last_nlh->nlmsg_len;
+		batch->iov[batch->num_pages - 1].iov_len = cur->len;
 		return 0;
+	}
 
-	last_nlh = nftnl_batch_buffer(batch);
+	/* In no-copy mode, the message stays where it was built, in the
+	 * overrun area of this page, and the next message goes to a new page.
+	 */
+	if (batch->flags & NFTNL_BATCH_F_NOCOPY) {
+		cur->len += last_nlh->nlmsg_len;
+		batch->iov[batch->num_pages - 1].iov_len = cur->len;
+	}
 
-	page = nftnl_batch_page_alloc(batch);
+	page = nftnl_batch_page_get(batch);
 	if (page == NULL)
 		goto err1;
 
-	nftnl_batch_add_page(page, batch);
+	if (nftnl_batch_add_page(page, batch) < 0)
+		goto err2;
 
-	memcpy(nftnl_batch_buffer(batch), last_nlh, last_nlh->nlmsg_len);
-	mnl_nlmsg_batch_next(batch->current_page->batch);
+	if (batch->flags & NFTNL_BATCH_F_NOCOPY)
+		return 0;
+
+	memcpy(page->buf, last_nlh, last_nlh->nlmsg_len);
+	page->len = last_nlh->nlmsg_len;
+	batch->iov[batch->num_pages - 1].iov_len = page->len;
 
 	return 0;
+err2:
+	nftnl_batch_page_put(page, batch);
 err1:
+	if (batch->flags & NFTNL_BATCH_F_NOCOPY) {
+		cur->len -= last_nlh->nlmsg_len;
+		batch->iov[batch->num_pages - 1].iov_len = cur->len;
+	}
 	return -1;
 }
 
 EXPORT_SYMBOL(nftnl_batch_buffer);
 void *nftnl_batch_buffer(struct nftnl_batch *batch)
 {
-	return mnl_nlmsg_batch_current(batch->current_page->batch);
+	return batch->current_page->buf + batch->current_page->len;
 }
 
 EXPORT_SYMBOL(nftnl_batch_buffer_len);
 uint32_t nftnl_batch_buffer_len(struct nftnl_batch *batch)
 {
-	return mnl_nlmsg_batch_size(batch->current_page->batch);
+	return batch->current_page->len;
+}
+
+/* Bytes that a message built at nftnl_batch_buffer() may take, the overrun
+ * area included.
+ */
+uint32_t nftnl_batch_buffer_room(const struct nftnl_batch *batch)
+{
+	return batch->page_size + batch->page_overrun_size -
+	       batch->current_page->len;
+}
+
+/* Makes room for a message of @len bytes at nftnl_batch_buffer(). A new page
+ * is started if the current one is short of room, or if it is full already,
+ * as nftnl_batch_update() would move the message to a new page anyway.
+ */
+int nftnl_batch_buffer_reserve(struct nftnl_batch *batch, uint32_t len)
+{
+	struct nftnl_batch_page *page, *cur = batch->current_page;
+
+	if (len > batch->page_size + batch->page_overrun_size) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	if (cur->len == 0 ||
+	    (cur->len < batch->page_size &&
+	     nftnl_batch_buffer_room(batch) >= len))
+		return 0;
+
+	page = nftnl_batch_page_get(batch);
+	if (page == NULL)
+		return -1;
+
+	if (nftnl_batch_add_page(page, batch) < 0) {
+		nftnl_batch_page_put(page, batch);
+		return -1;
+	}
+
+	return 0;
 }
 
 EXPORT_SYMBOL(nftnl_batch_iovec_len);
@@ -139,7 +304,7 @@ int nftnl_batch_iovec_len(struct nftnl_batch *batch)
 	int num_pages = batch->num_pages;
 
 	/* Skip last page if it's empty */
-	if (mnl_nlmsg_batch_is_empty(batch->current_page->batch))
+	if (batch->current_page->len == 0)
 		num_pages--;
 
 	return num_pages;
@@ -149,15 +314,17 @@ EXPORT_SYMBOL(nftnl_batch_iovec);
 void nftnl_batch_iovec(struct nftnl_batch *batch, struct iovec *iov,
 		       uint32_t iovlen)
 {
-	struct nftnl_batch_page *page;
-	int i = 0;
+	if (iovlen > batch->num_pages)
+		iovlen = batch->num_pages;
 
-	list_for_each_entry(page, &batch->page_list, head) {
-		if (i >= iovlen)
-			break;
+	memcpy(iov, batch->iov, iovlen * sizeof(struct iovec));
+}
 
-		iov[i].iov_base = mnl_nlmsg_batch_head(page->batch);
-		iov[i].iov_len = mnl_nlmsg_batch_size(page->batch);
-		i++;
-	}
+EXPORT_SYMBOL(nftnl_batch_msghdr);
+const struct msghdr *nftnl_batch_msghdr(struct nftnl_batch *batch)
+{
+	batch->msg.msg_iov = batch->iov;
+	batch->msg.msg_iovlen = nftnl_batch_iovec_len(batch);
+
+	return &batch->msg;
 }
@@ -47,19 +47,173 @@ int nftnl_buf_done(struct nftnl_buf *b)
 	return b->off;
 }
 
-static int nftnl_buf_put(struct nftnl_buf *b, const char *fmt, ...)
+/* Room made before formatting into a buffer with a sink, large enough for
+ * most objects to be formatted only once.
+ */
+#define NFTNL_BUF_SLACK		512
+
+void nftnl_buf_init_file(struct nftnl_buf *b, char *buf, size_t len, FILE *fp)
+{
+	memset(b, 0, sizeof(*b));
+	b->buf = buf;
+	b->len = len;
+	b->sink = NFTNL_BUF_SINK_FILE;
+	b->fp = fp;
+}
+
+/* The output is kept in memory, in a buffer that is doubled as needed. Once
+ * flushed, the buffer is nul-terminated and owned by the caller.
+ */
+void nftnl_buf_init_alloc(struct nftnl_buf *b)
+{
+	memset(b, 0, sizeof(*b));
+	b->sink = NFTNL_BUF_SINK_ALLOC;
+}
+
+static int nftnl_buf_write(struct nftnl_buf *b, size_t len)
+{
+	return fwrite(b->buf, 1, len, b->fp) == len ? 0 : -1;
+}
+
+static int nftnl_buf_grow(struct nftnl_buf *b, size_t len)
+{
+	size_t size = b->size + b->len;
+	char *buf;
+
+	if (size < NFTNL_SNPRINTF_BUFSIZ)
+		size = NFTNL_SNPRINTF_BUFSIZ;
+	while (size - b->size < len)
+		size *= 2;
+
+	if (b->owned) {
+		buf = realloc(b->buf, size);
+		if (buf == NULL)
+			return -1;
+	} else {
+		buf = malloc(size);
+		if (buf == NULL)
+			return -1;
+		if (b->size)
+			memcpy(buf, b->buf, b->size);
+		b->owned = true;
+	}
+
+	b->buf = buf;
+	b->len = size - b->size;
+
+	return 0;
+}
+
+/* Makes room for @len bytes, which is a no-op without a sink. The last byte
+ * is not flushed, since it may be a trailing comma that is removed later.
+ */
+int nftnl_buf_reserve(struct nftnl_buf *b, size_t len)
+{
+	if (b->len >= len || b->sink == NFTNL_BUF_SINK_NONE)
+		return 0;
+
+	if (b->sink == NFTNL_BUF_SINK_FILE && b->size > 1) {
+		if (nftnl_buf_write(b, b->size - 1) < 0)
+			goto err;
+
+		b->buf[0] = b->buf[b->size - 1];
+		b->len += b->size - 1;
+		b->size = 1;
+		if (b->len >= len)
+			return 0;
+	}
+
+	if (nftnl_buf_grow(b, len) < 0)
+		goto err;
+
+	return 0;
+err:
+	b->fail = true;
+	return -1;
+}
+
+/* Returns the length of the whole output, or -1 on error. */
+int nftnl_buf_flush(struct nftnl_buf *b)
+{
+	switch (b->sink) {
+	case NFTNL_BUF_SINK_FILE:
+		if (b->size == 0)
+			break;
+		if (!b->fail && nftnl_buf_write(b, b->size) < 0)
+			b->fail = true;
+
+		b->len += b->size;
+		b->size = 0;
+		break;
+	case NFTNL_BUF_SINK_ALLOC:
+		if (nftnl_buf_reserve(b, 1) == 0)
+			b->buf[b->size] = '\0';
+		break;
+	}
+
+	return b->fail ? -1 : b->off;
+}
+
+void nftnl_buf_release(struct nftnl_buf *b)
+{
+	if (b->owned)
+		xfree(b->buf);
+
+	b->buf = NULL;
+	b->owned = false;
+}
+
+int nftnl_buf_put(struct nftnl_buf *b, const char *fmt, ...)
 {
+	va_list ap, aq;
 	int ret;
-	va_list ap;
+
+	if (b->sink != NFTNL_BUF_SINK_NONE && b->len < NFTNL_BUF_SLACK)
+		nftnl_buf_reserve(b, NFTNL_BUF_SLACK);
 
 	va_start(ap, fmt);
-	ret = vsnprintf(b->buf + b->off, b->len, fmt, ap);
+	va_copy(aq, ap);
+	ret = vsnprintf(b->buf + b->size, b->len, fmt, ap);
+	if (ret >= 0 && (size_t)ret >= b->len &&
+	    b->sink != NFTNL_BUF_SINK_NONE &&
+	    nftnl_buf_reserve(b, ret + 1) == 0)
+		ret = vsnprintf(b->buf + b->size, b->len, fmt, aq);
 	ret = nftnl_buf_update(b, ret);
+	va_end(aq);
 	va_end(ap);
 
 	return ret;
 }
 
+/* Formats @obj through @snprintf_cb straight into the buffer. Errors from the
+ * callback are returned but they leave the buffer untouched. Otherwise, the
+ * length of the object output is returned, as snprintf() does.
+ */
+int nftnl_buf_snprintf(struct nftnl_buf *b, const void *obj, uint32_t cmd,
+		       uint32_t type, uint32_t flags,
+		       int (*snprintf_cb)(char *buf, size_t bufsiz,
+					  const void *obj, uint32_t cmd,
+					  uint32_t type, uint32_t flags))
+{
+	int ret;
+
+	if (b->sink != NFTNL_BUF_SINK_NONE && b->len < NFTNL_BUF_SLACK)
+		nftnl_buf_reserve(b, NFTNL_BUF_SLACK);
+
+	ret = snprintf_cb(b->buf + b->size, b->len, obj, cmd, type, flags);
+	if (ret >= 0 && (size_t)ret >= b->len &&
+	    b->sink != NFTNL_BUF_SINK_NONE &&
+	    nftnl_buf_reserve(b, ret + 1) == 0)
+		ret = snprintf_cb(b->buf + b->size, b->len, obj, cmd, type,
+				  flags);
+	if (ret < 0)
+		return ret;
+
+	nftnl_buf_update(b, ret);
+
+	return ret;
+}
+
 int nftnl_buf_open(struct nftnl_buf *b, int type, const char *tag)
 {
 	switch (type) {
@@ -111,11 +265,38 @@ int nftnl_buf_close_array(struct nftnl_buf *b, int type, const char *tag)
 	}
 }
 
+/* Same as nftnl_buf_put(b, "\"%s\":%"PRIu64",", tag, value) without going
+ * through the printf machinery, numbers are printed for every counter.
+ */
+static int nftnl_buf_uint(struct nftnl_buf *b, uint64_t value, const char *tag)
+{
+	char tmp[64 + NFTNL_FMT_U64_LEN];
+	size_t taglen = strlen(tag);
+	int n = 0;
+
+	if (taglen > sizeof(tmp) - NFTNL_FMT_U64_LEN - 4)
+		return nftnl_buf_put(b, "\"%s\":%"PRIu64",", tag, value);
+
+	tmp[n++] = '"';
+	memcpy(tmp + n, tag, taglen);
+	n += taglen;
+	tmp[n++] = '"';
+	tmp[n++] = ':';
+	n += nftnl_fmt_u64(tmp + n, value);
+	tmp[n++] = ',';
+
+	if (b->sink != NFTNL_BUF_SINK_NONE && b->len <= (size_t)n)
+		nftnl_buf_reserve(b, n + 1);
+
+	return nftnl_buf_update(b, nftnl_fmt_copy(b->buf + b->size, b->len,
+						  tmp, n));
+}
+
 int nftnl_buf_u32(struct nftnl_buf *b, int type, uint32_t value, const char *tag)
 {
 	switch (type) {
 	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "\"%s\":%u,", tag, value);
+		return nftnl_buf_uint(b, value, tag);
 	case NFTNL_OUTPUT_XML:
 	default:
 		return 0;
@@ -137,7 +318,7 @@ int nftnl_buf_u64(struct nftnl_buf *b, int type, uint64_t value, const char *tag
 {
 	switch (type) {
 	case NFTNL_OUTPUT_JSON:
-		return nftnl_buf_put(b, "\"%s\":%"PRIu64",", tag, value);
+		return nftnl_buf_uint(b, value, tag);
 	case NFTNL_OUTPUT_XML:
 	default:
 		return 0;
@@ -165,8 +346,14 @@ int nftnl_buf_reg(struct nftnl_buf *b, int type, union nftnl_data_reg *reg,
 		return 0;
 	case NFTNL_OUTPUT_JSON:
 		nftnl_buf_put(b, "\"%s\":{", tag);
-		ret = nftnl_data_reg_snprintf(b->buf + b->off, b->len, reg,
+		ret = nftnl_data_reg_snprintf(b->buf + b->size, b->len, reg,
 					    NFTNL_OUTPUT_JSON, 0, reg_type);
+		if (ret >= 0 && (size_t)ret >= b->len &&
+		    b->sink != NFTNL_BUF_SINK_NONE &&
+		    nftnl_buf_reserve(b, ret + 1) == 0)
+			ret = nftnl_data_reg_snprintf(b->buf + b->size, b->len,
+						      reg, NFTNL_OUTPUT_JSON,
+						      0, reg_type);
 		nftnl_buf_update(b, ret);
 		return nftnl_buf_put(b, "},");
 	}
@@ -207,11 +394,9 @@ int nftnl_buf_expr(struct nftnl_buf *b, int type, uint32_t flags,
 	case NFTNL_OUTPUT_JSON:
 		nftnl_buf_put(b, "{");
 		nftnl_buf_str(b, type, expr->ops->name, TYPE);
-		ret = nftnl_expr_snprintf(b->buf + b->off, b->len, expr, type,
-					  flags);
-		if (ret > 0)
-			nftnl_buf_update(b, ret);
-		else
+		ret = nftnl_buf_snprintf(b, expr, NFTNL_CMD_UNSPEC, type, flags,
+					 nftnl_expr_do_snprintf);
+		if (ret <= 0)
 			nftnl_buf_done(b);
 
 		return nftnl_buf_put(b, "},");
@@ -29,8 +29,13 @@
 #include <libnftnl/chain.h>
 #include <buffer.h>
 
+struct nftnl_chain_list;
+
 struct nftnl_chain {
 	struct list_head head;
+	struct hlist_node hnode;
+	/* list whose index holds this chain */
+	struct nftnl_chain_list *list;
 
 	const char	*name;
 	const char	*type;
@@ -45,6 +50,7 @@ struct nftnl_chain {
 	uint64_t	bytes;
 	uint64_t	handle;
 	uint32_t	flags;
+	uint32_t	interned;
 };
 
 static const char *nftnl_hooknum2str(int family, int hooknum)
@@ -97,9 +103,9 @@ EXPORT_SYMBOL(nftnl_chain_free);
 void nftnl_chain_free(const struct nftnl_chain *c)
 {
 	if (c->flags & (1 << NFTNL_CHAIN_NAME))
-		xfree(c->name);
+		nftnl_str_release(c->name, c->interned, NFTNL_CHAIN_NAME);
 	if (c->flags & (1 << NFTNL_CHAIN_TABLE))
-		xfree(c->table);
+		nftnl_str_release(c->table, c->interned, NFTNL_CHAIN_TABLE);
 	if (c->flags & (1 << NFTNL_CHAIN_TYPE))
 		xfree(c->type);
 	if (c->flags & (1 << NFTNL_CHAIN_DEV))
@@ -121,10 +127,10 @@ void nftnl_chain_unset(struct nftnl_chain *c, uint16_t attr)
 
 	switch (attr) {
 	case NFTNL_CHAIN_NAME:
-		xfree(c->name);
+		nftnl_str_release(c->name, c->interned, NFTNL_CHAIN_NAME);
 		break;
 	case NFTNL_CHAIN_TABLE:
-		xfree(c->table);
+		nftnl_str_release(c->table, c->interned, NFTNL_CHAIN_TABLE);
 		break;
 	case NFTNL_CHAIN_USE:
 		break;
@@ -169,17 +175,19 @@ int nftnl_chain_set_data(struct nftnl_chain *c, uint16_t attr,
 	switch(attr) {
 	case NFTNL_CHAIN_NAME:
 		if (c->flags & (1 << NFTNL_CHAIN_NAME))
-			xfree(c->name);
+			nftnl_str_release(c->name, c->interned, NFTNL_CHAIN_NAME);
 
 		c->name = strdup(data);
+		c->interned &= ~(1 << NFTNL_CHAIN_NAME);
 		if (!c->name)
 			return -1;
 		break;
 	case NFTNL_CHAIN_TABLE:
 		if (c->flags & (1 << NFTNL_CHAIN_TABLE))
-			xfree(c->table);
+			nftnl_str_release(c->table, c->interned, NFTNL_CHAIN_TABLE);
 
 		c->table = strdup(data);
+		c->interned &= ~(1 << NFTNL_CHAIN_TABLE);
 		if (!c->table)
 			return -1;
 		break;
@@ -541,16 +549,18 @@ int nftnl_chain_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_chain *c)
 
 	if (tb[NFTA_CHAIN_NAME]) {
 		if (c->flags & (1 << NFTNL_CHAIN_NAME))
-			xfree(c->name);
-		c->name = strdup(mnl_attr_get_str(tb[NFTA_CHAIN_NAME]));
+			nftnl_str_release(c->name, c->interned, NFTNL_CHAIN_NAME);
+		c->name = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_CHAIN_NAME]),
+						&c->interned, NFTNL_CHAIN_NAME);
 		if (!c->name)
 			return -1;
 		c->flags |= (1 << NFTNL_CHAIN_NAME);
 	}
 	if (tb[NFTA_CHAIN_TABLE]) {
 		if (c->flags & (1 << NFTNL_CHAIN_TABLE))
-			xfree(c->table);
-		c->table = strdup(mnl_attr_get_str(tb[NFTA_CHAIN_TABLE]));
+			nftnl_str_release(c->table, c->interned, NFTNL_CHAIN_TABLE);
+		c->table = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_CHAIN_TABLE]),
+						&c->interned, NFTNL_CHAIN_TABLE);
 		if (!c->table)
 			return -1;
 		c->flags |= (1 << NFTNL_CHAIN_TABLE);
@@ -877,8 +887,80 @@ int nftnl_chain_fprintf(FILE *fp, const struct nftnl_chain *c, uint32_t type,
 
 struct nftnl_chain_list {
 	struct list_head list;
+	struct {
+		struct hlist_head	*buckets;
+		uint32_t		size;
+		uint32_t		count;
+	} hash;
 };
 
+#define NFTNL_CHAIN_LIST_HSIZE_MIN	64
+
+#define NFTNL_CHAIN_KEY	((1 << NFTNL_CHAIN_TABLE) | (1 << NFTNL_CHAIN_NAME))
+
+/* Chains that share a key are kept in the order of the list, so that lookups
+ * return the same chain whether the list is indexed or not.
+ */
+static void nftnl_chain_list_hash_insert(struct hlist_head *buckets,
+					 uint32_t size, struct nftnl_chain *c,
+					 bool tail)
+{
+	uint32_t hash = nftnl_name_hash(c->family, c->table, c->name);
+	struct hlist_head *bucket = &buckets[hash & (size - 1)];
+	struct hlist_node *last;
+
+	if (!tail || hlist_empty(bucket)) {
+		hlist_add_head(&c->hnode, bucket);
+		return;
+	}
+
+	for (last = bucket->first; last->next; last = last->next)
+		;
+	hlist_add_after(last, &c->hnode);
+}
+
+static int nftnl_chain_list_hash_resize(struct nftnl_chain_list *list,
+					uint32_t size)
+{
+	struct hlist_node *pos, *n;
+	struct hlist_head *buckets;
+	struct nftnl_chain *c;
+	uint32_t i;
+
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < list->hash.size; i++) {
+		hlist_for_each_entry_safe(c, pos, n, &list->hash.buckets[i],
+					  hnode)
+			nftnl_chain_list_hash_insert(buckets, size, c, true);
+	}
+	xfree(list->hash.buckets);
+
+	list->hash.buckets = buckets;
+	list->hash.size = size;
+
+	return 0;
+}
+
+static void nftnl_chain_list_hash_add(struct nftnl_chain_list *list,
+				      struct nftnl_chain *c, bool tail)
+{
+	if (list->hash.size == 0 ||
+	    (c->flags & NFTNL_CHAIN_KEY) != NFTNL_CHAIN_KEY)
+		return;
+
+	/* If we cannot grow, keep going with a higher load factor. */
+	if (list->hash.count >= list->hash.size)
+		nftnl_chain_list_hash_resize(list, list->hash.size * 2);
+
+	nftnl_chain_list_hash_insert(list->hash.buckets, list->hash.size, c,
+				     tail);
+	c->list = list;
+	list->hash.count++;
+}
+
 EXPORT_SYMBOL(nftnl_chain_list_alloc);
 struct nftnl_chain_list *nftnl_chain_list_alloc(void)
 {
@@ -902,6 +984,7 @@ void nftnl_chain_list_free(struct nftnl_chain_list *list)
 		list_del(&r->head);
 		nftnl_chain_free(r);
 	}
+	xfree(list->hash.buckets);
 	xfree(list);
 }
 
@@ -915,20 +998,93 @@ EXPORT_SYMBOL(nftnl_chain_list_add);
 void nftnl_chain_list_add(struct nftnl_chain *r, struct nftnl_chain_list *list)
 {
 	list_add(&r->head, &list->list);
+	nftnl_chain_list_hash_add(list, r, false);
 }
 
 EXPORT_SYMBOL(nftnl_chain_list_add_tail);
 void nftnl_chain_list_add_tail(struct nftnl_chain *r, struct nftnl_chain_list *list)
 {
 	list_add_tail(&r->head, &list->list);
+	nftnl_chain_list_hash_add(list, r, true);
 }
 
 EXPORT_SYMBOL(nftnl_chain_list_del);
 void nftnl_chain_list_del(struct nftnl_chain *r)
 {
+	if (!hlist_unhashed(&r->hnode)) {
+		hlist_del_init(&r->hnode);
+		r->list->hash.count--;
+		r->list = NULL;
+	}
 	list_del(&r->head);
 }
 
+/* Chains are indexed by family, table and name when they are added to the
+ * list, hence these must not be updated while the chain is in an indexed list.
+ */
+EXPORT_SYMBOL(nftnl_chain_list_hash_enable);
+int nftnl_chain_list_hash_enable(struct nftnl_chain_list *list)
+{
+	uint32_t size = NFTNL_CHAIN_LIST_HSIZE_MIN;
+	struct nftnl_chain *c;
+	uint32_t count = 0;
+
+	if (list->hash.size)
+		return 0;
+
+	list_for_each_entry(c, &list->list, head)
+		count++;
+
+	while (size < count)
+		size <<= 1;
+
+	if (nftnl_chain_list_hash_resize(list, size) < 0)
+		return -1;
+
+	list_for_each_entry(c, &list->list, head)
+		nftnl_chain_list_hash_add(list, c, true);
+
+	return 0;
+}
+
+static bool nftnl_chain_key_eq(const struct nftnl_chain *c, uint32_t family,
+			       const char *table, const char *name)
+{
+	return (c->flags & NFTNL_CHAIN_KEY) == NFTNL_CHAIN_KEY &&
+	       c->family == family &&
+	       !strcmp(c->name, name) &&
+	       !strcmp(c->table, table);
+}
+
+EXPORT_SYMBOL(nftnl_chain_list_lookup_byname);
+struct nftnl_chain *
+nftnl_chain_list_lookup_byname(const struct nftnl_chain_list *list,
+			       uint32_t family, const char *table,
+			       const char *name)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *pos;
+	struct nftnl_chain *c;
+	uint32_t hash;
+
+	/* No index on this list, fall back to walking it. */
+	if (list->hash.size == 0) {
+		list_for_each_entry(c, &list->list, head) {
+			if (nftnl_chain_key_eq(c, family, table, name))
+				return c;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_name_hash(family, table, name);
+	bucket = &list->hash.buckets[hash & (list->hash.size - 1)];
+	hlist_for_each_entry(c, pos, bucket, hnode) {
+		if (nftnl_chain_key_eq(c, family, table, name))
+			return c;
+	}
+	return NULL;
+}
+
 EXPORT_SYMBOL(nftnl_chain_list_foreach);
 int nftnl_chain_list_foreach(struct nftnl_chain_list *chain_list,
 			   int (*cb)(struct nftnl_chain *r, void *data),
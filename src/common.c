@@ -125,11 +125,11 @@ static int nftnl_cmd_header_fprintf_cb(char *buf, size_t size, const void *obj,
 	return nftnl_cmd_header_snprintf(buf, size, cmd, type, flags);
 }
 
-int nftnl_cmd_header_fprintf(FILE *fp, uint32_t cmd, uint32_t type,
-			   uint32_t flags)
+int nftnl_cmd_header_buf(struct nftnl_buf *b, uint32_t cmd, uint32_t type,
+			 uint32_t flags)
 {
-	return nftnl_fprintf(fp, NULL, cmd, type, flags,
-			   nftnl_cmd_header_fprintf_cb);
+	return nftnl_buf_snprintf(b, NULL, cmd, type, flags,
+				  nftnl_cmd_header_fprintf_cb);
 }
 
 int nftnl_cmd_footer_snprintf(char *buf, size_t size, uint32_t cmd, uint32_t type,
@@ -158,11 +158,11 @@ static int nftnl_cmd_footer_fprintf_cb(char *buf, size_t size, const void *obj,
 	return nftnl_cmd_footer_snprintf(buf, size, cmd, type, flags);
 }
 
-int nftnl_cmd_footer_fprintf(FILE *fp, uint32_t cmd, uint32_t type,
-			   uint32_t flags)
+int nftnl_cmd_footer_buf(struct nftnl_buf *b, uint32_t cmd, uint32_t type,
+			 uint32_t flags)
 {
-	return nftnl_fprintf(fp, NULL, cmd, type, flags,
-			   nftnl_cmd_footer_fprintf_cb);
+	return nftnl_buf_snprintf(b, NULL, cmd, type, flags,
+				  nftnl_cmd_footer_fprintf_cb);
 }
 
 EXPORT_SYMBOL(nftnl_batch_begin);
@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 #include <netinet/in.h>
 
 #include <libmnl/libmnl.h>
@@ -24,17 +25,188 @@
 
 #include <libnftnl/expr.h>
 
-EXPORT_SYMBOL(nftnl_expr_alloc);
-struct nftnl_expr *nftnl_expr_alloc(const char *name)
+/* Released expressions are kept in per-thread lists, one per size class, and
+ * handed out again to the next allocations of the same size class. A thread
+ * key releases the lists of exiting threads.
+ */
+#define NFTNL_EXPR_CACHE_ALIGN		16
+#define NFTNL_EXPR_CACHE_CLASSES	32
+
+#ifdef EXPR_CACHE
+#define NFTNL_EXPR_CACHE_DEFAULT	65536
+#else
+#define NFTNL_EXPR_CACHE_DEFAULT	0
+#endif
+
+struct nftnl_expr_cache_obj {
+	struct nftnl_expr_cache_obj	*next;
+};
+
+static __thread struct {
+	struct nftnl_expr_cache_obj	*list[NFTNL_EXPR_CACHE_CLASSES];
+	uint32_t			len[NFTNL_EXPR_CACHE_CLASSES];
+	uint64_t			stats[__NFTNL_EXPR_CACHE_MAX];
+	bool				registered;
+} nftnl_expr_cache;
+
+/* Accessed with atomics, threads read it while others update it. */
+static uint32_t nftnl_expr_cache_size = NFTNL_EXPR_CACHE_DEFAULT;
+
+static pthread_once_t nftnl_expr_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t nftnl_expr_cache_key;
+static bool nftnl_expr_cache_key_ready;
+
+static void nftnl_expr_cache_exit(void *data)
 {
-	struct nftnl_expr *expr;
-	struct expr_ops *ops;
+	nftnl_expr_cache_flush();
+	/* Later thread destructors may cache expressions again. */
+	nftnl_expr_cache.registered = false;
+}
 
-	ops = nftnl_expr_ops_lookup(name);
-	if (ops == NULL)
-		return NULL;
+static void nftnl_expr_cache_key_init(void)
+{
+	nftnl_expr_cache_key_ready =
+		pthread_key_create(&nftnl_expr_cache_key,
+				   nftnl_expr_cache_exit) == 0;
+}
+
+/* The key is only set by threads that cache expressions, its destructor is
+ * not called otherwise.
+ */
+static bool nftnl_expr_cache_register(void)
+{
+	if (nftnl_expr_cache.registered)
+		return true;
+
+	pthread_once(&nftnl_expr_cache_once, nftnl_expr_cache_key_init);
+	if (!nftnl_expr_cache_key_ready ||
+	    pthread_setspecific(nftnl_expr_cache_key, &nftnl_expr_cache) != 0)
+		return false;
+
+	nftnl_expr_cache.registered = true;
+	return true;
+}
+
+static uint32_t nftnl_expr_cache_limit(void)
+{
+	uint32_t size = __atomic_load_n(&nftnl_expr_cache_size,
+					__ATOMIC_RELAXED);
+
+	/* The cache was turned off, maybe by another thread. */
+	if (size == 0 && nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_OBJS])
+		nftnl_expr_cache_flush();
+
+	return size;
+}
 
-	expr = calloc(1, sizeof(struct nftnl_expr) + ops->alloc_len);
+static size_t nftnl_expr_size(const struct expr_ops *ops)
+{
+	return sizeof(struct nftnl_expr) + ops->alloc_len;
+}
+
+static uint32_t nftnl_expr_cache_class(size_t size)
+{
+	return (size - 1) / NFTNL_EXPR_CACHE_ALIGN;
+}
+
+static struct nftnl_expr *nftnl_expr_mem_alloc(const struct expr_ops *ops)
+{
+	size_t size = nftnl_expr_size(ops);
+	uint32_t class = nftnl_expr_cache_class(size);
+	struct nftnl_expr_cache_obj *obj;
+
+	nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_ALLOC]++;
+
+	if (class < NFTNL_EXPR_CACHE_CLASSES && nftnl_expr_cache_limit() &&
+	    nftnl_expr_cache.list[class]) {
+		obj = nftnl_expr_cache.list[class];
+		nftnl_expr_cache.list[class] = obj->next;
+		nftnl_expr_cache.len[class]--;
+		nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_OBJS]--;
+
+		memset(obj, 0, size);
+		return (struct nftnl_expr *)obj;
+	}
+
+	nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_MALLOC]++;
+
+	/* Round up so the object fits any expression of its size class. */
+	if (class < NFTNL_EXPR_CACHE_CLASSES)
+		size = (class + 1) * NFTNL_EXPR_CACHE_ALIGN;
+
+	return calloc(1, size);
+}
+
+static void nftnl_expr_mem_free(const struct nftnl_expr *expr)
+{
+	uint32_t class = nftnl_expr_cache_class(nftnl_expr_size(expr->ops));
+	struct nftnl_expr_cache_obj *obj = (struct nftnl_expr_cache_obj *)expr;
+
+	nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_FREE]++;
+
+	if (class >= NFTNL_EXPR_CACHE_CLASSES ||
+	    nftnl_expr_cache.len[class] >= nftnl_expr_cache_limit() ||
+	    !nftnl_expr_cache_register()) {
+		xfree(expr);
+		return;
+	}
+
+	obj->next = nftnl_expr_cache.list[class];
+	nftnl_expr_cache.list[class] = obj;
+	nftnl_expr_cache.len[class]++;
+	nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_OBJS]++;
+}
+
+/* Release the expressions that are kept for reuse by the calling thread. This
+ * is done anyway when the thread exits.
+ */
+EXPORT_SYMBOL(nftnl_expr_cache_flush);
+void nftnl_expr_cache_flush(void)
+{
+	struct nftnl_expr_cache_obj *obj;
+	uint32_t i;
+
+	for (i = 0; i < NFTNL_EXPR_CACHE_CLASSES; i++) {
+		while (nftnl_expr_cache.list[i]) {
+			obj = nftnl_expr_cache.list[i];
+			nftnl_expr_cache.list[i] = obj->next;
+			xfree(obj);
+		}
+		nftnl_expr_cache.len[i] = 0;
+	}
+	nftnl_expr_cache.stats[NFTNL_EXPR_CACHE_OBJS] = 0;
+}
+
+/* Set the number of released expressions that are kept for reuse, per thread
+ * and size class. Zero turns the cache off, which is the default unless the
+ * library is configured with --enable-expr-cache. The calling thread then
+ * releases its expressions right away, other threads do on their next
+ * expression allocation or release, or when they exit.
+ */
+EXPORT_SYMBOL(nftnl_expr_cache_set_size);
+void nftnl_expr_cache_set_size(uint32_t size)
+{
+	__atomic_store_n(&nftnl_expr_cache_size, size, __ATOMIC_RELAXED);
+
+	if (size == 0)
+		nftnl_expr_cache_flush();
+}
+
+/* Counters are per thread. */
+EXPORT_SYMBOL(nftnl_expr_cache_get_u64);
+uint64_t nftnl_expr_cache_get_u64(uint16_t attr)
+{
+	if (attr >= __NFTNL_EXPR_CACHE_MAX)
+		return 0;
+
+	return nftnl_expr_cache.stats[attr];
+}
+
+static struct nftnl_expr *__nftnl_expr_alloc(struct expr_ops *ops)
+{
+	struct nftnl_expr *expr;
+
+	expr = nftnl_expr_mem_alloc(ops);
 	if (expr == NULL)
 		return NULL;
 
@@ -45,13 +217,38 @@ struct nftnl_expr *nftnl_expr_alloc(const char *name)
 	return expr;
 }
 
+EXPORT_SYMBOL(nftnl_expr_alloc);
+struct nftnl_expr *nftnl_expr_alloc(const char *name)
+{
+	struct expr_ops *ops;
+
+	ops = nftnl_expr_ops_lookup(name);
+	if (ops == NULL)
+		return NULL;
+
+	return __nftnl_expr_alloc(ops);
+}
+
+/* Same as nftnl_expr_alloc(), without looking up the expression by name. */
+EXPORT_SYMBOL(nftnl_expr_alloc_type);
+struct nftnl_expr *nftnl_expr_alloc_type(uint32_t type)
+{
+	struct expr_ops *ops;
+
+	ops = nftnl_expr_ops_lookup_type(type);
+	if (ops == NULL)
+		return NULL;
+
+	return __nftnl_expr_alloc(ops);
+}
+
 EXPORT_SYMBOL(nftnl_expr_free);
 void nftnl_expr_free(const struct nftnl_expr *expr)
 {
 	if (expr->ops->free)
 		expr->ops->free(expr);
 
-	xfree(expr);
+	nftnl_expr_mem_free(expr);
 }
 
 EXPORT_SYMBOL(nftnl_expr_is_set);
@@ -210,9 +407,27 @@ bool nftnl_expr_cmp(const struct nftnl_expr *e1, const struct nftnl_expr *e2)
 	    strcmp(e1->ops->name, e2->ops->name) != 0)
 		return false;
 
+	/* Expressions that cannot be compared are never equal. */
+	if (e1->ops->cmp == NULL)
+		return false;
+
 	return e1->ops->cmp(e1, e2);
 }
 
+/* Expressions that nftnl_expr_cmp() finds equal have the same hash. */
+EXPORT_SYMBOL(nftnl_expr_hash);
+uint64_t nftnl_expr_hash(const struct nftnl_expr *e)
+{
+	uint64_t h;
+
+	h = nftnl_hash64(e->ops->name, strlen(e->ops->name), 0);
+	h = nftnl_hash64(&e->flags, sizeof(e->flags), h);
+	if (e->ops->hash)
+		h = e->ops->hash(e, h);
+
+	return h;
+}
+
 void nftnl_expr_build_payload(struct nlmsghdr *nlh, struct nftnl_expr *expr)
 {
 	struct nlattr *nest;
@@ -270,7 +485,7 @@ struct nftnl_expr *nftnl_expr_parse(struct nlattr *attr)
 	return expr;
 
 err2:
-	xfree(expr);
+	nftnl_expr_free(expr);
 err1:
 	return NULL;
 }
@@ -294,8 +509,8 @@ int nftnl_expr_snprintf(char *buf, size_t size, const struct nftnl_expr *expr,
 	return offset;
 }
 
-static int nftnl_expr_do_snprintf(char *buf, size_t size, const void *e,
-				  uint32_t cmd, uint32_t type, uint32_t flags)
+int nftnl_expr_do_snprintf(char *buf, size_t size, const void *e,
+			   uint32_t cmd, uint32_t type, uint32_t flags)
 {
 	return nftnl_expr_snprintf(buf, size, e, type, flags);
 }
@@ -290,11 +290,30 @@ static bool nftnl_expr_bitwise_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_bitwise_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_bitwise *bitwise = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_BITWISE_SREG))
+		h = nftnl_hash64(&bitwise->sreg, sizeof(bitwise->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_BITWISE_DREG))
+		h = nftnl_hash64(&bitwise->dreg, sizeof(bitwise->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_BITWISE_LEN))
+		h = nftnl_hash64(&bitwise->len, sizeof(bitwise->len), h);
+	if (e->flags & (1 << NFTNL_EXPR_BITWISE_MASK))
+		h = nftnl_data_reg_hash(&bitwise->mask, DATA_VALUE, h);
+	if (e->flags & (1 << NFTNL_EXPR_BITWISE_XOR))
+		h = nftnl_data_reg_hash(&bitwise->xor, DATA_VALUE, h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_bitwise = {
 	.name		= "bitwise",
 	.alloc_len	= sizeof(struct nftnl_expr_bitwise),
 	.max_attr	= NFTA_BITWISE_MAX,
 	.cmp		= nftnl_expr_bitwise_cmp,
+	.hash		= nftnl_expr_bitwise_hash,
 	.set		= nftnl_expr_bitwise_set,
 	.get		= nftnl_expr_bitwise_get,
 	.parse		= nftnl_expr_bitwise_parse,
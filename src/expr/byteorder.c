@@ -305,11 +305,31 @@ static bool nftnl_expr_byteorder_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_byteorder_hash(const struct nftnl_expr *e,
+					  uint64_t h)
+{
+	struct nftnl_expr_byteorder *byteorder = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_BYTEORDER_SREG))
+		h = nftnl_hash64(&byteorder->sreg, sizeof(byteorder->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_BYTEORDER_DREG))
+		h = nftnl_hash64(&byteorder->dreg, sizeof(byteorder->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_BYTEORDER_OP))
+		h = nftnl_hash64(&byteorder->op, sizeof(byteorder->op), h);
+	if (e->flags & (1 << NFTNL_EXPR_BYTEORDER_LEN))
+		h = nftnl_hash64(&byteorder->len, sizeof(byteorder->len), h);
+	if (e->flags & (1 << NFTNL_EXPR_BYTEORDER_SIZE))
+		h = nftnl_hash64(&byteorder->size, sizeof(byteorder->size), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_byteorder = {
 	.name		= "byteorder",
 	.alloc_len	= sizeof(struct nftnl_expr_byteorder),
 	.max_attr	= NFTA_BYTEORDER_MAX,
 	.cmp		= nftnl_expr_byteorder_cmp,
+	.hash		= nftnl_expr_byteorder_hash,
 	.set		= nftnl_expr_byteorder_set,
 	.get		= nftnl_expr_byteorder_get,
 	.parse		= nftnl_expr_byteorder_parse,
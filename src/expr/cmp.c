@@ -275,11 +275,26 @@ static bool nftnl_expr_cmp_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_cmp_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_cmp *cmp = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_CMP_DATA))
+		h = nftnl_data_reg_hash(&cmp->data, DATA_VALUE, h);
+	if (e->flags & (1 << NFTNL_EXPR_CMP_SREG))
+		h = nftnl_hash64(&cmp->sreg, sizeof(cmp->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_CMP_OP))
+		h = nftnl_hash64(&cmp->op, sizeof(cmp->op), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_cmp = {
 	.name		= "cmp",
 	.alloc_len	= sizeof(struct nftnl_expr_cmp),
 	.max_attr	= NFTA_CMP_MAX,
 	.cmp		= nftnl_expr_cmp_cmp,
+	.hash		= nftnl_expr_cmp_hash,
 	.set		= nftnl_expr_cmp_set,
 	.get		= nftnl_expr_cmp_get,
 	.parse		= nftnl_expr_cmp_parse,
@@ -155,9 +155,18 @@ static int nftnl_expr_counter_snprintf_default(char *buf, size_t len,
 					       const struct nftnl_expr *e)
 {
 	struct nftnl_expr_counter *ctr = nftnl_expr_data(e);
-
-	return snprintf(buf, len, "pkts %"PRIu64" bytes %"PRIu64" ",
-			ctr->pkts, ctr->bytes);
+	char tmp[2 * NFTNL_FMT_U64_LEN + 13];
+	int n;
+
+	memcpy(tmp, "pkts ", 5);
+	n = 5;
+	n += nftnl_fmt_u64(tmp + n, ctr->pkts);
+	memcpy(tmp + n, " bytes ", 7);
+	n += 7;
+	n += nftnl_fmt_u64(tmp + n, ctr->bytes);
+	tmp[n++] = ' ';
+
+	return nftnl_fmt_copy(buf, len, tmp, n);
 }
 
 static int nftnl_expr_counter_snprintf(char *buf, size_t len, uint32_t type,
@@ -186,16 +195,29 @@ static bool nftnl_expr_counter_cmp(const struct nftnl_expr *e1,
 	if (e1->flags & (1 << NFTNL_EXPR_CTR_PACKETS))
 		eq &= (c1->pkts == c2->pkts);
 	if (e1->flags & (1 << NFTNL_EXPR_CTR_BYTES))
-		eq &= (c1->pkts == c2->pkts);
+		eq &= (c1->bytes == c2->bytes);
 
 	return eq;
 }
 
+static uint64_t nftnl_expr_counter_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_counter *ctr = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_CTR_PACKETS))
+		h = nftnl_hash64(&ctr->pkts, sizeof(ctr->pkts), h);
+	if (e->flags & (1 << NFTNL_EXPR_CTR_BYTES))
+		h = nftnl_hash64(&ctr->bytes, sizeof(ctr->bytes), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_counter = {
 	.name		= "counter",
 	.alloc_len	= sizeof(struct nftnl_expr_counter),
 	.max_attr	= NFTA_COUNTER_MAX,
 	.cmp		= nftnl_expr_counter_cmp,
+	.hash		= nftnl_expr_counter_hash,
 	.set		= nftnl_expr_counter_set,
 	.get		= nftnl_expr_counter_get,
 	.parse		= nftnl_expr_counter_parse,
@@ -348,11 +348,28 @@ static bool nftnl_expr_ct_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_ct_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_ct *ct = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_CT_KEY))
+		h = nftnl_hash64(&ct->key, sizeof(ct->key), h);
+	if (e->flags & (1 << NFTNL_EXPR_CT_DREG))
+		h = nftnl_hash64(&ct->dreg, sizeof(ct->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_CT_SREG))
+		h = nftnl_hash64(&ct->sreg, sizeof(ct->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_CT_DIR))
+		h = nftnl_hash64(&ct->dir, sizeof(ct->dir), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_ct = {
 	.name		= "ct",
 	.alloc_len	= sizeof(struct nftnl_expr_ct),
 	.max_attr	= NFTA_CT_MAX,
 	.cmp		= nftnl_expr_ct_cmp,
+	.hash		= nftnl_expr_ct_hash,
 	.set		= nftnl_expr_ct_set,
 	.get		= nftnl_expr_ct_get,
 	.parse		= nftnl_expr_ct_parse,
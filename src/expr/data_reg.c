@@ -97,14 +97,27 @@ int nftnl_data_reg_json_parse(union nftnl_data_reg *reg, json_t *data,
 }
 #endif
 
+#define NFTNL_DATA_REG_WORDS	(NFT_DATA_VALUE_MAXLEN / sizeof(uint32_t))
+
+/* Words of a register value, there are at most NFT_DATA_VALUE_MAXLEN bytes. */
+static int nftnl_data_reg_words(const union nftnl_data_reg *reg)
+{
+	int words = div_round_up(reg->len, sizeof(uint32_t));
+
+	if (words > NFTNL_DATA_REG_WORDS)
+		words = NFTNL_DATA_REG_WORDS;
+
+	return words;
+}
+
 static int
 nftnl_data_reg_value_snprintf_json(char *buf, size_t size,
 				   const union nftnl_data_reg *reg,
 				   uint32_t flags)
 {
-	int remain = size, offset = 0, ret, i, j;
-	uint32_t utemp;
-	uint8_t *tmp;
+	/* "\"data15\":\"0x%.8x\"," per word and the closing brace */
+	char tmp[NFTNL_DATA_REG_WORDS * (NFTNL_FMT_HEX32_LEN + 14) + 1];
+	int remain = size, offset = 0, ret, i, n = 0;
 
 	ret = snprintf(buf, remain, "\"reg\":{\"type\":\"value\",");
 	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
@@ -112,23 +125,24 @@ nftnl_data_reg_value_snprintf_json(char *buf, size_t size,
 	ret = snprintf(buf + offset, remain, "\"len\":%u,", reg->len);
 	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
-	for (i = 0; i < div_round_up(reg->len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf + offset, remain, "\"data%d\":\"0x", i);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-		utemp = htonl(reg->val[i]);
-		tmp = (uint8_t *)&utemp;
-
-		for (j = 0; j<sizeof(uint32_t); j++) {
-			ret = snprintf(buf + offset, remain, "%.02x", tmp[j]);
-			SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-		}
-
-		ret = snprintf(buf + offset, remain, "\",");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	for (i = 0; i < nftnl_data_reg_words(reg); i++) {
+		memcpy(tmp + n, "\"data", 5);
+		n += 5;
+		n += nftnl_fmt_u64(tmp + n, i);
+		memcpy(tmp + n, "\":\"0x", 5);
+		n += 5;
+		n += nftnl_fmt_hex32(tmp + n, reg->val[i]);
+		memcpy(tmp + n, "\",", 2);
+		n += 2;
 	}
-	offset--;
-	ret = snprintf(buf + offset, remain, "}");
+	/* Replace the trailing comma, if any, by the closing brace. */
+	if (n > 0)
+		n--;
+	else
+		offset--;
+	tmp[n++] = '}';
+
+	ret = nftnl_fmt_copy(buf + offset, remain, tmp, n);
 	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
 	return offset;
@@ -139,14 +153,17 @@ nftnl_data_reg_value_snprintf_default(char *buf, size_t size,
 				      const union nftnl_data_reg *reg,
 				      uint32_t flags)
 {
-	int remain = size, offset = 0, ret, i;
-
-	for (i = 0; i < div_round_up(reg->len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf + offset, remain, "0x%.8x ", reg->val[i]);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	char tmp[NFTNL_DATA_REG_WORDS * (NFTNL_FMT_HEX32_LEN + 3)];
+	int i, n = 0;
+
+	for (i = 0; i < nftnl_data_reg_words(reg); i++) {
+		tmp[n++] = '0';
+		tmp[n++] = 'x';
+		n += nftnl_fmt_hex32(tmp + n, reg->val[i]);
+		tmp[n++] = ' ';
 	}
 
-	return offset;
+	return nftnl_fmt_copy(buf, size, tmp, n);
 }
 
 static int
@@ -247,6 +264,22 @@ bool nftnl_data_reg_cmp(const union nftnl_data_reg *r1,
 	}
 }
 
+uint64_t nftnl_data_reg_hash(const union nftnl_data_reg *reg, int reg_type,
+			     uint64_t h)
+{
+	switch (reg_type) {
+	case DATA_VALUE:
+		return nftnl_hash64(reg->val, reg->len, h);
+	case DATA_VERDICT:
+		return nftnl_hash64(&reg->verdict, sizeof(reg->verdict), h);
+	case DATA_CHAIN:
+		h = nftnl_hash64(&reg->verdict, sizeof(reg->verdict), h);
+		return nftnl_hash64(reg->chain, strlen(reg->chain), h);
+	default:
+		return h;
+	}
+}
+
 static int nftnl_data_parse_cb(const struct nlattr *attr, void *data)
 {
 	const struct nlattr **tb = data;
@@ -291,10 +324,10 @@ static int nftnl_verdict_parse_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
-static int
-nftnl_parse_verdict(union nftnl_data_reg *data, const struct nlattr *attr, int *type)
+static int nftnl_parse_verdict_ref(struct nftnl_data_ref *ref,
+				   const struct nlattr *attr, int *type)
 {
-	struct nlattr *tb[NFTA_VERDICT_MAX+1];
+	struct nlattr *tb[NFTA_VERDICT_MAX+1] = {};
 
 	if (mnl_attr_parse_nested(attr, nftnl_verdict_parse_cb, tb) < 0)
 		return -1;
@@ -302,9 +335,9 @@ nftnl_parse_verdict(union nftnl_data_reg *data, const struct nlattr *attr, int *
 	if (!tb[NFTA_VERDICT_CODE])
 		return -1;
 
-	data->verdict = ntohl(mnl_attr_get_u32(tb[NFTA_VERDICT_CODE]));
+	ref->verdict = ntohl(mnl_attr_get_u32(tb[NFTA_VERDICT_CODE]));
 
-	switch(data->verdict) {
+	switch(ref->verdict) {
 	case NF_ACCEPT:
 	case NF_DROP:
 	case NF_QUEUE:
@@ -313,17 +346,13 @@ nftnl_parse_verdict(union nftnl_data_reg *data, const struct nlattr *attr, int *
 	case NFT_RETURN:
 		if (type)
 			*type = DATA_VERDICT;
-		data->len = sizeof(data->verdict);
 		break;
 	case NFT_JUMP:
 	case NFT_GOTO:
 		if (!tb[NFTA_VERDICT_CHAIN])
 			return -1;
 
-		data->chain = strdup(mnl_attr_get_str(tb[NFTA_VERDICT_CHAIN]));
-		if (!data->chain)
-			return -1;
-
+		ref->chain = mnl_attr_get_str(tb[NFTA_VERDICT_CHAIN]);
 		if (type)
 			*type = DATA_CHAIN;
 		break;
@@ -334,6 +363,34 @@ nftnl_parse_verdict(union nftnl_data_reg *data, const struct nlattr *attr, int *
 	return 0;
 }
 
+static int
+nftnl_parse_verdict(union nftnl_data_reg *data, const struct nlattr *attr, int *type)
+{
+	struct nftnl_data_ref ref = {};
+	int verdict_type;
+
+	if (nftnl_parse_verdict_ref(&ref, attr, &verdict_type) < 0)
+		return -1;
+
+	data->verdict = ref.verdict;
+
+	switch(verdict_type) {
+	case DATA_VERDICT:
+		data->len = sizeof(data->verdict);
+		break;
+	case DATA_CHAIN:
+		data->chain = strdup(ref.chain);
+		if (!data->chain)
+			return -1;
+		break;
+	}
+
+	if (type)
+		*type = verdict_type;
+
+	return 0;
+}
+
 static int
 __nftnl_parse_data(union nftnl_data_reg *data, const struct nlattr *attr)
 {
@@ -374,6 +431,32 @@ int nftnl_parse_data(union nftnl_data_reg *data, struct nlattr *attr, int *type)
 	return ret;
 }
 
+/* Same as nftnl_parse_data(), but nothing is copied: the value and the chain
+ * name point to the netlink message.
+ */
+int nftnl_parse_data_ref(struct nftnl_data_ref *ref, const struct nlattr *attr,
+			 int *type)
+{
+	struct nlattr *tb[NFTA_DATA_MAX+1] = {};
+
+	if (mnl_attr_parse_nested(attr, nftnl_data_parse_cb, tb) < 0)
+		return -1;
+
+	if (tb[NFTA_DATA_VALUE]) {
+		ref->val = mnl_attr_get_payload(tb[NFTA_DATA_VALUE]);
+		ref->len = mnl_attr_get_payload_len(tb[NFTA_DATA_VALUE]);
+		if (ref->len == 0 || ref->len > NFT_DATA_VALUE_MAXLEN)
+			return -1;
+
+		if (type)
+			*type = DATA_VALUE;
+	}
+	if (tb[NFTA_DATA_VERDICT])
+		return nftnl_parse_verdict_ref(ref, tb[NFTA_DATA_VERDICT], type);
+
+	return 0;
+}
+
 void nftnl_free_verdict(const union nftnl_data_reg *data)
 {
 	switch(data->verdict) {
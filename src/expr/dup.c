@@ -197,11 +197,24 @@ static bool nftnl_expr_dup_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_dup_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_dup *dup = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_DUP_SREG_ADDR))
+		h = nftnl_hash64(&dup->sreg_addr, sizeof(dup->sreg_addr), h);
+	if (e->flags & (1 << NFTNL_EXPR_DUP_SREG_DEV))
+		h = nftnl_hash64(&dup->sreg_dev, sizeof(dup->sreg_dev), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_dup = {
 	.name		= "dup",
 	.alloc_len	= sizeof(struct nftnl_expr_dup),
 	.max_attr	= NFTA_DUP_MAX,
 	.cmp		= nftnl_expr_dup_cmp,
+	.hash		= nftnl_expr_dup_hash,
 	.set		= nftnl_expr_dup_set,
 	.get		= nftnl_expr_dup_get,
 	.parse		= nftnl_expr_dup_parse,
@@ -358,12 +358,40 @@ static bool nftnl_expr_dynset_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_dynset_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_dynset *dynset = nftnl_expr_data(e);
+	uint64_t expr_hash;
+
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SREG_KEY))
+		h = nftnl_hash64(&dynset->sreg_key,
+				 sizeof(dynset->sreg_key), h);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SREG_DATA))
+		h = nftnl_hash64(&dynset->sreg_data,
+				 sizeof(dynset->sreg_data), h);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_OP))
+		h = nftnl_hash64(&dynset->op, sizeof(dynset->op), h);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_TIMEOUT))
+		h = nftnl_hash64(&dynset->timeout, sizeof(dynset->timeout), h);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_EXPR)) {
+		expr_hash = nftnl_expr_hash(dynset->expr);
+		h = nftnl_hash64(&expr_hash, sizeof(expr_hash), h);
+	}
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SET_NAME))
+		h = nftnl_hash64(dynset->set_name, strlen(dynset->set_name), h);
+	if (e->flags & (1 << NFTNL_EXPR_DYNSET_SET_ID))
+		h = nftnl_hash64(&dynset->set_id, sizeof(dynset->set_id), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_dynset = {
 	.name		= "dynset",
 	.alloc_len	= sizeof(struct nftnl_expr_dynset),
 	.max_attr	= NFTA_DYNSET_MAX,
 	.free		= nftnl_expr_dynset_free,
 	.cmp		= nftnl_expr_dynset_cmp,
+	.hash		= nftnl_expr_dynset_hash,
 	.set		= nftnl_expr_dynset_set,
 	.get		= nftnl_expr_dynset_get,
 	.parse		= nftnl_expr_dynset_parse,
@@ -376,11 +376,34 @@ static bool nftnl_expr_exthdr_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_exthdr_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_exthdr *exthdr = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_DREG))
+		h = nftnl_hash64(&exthdr->dreg, sizeof(exthdr->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_SREG))
+		h = nftnl_hash64(&exthdr->sreg, sizeof(exthdr->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_OFFSET))
+		h = nftnl_hash64(&exthdr->offset, sizeof(exthdr->offset), h);
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_LEN))
+		h = nftnl_hash64(&exthdr->len, sizeof(exthdr->len), h);
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_TYPE))
+		h = nftnl_hash64(&exthdr->type, sizeof(exthdr->type), h);
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_OP))
+		h = nftnl_hash64(&exthdr->op, sizeof(exthdr->op), h);
+	if (e->flags & (1 << NFTNL_EXPR_EXTHDR_FLAGS))
+		h = nftnl_hash64(&exthdr->flags, sizeof(exthdr->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_exthdr = {
 	.name		= "exthdr",
 	.alloc_len	= sizeof(struct nftnl_expr_exthdr),
 	.max_attr	= NFTA_EXTHDR_MAX,
 	.cmp		= nftnl_expr_exthdr_cmp,
+	.hash		= nftnl_expr_exthdr_hash,
 	.set		= nftnl_expr_exthdr_set,
 	.get		= nftnl_expr_exthdr_get,
 	.parse		= nftnl_expr_exthdr_parse,
@@ -265,11 +265,26 @@ static bool nftnl_expr_fib_cmp(const struct nftnl_expr *e1,
        return eq;
 }
 
+static uint64_t nftnl_expr_fib_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_fib *fib = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_FIB_RESULT))
+		h = nftnl_hash64(&fib->result, sizeof(fib->result), h);
+	if (e->flags & (1 << NFTNL_EXPR_FIB_DREG))
+		h = nftnl_hash64(&fib->dreg, sizeof(fib->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_FIB_FLAGS))
+		h = nftnl_hash64(&fib->flags, sizeof(fib->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_fib = {
 	.name		= "fib",
 	.alloc_len	= sizeof(struct nftnl_expr_fib),
 	.max_attr	= NFTA_FIB_MAX,
 	.cmp		= nftnl_expr_fib_cmp,
+	.hash		= nftnl_expr_fib_hash,
 	.set		= nftnl_expr_fib_set,
 	.get		= nftnl_expr_fib_get,
 	.parse		= nftnl_expr_fib_parse,
@@ -172,11 +172,22 @@ static bool nftnl_expr_fwd_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_fwd_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_fwd *fwd = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_FWD_SREG_DEV))
+		h = nftnl_hash64(&fwd->sreg_dev, sizeof(fwd->sreg_dev), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_fwd = {
 	.name		= "fwd",
 	.alloc_len	= sizeof(struct nftnl_expr_fwd),
 	.max_attr	= NFTA_FWD_MAX,
 	.cmp		= nftnl_expr_fwd_cmp,
+	.hash		= nftnl_expr_fwd_hash,
 	.set		= nftnl_expr_fwd_set,
 	.get		= nftnl_expr_fwd_get,
 	.parse		= nftnl_expr_fwd_parse,
@@ -325,11 +325,34 @@ static bool nftnl_expr_hash_cmp(const struct nftnl_expr *e1,
        return eq;
 }
 
+static uint64_t nftnl_expr_hash_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_hash *hash = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_HASH_SREG))
+		h = nftnl_hash64(&hash->sreg, sizeof(hash->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_HASH_DREG))
+		h = nftnl_hash64(&hash->dreg, sizeof(hash->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_HASH_LEN))
+		h = nftnl_hash64(&hash->len, sizeof(hash->len), h);
+	if (e->flags & (1 << NFTNL_EXPR_HASH_MODULUS))
+		h = nftnl_hash64(&hash->modulus, sizeof(hash->modulus), h);
+	if (e->flags & (1 << NFTNL_EXPR_HASH_SEED))
+		h = nftnl_hash64(&hash->seed, sizeof(hash->seed), h);
+	if (e->flags & (1 << NFTNL_EXPR_HASH_OFFSET))
+		h = nftnl_hash64(&hash->offset, sizeof(hash->offset), h);
+	if (e->flags & (1 << NFTNL_EXPR_HASH_TYPE))
+		h = nftnl_hash64(&hash->type, sizeof(hash->type), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_hash = {
 	.name		= "hash",
 	.alloc_len	= sizeof(struct nftnl_expr_hash),
 	.max_attr	= NFTA_HASH_MAX,
 	.cmp		= nftnl_expr_hash_cmp,
+	.hash		= nftnl_expr_hash_hash,
 	.set		= nftnl_expr_hash_set,
 	.get		= nftnl_expr_hash_get,
 	.parse		= nftnl_expr_hash_parse,
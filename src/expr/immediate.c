@@ -306,12 +306,35 @@ static bool nftnl_expr_immediate_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_immediate_hash(const struct nftnl_expr *e,
+					  uint64_t h)
+{
+	struct nftnl_expr_immediate *imm = nftnl_expr_data(e);
+	int type = DATA_NONE;
+
+	if (e->flags & (1 << NFTNL_EXPR_IMM_DREG))
+		h = nftnl_hash64(&imm->dreg, sizeof(imm->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_IMM_VERDICT))
+		if (e->flags & (1 << NFTNL_EXPR_IMM_CHAIN))
+			type = DATA_CHAIN;
+		else
+			type = DATA_VERDICT;
+	else if (e->flags & (1 << NFTNL_EXPR_IMM_DATA))
+		type = DATA_VALUE;
+
+	if (type != DATA_NONE)
+		h = nftnl_data_reg_hash(&imm->data, type, h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_immediate = {
 	.name		= "immediate",
 	.alloc_len	= sizeof(struct nftnl_expr_immediate),
 	.max_attr	= NFTA_IMMEDIATE_MAX,
 	.free		= nftnl_expr_immediate_free,
 	.cmp		= nftnl_expr_immediate_cmp,
+	.hash		= nftnl_expr_immediate_hash,
 	.set		= nftnl_expr_immediate_set,
 	.get		= nftnl_expr_immediate_get,
 	.parse		= nftnl_expr_immediate_parse,
@@ -276,12 +276,31 @@ static bool nftnl_expr_limit_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_limit_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_limit *limit = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_LIMIT_RATE))
+		h = nftnl_hash64(&limit->rate, sizeof(limit->rate), h);
+	if (e->flags & (1 << NFTNL_EXPR_LIMIT_UNIT))
+		h = nftnl_hash64(&limit->unit, sizeof(limit->unit), h);
+	if (e->flags & (1 << NFTNL_EXPR_LIMIT_BURST))
+		h = nftnl_hash64(&limit->burst, sizeof(limit->burst), h);
+	if (e->flags & (1 << NFTNL_EXPR_LIMIT_TYPE))
+		h = nftnl_hash64(&limit->type, sizeof(limit->type), h);
+	if (e->flags & (1 << NFTNL_EXPR_LIMIT_FLAGS))
+		h = nftnl_hash64(&limit->flags, sizeof(limit->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_limit = {
 	.name		= "limit",
 	.alloc_len	= sizeof(struct nftnl_expr_limit),
 	.max_attr	= NFTA_LIMIT_MAX,
 	.set		= nftnl_expr_limit_set,
 	.cmp		= nftnl_expr_limit_cmp,
+	.hash		= nftnl_expr_limit_hash,
 	.get		= nftnl_expr_limit_get,
 	.parse		= nftnl_expr_limit_parse,
 	.build		= nftnl_expr_limit_build,
@@ -38,7 +38,7 @@ static int nftnl_expr_log_set(struct nftnl_expr *e, uint16_t type,
 
 	switch(type) {
 	case NFTNL_EXPR_LOG_PREFIX:
-		if (log->flags & (1 << NFTNL_EXPR_LOG_PREFIX))
+		if (e->flags & (1 << NFTNL_EXPR_LOG_PREFIX))
 			xfree(log->prefix);
 
 		log->prefix = strdup(data);
@@ -343,12 +343,33 @@ static bool nftnl_expr_log_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_log_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_log *log = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_LOG_SNAPLEN))
+		h = nftnl_hash64(&log->snaplen, sizeof(log->snaplen), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOG_GROUP))
+		h = nftnl_hash64(&log->group, sizeof(log->group), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOG_QTHRESHOLD))
+		h = nftnl_hash64(&log->qthreshold, sizeof(log->qthreshold), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOG_LEVEL))
+		h = nftnl_hash64(&log->level, sizeof(log->level), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOG_FLAGS))
+		h = nftnl_hash64(&log->flags, sizeof(log->flags), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOG_PREFIX))
+		h = nftnl_hash64(log->prefix, strlen(log->prefix), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_log = {
 	.name		= "log",
 	.alloc_len	= sizeof(struct nftnl_expr_log),
 	.max_attr	= NFTA_LOG_MAX,
 	.free		= nftnl_expr_log_free,
 	.cmp		= nftnl_expr_log_cmp,
+	.hash		= nftnl_expr_log_hash,
 	.set		= nftnl_expr_log_set,
 	.get		= nftnl_expr_log_get,
 	.parse		= nftnl_expr_log_parse,
@@ -282,12 +282,31 @@ static bool nftnl_expr_lookup_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_lookup_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_lookup *lookup = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_LOOKUP_SREG))
+		h = nftnl_hash64(&lookup->sreg, sizeof(lookup->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOOKUP_DREG))
+		h = nftnl_hash64(&lookup->dreg, sizeof(lookup->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOOKUP_SET))
+		h = nftnl_hash64(lookup->set_name, strlen(lookup->set_name), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOOKUP_SET_ID))
+		h = nftnl_hash64(&lookup->set_id, sizeof(lookup->set_id), h);
+	if (e->flags & (1 << NFTNL_EXPR_LOOKUP_FLAGS))
+		h = nftnl_hash64(&lookup->flags, sizeof(lookup->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_lookup = {
 	.name		= "lookup",
 	.alloc_len	= sizeof(struct nftnl_expr_lookup),
 	.max_attr	= NFTA_LOOKUP_MAX,
 	.free		= nftnl_expr_lookup_free,
 	.cmp		= nftnl_expr_lookup_cmp,
+	.hash		= nftnl_expr_lookup_hash,
 	.set		= nftnl_expr_lookup_set,
 	.get		= nftnl_expr_lookup_get,
 	.parse		= nftnl_expr_lookup_parse,
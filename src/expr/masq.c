@@ -219,11 +219,28 @@ static bool nftnl_expr_masq_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_masq_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_masq *masq = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_MASQ_FLAGS))
+		h = nftnl_hash64(&masq->flags, sizeof(masq->flags), h);
+	if (e->flags & (1 << NFTNL_EXPR_MASQ_REG_PROTO_MIN))
+		h = nftnl_hash64(&masq->sreg_proto_min,
+				 sizeof(masq->sreg_proto_min), h);
+	if (e->flags & (1 << NFTNL_EXPR_MASQ_REG_PROTO_MAX))
+		h = nftnl_hash64(&masq->sreg_proto_max,
+				 sizeof(masq->sreg_proto_max), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_masq = {
 	.name		= "masq",
 	.alloc_len	= sizeof(struct nftnl_expr_masq),
 	.max_attr	= NFTA_MASQ_MAX,
 	.cmp		= nftnl_expr_masq_cmp,
+	.hash		= nftnl_expr_masq_hash,
 	.set		= nftnl_expr_masq_set,
 	.get		= nftnl_expr_masq_get,
 	.parse		= nftnl_expr_masq_parse,
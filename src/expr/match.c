@@ -239,12 +239,29 @@ static bool nftnl_expr_match_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_match_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_match *mt = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_MT_NAME))
+		h = nftnl_hash64(mt->name, strlen(mt->name), h);
+	if (e->flags & (1 << NFTNL_EXPR_MT_REV))
+		h = nftnl_hash64(&mt->rev, sizeof(mt->rev), h);
+	if (e->flags & (1 << NFTNL_EXPR_MT_INFO)) {
+		h = nftnl_hash64(&mt->data_len, sizeof(mt->data_len), h);
+		h = nftnl_hash64(mt->data, mt->data_len, h);
+	}
+
+	return h;
+}
+
 struct expr_ops expr_ops_match = {
 	.name		= "match",
 	.alloc_len	= sizeof(struct nftnl_expr_match),
 	.max_attr	= NFTA_MATCH_MAX,
 	.free		= nftnl_expr_match_free,
 	.cmp		= nftnl_expr_match_cmp,
+	.hash		= nftnl_expr_match_hash,
 	.set		= nftnl_expr_match_set,
 	.get		= nftnl_expr_match_get,
 	.parse		= nftnl_expr_match_parse,
@@ -282,11 +282,26 @@ static bool nftnl_expr_meta_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_meta_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_meta *meta = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_META_KEY))
+		h = nftnl_hash64(&meta->key, sizeof(meta->key), h);
+	if (e->flags & (1 << NFTNL_EXPR_META_DREG))
+		h = nftnl_hash64(&meta->dreg, sizeof(meta->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_META_SREG))
+		h = nftnl_hash64(&meta->sreg, sizeof(meta->sreg), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_meta = {
 	.name		= "meta",
 	.alloc_len	= sizeof(struct nftnl_expr_meta),
 	.max_attr	= NFTA_META_MAX,
 	.cmp		= nftnl_expr_meta_cmp,
+	.hash		= nftnl_expr_meta_hash,
 	.set		= nftnl_expr_meta_set,
 	.get		= nftnl_expr_meta_get,
 	.parse		= nftnl_expr_meta_parse,
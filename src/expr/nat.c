@@ -375,11 +375,38 @@ static bool nftnl_expr_nat_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_nat_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_nat *nat = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_NAT_REG_ADDR_MIN))
+		h = nftnl_hash64(&nat->sreg_addr_min,
+				 sizeof(nat->sreg_addr_min), h);
+	if (e->flags & (1 << NFTNL_EXPR_NAT_REG_ADDR_MAX))
+		h = nftnl_hash64(&nat->sreg_addr_max,
+				 sizeof(nat->sreg_addr_max), h);
+	if (e->flags & (1 << NFTNL_EXPR_NAT_REG_PROTO_MIN))
+		h = nftnl_hash64(&nat->sreg_proto_min,
+				 sizeof(nat->sreg_proto_min), h);
+	if (e->flags & (1 << NFTNL_EXPR_NAT_REG_PROTO_MAX))
+		h = nftnl_hash64(&nat->sreg_proto_max,
+				 sizeof(nat->sreg_proto_max), h);
+	if (e->flags & (1 << NFTNL_EXPR_NAT_FAMILY))
+		h = nftnl_hash64(&nat->family, sizeof(nat->family), h);
+	if (e->flags & (1 << NFTNL_EXPR_NAT_TYPE))
+		h = nftnl_hash64(&nat->type, sizeof(nat->type), h);
+	if (e->flags & (1 << NFTNL_EXPR_NAT_FLAGS))
+		h = nftnl_hash64(&nat->flags, sizeof(nat->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_nat = {
 	.name		= "nat",
 	.alloc_len	= sizeof(struct nftnl_expr_nat),
 	.max_attr	= NFTA_NAT_MAX,
 	.cmp		= nftnl_expr_nat_cmp,
+	.hash		= nftnl_expr_nat_hash,
 	.set		= nftnl_expr_nat_set,
 	.get		= nftnl_expr_nat_get,
 	.parse		= nftnl_expr_nat_parse,
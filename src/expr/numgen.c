@@ -255,11 +255,28 @@ static bool nftnl_expr_ng_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_ng_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_ng *ng = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_NG_DREG))
+		h = nftnl_hash64(&ng->dreg, sizeof(ng->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_NG_MODULUS))
+		h = nftnl_hash64(&ng->modulus, sizeof(ng->modulus), h);
+	if (e->flags & (1 << NFTNL_EXPR_NG_TYPE))
+		h = nftnl_hash64(&ng->type, sizeof(ng->type), h);
+	if (e->flags & (1 << NFTNL_EXPR_NG_OFFSET))
+		h = nftnl_hash64(&ng->offset, sizeof(ng->offset), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_ng = {
 	.name		= "numgen",
 	.alloc_len	= sizeof(struct nftnl_expr_ng),
 	.max_attr	= NFTA_NG_MAX,
 	.cmp		= nftnl_expr_ng_cmp,
+	.hash		= nftnl_expr_ng_hash,
 	.set		= nftnl_expr_ng_set,
 	.get		= nftnl_expr_ng_get,
 	.parse		= nftnl_expr_ng_parse,
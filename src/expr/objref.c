@@ -269,11 +269,32 @@ static bool nftnl_expr_objref_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_objref_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_objref *objref = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_OBJREF_IMM_TYPE))
+		h = nftnl_hash64(&objref->imm.type,
+				 sizeof(objref->imm.type), h);
+	if (e->flags & (1 << NFTNL_EXPR_OBJREF_IMM_NAME))
+		h = nftnl_hash64(objref->imm.name, strlen(objref->imm.name), h);
+	if (e->flags & (1 << NFTNL_EXPR_OBJREF_SET_SREG))
+		h = nftnl_hash64(&objref->set.sreg,
+				 sizeof(objref->set.sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_OBJREF_SET_NAME))
+		h = nftnl_hash64(objref->set.name, strlen(objref->set.name), h);
+	if (e->flags & (1 << NFTNL_EXPR_OBJREF_SET_ID))
+		h = nftnl_hash64(&objref->set.id, sizeof(objref->set.id), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_objref = {
 	.name		= "objref",
 	.alloc_len	= sizeof(struct nftnl_expr_objref),
 	.max_attr	= NFTA_OBJREF_MAX,
 	.cmp		= nftnl_expr_objref_cmp,
+	.hash		= nftnl_expr_objref_hash,
 	.set		= nftnl_expr_objref_set,
 	.get		= nftnl_expr_objref_get,
 	.parse		= nftnl_expr_objref_parse,
@@ -339,11 +339,39 @@ static bool nftnl_expr_payload_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_payload_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_payload *payload = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_SREG))
+		h = nftnl_hash64(&payload->sreg, sizeof(payload->sreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_DREG))
+		h = nftnl_hash64(&payload->dreg, sizeof(payload->dreg), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_BASE))
+		h = nftnl_hash64(&payload->base, sizeof(payload->base), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_OFFSET))
+		h = nftnl_hash64(&payload->offset, sizeof(payload->offset), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_LEN))
+		h = nftnl_hash64(&payload->len, sizeof(payload->len), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_CSUM_TYPE))
+		h = nftnl_hash64(&payload->csum_type,
+				 sizeof(payload->csum_type), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_CSUM_OFFSET))
+		h = nftnl_hash64(&payload->csum_offset,
+				 sizeof(payload->csum_offset), h);
+	if (e->flags & (1 << NFTNL_EXPR_PAYLOAD_FLAGS))
+		h = nftnl_hash64(&payload->csum_flags,
+				 sizeof(payload->csum_flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_payload = {
 	.name		= "payload",
 	.alloc_len	= sizeof(struct nftnl_expr_payload),
 	.max_attr	= NFTA_PAYLOAD_MAX,
 	.cmp		= nftnl_expr_payload_cmp,
+	.hash		= nftnl_expr_payload_hash,
 	.set		= nftnl_expr_payload_set,
 	.get		= nftnl_expr_payload_get,
 	.parse		= nftnl_expr_payload_parse,
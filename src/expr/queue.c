@@ -266,11 +266,30 @@ static bool nftnl_expr_queue_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_queue_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_queue *queue = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_QUEUE_NUM))
+		h = nftnl_hash64(&queue->queuenum, sizeof(queue->queuenum), h);
+	if (e->flags & (1 << NFTNL_EXPR_QUEUE_TOTAL))
+		h = nftnl_hash64(&queue->queues_total,
+				 sizeof(queue->queues_total), h);
+	if (e->flags & (1 << NFTNL_EXPR_QUEUE_FLAGS))
+		h = nftnl_hash64(&queue->flags, sizeof(queue->flags), h);
+	if (e->flags & (1 << NFTNL_EXPR_QUEUE_SREG_QNUM))
+		h = nftnl_hash64(&queue->sreg_qnum,
+				 sizeof(queue->sreg_qnum), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_queue = {
 	.name		= "queue",
 	.alloc_len	= sizeof(struct nftnl_expr_queue),
 	.max_attr	= NFTA_QUEUE_MAX,
 	.cmp		= nftnl_expr_queue_cmp,
+	.hash		= nftnl_expr_queue_hash,
 	.set		= nftnl_expr_queue_set,
 	.get		= nftnl_expr_queue_get,
 	.parse		= nftnl_expr_queue_parse,
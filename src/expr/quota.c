@@ -195,10 +195,43 @@ static int nftnl_expr_quota_snprintf(char *buf, size_t len, uint32_t type,
 	return -1;
 }
 
+static bool nftnl_expr_quota_cmp(const struct nftnl_expr *e1,
+				 const struct nftnl_expr *e2)
+{
+	struct nftnl_expr_quota *q1 = nftnl_expr_data(e1);
+	struct nftnl_expr_quota *q2 = nftnl_expr_data(e2);
+	bool eq = true;
+
+	if (e1->flags & (1 << NFTNL_EXPR_QUOTA_BYTES))
+		eq &= (q1->bytes == q2->bytes);
+	if (e1->flags & (1 << NFTNL_EXPR_QUOTA_CONSUMED))
+		eq &= (q1->consumed == q2->consumed);
+	if (e1->flags & (1 << NFTNL_EXPR_QUOTA_FLAGS))
+		eq &= (q1->flags == q2->flags);
+
+	return eq;
+}
+
+static uint64_t nftnl_expr_quota_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_quota *quota = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_QUOTA_BYTES))
+		h = nftnl_hash64(&quota->bytes, sizeof(quota->bytes), h);
+	if (e->flags & (1 << NFTNL_EXPR_QUOTA_CONSUMED))
+		h = nftnl_hash64(&quota->consumed, sizeof(quota->consumed), h);
+	if (e->flags & (1 << NFTNL_EXPR_QUOTA_FLAGS))
+		h = nftnl_hash64(&quota->flags, sizeof(quota->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_quota = {
 	.name		= "quota",
 	.alloc_len	= sizeof(struct nftnl_expr_quota),
 	.max_attr	= NFTA_QUOTA_MAX,
+	.cmp		= nftnl_expr_quota_cmp,
+	.hash		= nftnl_expr_quota_hash,
 	.set		= nftnl_expr_quota_set,
 	.get		= nftnl_expr_quota_get,
 	.parse		= nftnl_expr_quota_parse,
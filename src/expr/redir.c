@@ -233,11 +233,28 @@ static bool nftnl_expr_redir_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_redir_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_redir *redir = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_REDIR_REG_PROTO_MIN))
+		h = nftnl_hash64(&redir->sreg_proto_min,
+				 sizeof(redir->sreg_proto_min), h);
+	if (e->flags & (1 << NFTNL_EXPR_REDIR_REG_PROTO_MAX))
+		h = nftnl_hash64(&redir->sreg_proto_max,
+				 sizeof(redir->sreg_proto_max), h);
+	if (e->flags & (1 << NFTNL_EXPR_REDIR_FLAGS))
+		h = nftnl_hash64(&redir->flags, sizeof(redir->flags), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_redir = {
 	.name		= "redir",
 	.alloc_len	= sizeof(struct nftnl_expr_redir),
 	.max_attr	= NFTA_REDIR_MAX,
 	.cmp		= nftnl_expr_redir_cmp,
+	.hash		= nftnl_expr_redir_hash,
 	.set		= nftnl_expr_redir_set,
 	.get		= nftnl_expr_redir_get,
 	.parse		= nftnl_expr_redir_parse,
@@ -191,11 +191,25 @@ static bool nftnl_expr_reject_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_reject_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_reject *reject = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_REJECT_TYPE))
+		h = nftnl_hash64(&reject->type, sizeof(reject->type), h);
+	if (e->flags & (1 << NFTNL_EXPR_REJECT_CODE))
+		h = nftnl_hash64(&reject->icmp_code,
+				 sizeof(reject->icmp_code), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_reject = {
 	.name		= "reject",
 	.alloc_len	= sizeof(struct nftnl_expr_reject),
 	.max_attr	= NFTA_REJECT_MAX,
 	.cmp		= nftnl_expr_reject_cmp,
+	.hash		= nftnl_expr_reject_hash,
 	.set		= nftnl_expr_reject_set,
 	.get		= nftnl_expr_reject_get,
 	.parse		= nftnl_expr_reject_parse,
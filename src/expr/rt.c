@@ -230,11 +230,24 @@ static bool nftnl_expr_rt_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_rt_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_rt *rt = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_RT_KEY))
+		h = nftnl_hash64(&rt->key, sizeof(rt->key), h);
+	if (e->flags & (1 << NFTNL_EXPR_RT_DREG))
+		h = nftnl_hash64(&rt->dreg, sizeof(rt->dreg), h);
+
+	return h;
+}
+
 struct expr_ops expr_ops_rt = {
 	.name		= "rt",
 	.alloc_len	= sizeof(struct nftnl_expr_rt),
 	.max_attr	= NFTA_RT_MAX,
 	.cmp		= nftnl_expr_rt_cmp,
+	.hash		= nftnl_expr_rt_hash,
 	.set		= nftnl_expr_rt_set,
 	.get		= nftnl_expr_rt_get,
 	.parse		= nftnl_expr_rt_parse,
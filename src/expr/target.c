@@ -239,12 +239,30 @@ static bool nftnl_expr_target_cmp(const struct nftnl_expr *e1,
 	return eq;
 }
 
+static uint64_t nftnl_expr_target_hash(const struct nftnl_expr *e, uint64_t h)
+{
+	struct nftnl_expr_target *target = nftnl_expr_data(e);
+
+	if (e->flags & (1 << NFTNL_EXPR_TG_NAME))
+		h = nftnl_hash64(target->name, strlen(target->name), h);
+	if (e->flags & (1 << NFTNL_EXPR_TG_REV))
+		h = nftnl_hash64(&target->rev, sizeof(target->rev), h);
+	if (e->flags & (1 << NFTNL_EXPR_TG_INFO)) {
+		h = nftnl_hash64(&target->data_len,
+				 sizeof(target->data_len), h);
+		h = nftnl_hash64(target->data, target->data_len, h);
+	}
+
+	return h;
+}
+
 struct expr_ops expr_ops_target = {
 	.name		= "target",
 	.alloc_len	= sizeof(struct nftnl_expr_target),
 	.max_attr	= NFTA_TARGET_MAX,
 	.free		= nftnl_expr_target_free,
 	.cmp		= nftnl_expr_target_cmp,
+	.hash		= nftnl_expr_target_hash,
 	.set		= nftnl_expr_target_set,
 	.get		= nftnl_expr_target_get,
 	.parse		= nftnl_expr_target_parse,
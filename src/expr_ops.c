@@ -2,6 +2,7 @@
 #include <linux_list.h>
 
 #include "expr_ops.h"
+#include <libnftnl/expr.h>
 
 /* Unfortunately, __attribute__((constructor)) breaks library static linking */
 extern struct expr_ops expr_ops_bitwise;
@@ -38,49 +39,99 @@ static struct expr_ops expr_ops_notrack = {
 	.name	= "notrack",
 };
 
-static struct expr_ops *expr_ops[] = {
-	&expr_ops_bitwise,
-	&expr_ops_byteorder,
-	&expr_ops_cmp,
-	&expr_ops_counter,
-	&expr_ops_ct,
-	&expr_ops_dup,
-	&expr_ops_exthdr,
-	&expr_ops_fwd,
-	&expr_ops_immediate,
-	&expr_ops_limit,
-	&expr_ops_log,
-	&expr_ops_lookup,
-	&expr_ops_masq,
-	&expr_ops_match,
-	&expr_ops_meta,
-	&expr_ops_ng,
-	&expr_ops_nat,
-	&expr_ops_notrack,
-	&expr_ops_payload,
-	&expr_ops_range,
-	&expr_ops_redir,
-	&expr_ops_reject,
-	&expr_ops_rt,
-	&expr_ops_queue,
-	&expr_ops_quota,
-	&expr_ops_target,
-	&expr_ops_dynset,
-	&expr_ops_hash,
-	&expr_ops_fib,
-	&expr_ops_objref,
-	NULL,
+static struct expr_ops *expr_ops[__NFTNL_EXPR_TYPE_MAX] = {
+	[NFTNL_EXPR_TYPE_BITWISE]	= &expr_ops_bitwise,
+	[NFTNL_EXPR_TYPE_BYTEORDER]	= &expr_ops_byteorder,
+	[NFTNL_EXPR_TYPE_CMP]		= &expr_ops_cmp,
+	[NFTNL_EXPR_TYPE_COUNTER]	= &expr_ops_counter,
+	[NFTNL_EXPR_TYPE_CT]		= &expr_ops_ct,
+	[NFTNL_EXPR_TYPE_DUP]		= &expr_ops_dup,
+	[NFTNL_EXPR_TYPE_DYNSET]	= &expr_ops_dynset,
+	[NFTNL_EXPR_TYPE_EXTHDR]	= &expr_ops_exthdr,
+	[NFTNL_EXPR_TYPE_FIB]		= &expr_ops_fib,
+	[NFTNL_EXPR_TYPE_FWD]		= &expr_ops_fwd,
+	[NFTNL_EXPR_TYPE_HASH]		= &expr_ops_hash,
+	[NFTNL_EXPR_TYPE_IMMEDIATE]	= &expr_ops_immediate,
+	[NFTNL_EXPR_TYPE_LIMIT]		= &expr_ops_limit,
+	[NFTNL_EXPR_TYPE_LOG]		= &expr_ops_log,
+	[NFTNL_EXPR_TYPE_LOOKUP]	= &expr_ops_lookup,
+	[NFTNL_EXPR_TYPE_MASQ]		= &expr_ops_masq,
+	[NFTNL_EXPR_TYPE_MATCH]		= &expr_ops_match,
+	[NFTNL_EXPR_TYPE_META]		= &expr_ops_meta,
+	[NFTNL_EXPR_TYPE_NAT]		= &expr_ops_nat,
+	[NFTNL_EXPR_TYPE_NG]		= &expr_ops_ng,
+	[NFTNL_EXPR_TYPE_NOTRACK]	= &expr_ops_notrack,
+	[NFTNL_EXPR_TYPE_OBJREF]	= &expr_ops_objref,
+	[NFTNL_EXPR_TYPE_PAYLOAD]	= &expr_ops_payload,
+	[NFTNL_EXPR_TYPE_QUEUE]		= &expr_ops_queue,
+	[NFTNL_EXPR_TYPE_QUOTA]		= &expr_ops_quota,
+	[NFTNL_EXPR_TYPE_RANGE]		= &expr_ops_range,
+	[NFTNL_EXPR_TYPE_REDIR]		= &expr_ops_redir,
+	[NFTNL_EXPR_TYPE_REJECT]	= &expr_ops_reject,
+	[NFTNL_EXPR_TYPE_RT]		= &expr_ops_rt,
+	[NFTNL_EXPR_TYPE_TARGET]	= &expr_ops_target,
+};
+
+/* Expressions by the first letter of their name, most used first, so that a
+ * lookup compares the name with a few candidates at most. This must be kept
+ * in sync with expr_ops[] above.
+ */
+static struct expr_ops **const expr_ops_by_letter['z' - 'a' + 1] = {
+	['b' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_bitwise, &expr_ops_byteorder, NULL },
+	['c' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_cmp, &expr_ops_counter, &expr_ops_ct, NULL },
+	['d' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_dynset, &expr_ops_dup, NULL },
+	['e' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_exthdr, NULL },
+	['f' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_fib, &expr_ops_fwd, NULL },
+	['h' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_hash, NULL },
+	['i' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_immediate, NULL },
+	['l' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_lookup, &expr_ops_limit, &expr_ops_log, NULL },
+	['m' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_meta, &expr_ops_match, &expr_ops_masq, NULL },
+	['n' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_nat, &expr_ops_notrack, &expr_ops_ng, NULL },
+	['o' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_objref, NULL },
+	['p' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_payload, NULL },
+	['q' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_queue, &expr_ops_quota, NULL },
+	['r' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_range, &expr_ops_redir, &expr_ops_reject,
+		&expr_ops_rt, NULL },
+	['t' - 'a'] = (struct expr_ops *[]) {
+		&expr_ops_target, NULL },
 };
 
 struct expr_ops *nftnl_expr_ops_lookup(const char *name)
 {
-	int i = 0;
+	struct expr_ops **ops;
 
-	while (expr_ops[i] != NULL) {
-		if (strcmp(expr_ops[i]->name, name) == 0)
-			return expr_ops[i];
+	if (name[0] < 'a' || name[0] > 'z')
+		return NULL;
 
-		i++;
+	ops = expr_ops_by_letter[name[0] - 'a'];
+	if (ops == NULL)
+		return NULL;
+
+	for (; *ops != NULL; ops++) {
+		if (strcmp((*ops)->name, name) == 0)
+			return *ops;
 	}
 	return NULL;
 }
+
+struct expr_ops *nftnl_expr_ops_lookup_type(uint32_t type)
+{
+	if (type >= __NFTNL_EXPR_TYPE_MAX)
+		return NULL;
+
+	return expr_ops[type];
+}
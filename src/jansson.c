@@ -247,26 +247,34 @@ int nftnl_jansson_data_reg_parse(json_t *root, const char *node_name,
 int nftnl_jansson_set_elem_parse(struct nftnl_set_elem *e, json_t *root,
 			       struct nftnl_parse_err *err)
 {
-	int set_elem_data;
+	union nftnl_data_reg reg = {};
+	int set_elem_data, ret = 0;
 	uint32_t flags;
 
 	if (nftnl_jansson_parse_val(root, "flags", NFTNL_TYPE_U32, &flags, err) == 0)
 		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_FLAGS, flags);
 
-	if (nftnl_jansson_data_reg_parse(root, "key", &e->key, err) == DATA_VALUE)
-		e->flags |= (1 << NFTNL_SET_ELEM_KEY);
+	if (nftnl_jansson_data_reg_parse(root, "key", &reg, err) == DATA_VALUE &&
+	    nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, reg.val, reg.len) < 0)
+		return -1;
 
 	if (nftnl_jansson_node_exist(root, "data")) {
+		memset(&reg, 0, sizeof(reg));
 		set_elem_data = nftnl_jansson_data_reg_parse(root, "data",
-							   &e->data, err);
+							   &reg, err);
 		switch (set_elem_data) {
 		case DATA_VALUE:
-			e->flags |= (1 << NFTNL_SET_ELEM_DATA);
+			ret = nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA,
+						 reg.val, reg.len);
 			break;
 		case DATA_VERDICT:
-			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
-			if (e->data.chain != NULL)
-				e->flags |= (1 << NFTNL_SET_ELEM_CHAIN);
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT,
+					       reg.verdict);
+			if (reg.chain != NULL) {
+				ret = nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN,
+							     reg.chain);
+				xfree(reg.chain);
+			}
 			break;
 		case DATA_NONE:
 		default:
@@ -274,6 +282,304 @@ int nftnl_jansson_set_elem_parse(struct nftnl_set_elem *e, json_t *root,
 		}
 	}
 
+	return ret;
+}
+
+/*
+ * Pull scanner for documents that are too large to be loaded as a whole. It
+ * walks the containers that the caller expects and only hands values over to
+ * jansson one at a time, so memory is bounded by the largest of them.
+ */
+void nftnl_jansson_stream_init(struct nftnl_jansson_stream *s, FILE *fp)
+{
+	memset(s, 0, sizeof(*s));
+	s->fp = fp;
+	s->cur = s->buf;
+	s->line = 1;
+}
+
+/* Same, for a document that is already in memory. Values are not copied
+ * before they are decoded, and they can be located with
+ * nftnl_jansson_stream_span().
+ */
+void nftnl_jansson_stream_init_buffer(struct nftnl_jansson_stream *s,
+				      const char *data, size_t len)
+{
+	memset(s, 0, sizeof(*s));
+	s->cur = data;
+	s->end = len;
+	s->line = 1;
+}
+
+void nftnl_jansson_stream_release(struct nftnl_jansson_stream *s)
+{
+	xfree(s->data);
+	s->data = NULL;
+	s->size = 0;
+}
+
+static int nftnl_jansson_stream_peekc(struct nftnl_jansson_stream *s)
+{
+	if (s->pos == s->end) {
+		if (s->fp == NULL)
+			return EOF;
+
+		s->end = fread(s->buf, 1, sizeof(s->buf), s->fp);
+		s->pos = 0;
+		if (s->end == 0)
+			return EOF;
+	}
+
+	return (unsigned char)s->cur[s->pos];
+}
+
+static int nftnl_jansson_stream_getc(struct nftnl_jansson_stream *s)
+{
+	int c = nftnl_jansson_stream_peekc(s);
+
+	if (c == EOF)
+		return EOF;
+
+	s->pos++;
+	if (c == '\n') {
+		s->line++;
+		s->column = 0;
+	} else {
+		s->column++;
+	}
+
+	return c;
+}
+
+static int nftnl_jansson_stream_error(struct nftnl_jansson_stream *s,
+				      struct nftnl_parse_err *err)
+{
+	err->error = NFTNL_PARSE_EBADINPUT;
+	err->line = s->line;
+	err->column = s->column;
+	errno = EINVAL;
+	return -1;
+}
+
+/* Next character that is not blank, which is left in the stream. */
+static int nftnl_jansson_stream_peek(struct nftnl_jansson_stream *s)
+{
+	int c;
+
+	while ((c = nftnl_jansson_stream_peekc(s)) != EOF) {
+		if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+			break;
+		nftnl_jansson_stream_getc(s);
+	}
+
+	return c;
+}
+
+/* Consumes the @open character. Returns 1 if the container has items, 0 if
+ * it is empty, in which case @close is consumed too.
+ */
+int nftnl_jansson_stream_open(struct nftnl_jansson_stream *s, int open,
+			      int close, struct nftnl_parse_err *err)
+{
+	if (nftnl_jansson_stream_peek(s) != open)
+		return nftnl_jansson_stream_error(s, err);
+	nftnl_jansson_stream_getc(s);
+
+	if (nftnl_jansson_stream_peek(s) != close)
+		return 1;
+	nftnl_jansson_stream_getc(s);
+
+	return 0;
+}
+
+/* Consumes what follows an item. Returns 1 if another item comes, 0 once
+ * the container is closed by @close.
+ */
+int nftnl_jansson_stream_next(struct nftnl_jansson_stream *s, int close,
+			      struct nftnl_parse_err *err)
+{
+	int c = nftnl_jansson_stream_peek(s);
+
+	if (c != ',' && c != close)
+		return nftnl_jansson_stream_error(s, err);
+	nftnl_jansson_stream_getc(s);
+
+	return c == ',';
+}
+
+static int nftnl_jansson_stream_put(struct nftnl_jansson_stream *s, int c)
+{
+	char *data;
+	size_t size;
+
+	if (s->len == s->size) {
+		size = s->size ? s->size * 2 : 4096;
+		data = realloc(s->data, size);
+		if (data == NULL)
+			return -1;
+
+		s->data = data;
+		s->size = size;
+	}
+	s->data[s->len++] = c;
+
+	return 0;
+}
+
+/* Walks over the next value, whatever its type. If @capture is set, it is
+ * copied to the capture buffer on the way.
+ */
+static int nftnl_jansson_stream_walk(struct nftnl_jansson_stream *s,
+				     bool capture, struct nftnl_parse_err *err)
+{
+	bool string = false, escape = false;
+	int c, depth = 0;
+
+	s->len = 0;
+	c = nftnl_jansson_stream_peek(s);
+	if (c == EOF)
+		return nftnl_jansson_stream_error(s, err);
+
+	if (c != '{' && c != '[' && c != '"') {
+		/* Numbers and literals end where the enclosing container
+		 * goes on.
+		 */
+		while ((c = nftnl_jansson_stream_peekc(s)) != EOF &&
+		       !strchr(",]} \t\r\n", c)) {
+			if (capture && nftnl_jansson_stream_put(s, c) < 0)
+				return -1;
+			nftnl_jansson_stream_getc(s);
+		}
+		return 0;
+	}
+
+	do {
+		c = nftnl_jansson_stream_getc(s);
+		if (c == EOF)
+			return nftnl_jansson_stream_error(s, err);
+		if (capture && nftnl_jansson_stream_put(s, c) < 0)
+			return -1;
+
+		if (escape)
+			escape = false;
+		else if (string && c == '\\')
+			escape = true;
+		else if (c == '"')
+			string = !string;
+		else if (!string && (c == '{' || c == '['))
+			depth++;
+		else if (!string && (c == '}' || c == ']'))
+			depth--;
+	} while (string || depth > 0);
+
 	return 0;
 }
+
+/* Decodes the next value, to be released with json_decref(). */
+json_t *nftnl_jansson_stream_value(struct nftnl_jansson_stream *s,
+				   struct nftnl_parse_err *err)
+{
+	json_error_t error;
+	int line = s->line;
+	json_t *node;
+
+	if (nftnl_jansson_stream_walk(s, true, err) < 0)
+		return NULL;
+
+	node = json_loadb(s->data, s->len, JSON_DECODE_ANY, &error);
+	if (node == NULL) {
+		err->error = NFTNL_PARSE_EBADINPUT;
+		err->line = line + error.line - 1;
+		err->column = error.column;
+		errno = EINVAL;
+	}
+
+	return node;
+}
+
+/* Same as nftnl_jansson_stream_value(), for values that are of no use. */
+int nftnl_jansson_stream_skip(struct nftnl_jansson_stream *s,
+			      struct nftnl_parse_err *err)
+{
+	json_t *node;
+
+	node = nftnl_jansson_stream_value(s, err);
+	if (node == NULL)
+		return -1;
+
+	json_decref(node);
+	return 0;
+}
+
+/* Skips the next value of a document in memory. Returns where it starts,
+ * its length is stored in @len.
+ */
+const char *nftnl_jansson_stream_span(struct nftnl_jansson_stream *s,
+				      size_t *len, struct nftnl_parse_err *err)
+{
+	const char *data;
+
+	nftnl_jansson_stream_peek(s);
+	data = s->cur + s->pos;
+
+	if (nftnl_jansson_stream_walk(s, false, err) < 0)
+		return NULL;
+
+	*len = s->cur + s->pos - data;
+	return data;
+}
+
+/* Reads the name of the next object member and the colon that follows it.
+ * The name has to be released by the caller.
+ */
+char *nftnl_jansson_stream_key(struct nftnl_jansson_stream *s,
+			       struct nftnl_parse_err *err)
+{
+	const char *data;
+	json_t *node;
+	char *key;
+	size_t len;
+
+	if (nftnl_jansson_stream_peek(s) != '"') {
+		nftnl_jansson_stream_error(s, err);
+		return NULL;
+	}
+
+	/* Documents in memory are not copied. */
+	if (s->fp == NULL) {
+		data = nftnl_jansson_stream_span(s, &len, err);
+		if (data == NULL)
+			return NULL;
+	} else {
+		if (nftnl_jansson_stream_walk(s, true, err) < 0)
+			return NULL;
+		data = s->data;
+		len = s->len;
+	}
+
+	/* Only names with escape sequences need to be decoded. */
+	if (memchr(data, '\\', len) == NULL) {
+		key = strndup(data + 1, len - 2);
+	} else {
+		node = json_loadb(data, len, JSON_DECODE_ANY, NULL);
+		if (node == NULL) {
+			nftnl_jansson_stream_error(s, err);
+			return NULL;
+		}
+
+		key = strdup(json_string_value(node));
+		json_decref(node);
+	}
+	if (key == NULL)
+		return NULL;
+
+	if (nftnl_jansson_stream_peek(s) != ':') {
+		free(key);
+		nftnl_jansson_stream_error(s, err);
+		return NULL;
+	}
+	nftnl_jansson_stream_getc(s);
+
+	return key;
+}
 #endif
@@ -50,9 +50,9 @@ EXPORT_SYMBOL(nftnl_obj_free);
 void nftnl_obj_free(const struct nftnl_obj *obj)
 {
 	if (obj->flags & (1 << NFTNL_OBJ_TABLE))
-		xfree(obj->table);
+		nftnl_str_release(obj->table, obj->interned, NFTNL_OBJ_TABLE);
 	if (obj->flags & (1 << NFTNL_OBJ_NAME))
-		xfree(obj->name);
+		nftnl_str_release(obj->name, obj->interned, NFTNL_OBJ_NAME);
 
 	xfree(obj);
 }
@@ -77,12 +77,14 @@ void nftnl_obj_set_data(struct nftnl_obj *obj, uint16_t attr,
 
 	switch (attr) {
 	case NFTNL_OBJ_TABLE:
-		xfree(obj->table);
+		nftnl_str_release(obj->table, obj->interned, NFTNL_OBJ_TABLE);
 		obj->table = strdup(data);
+		obj->interned &= ~(1 << NFTNL_OBJ_TABLE);
 		break;
 	case NFTNL_OBJ_NAME:
-		xfree(obj->name);
+		nftnl_str_release(obj->name, obj->interned, NFTNL_OBJ_NAME);
 		obj->name = strdup(data);
+		obj->interned &= ~(1 << NFTNL_OBJ_NAME);
 		break;
 	case NFTNL_OBJ_TYPE:
 		obj->ops = nftnl_obj_ops_lookup(*((uint32_t *)data));
@@ -270,11 +272,13 @@ int nftnl_obj_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_obj *obj)
 		return -1;
 
 	if (tb[NFTA_OBJ_TABLE]) {
-		obj->table = strdup(mnl_attr_get_str(tb[NFTA_OBJ_TABLE]));
+		obj->table = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_OBJ_TABLE]),
+						&obj->interned, NFTNL_OBJ_TABLE);
 		obj->flags |= (1 << NFTNL_OBJ_TABLE);
 	}
 	if (tb[NFTA_OBJ_NAME]) {
-		obj->name = strdup(mnl_attr_get_str(tb[NFTA_OBJ_NAME]));
+		obj->name = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_OBJ_NAME]),
+						&obj->interned, NFTNL_OBJ_NAME);
 		obj->flags |= (1 << NFTNL_OBJ_NAME);
 	}
 	if (tb[NFTA_OBJ_TYPE]) {
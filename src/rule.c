@@ -29,11 +29,21 @@
 #include <libnftnl/rule.h>
 #include <libnftnl/set.h>
 #include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
+
+struct nftnl_rule_list;
 
 struct nftnl_rule {
 	struct list_head head;
+	struct hlist_node handle_hnode;
+	/* rules of the same chain, in an indexed rule list */
+	struct list_head chain_head;
+	/* list whose index holds this rule */
+	struct nftnl_rule_list *list;
 
 	uint32_t	flags;
+	/* names that belong to a string pool */
+	uint32_t	interned;
 	uint32_t	family;
 	const char	*table;
 	const char	*chain;
@@ -50,6 +60,8 @@ struct nftnl_rule {
 	} compat;
 
 	struct list_head expr_list;
+	/* NFTA_RULE_EXPRESSIONS as received, until it is decoded */
+	struct nlattr	*raw_exprs;
 };
 
 EXPORT_SYMBOL(nftnl_rule_alloc);
@@ -62,6 +74,7 @@ struct nftnl_rule *nftnl_rule_alloc(void)
 		return NULL;
 
 	INIT_LIST_HEAD(&r->expr_list);
+	INIT_LIST_HEAD(&r->chain_head);
 
 	return r;
 }
@@ -73,17 +86,36 @@ void nftnl_rule_free(const struct nftnl_rule *r)
 
 	list_for_each_entry_safe(e, tmp, &r->expr_list, head)
 		nftnl_expr_free(e);
+	xfree(r->raw_exprs);
 
 	if (r->flags & (1 << (NFTNL_RULE_TABLE)))
-		xfree(r->table);
+		nftnl_str_release(r->table, r->interned, NFTNL_RULE_TABLE);
 	if (r->flags & (1 << (NFTNL_RULE_CHAIN)))
-		xfree(r->chain);
+		nftnl_str_release(r->chain, r->interned, NFTNL_RULE_CHAIN);
 	if (r->flags & (1 << (NFTNL_RULE_USERDATA)))
 		xfree(r->user.data);
 
 	xfree(r);
 }
 
+/* Releases what @r holds, so that it can be reused as if it was just
+ * allocated. Expressions go back to the expression cache.
+ */
+void nftnl_rule_reset(struct nftnl_rule *r)
+{
+	struct nftnl_expr *e, *tmp;
+	uint16_t attr;
+
+	list_for_each_entry_safe(e, tmp, &r->expr_list, head)
+		nftnl_expr_free(e);
+	INIT_LIST_HEAD(&r->expr_list);
+	xfree(r->raw_exprs);
+	r->raw_exprs = NULL;
+
+	for (attr = 0; attr <= NFTNL_RULE_MAX; attr++)
+		nftnl_rule_unset(r, attr);
+}
+
 EXPORT_SYMBOL(nftnl_rule_is_set);
 bool nftnl_rule_is_set(const struct nftnl_rule *r, uint16_t attr)
 {
@@ -98,10 +130,10 @@ void nftnl_rule_unset(struct nftnl_rule *r, uint16_t attr)
 
 	switch (attr) {
 	case NFTNL_RULE_TABLE:
-		xfree(r->table);
+		nftnl_str_release(r->table, r->interned, NFTNL_RULE_TABLE);
 		break;
 	case NFTNL_RULE_CHAIN:
-		xfree(r->chain);
+		nftnl_str_release(r->chain, r->interned, NFTNL_RULE_CHAIN);
 		break;
 	case NFTNL_RULE_HANDLE:
 	case NFTNL_RULE_COMPAT_PROTO:
@@ -137,17 +169,19 @@ int nftnl_rule_set_data(struct nftnl_rule *r, uint16_t attr,
 	switch(attr) {
 	case NFTNL_RULE_TABLE:
 		if (r->flags & (1 << NFTNL_RULE_TABLE))
-			xfree(r->table);
+			nftnl_str_release(r->table, r->interned, NFTNL_RULE_TABLE);
 
 		r->table = strdup(data);
+		r->interned &= ~(1 << NFTNL_RULE_TABLE);
 		if (!r->table)
 			return -1;
 		break;
 	case NFTNL_RULE_CHAIN:
 		if (r->flags & (1 << NFTNL_RULE_CHAIN))
-			xfree(r->chain);
+			nftnl_str_release(r->chain, r->interned, NFTNL_RULE_CHAIN);
 
 		r->chain = strdup(data);
+		r->interned &= ~(1 << NFTNL_RULE_CHAIN);
 		if (!r->chain)
 			return -1;
 		break;
@@ -294,27 +328,39 @@ uint8_t nftnl_rule_get_u8(const struct nftnl_rule *r, uint16_t attr)
 	return val ? *val : 0;
 }
 
-EXPORT_SYMBOL(nftnl_rule_nlmsg_build_payload);
-void nftnl_rule_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_rule *r)
+/* Attributes that are not in @mask are left out of the message. */
+static void __nftnl_rule_nlmsg_build_payload(struct nlmsghdr *nlh,
+					     struct nftnl_rule *r,
+					     uint32_t mask)
 {
+	uint32_t flags = r->flags & mask;
 	struct nftnl_expr *expr;
 	struct nlattr *nest, *nest2;
 
-	if (r->flags & (1 << NFTNL_RULE_TABLE))
+	if (flags & (1 << NFTNL_RULE_TABLE))
 		mnl_attr_put_strz(nlh, NFTA_RULE_TABLE, r->table);
-	if (r->flags & (1 << NFTNL_RULE_CHAIN))
+	if (flags & (1 << NFTNL_RULE_CHAIN))
 		mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN, r->chain);
-	if (r->flags & (1 << NFTNL_RULE_HANDLE))
+	if (flags & (1 << NFTNL_RULE_HANDLE))
 		mnl_attr_put_u64(nlh, NFTA_RULE_HANDLE, htobe64(r->handle));
-	if (r->flags & (1 << NFTNL_RULE_POSITION))
+	if (flags & (1 << NFTNL_RULE_POSITION))
 		mnl_attr_put_u64(nlh, NFTA_RULE_POSITION, htobe64(r->position));
-	if (r->flags & (1 << NFTNL_RULE_USERDATA)) {
+	if (flags & (1 << NFTNL_RULE_USERDATA)) {
 		mnl_attr_put(nlh, NFTA_RULE_USERDATA, r->user.len,
 			     r->user.data);
 	}
 
-	if (!list_empty(&r->expr_list)) {
+	/* Expressions that were received and not decoded come first, those
+	 * added since then follow in the same attribute.
+	 */
+	if (r->raw_exprs) {
+		nest = mnl_nlmsg_get_payload_tail(nlh);
+		memcpy(nest, r->raw_exprs, MNL_ALIGN(r->raw_exprs->nla_len));
+		nlh->nlmsg_len += MNL_ALIGN(r->raw_exprs->nla_len);
+	} else if (!list_empty(&r->expr_list)) {
 		nest = mnl_attr_nest_start(nlh, NFTA_RULE_EXPRESSIONS);
+	}
+	if (!list_empty(&r->expr_list)) {
 		list_for_each_entry(expr, &r->expr_list, head) {
 			nest2 = mnl_attr_nest_start(nlh, NFTA_LIST_ELEM);
 			nftnl_expr_build_payload(nlh, expr);
@@ -323,8 +369,8 @@ void nftnl_rule_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_rule *r)
 		mnl_attr_nest_end(nlh, nest);
 	}
 
-	if (r->flags & (1 << NFTNL_RULE_COMPAT_PROTO) &&
-	    r->flags & (1 << NFTNL_RULE_COMPAT_FLAGS)) {
+	if (flags & (1 << NFTNL_RULE_COMPAT_PROTO) &&
+	    flags & (1 << NFTNL_RULE_COMPAT_FLAGS)) {
 
 		nest = mnl_attr_nest_start(nlh, NFTA_RULE_COMPAT);
 		mnl_attr_put_u32(nlh, NFTA_RULE_COMPAT_PROTO,
@@ -333,13 +379,25 @@ void nftnl_rule_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_rule *r)
 				 htonl(r->compat.flags));
 		mnl_attr_nest_end(nlh, nest);
 	}
-	if (r->flags & (1 << NFTNL_RULE_ID))
+	if (flags & (1 << NFTNL_RULE_ID))
 		mnl_attr_put_u32(nlh, NFTA_RULE_ID, htonl(r->id));
 }
 
+EXPORT_SYMBOL(nftnl_rule_nlmsg_build_payload);
+void nftnl_rule_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_rule *r)
+{
+	__nftnl_rule_nlmsg_build_payload(nlh, r, UINT32_MAX);
+}
+
+static int nftnl_rule_expr_decode(struct nftnl_rule *r);
+
 EXPORT_SYMBOL(nftnl_rule_add_expr);
 void nftnl_rule_add_expr(struct nftnl_rule *r, struct nftnl_expr *expr)
 {
+	/* Received expressions that cannot be decoded, e.g. because they are
+	 * unknown to this library, are kept and built ahead of @expr.
+	 */
+	nftnl_rule_expr_decode(r);
 	list_add_tail(&expr->head, &r->expr_list);
 }
 
@@ -383,7 +441,7 @@ static int nftnl_rule_parse_attr_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
-static int nftnl_rule_parse_expr(struct nlattr *nest, struct nftnl_rule *r)
+static int nftnl_rule_parse_expr(struct nlattr *nest, struct list_head *list)
 {
 	struct nftnl_expr *expr;
 	struct nlattr *attr;
@@ -396,8 +454,62 @@ static int nftnl_rule_parse_expr(struct nlattr *nest, struct nftnl_rule *r)
 		if (expr == NULL)
 			return -1;
 
-		list_add_tail(&expr->head, &r->expr_list);
+		list_add_tail(&expr->head, list);
+	}
+	return 0;
+}
+
+static int nftnl_rule_keep_expr(struct nlattr *nest, struct nftnl_rule *r)
+{
+	struct nlattr *raw;
+
+	raw = calloc(1, MNL_ALIGN(nest->nla_len));
+	if (raw == NULL)
+		return -1;
+
+	memcpy(raw, nest, nest->nla_len);
+	xfree(r->raw_exprs);
+	r->raw_exprs = raw;
+
+	return 0;
+}
+
+static void nftnl_rule_expr_list_free(struct list_head *list)
+{
+	struct nftnl_expr *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, list, head) {
+		list_del(&e->head);
+		nftnl_expr_free(e);
+	}
+}
+
+/* Expressions of rules parsed in lazy mode are decoded on first access
+ * through a non-const path. The raw attribute is dropped then, since
+ * expressions may be updated through the list from then on. It is kept if
+ * decoding fails, expressions that were added to the rule in the meantime
+ * stay behind it.
+ *
+ * Const paths leave the rule alone, so that several threads can read it at
+ * once: they decode expressions into a list of their own, see
+ * nftnl_expr_iter_init().
+ */
+static int nftnl_rule_expr_decode(struct nftnl_rule *r)
+{
+	LIST_HEAD(list);
+
+	if (r->raw_exprs == NULL)
+		return 0;
+
+	if (nftnl_rule_parse_expr(r->raw_exprs, &list) < 0) {
+		nftnl_rule_expr_list_free(&list);
+		return -1;
 	}
+	list_splice(&list, &r->expr_list);
+
+	xfree(r->raw_exprs);
+	r->raw_exprs = NULL;
+
 	return 0;
 }
 
@@ -441,8 +553,8 @@ static int nftnl_rule_parse_compat(struct nlattr *nest, struct nftnl_rule *r)
 	return 0;
 }
 
-EXPORT_SYMBOL(nftnl_rule_nlmsg_parse);
-int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
+static int __nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh,
+				    struct nftnl_rule *r, bool lazy)
 {
 	struct nlattr *tb[NFTA_RULE_MAX+1] = {};
 	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
@@ -453,16 +565,18 @@ int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
 
 	if (tb[NFTA_RULE_TABLE]) {
 		if (r->flags & (1 << NFTNL_RULE_TABLE))
-			xfree(r->table);
-		r->table = strdup(mnl_attr_get_str(tb[NFTA_RULE_TABLE]));
+			nftnl_str_release(r->table, r->interned, NFTNL_RULE_TABLE);
+		r->table = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_RULE_TABLE]),
+						&r->interned, NFTNL_RULE_TABLE);
 		if (!r->table)
 			return -1;
 		r->flags |= (1 << NFTNL_RULE_TABLE);
 	}
 	if (tb[NFTA_RULE_CHAIN]) {
 		if (r->flags & (1 << NFTNL_RULE_CHAIN))
-			xfree(r->chain);
-		r->chain = strdup(mnl_attr_get_str(tb[NFTA_RULE_CHAIN]));
+			nftnl_str_release(r->chain, r->interned, NFTNL_RULE_CHAIN);
+		r->chain = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_RULE_CHAIN]),
+						&r->interned, NFTNL_RULE_CHAIN);
 		if (!r->chain)
 			return -1;
 		r->flags |= (1 << NFTNL_RULE_CHAIN);
@@ -472,7 +586,11 @@ int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
 		r->flags |= (1 << NFTNL_RULE_HANDLE);
 	}
 	if (tb[NFTA_RULE_EXPRESSIONS]) {
-		ret = nftnl_rule_parse_expr(tb[NFTA_RULE_EXPRESSIONS], r);
+		if (lazy)
+			ret = nftnl_rule_keep_expr(tb[NFTA_RULE_EXPRESSIONS], r);
+		else
+			ret = nftnl_rule_parse_expr(tb[NFTA_RULE_EXPRESSIONS],
+						    &r->expr_list);
 		if (ret < 0)
 			return ret;
 	}
@@ -512,6 +630,24 @@ int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
 	return 0;
 }
 
+EXPORT_SYMBOL(nftnl_rule_nlmsg_parse);
+int nftnl_rule_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_rule *r)
+{
+	return __nftnl_rule_nlmsg_parse(nlh, r, false);
+}
+
+/* Same as nftnl_rule_nlmsg_parse(), but expressions are kept as they come in
+ * the message and only decoded when they are accessed. A rule whose
+ * expressions were not accessed is built back with the very same attribute.
+ * Malformed expressions are not reported until they are decoded.
+ */
+EXPORT_SYMBOL(nftnl_rule_nlmsg_parse_lazy);
+int nftnl_rule_nlmsg_parse_lazy(const struct nlmsghdr *nlh,
+				struct nftnl_rule *r)
+{
+	return __nftnl_rule_nlmsg_parse(nlh, r, true);
+}
+
 #ifdef JSON_PARSING
 int nftnl_jansson_parse_rule(struct nftnl_rule *r, json_t *tree,
 			   struct nftnl_parse_err *err,
@@ -673,176 +809,192 @@ int nftnl_rule_parse_file(struct nftnl_rule *r, enum nftnl_parse_type type,
 	return nftnl_rule_do_parse(r, type, fp, err, NFTNL_PARSE_FILE);
 }
 
-static int nftnl_rule_export(char *buf, size_t size,
-			     const struct nftnl_rule *r,
-			     uint32_t type, uint32_t flags)
+struct nftnl_expr_iter {
+	const struct nftnl_rule	*r;
+	/* expressions of @r that were not decoded yet, walked first */
+	struct list_head	raw;
+	struct nftnl_expr	*cur;
+};
+
+static struct nftnl_expr *nftnl_expr_iter_entry(struct nftnl_expr_iter *iter,
+						struct list_head *pos)
 {
-	struct nftnl_expr *expr;
+	if (pos == &iter->raw)
+		pos = iter->r->expr_list.next;
+	if (pos == &iter->r->expr_list)
+		return NULL;
 
-	NFTNL_BUF_INIT(b, buf, size);
+	return list_entry(pos, struct nftnl_expr, head);
+}
+
+static int nftnl_expr_iter_init(const struct nftnl_rule *r,
+				struct nftnl_expr_iter *iter)
+{
+	iter->r = r;
+	INIT_LIST_HEAD(&iter->raw);
+	if (r->raw_exprs &&
+	    nftnl_rule_parse_expr(r->raw_exprs, &iter->raw) < 0) {
+		nftnl_rule_expr_list_free(&iter->raw);
+		return -1;
+	}
+	iter->cur = nftnl_expr_iter_entry(iter, iter->raw.next);
+
+	return 0;
+}
+
+static struct nftnl_expr *__nftnl_expr_iter_next(struct nftnl_expr_iter *iter)
+{
+	struct nftnl_expr *expr = iter->cur;
+
+	if (expr != NULL)
+		iter->cur = nftnl_expr_iter_entry(iter, expr->head.next);
+
+	return expr;
+}
+
+static void nftnl_expr_iter_fini(struct nftnl_expr_iter *iter)
+{
+	nftnl_rule_expr_list_free(&iter->raw);
+}
+
+static void nftnl_rule_buf_json(struct nftnl_buf *b,
+				const struct nftnl_rule *r,
+				struct nftnl_expr_iter *it,
+				uint32_t type, uint32_t flags)
+{
+	struct nftnl_expr *expr;
 
-	nftnl_buf_open(&b, type, RULE);
+	nftnl_buf_open(b, type, RULE);
 
 	if (r->flags & (1 << NFTNL_RULE_FAMILY))
-		nftnl_buf_str(&b, type, nftnl_family2str(r->family), FAMILY);
+		nftnl_buf_str(b, type, nftnl_family2str(r->family), FAMILY);
 	if (r->flags & (1 << NFTNL_RULE_TABLE))
-		nftnl_buf_str(&b, type, r->table, TABLE);
+		nftnl_buf_str(b, type, r->table, TABLE);
 	if (r->flags & (1 << NFTNL_RULE_CHAIN))
-		nftnl_buf_str(&b, type, r->chain, CHAIN);
+		nftnl_buf_str(b, type, r->chain, CHAIN);
 	if (r->flags & (1 << NFTNL_RULE_HANDLE))
-		nftnl_buf_u64(&b, type, r->handle, HANDLE);
+		nftnl_buf_u64(b, type, r->handle, HANDLE);
 	if (r->flags & (1 << NFTNL_RULE_COMPAT_PROTO))
-		nftnl_buf_u32(&b, type, r->compat.proto, COMPAT_PROTO);
+		nftnl_buf_u32(b, type, r->compat.proto, COMPAT_PROTO);
 	if (r->flags & (1 << NFTNL_RULE_COMPAT_FLAGS))
-		nftnl_buf_u32(&b, type, r->compat.flags, COMPAT_FLAGS);
+		nftnl_buf_u32(b, type, r->compat.flags, COMPAT_FLAGS);
 	if (r->flags & (1 << NFTNL_RULE_POSITION))
-		nftnl_buf_u64(&b, type, r->position, POSITION);
+		nftnl_buf_u64(b, type, r->position, POSITION);
 	if (r->flags & (1 << NFTNL_RULE_ID))
-		nftnl_buf_u32(&b, type, r->id, ID);
+		nftnl_buf_u32(b, type, r->id, ID);
 
-	nftnl_buf_expr_open(&b, type);
-	list_for_each_entry(expr, &r->expr_list, head)
-		nftnl_buf_expr(&b, type, flags, expr);
-	nftnl_buf_expr_close(&b, type);
+	nftnl_buf_expr_open(b, type);
+	while ((expr = __nftnl_expr_iter_next(it)) != NULL)
+		nftnl_buf_expr(b, type, flags, expr);
+	nftnl_buf_expr_close(b, type);
 
-	nftnl_buf_close(&b, type, RULE);
-
-	return nftnl_buf_done(&b);
+	nftnl_buf_close(b, type, RULE);
 }
 
-static int nftnl_rule_snprintf_default(char *buf, size_t size,
-				       const struct nftnl_rule *r,
-				       uint32_t type, uint32_t flags)
+static void nftnl_rule_buf_default(struct nftnl_buf *b,
+				   const struct nftnl_rule *r,
+				   struct nftnl_expr_iter *it,
+				   uint32_t type, uint32_t flags)
 {
 	struct nftnl_expr *expr;
-	int ret, remain = size, offset = 0, i;
-
-	if (r->flags & (1 << NFTNL_RULE_FAMILY)) {
-		ret = snprintf(buf + offset, remain, "%s ",
-			       nftnl_family2str(r->family));
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	int i;
 
-	if (r->flags & (1 << NFTNL_RULE_TABLE)) {
-		ret = snprintf(buf + offset, remain, "%s ",
-			       r->table);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-
-	if (r->flags & (1 << NFTNL_RULE_CHAIN)) {
-		ret = snprintf(buf + offset, remain, "%s ",
-			       r->chain);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (r->flags & (1 << NFTNL_RULE_HANDLE)) {
-		ret = snprintf(buf + offset, remain, "%llu ",
-			       (unsigned long long)r->handle);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (r->flags & (1 << NFTNL_RULE_FAMILY))
+		nftnl_buf_put(b, "%s ", nftnl_family2str(r->family));
 
-	if (r->flags & (1 << NFTNL_RULE_POSITION)) {
-		ret = snprintf(buf + offset, remain, "%llu ",
-			       (unsigned long long)r->position);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (r->flags & (1 << NFTNL_RULE_TABLE))
+		nftnl_buf_put(b, "%s ", r->table);
 
-	if (r->flags & (1 << NFTNL_RULE_ID)) {
-		ret = snprintf(buf + offset, remain, "%u ", r->id);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (r->flags & (1 << NFTNL_RULE_CHAIN))
+		nftnl_buf_put(b, "%s ", r->chain);
+	if (r->flags & (1 << NFTNL_RULE_HANDLE))
+		nftnl_buf_put(b, "%llu ", (unsigned long long)r->handle);
 
-	ret = snprintf(buf + offset, remain, "\n");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	if (r->flags & (1 << NFTNL_RULE_POSITION))
+		nftnl_buf_put(b, "%llu ", (unsigned long long)r->position);
 
-	list_for_each_entry(expr, &r->expr_list, head) {
-		ret = snprintf(buf + offset, remain, "  [ %s ", expr->ops->name);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	if (r->flags & (1 << NFTNL_RULE_ID))
+		nftnl_buf_put(b, "%u ", r->id);
 
-		ret = nftnl_expr_snprintf(buf + offset, remain, expr,
-					     type, flags);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_buf_put(b, "\n");
 
-		ret = snprintf(buf + offset, remain, "]\n");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	while ((expr = __nftnl_expr_iter_next(it)) != NULL) {
+		nftnl_buf_put(b, "  [ %s ", expr->ops->name);
+		nftnl_buf_snprintf(b, expr, NFTNL_CMD_UNSPEC, type, flags,
+				   nftnl_expr_do_snprintf);
+		nftnl_buf_put(b, "]\n");
 	}
 
 	if (r->user.len) {
-		ret = snprintf(buf + offset, remain, "  userdata = { ");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+		nftnl_buf_put(b, "  userdata = { ");
 
 		for (i = 0; i < r->user.len; i++) {
 			char *c = r->user.data;
 
-			ret = snprintf(buf + offset, remain, "%c",
-				       isalnum(c[i]) ? c[i] : 0);
-			SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+			nftnl_buf_put(b, "%c", isalnum(c[i]) ? c[i] : 0);
 		}
 
-		ret = snprintf(buf + offset, remain, " }\n");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
+		nftnl_buf_put(b, " }\n");
 	}
-
-	return offset;
 }
 
-static int nftnl_rule_cmd_snprintf(char *buf, size_t size,
-				   const struct nftnl_rule *r, uint32_t cmd,
-				   uint32_t type, uint32_t flags)
+/* Expressions are formatted one at a time, see nftnl_set_buf_snprintf(). */
+int nftnl_rule_buf_snprintf(struct nftnl_buf *b, const void *obj, uint32_t cmd,
+			    uint32_t type, uint32_t flags)
 {
-	int ret, remain = size, offset = 0;
+	const struct nftnl_rule *r = obj;
 	uint32_t inner_flags = flags;
+	struct nftnl_expr_iter it;
+
+	if (type != NFTNL_OUTPUT_DEFAULT && type != NFTNL_OUTPUT_JSON)
+		return -1;
+
+	if (nftnl_expr_iter_init(r, &it) < 0)
+		return -1;
 
 	inner_flags &= ~NFTNL_OF_EVENT_ANY;
 
-	ret = nftnl_cmd_header_snprintf(buf + offset, remain, cmd, type, flags);
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_cmd_header_buf(b, cmd, type, flags);
 
 	switch(type) {
 	case NFTNL_OUTPUT_DEFAULT:
-		ret = nftnl_rule_snprintf_default(buf + offset, remain, r, type,
-						inner_flags);
+		nftnl_rule_buf_default(b, r, &it, type, inner_flags);
 		break;
 	case NFTNL_OUTPUT_JSON:
-		ret = nftnl_rule_export(buf + offset, remain, r, type,
-					     inner_flags);
+		nftnl_rule_buf_json(b, r, &it, type, inner_flags);
 		break;
-	case NFTNL_OUTPUT_XML:
-	default:
-		return -1;
 	}
+	nftnl_expr_iter_fini(&it);
 
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-	ret = nftnl_cmd_footer_snprintf(buf + offset, remain, cmd, type, flags);
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_cmd_footer_buf(b, cmd, type, flags);
 
-	return offset;
+	return 0;
 }
 
 EXPORT_SYMBOL(nftnl_rule_snprintf);
 int nftnl_rule_snprintf(char *buf, size_t size, const struct nftnl_rule *r,
 			uint32_t type, uint32_t flags)
 {
+	NFTNL_BUF_INIT(b, buf, size);
+	int ret;
+
 	if (size)
 		buf[0] = '\0';
 
-	return nftnl_rule_cmd_snprintf(buf, size, r, nftnl_flag2cmd(flags), type,
-				     flags);
-}
+	ret = nftnl_rule_buf_snprintf(&b, r, nftnl_flag2cmd(flags), type,
+				      flags);
+	if (ret < 0)
+		return ret;
 
-static int nftnl_rule_do_snprintf(char *buf, size_t size, const void *r,
-				  uint32_t cmd, uint32_t type, uint32_t flags)
-{
-	return nftnl_rule_snprintf(buf, size, r, type, flags);
+	return b.off;
 }
 
 EXPORT_SYMBOL(nftnl_rule_fprintf);
 int nftnl_rule_fprintf(FILE *fp, const struct nftnl_rule *r, uint32_t type,
 		       uint32_t flags)
 {
-	return nftnl_fprintf(fp, r, NFTNL_CMD_UNSPEC, type, flags,
-			   nftnl_rule_do_snprintf);
+	return nftnl_fprintf_buf(fp, r, nftnl_flag2cmd(flags), type, flags,
+				 nftnl_rule_buf_snprintf);
 }
 
 EXPORT_SYMBOL(nftnl_expr_foreach);
@@ -853,6 +1005,9 @@ int nftnl_expr_foreach(struct nftnl_rule *r,
        struct nftnl_expr *cur, *tmp;
        int ret;
 
+       if (nftnl_rule_expr_decode(r) < 0)
+               return -1;
+
        list_for_each_entry_safe(cur, tmp, &r->expr_list, head) {
                ret = cb(cur, data);
                if (ret < 0)
@@ -861,22 +1016,10 @@ int nftnl_expr_foreach(struct nftnl_rule *r,
        return 0;
 }
 
-struct nftnl_expr_iter {
-	const struct nftnl_rule	*r;
-	struct nftnl_expr	*cur;
-};
-
-static void nftnl_expr_iter_init(const struct nftnl_rule *r,
-				 struct nftnl_expr_iter *iter)
-{
-	iter->r = r;
-	if (list_empty(&r->expr_list))
-		iter->cur = NULL;
-	else
-		iter->cur = list_entry(r->expr_list.next, struct nftnl_expr,
-				       head);
-}
-
+/* Expressions of a lazily parsed rule that were not decoded yet are decoded
+ * for this iterator only, and released along with it. Use
+ * nftnl_expr_foreach() to update them.
+ */
 EXPORT_SYMBOL(nftnl_expr_iter_create);
 struct nftnl_expr_iter *nftnl_expr_iter_create(const struct nftnl_rule *r)
 {
@@ -886,7 +1029,10 @@ struct nftnl_expr_iter *nftnl_expr_iter_create(const struct nftnl_rule *r)
 	if (iter == NULL)
 		return NULL;
 
-	nftnl_expr_iter_init(r, iter);
+	if (nftnl_expr_iter_init(r, iter) < 0) {
+		xfree(iter);
+		return NULL;
+	}
 
 	return iter;
 }
@@ -894,25 +1040,22 @@ struct nftnl_expr_iter *nftnl_expr_iter_create(const struct nftnl_rule *r)
 EXPORT_SYMBOL(nftnl_expr_iter_next);
 struct nftnl_expr *nftnl_expr_iter_next(struct nftnl_expr_iter *iter)
 {
-	struct nftnl_expr *expr = iter->cur;
-
-	if (expr == NULL)
-		return NULL;
-
-	/* get next expression, if any */
-	iter->cur = list_entry(iter->cur->head.next, struct nftnl_expr, head);
-	if (&iter->cur->head == iter->r->expr_list.next)
-		return NULL;
-
-	return expr;
+	return __nftnl_expr_iter_next(iter);
 }
 
 EXPORT_SYMBOL(nftnl_expr_iter_destroy);
 void nftnl_expr_iter_destroy(struct nftnl_expr_iter *iter)
 {
+	nftnl_expr_iter_fini(iter);
 	xfree(iter);
 }
 
+/* Names that were interned in the same string pool share their storage. */
+static bool nftnl_rule_name_eq(const char *n1, const char *n2)
+{
+	return n1 == n2 || !strcmp(n1, n2);
+}
+
 EXPORT_SYMBOL(nftnl_rule_cmp);
 bool nftnl_rule_cmp(const struct nftnl_rule *r1, const struct nftnl_rule *r2)
 {
@@ -921,33 +1064,281 @@ bool nftnl_rule_cmp(const struct nftnl_rule *r1, const struct nftnl_rule *r2)
 	unsigned int eq = 1;
 
 	if (r1->flags & r1->flags & (1 << NFTNL_RULE_TABLE))
-		eq &= !strcmp(r1->table, r2->table);
+		eq &= nftnl_rule_name_eq(r1->table, r2->table);
 	if (r1->flags & r1->flags & (1 << NFTNL_RULE_CHAIN))
-		eq &= !strcmp(r1->chain, r2->chain);
+		eq &= nftnl_rule_name_eq(r1->chain, r2->chain);
 	if (r1->flags & r1->flags & (1 << NFTNL_RULE_COMPAT_FLAGS))
 		eq &= (r1->compat.flags == r2->compat.flags);
 	if (r1->flags & r1->flags & (1 << NFTNL_RULE_COMPAT_PROTO))
 		eq &= (r1->compat.proto == r2->compat.proto);
 
-	nftnl_expr_iter_init(r1, &it1);
-	nftnl_expr_iter_init(r2, &it2);
-	e1 = nftnl_expr_iter_next(&it1);
-	e2 = nftnl_expr_iter_next(&it2);
+	if (!eq || nftnl_expr_iter_init(r1, &it1) < 0)
+		return false;
+	if (nftnl_expr_iter_init(r2, &it2) < 0) {
+		nftnl_expr_iter_fini(&it1);
+		return false;
+	}
+	e1 = __nftnl_expr_iter_next(&it1);
+	e2 = __nftnl_expr_iter_next(&it2);
 	while (eq && e1 && e2) {
 		eq = nftnl_expr_cmp(e1, e2);
 
-		e1 = nftnl_expr_iter_next(&it1);
-		e2 = nftnl_expr_iter_next(&it2);
+		e1 = __nftnl_expr_iter_next(&it1);
+		e2 = __nftnl_expr_iter_next(&it2);
 	}
 	eq &= (!e1 && !e2);
 
+	nftnl_expr_iter_fini(&it1);
+	nftnl_expr_iter_fini(&it2);
+
 	return eq;
 }
 
+/* Hash of the expressions of @r, rules that nftnl_rule_cmp() finds equal
+ * have the same hash. Table, chain and the rest of the rule attributes are
+ * not part of it.
+ */
+EXPORT_SYMBOL(nftnl_rule_hash);
+uint64_t nftnl_rule_hash(const struct nftnl_rule *r)
+{
+	struct nftnl_expr_iter it;
+	struct nftnl_expr *e;
+	uint64_t h = 0, expr_hash;
+
+	if (nftnl_expr_iter_init(r, &it) < 0)
+		return 0;
+
+	while ((e = __nftnl_expr_iter_next(&it)) != NULL) {
+		expr_hash = nftnl_expr_hash(e);
+		h = nftnl_hash64(&expr_hash, sizeof(expr_hash), h);
+	}
+	nftnl_expr_iter_fini(&it);
+
+	return h;
+}
+
+struct nftnl_rule_chain {
+	struct hlist_node	hnode;
+	uint32_t		family;
+	const char		*table;
+	const char		*chain;
+	struct list_head	rule_list;
+};
+
 struct nftnl_rule_list {
 	struct list_head list;
+	struct {
+		struct hlist_head	*buckets;
+		uint32_t		size;
+		uint32_t		count;
+	} handle_hash;
+	struct {
+		struct hlist_head	*buckets;
+		uint32_t		size;
+		uint32_t		count;
+	} chain_hash;
 };
 
+#define NFTNL_RULE_LIST_HSIZE_MIN	64
+
+#define NFTNL_RULE_CHAIN_KEY	((1 << NFTNL_RULE_TABLE) | \
+				 (1 << NFTNL_RULE_CHAIN))
+#define NFTNL_RULE_HANDLE_KEY	(NFTNL_RULE_CHAIN_KEY | \
+				 (1 << NFTNL_RULE_HANDLE))
+
+static uint32_t nftnl_rule_handle_hash(uint64_t handle)
+{
+	return nftnl_hash(&handle, sizeof(handle), 0);
+}
+
+static int nftnl_rule_list_handle_resize(struct nftnl_rule_list *list,
+					 uint32_t size)
+{
+	struct hlist_node *pos, *n;
+	struct hlist_head *buckets;
+	struct nftnl_rule *r;
+	uint32_t i, hash;
+
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < list->handle_hash.size; i++) {
+		hlist_for_each_entry_safe(r, pos, n,
+					  &list->handle_hash.buckets[i],
+					  handle_hnode) {
+			hash = nftnl_rule_handle_hash(r->handle);
+			hlist_add_head(&r->handle_hnode,
+				       &buckets[hash & (size - 1)]);
+		}
+	}
+	xfree(list->handle_hash.buckets);
+
+	list->handle_hash.buckets = buckets;
+	list->handle_hash.size = size;
+
+	return 0;
+}
+
+static int nftnl_rule_list_chain_resize(struct nftnl_rule_list *list,
+					uint32_t size)
+{
+	struct nftnl_rule_chain *rc;
+	struct hlist_node *pos, *n;
+	struct hlist_head *buckets;
+	uint32_t i, hash;
+
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < list->chain_hash.size; i++) {
+		hlist_for_each_entry_safe(rc, pos, n,
+					  &list->chain_hash.buckets[i], hnode) {
+			hash = nftnl_name_hash(rc->family, rc->table,
+					       rc->chain);
+			hlist_add_head(&rc->hnode, &buckets[hash & (size - 1)]);
+		}
+	}
+	xfree(list->chain_hash.buckets);
+
+	list->chain_hash.buckets = buckets;
+	list->chain_hash.size = size;
+
+	return 0;
+}
+
+static struct nftnl_rule_chain *
+nftnl_rule_list_chain_find(const struct nftnl_rule_list *list,
+			   uint32_t family, const char *table,
+			   const char *chain)
+{
+	struct nftnl_rule_chain *rc;
+	struct hlist_head *bucket;
+	struct hlist_node *pos;
+	uint32_t hash;
+
+	hash = nftnl_name_hash(family, table, chain);
+	bucket = &list->chain_hash.buckets[hash & (list->chain_hash.size - 1)];
+	hlist_for_each_entry(rc, pos, bucket, hnode) {
+		if (rc->family == family &&
+		    !strcmp(rc->chain, chain) &&
+		    !strcmp(rc->table, table))
+			return rc;
+	}
+	return NULL;
+}
+
+static struct nftnl_rule_chain *
+nftnl_rule_list_chain_get(struct nftnl_rule_list *list,
+			  const struct nftnl_rule *r)
+{
+	struct nftnl_rule_chain *rc;
+	struct hlist_head *bucket;
+	uint32_t hash;
+
+	rc = nftnl_rule_list_chain_find(list, r->family, r->table, r->chain);
+	if (rc != NULL)
+		return rc;
+
+	rc = calloc(1, sizeof(struct nftnl_rule_chain));
+	if (rc == NULL)
+		return NULL;
+
+	rc->family = r->family;
+	rc->table = strdup(r->table);
+	rc->chain = strdup(r->chain);
+	if (rc->table == NULL || rc->chain == NULL)
+		goto err;
+	INIT_LIST_HEAD(&rc->rule_list);
+
+	/* If we cannot grow, keep going with a higher load factor. */
+	if (list->chain_hash.count >= list->chain_hash.size)
+		nftnl_rule_list_chain_resize(list, list->chain_hash.size * 2);
+
+	hash = nftnl_name_hash(rc->family, rc->table, rc->chain);
+	bucket = &list->chain_hash.buckets[hash & (list->chain_hash.size - 1)];
+	hlist_add_head(&rc->hnode, bucket);
+	list->chain_hash.count++;
+
+	return rc;
+err:
+	xfree(rc->table);
+	xfree(rc->chain);
+	xfree(rc);
+	return NULL;
+}
+
+/* Release the entry of the chain of @r once its last rule is gone. */
+static void nftnl_rule_list_chain_put(struct nftnl_rule_list *list,
+				      const struct nftnl_rule *r)
+{
+	struct nftnl_rule_chain *rc;
+
+	rc = nftnl_rule_list_chain_find(list, r->family, r->table, r->chain);
+	if (rc == NULL || !list_empty(&rc->rule_list))
+		return;
+
+	hlist_del(&rc->hnode);
+	list->chain_hash.count--;
+	xfree(rc->table);
+	xfree(rc->chain);
+	xfree(rc);
+}
+
+/* Rules that cannot be indexed, because some of their attributes are missing
+ * or because we ran out of memory, are still reachable through the list.
+ */
+static void nftnl_rule_list_hash_add(struct nftnl_rule_list *list,
+				     struct nftnl_rule *r, bool tail)
+{
+	struct nftnl_rule_chain *rc;
+	struct hlist_head *bucket;
+	uint32_t hash;
+
+	if (list->handle_hash.size == 0 ||
+	    (r->flags & NFTNL_RULE_CHAIN_KEY) != NFTNL_RULE_CHAIN_KEY)
+		return;
+
+	r->list = list;
+	rc = nftnl_rule_list_chain_get(list, r);
+	if (rc != NULL) {
+		if (tail)
+			list_add_tail(&r->chain_head, &rc->rule_list);
+		else
+			list_add(&r->chain_head, &rc->rule_list);
+	}
+
+	if (!(r->flags & (1 << NFTNL_RULE_HANDLE)))
+		return;
+
+	if (list->handle_hash.count >= list->handle_hash.size)
+		nftnl_rule_list_handle_resize(list, list->handle_hash.size * 2);
+
+	hash = nftnl_rule_handle_hash(r->handle);
+	bucket = &list->handle_hash.buckets[hash & (list->handle_hash.size - 1)];
+	hlist_add_head(&r->handle_hnode, bucket);
+	list->handle_hash.count++;
+}
+
+static void nftnl_rule_list_hash_free(struct nftnl_rule_list *list)
+{
+	struct nftnl_rule_chain *rc;
+	struct hlist_node *pos, *n;
+	uint32_t i;
+
+	for (i = 0; i < list->chain_hash.size; i++) {
+		hlist_for_each_entry_safe(rc, pos, n,
+					  &list->chain_hash.buckets[i], hnode) {
+			xfree(rc->table);
+			xfree(rc->chain);
+			xfree(rc);
+		}
+	}
+	xfree(list->chain_hash.buckets);
+	xfree(list->handle_hash.buckets);
+}
+
 EXPORT_SYMBOL(nftnl_rule_list_alloc);
 struct nftnl_rule_list *nftnl_rule_list_alloc(void)
 {
@@ -971,6 +1362,7 @@ void nftnl_rule_list_free(struct nftnl_rule_list *list)
 		list_del(&r->head);
 		nftnl_rule_free(r);
 	}
+	nftnl_rule_list_hash_free(list);
 	xfree(list);
 }
 
@@ -984,38 +1376,201 @@ EXPORT_SYMBOL(nftnl_rule_list_add);
 void nftnl_rule_list_add(struct nftnl_rule *r, struct nftnl_rule_list *list)
 {
 	list_add(&r->head, &list->list);
+	nftnl_rule_list_hash_add(list, r, false);
 }
 
 EXPORT_SYMBOL(nftnl_rule_list_add_tail);
 void nftnl_rule_list_add_tail(struct nftnl_rule *r, struct nftnl_rule_list *list)
 {
 	list_add_tail(&r->head, &list->list);
+	nftnl_rule_list_hash_add(list, r, true);
 }
 
 EXPORT_SYMBOL(nftnl_rule_list_del);
 void nftnl_rule_list_del(struct nftnl_rule *r)
 {
+	if (r->list != NULL) {
+		if (!hlist_unhashed(&r->handle_hnode)) {
+			hlist_del_init(&r->handle_hnode);
+			r->list->handle_hash.count--;
+		}
+		if (!list_empty(&r->chain_head)) {
+			list_del_init(&r->chain_head);
+			nftnl_rule_list_chain_put(r->list, r);
+		}
+		r->list = NULL;
+	}
 	list_del(&r->head);
 }
 
-EXPORT_SYMBOL(nftnl_rule_list_foreach);
-int nftnl_rule_list_foreach(struct nftnl_rule_list *rule_list,
-			  int (*cb)(struct nftnl_rule *r, void *data),
-			  void *data)
+/* Insert @r right after @prev, which must be a rule of the same chain, or in
+ * front of the rules of its chain if @prev is NULL. The list must be indexed.
+ */
+void nftnl_rule_list_insert(struct nftnl_rule_list *list, struct nftnl_rule *r,
+			    struct nftnl_rule *prev)
 {
-	struct nftnl_rule *cur, *tmp;
-	int ret;
+	struct nftnl_rule_chain *rc;
+	struct nftnl_rule *first;
+
+	if (prev != NULL) {
+		list_add(&r->head, &prev->head);
+		nftnl_rule_list_hash_add(list, r, true);
+		if (!list_empty(&r->chain_head) &&
+		    !list_empty(&prev->chain_head))
+			list_move(&r->chain_head, &prev->chain_head);
+		return;
+	}
 
-	list_for_each_entry_safe(cur, tmp, &rule_list->list, head) {
-		ret = cb(cur, data);
-		if (ret < 0)
-			return ret;
+	rc = nftnl_rule_list_chain_find(list, r->family, r->table, r->chain);
+	if (rc != NULL && !list_empty(&rc->rule_list)) {
+		first = list_entry(rc->rule_list.next, struct nftnl_rule,
+				   chain_head);
+		list_add_tail(&r->head, &first->head);
+	} else {
+		list_add_tail(&r->head, &list->list);
 	}
-	return 0;
+	nftnl_rule_list_hash_add(list, r, false);
 }
 
-struct nftnl_rule_list_iter {
-	const struct nftnl_rule_list	*list;
+/* Rules are indexed by family, table, chain and handle when they are added to
+ * the list, hence these must not be updated while the rule is in an indexed
+ * list. Rules of a chain are kept in the same order as in the list.
+ */
+EXPORT_SYMBOL(nftnl_rule_list_hash_enable);
+int nftnl_rule_list_hash_enable(struct nftnl_rule_list *list)
+{
+	uint32_t size = NFTNL_RULE_LIST_HSIZE_MIN;
+	struct nftnl_rule *r;
+	uint32_t count = 0;
+
+	if (list->handle_hash.size)
+		return 0;
+
+	list_for_each_entry(r, &list->list, head)
+		count++;
+
+	while (size < count)
+		size <<= 1;
+
+	if (nftnl_rule_list_chain_resize(list, NFTNL_RULE_LIST_HSIZE_MIN) < 0)
+		return -1;
+	if (nftnl_rule_list_handle_resize(list, size) < 0) {
+		xfree(list->chain_hash.buckets);
+		list->chain_hash.buckets = NULL;
+		list->chain_hash.size = 0;
+		return -1;
+	}
+
+	list_for_each_entry(r, &list->list, head)
+		nftnl_rule_list_hash_add(list, r, true);
+
+	return 0;
+}
+
+static bool nftnl_rule_key_eq(const struct nftnl_rule *r, uint32_t family,
+			      const char *table, uint64_t handle)
+{
+	return (r->flags & NFTNL_RULE_HANDLE_KEY) == NFTNL_RULE_HANDLE_KEY &&
+	       r->handle == handle &&
+	       r->family == family &&
+	       !strcmp(r->table, table);
+}
+
+/* Handles are unique per table, not across tables. */
+EXPORT_SYMBOL(nftnl_rule_list_lookup_byhandle);
+struct nftnl_rule *
+nftnl_rule_list_lookup_byhandle(const struct nftnl_rule_list *list,
+				uint32_t family, const char *table,
+				uint64_t handle)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *pos;
+	struct nftnl_rule *r;
+	uint32_t hash;
+
+	/* No index on this list, fall back to walking it. */
+	if (list->handle_hash.size == 0) {
+		list_for_each_entry(r, &list->list, head) {
+			if (nftnl_rule_key_eq(r, family, table, handle))
+				return r;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_rule_handle_hash(handle);
+	bucket = &list->handle_hash.buckets[hash & (list->handle_hash.size - 1)];
+	hlist_for_each_entry(r, pos, bucket, handle_hnode) {
+		if (nftnl_rule_key_eq(r, family, table, handle))
+			return r;
+	}
+	return NULL;
+}
+
+EXPORT_SYMBOL(nftnl_rule_list_chain_foreach);
+int nftnl_rule_list_chain_foreach(struct nftnl_rule_list *list,
+				  uint32_t family, const char *table,
+				  const char *chain,
+				  int (*cb)(struct nftnl_rule *r, void *data),
+				  void *data)
+{
+	struct nftnl_rule_chain *rc;
+	struct nftnl_rule *cur, *tmp;
+	bool last;
+	int ret;
+
+	/* No index on this list, fall back to walking it. */
+	if (list->handle_hash.size == 0) {
+		list_for_each_entry_safe(cur, tmp, &list->list, head) {
+			if ((cur->flags & NFTNL_RULE_CHAIN_KEY) !=
+			    NFTNL_RULE_CHAIN_KEY ||
+			    cur->family != family ||
+			    strcmp(cur->chain, chain) ||
+			    strcmp(cur->table, table))
+				continue;
+
+			ret = cb(cur, data);
+			if (ret < 0)
+				return ret;
+		}
+		return 0;
+	}
+
+	rc = nftnl_rule_list_chain_find(list, family, table, chain);
+	if (rc == NULL)
+		return 0;
+
+	/* The chain entry goes away with its last rule, so do not look at it
+	 * once the last rule has been passed to the callback.
+	 */
+	list_for_each_entry_safe(cur, tmp, &rc->rule_list, chain_head) {
+		last = cur->chain_head.next == &rc->rule_list;
+		ret = cb(cur, data);
+		if (ret < 0)
+			return ret;
+		if (last)
+			break;
+	}
+	return 0;
+}
+
+EXPORT_SYMBOL(nftnl_rule_list_foreach);
+int nftnl_rule_list_foreach(struct nftnl_rule_list *rule_list,
+			  int (*cb)(struct nftnl_rule *r, void *data),
+			  void *data)
+{
+	struct nftnl_rule *cur, *tmp;
+	int ret;
+
+	list_for_each_entry_safe(cur, tmp, &rule_list->list, head) {
+		ret = cb(cur, data);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+struct nftnl_rule_list_iter {
+	const struct nftnl_rule_list	*list;
 	struct nftnl_rule		*cur;
 };
 
@@ -1065,3 +1620,689 @@ void nftnl_rule_list_iter_destroy(const struct nftnl_rule_list_iter *iter)
 {
 	xfree(iter);
 }
+
+struct nftnl_rule_diff {
+	struct nftnl_rule	**cur;
+	uint32_t		num_cur;
+	struct nftnl_rule	**want;
+	uint32_t		num_want;
+	/* open addressing tables of indexes to @cur, plus one */
+	uint32_t		*by_handle;
+	uint32_t		*by_udata;
+	/* current rules without userdata by expression hash, each slot is
+	 * the head of a list of rules in chain order, linked by @hash_next.
+	 */
+	uint32_t		*by_hash;
+	uint32_t		*hash_next;
+	uint64_t		*hashes;
+	uint32_t		size;
+	/* index to @cur of the rule kept for each wanted rule, plus one */
+	uint32_t		*match;
+	bool			*kept;
+};
+
+static bool nftnl_rule_udata_eq(const struct nftnl_rule *r1,
+				const struct nftnl_rule *r2)
+{
+	bool set1 = r1->flags & (1 << NFTNL_RULE_USERDATA);
+	bool set2 = r2->flags & (1 << NFTNL_RULE_USERDATA);
+
+	if (!set1 || !set2)
+		return set1 == set2;
+
+	return r1->user.len == r2->user.len &&
+	       !memcmp(r1->user.data, r2->user.data, r1->user.len);
+}
+
+static uint32_t *nftnl_rule_diff_handle_slot(struct nftnl_rule_diff *diff,
+					     uint64_t handle)
+{
+	uint32_t i, k;
+
+	for (i = nftnl_rule_handle_hash(handle);; i++) {
+		i &= diff->size - 1;
+		k = diff->by_handle[i];
+		if (k == 0 || diff->cur[k - 1]->handle == handle)
+			return &diff->by_handle[i];
+	}
+}
+
+static void nftnl_rule_diff_udata_add(struct nftnl_rule_diff *diff,
+				      const struct nftnl_rule *r, uint32_t k)
+{
+	uint32_t i;
+
+	for (i = nftnl_hash(r->user.data, r->user.len, 0);; i++) {
+		i &= diff->size - 1;
+		if (diff->by_udata[i] == 0) {
+			diff->by_udata[i] = k + 1;
+			return;
+		}
+	}
+}
+
+/* Several rules may carry the same userdata, pick the first one that can
+ * still be kept.
+ */
+static uint32_t nftnl_rule_diff_udata_find(const struct nftnl_rule_diff *diff,
+					   const struct nftnl_rule *r,
+					   uint32_t next)
+{
+	uint32_t i, k, found = UINT32_MAX;
+
+	for (i = nftnl_hash(r->user.data, r->user.len, 0);; i++) {
+		i &= diff->size - 1;
+		k = diff->by_udata[i];
+		if (k == 0)
+			return found;
+		k--;
+		if (k >= next && k < found &&
+		    nftnl_rule_udata_eq(diff->cur[k], r))
+			found = k;
+	}
+}
+
+static uint32_t *nftnl_rule_diff_hash_slot(struct nftnl_rule_diff *diff,
+					   uint64_t hash)
+{
+	uint32_t i, k;
+
+	for (i = hash;; i++) {
+		i &= diff->size - 1;
+		k = diff->by_hash[i];
+		if (k == 0 || diff->hashes[k - 1] == hash)
+			return &diff->by_hash[i];
+	}
+}
+
+static uint32_t nftnl_rule_diff_hash_find(struct nftnl_rule_diff *diff,
+					  const struct nftnl_rule *r,
+					  uint32_t next)
+{
+	uint32_t *slot, k;
+
+	slot = nftnl_rule_diff_hash_slot(diff, nftnl_rule_hash(r));
+
+	/* Rules before @next cannot be kept anymore, skip them for good. */
+	while (*slot != 0 && *slot - 1 < next && diff->hash_next[*slot - 1])
+		*slot = diff->hash_next[*slot - 1];
+
+	for (k = *slot; k != 0; k = diff->hash_next[k - 1]) {
+		if (k - 1 >= next && nftnl_rule_cmp(diff->cur[k - 1], r))
+			return k - 1;
+	}
+	return UINT32_MAX;
+}
+
+static int nftnl_rule_diff_collect(const struct nftnl_rule_list *list,
+				   uint32_t family, const char *table,
+				   const char *chain, struct nftnl_rule ***rules,
+				   uint32_t *num_rules)
+{
+	struct nftnl_rule_chain *rc = NULL;
+	struct nftnl_rule *r;
+	uint32_t count = 0;
+
+	if (list != NULL)
+		rc = nftnl_rule_list_chain_find(list, family, table, chain);
+	if (rc != NULL) {
+		list_for_each_entry(r, &rc->rule_list, chain_head)
+			count++;
+	}
+
+	*rules = calloc(count + 1, sizeof(struct nftnl_rule *));
+	if (*rules == NULL)
+		return -1;
+
+	if (rc != NULL) {
+		list_for_each_entry(r, &rc->rule_list, chain_head)
+			(*rules)[(*num_rules)++] = r;
+	}
+	return 0;
+}
+
+static int nftnl_rule_diff_init(struct nftnl_rule_diff *diff,
+				struct nftnl_rule_list *cur,
+				struct nftnl_rule_list *want,
+				uint32_t family, const char *table,
+				const char *chain)
+{
+	if ((cur != NULL && nftnl_rule_list_hash_enable(cur) < 0) ||
+	    nftnl_rule_list_hash_enable(want) < 0)
+		return -1;
+
+	if (nftnl_rule_diff_collect(cur, family, table, chain,
+				    &diff->cur, &diff->num_cur) < 0 ||
+	    nftnl_rule_diff_collect(want, family, table, chain,
+				    &diff->want, &diff->num_want) < 0)
+		return -1;
+
+	/* Keep the load factor of the open addressing tables below 0.5 */
+	diff->size = 16;
+	while (diff->size < diff->num_cur * 2)
+		diff->size <<= 1;
+
+	diff->by_handle = calloc(diff->size, sizeof(uint32_t));
+	diff->by_udata = calloc(diff->size, sizeof(uint32_t));
+	diff->by_hash = calloc(diff->size, sizeof(uint32_t));
+	diff->hash_next = calloc(diff->num_cur + 1, sizeof(uint32_t));
+	diff->hashes = calloc(diff->num_cur + 1, sizeof(uint64_t));
+	diff->match = calloc(diff->num_want + 1, sizeof(uint32_t));
+	diff->kept = calloc(diff->num_cur + 1, sizeof(bool));
+	if (diff->by_handle == NULL || diff->by_udata == NULL ||
+	    diff->by_hash == NULL || diff->hash_next == NULL ||
+	    diff->hashes == NULL || diff->match == NULL || diff->kept == NULL)
+		return -1;
+
+	return 0;
+}
+
+static void nftnl_rule_diff_fini(struct nftnl_rule_diff *diff)
+{
+	xfree(diff->cur);
+	xfree(diff->want);
+	xfree(diff->by_handle);
+	xfree(diff->by_udata);
+	xfree(diff->by_hash);
+	xfree(diff->hash_next);
+	xfree(diff->hashes);
+	xfree(diff->match);
+	xfree(diff->kept);
+}
+
+/* Wanted rules are matched to current rules by handle, then by userdata, then
+ * by their expressions. Matches that keep the order of the chain are kept,
+ * everything else is deleted or added.
+ */
+static void nftnl_rule_diff_compute(struct nftnl_rule_diff *diff)
+{
+	uint32_t *slot, j, k, next = 0;
+	struct nftnl_rule *r;
+
+	/* Walk backwards, so that hash lists end up in chain order. */
+	for (k = diff->num_cur; k-- > 0; ) {
+		r = diff->cur[k];
+		if (r->flags & (1 << NFTNL_RULE_HANDLE)) {
+			/* Duplicated handle, the first rule wins. */
+			slot = nftnl_rule_diff_handle_slot(diff, r->handle);
+			*slot = k + 1;
+		}
+		if (r->flags & (1 << NFTNL_RULE_USERDATA)) {
+			nftnl_rule_diff_udata_add(diff, r, k);
+			continue;
+		}
+
+		/* Rules of the cache are decoded once, not on every lookup. */
+		nftnl_rule_expr_decode(r);
+		diff->hashes[k] = nftnl_rule_hash(r);
+		slot = nftnl_rule_diff_hash_slot(diff, diff->hashes[k]);
+		diff->hash_next[k] = *slot;
+		*slot = k + 1;
+	}
+
+	for (j = 0; j < diff->num_want; j++) {
+		r = diff->want[j];
+		k = UINT32_MAX;
+		if (r->flags & (1 << NFTNL_RULE_HANDLE)) {
+			slot = nftnl_rule_diff_handle_slot(diff, r->handle);
+			if (*slot != 0)
+				k = *slot - 1;
+		} else if (r->flags & (1 << NFTNL_RULE_USERDATA)) {
+			k = nftnl_rule_diff_udata_find(diff, r, next);
+		} else {
+			k = nftnl_rule_diff_hash_find(diff, r, next);
+		}
+
+		if (k == UINT32_MAX || k < next)
+			continue;
+
+		diff->match[j] = k + 1;
+		diff->kept[k] = true;
+		next = k + 1;
+	}
+}
+
+static int nftnl_rule_diff_del(struct nftnl_batch *batch, uint32_t family,
+			       const struct nftnl_rule *r, uint32_t *seq)
+{
+	struct nlmsghdr *nlh;
+
+	if (!(r->flags & (1 << NFTNL_RULE_HANDLE))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch),
+				    NFT_MSG_DELRULE, family, 0, *seq);
+	mnl_attr_put_strz(nlh, NFTA_RULE_TABLE, r->table);
+	mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN, r->chain);
+	mnl_attr_put_u64(nlh, NFTA_RULE_HANDLE, htobe64(r->handle));
+	if (nftnl_batch_update(batch) < 0)
+		return -1;
+
+	(*seq)++;
+	return 0;
+}
+
+/* Build @r with the handle of the current rule @ref in attribute @type, which
+ * is either NFTA_RULE_HANDLE or NFTA_RULE_POSITION.
+ */
+static int nftnl_rule_diff_new(struct nftnl_batch *batch, uint32_t family,
+			       uint16_t flags, struct nftnl_rule *r,
+			       uint16_t type, const struct nftnl_rule *ref,
+			       uint32_t *seq)
+{
+	struct nlmsghdr *nlh;
+
+	if (ref != NULL && !(ref->flags & (1 << NFTNL_RULE_HANDLE))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch),
+				    NFT_MSG_NEWRULE, family, flags, *seq);
+	__nftnl_rule_nlmsg_build_payload(nlh, r,
+					 ~((1 << NFTNL_RULE_HANDLE) |
+					   (1 << NFTNL_RULE_POSITION)));
+	if (ref != NULL)
+		mnl_attr_put_u64(nlh, type, htobe64(ref->handle));
+	if (nftnl_batch_update(batch) < 0)
+		return -1;
+
+	(*seq)++;
+	return 0;
+}
+
+/* Wanted rule @j is already in place as is. */
+static bool nftnl_rule_diff_unchanged(const struct nftnl_rule_diff *diff,
+				      uint32_t j)
+{
+	const struct nftnl_rule *ref;
+
+	if (!diff->match[j])
+		return false;
+
+	ref = diff->cur[diff->match[j] - 1];
+	return nftnl_rule_cmp(ref, diff->want[j]) &&
+	       nftnl_rule_udata_eq(ref, diff->want[j]);
+}
+
+static int nftnl_rule_diff_build(struct nftnl_rule_diff *diff,
+				 struct nftnl_batch *batch, uint32_t family,
+				 uint32_t *seq)
+{
+	struct nftnl_rule *r, *ref;
+	uint32_t j, k, next = 0;
+	int num_msgs = 0;
+
+	for (k = 0; k < diff->num_cur; k++) {
+		if (diff->kept[k])
+			continue;
+		if (nftnl_rule_diff_del(batch, family, diff->cur[k], seq) < 0)
+			return -1;
+		num_msgs++;
+	}
+
+	for (j = 0; j < diff->num_want; j++) {
+		r = diff->want[j];
+		if (diff->match[j]) {
+			if (nftnl_rule_diff_unchanged(diff, j))
+				continue;
+
+			ref = diff->cur[diff->match[j] - 1];
+			if (nftnl_rule_diff_new(batch, family, NLM_F_REPLACE, r,
+						NFTA_RULE_HANDLE, ref, seq) < 0)
+				return -1;
+			num_msgs++;
+			continue;
+		}
+
+		/* Insert in front of the next kept rule, so rules that are
+		 * added one after another keep their order.
+		 */
+		if (next <= j) {
+			for (next = j + 1; next < diff->num_want; next++) {
+				if (diff->match[next])
+					break;
+			}
+		}
+
+		if (next < diff->num_want) {
+			ref = diff->cur[diff->match[next] - 1];
+			if (nftnl_rule_diff_new(batch, family, NLM_F_CREATE, r,
+						NFTA_RULE_POSITION, ref,
+						seq) < 0)
+				return -1;
+		} else {
+			if (nftnl_rule_diff_new(batch, family,
+						NLM_F_CREATE | NLM_F_APPEND, r,
+						0, NULL, seq) < 0)
+				return -1;
+		}
+		num_msgs++;
+	}
+
+	return num_msgs;
+}
+
+/* Append to @batch the DELRULE and NEWRULE messages that turn the rules of a
+ * chain in @cur into the ones in @want, keeping the rules that are already in
+ * place. Current rules need their handle, @cur may be NULL for a new chain.
+ * Both lists get indexed. Returns the number of messages, or -1 on error.
+ */
+EXPORT_SYMBOL(nftnl_rule_list_diff_batch);
+int nftnl_rule_list_diff_batch(struct nftnl_batch *batch,
+			       struct nftnl_rule_list *cur,
+			       struct nftnl_rule_list *want,
+			       uint32_t family, const char *table,
+			       const char *chain, uint32_t *seq)
+{
+	return __nftnl_rule_list_diff_batch(batch, cur, want, family, table,
+					    chain, seq, NULL, NULL);
+}
+
+/* Same as nftnl_rule_list_diff_batch(), @check is called before anything is
+ * added to @batch for each wanted rule that is created or replaced, the diff
+ * fails if it returns -1.
+ */
+int __nftnl_rule_list_diff_batch(struct nftnl_batch *batch,
+				 struct nftnl_rule_list *cur,
+				 struct nftnl_rule_list *want,
+				 uint32_t family, const char *table,
+				 const char *chain, uint32_t *seq,
+				 int (*check)(struct nftnl_rule *r, void *data),
+				 void *data)
+{
+	struct nftnl_rule_diff diff = {};
+	int ret = -1;
+	uint32_t j;
+
+	if (nftnl_rule_diff_init(&diff, cur, want, family, table, chain) < 0)
+		goto out;
+
+	nftnl_rule_diff_compute(&diff);
+
+	for (j = 0; check != NULL && j < diff.num_want; j++) {
+		if (!nftnl_rule_diff_unchanged(&diff, j) &&
+		    check(diff.want[j], data) < 0)
+			goto out;
+	}
+
+	ret = nftnl_rule_diff_build(&diff, batch, family, seq);
+out:
+	nftnl_rule_diff_fini(&diff);
+	return ret;
+}
+
+/* Rule templates are encoded once, with the location of some fixed-size
+ * expression attributes (holes) recorded, so that instances are built with a
+ * copy of the template followed by in-place patches of the holes.
+ */
+struct nftnl_rule_tmpl_hole {
+	struct nftnl_expr	*expr;
+	uint16_t		attr;
+	/* encoded in the opposite byte order of the attribute value */
+	bool			swap;
+	uint32_t		offset;
+	uint32_t		len;
+};
+
+struct nftnl_rule_tmpl {
+	void				*data;
+	uint32_t			len;
+	bool				ready;
+	uint32_t			num_holes;
+	uint32_t			holes_size;
+	struct nftnl_rule_tmpl_hole	*holes;
+};
+
+/* Large enough for any rule the kernel accepts. */
+#define NFTNL_RULE_TMPL_BUFSIZ	(1 << 17)
+
+EXPORT_SYMBOL(nftnl_rule_tmpl_alloc);
+struct nftnl_rule_tmpl *nftnl_rule_tmpl_alloc(void)
+{
+	return calloc(1, sizeof(struct nftnl_rule_tmpl));
+}
+
+EXPORT_SYMBOL(nftnl_rule_tmpl_free);
+void nftnl_rule_tmpl_free(struct nftnl_rule_tmpl *t)
+{
+	xfree(t->holes);
+	xfree(t->data);
+	xfree(t);
+}
+
+/* Returns the index of the new hole, or -1 on error. The expression must
+ * remain allocated until the template is built.
+ */
+EXPORT_SYMBOL(nftnl_rule_tmpl_add_hole);
+int nftnl_rule_tmpl_add_hole(struct nftnl_rule_tmpl *t, struct nftnl_expr *e,
+			     uint16_t attr)
+{
+	struct nftnl_rule_tmpl_hole *holes;
+	uint32_t size;
+
+	if (t->num_holes == t->holes_size) {
+		size = t->holes_size ? t->holes_size * 2 : 4;
+		holes = realloc(t->holes, size * sizeof(*holes));
+		if (holes == NULL)
+			return -1;
+
+		t->holes = holes;
+		t->holes_size = size;
+	}
+
+	t->holes[t->num_holes].expr = e;
+	t->holes[t->num_holes].attr = attr;
+	t->ready = false;
+
+	return t->num_holes++;
+}
+
+static uint32_t nftnl_rule_tmpl_encode(char *buf, struct nftnl_rule *r,
+				       char **payload)
+{
+	struct nlmsghdr *nlh;
+
+	/* libmnl does not always clear attribute padding, leave no garbage in
+	 * the template.
+	 */
+	memset(buf, 0, NFTNL_RULE_TMPL_BUFSIZ);
+	nlh = nftnl_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, 0, 0, 0);
+	*payload = mnl_nlmsg_get_payload_offset(nlh, sizeof(struct nfgenmsg));
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+
+	return (char *)mnl_nlmsg_get_payload_tail(nlh) - *payload;
+}
+
+/* The hole is located by encoding the rule with two probe values that differ
+ * in every byte. Their trailing nul byte keeps string attributes, which are
+ * then reported with a different length, from being read out of bounds.
+ */
+static int nftnl_rule_tmpl_probe(struct nftnl_rule_tmpl_hole *hole,
+				 struct nftnl_rule *r, char *buf[2])
+{
+	uint64_t value[2][NFT_DATA_VALUE_MAXLEN / sizeof(uint64_t) + 1];
+	uint32_t len = hole->len, data_len, i, j;
+	struct nftnl_expr *e = hole->expr;
+	uint32_t payload_len[2];
+	uint8_t *probe[2];
+	char *payload[2];
+	const void *data;
+	int k;
+
+	for (k = 0; k < 2; k++) {
+		probe[k] = (uint8_t *)value[k];
+		for (i = 0; i < len; i++)
+			probe[k][i] = k ? ~(i + 1) : i + 1;
+		probe[k][len] = '\0';
+
+		if (nftnl_expr_set(e, hole->attr, probe[k], len) < 0)
+			return -1;
+		data = nftnl_expr_get(e, hole->attr, &data_len);
+		if (data == NULL || data_len != len ||
+		    memcmp(data, probe[k], len) != 0)
+			return -1;
+
+		payload_len[k] = nftnl_rule_tmpl_encode(buf[k], r, &payload[k]);
+	}
+	if (payload_len[0] != payload_len[1])
+		return -1;
+
+	for (i = 0; i < payload_len[0]; i++) {
+		if (payload[0][i] != payload[1][i])
+			break;
+	}
+	for (j = payload_len[0]; j > i; j--) {
+		if (payload[0][j - 1] != payload[1][j - 1])
+			break;
+	}
+	if (j - i != len)
+		return -1;
+
+	hole->offset = i;
+	if (memcmp(payload[0] + i, probe[0], len) == 0) {
+		hole->swap = false;
+		return 0;
+	}
+	if (len != sizeof(uint16_t) && len != sizeof(uint32_t) &&
+	    len != sizeof(uint64_t))
+		return -1;
+
+	for (i = 0; i < len; i++) {
+		if ((uint8_t)payload[0][hole->offset + i] != probe[0][len - 1 - i])
+			return -1;
+	}
+	hole->swap = true;
+
+	return 0;
+}
+
+static int nftnl_rule_tmpl_locate(struct nftnl_rule_tmpl_hole *hole,
+				  struct nftnl_rule *r, char *buf[2])
+{
+	uint64_t value[NFT_DATA_VALUE_MAXLEN / sizeof(uint64_t)];
+	struct nftnl_expr *e;
+	const void *data;
+	int ret;
+
+	list_for_each_entry(e, &r->expr_list, head) {
+		if (e == hole->expr)
+			break;
+	}
+	if (&e->head == &r->expr_list)
+		return -1;
+
+	data = nftnl_expr_get(e, hole->attr, &hole->len);
+	if (data == NULL || hole->len == 0 ||
+	    hole->len > NFT_DATA_VALUE_MAXLEN)
+		return -1;
+	memcpy(value, data, hole->len);
+
+	ret = nftnl_rule_tmpl_probe(hole, r, buf);
+	if (nftnl_expr_set(e, hole->attr, value, hole->len) < 0)
+		return -1;
+
+	return ret;
+}
+
+/* Encodes @r into the template and locates its holes. Hole values are changed
+ * while doing so and restored afterwards; the rule may be released then.
+ * Holes must be fixed-size attributes, such as NFTNL_EXPR_CMP_DATA and
+ * NFTNL_EXPR_IMM_VERDICT, otherwise errno is set to EINVAL.
+ */
+EXPORT_SYMBOL(nftnl_rule_tmpl_build);
+int nftnl_rule_tmpl_build(struct nftnl_rule_tmpl *t, struct nftnl_rule *r)
+{
+	char *buf[2], *payload;
+	uint32_t i, len;
+	void *data;
+	int ret = -1;
+
+	if (nftnl_rule_expr_decode(r) < 0)
+		return -1;
+
+	buf[0] = malloc(NFTNL_RULE_TMPL_BUFSIZ);
+	buf[1] = malloc(NFTNL_RULE_TMPL_BUFSIZ);
+	if (buf[0] == NULL || buf[1] == NULL)
+		goto out;
+
+	for (i = 0; i < t->num_holes; i++) {
+		if (nftnl_rule_tmpl_locate(&t->holes[i], r, buf) < 0) {
+			errno = EINVAL;
+			goto out;
+		}
+	}
+
+	len = nftnl_rule_tmpl_encode(buf[0], r, &payload);
+	data = malloc(len);
+	if (data == NULL)
+		goto out;
+	memcpy(data, payload, len);
+
+	xfree(t->data);
+	t->data = data;
+	t->len = len;
+	t->ready = true;
+	ret = 0;
+out:
+	xfree(buf[0]);
+	xfree(buf[1]);
+	return ret;
+}
+
+/* The template must be the whole payload of the message built by @nlh. Fails
+ * if the template is not built, or not rebuilt since a hole was added.
+ */
+EXPORT_SYMBOL(nftnl_rule_tmpl_nlmsg_build_payload);
+int nftnl_rule_tmpl_nlmsg_build_payload(struct nlmsghdr *nlh,
+					const struct nftnl_rule_tmpl *t)
+{
+	if (!t->ready) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memcpy(mnl_nlmsg_get_payload_tail(nlh), t->data, t->len);
+	nlh->nlmsg_len += t->len;
+	return 0;
+}
+
+EXPORT_SYMBOL(nftnl_rule_tmpl_nlmsg_patch);
+int nftnl_rule_tmpl_nlmsg_patch(struct nlmsghdr *nlh,
+				const struct nftnl_rule_tmpl *t, uint32_t hole,
+				const void *data, uint32_t data_len)
+{
+	const struct nftnl_rule_tmpl_hole *h;
+	const uint8_t *src = data;
+	uint8_t *dst;
+	uint32_t i;
+
+	if (!t->ready || hole >= t->num_holes ||
+	    t->holes[hole].len != data_len) {
+		errno = EINVAL;
+		return -1;
+	}
+	h = &t->holes[hole];
+
+	dst = mnl_nlmsg_get_payload_offset(nlh, sizeof(struct nfgenmsg));
+	dst += h->offset;
+
+	if (!h->swap) {
+		memcpy(dst, data, data_len);
+		return 0;
+	}
+	for (i = 0; i < data_len; i++)
+		dst[i] = src[data_len - 1 - i];
+
+	return 0;
+}
+
+EXPORT_SYMBOL(nftnl_rule_tmpl_nlmsg_patch_u32);
+int nftnl_rule_tmpl_nlmsg_patch_u32(struct nlmsghdr *nlh,
+				    const struct nftnl_rule_tmpl *t,
+				    uint32_t hole, uint32_t val)
+{
+	return nftnl_rule_tmpl_nlmsg_patch(nlh, t, hole, &val, sizeof(val));
+}
@@ -12,16 +12,24 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "internal.h"
 #include <stdlib.h>
+#include <netinet/in.h>
 
 #include <libmnl/libmnl.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
 #include <libnftnl/ruleset.h>
 #include <libnftnl/table.h>
 #include <libnftnl/chain.h>
 #include <libnftnl/set.h>
 #include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/gen.h>
+#include <libnftnl/batch.h>
 
 struct nftnl_ruleset {
 	struct nftnl_table_list	*table_list;
@@ -30,6 +38,11 @@ struct nftnl_ruleset {
 	struct nftnl_rule_list	*rule_list;
 
 	uint16_t		flags;
+
+	/* generation the ruleset is at, see nftnl_ruleset_nlmsg_apply() */
+	uint32_t		genid;
+	bool			has_genid;
+	bool			stale;
 };
 
 struct nftnl_parse_ctx {
@@ -53,6 +66,14 @@ struct nftnl_parse_ctx {
 
 	int (*cb)(const struct nftnl_parse_ctx *ctx);
 	uint16_t flags;
+
+	/* If set, objects are only lent to the callback and they are reused
+	 * for the next ones of the same type.
+	 */
+	bool recycle;
+	struct nftnl_table *scratch_table;
+	struct nftnl_chain *scratch_chain;
+	struct nftnl_rule *scratch_rule;
 };
 
 EXPORT_SYMBOL(nftnl_ruleset_alloc);
@@ -248,12 +269,96 @@ static void nftnl_ruleset_ctx_set_u32(struct nftnl_parse_ctx *ctx, uint16_t attr
 	nftnl_ruleset_ctx_set(ctx, attr, &val);
 }
 
+static struct nftnl_table *nftnl_ruleset_table_get(struct nftnl_parse_ctx *ctx)
+{
+	if (!ctx->recycle)
+		return nftnl_table_alloc();
+
+	if (ctx->scratch_table == NULL)
+		ctx->scratch_table = nftnl_table_alloc();
+
+	return ctx->scratch_table;
+}
+
+static void nftnl_ruleset_table_put(struct nftnl_parse_ctx *ctx,
+				    struct nftnl_table *t)
+{
+	uint16_t attr;
+
+	if (!ctx->recycle) {
+		nftnl_table_free(t);
+		return;
+	}
+
+	for (attr = 0; attr <= NFTNL_TABLE_MAX; attr++)
+		nftnl_table_unset(t, attr);
+}
+
+static struct nftnl_chain *nftnl_ruleset_chain_get(struct nftnl_parse_ctx *ctx)
+{
+	if (!ctx->recycle)
+		return nftnl_chain_alloc();
+
+	if (ctx->scratch_chain == NULL)
+		ctx->scratch_chain = nftnl_chain_alloc();
+
+	return ctx->scratch_chain;
+}
+
+static void nftnl_ruleset_chain_put(struct nftnl_parse_ctx *ctx,
+				    struct nftnl_chain *c)
+{
+	uint16_t attr;
+
+	if (!ctx->recycle) {
+		nftnl_chain_free(c);
+		return;
+	}
+
+	for (attr = 0; attr <= NFTNL_CHAIN_MAX; attr++)
+		nftnl_chain_unset(c, attr);
+}
+
+static struct nftnl_rule *nftnl_ruleset_rule_get(struct nftnl_parse_ctx *ctx)
+{
+	if (!ctx->recycle)
+		return nftnl_rule_alloc();
+
+	if (ctx->scratch_rule == NULL)
+		ctx->scratch_rule = nftnl_rule_alloc();
+
+	return ctx->scratch_rule;
+}
+
+static void nftnl_ruleset_rule_put(struct nftnl_parse_ctx *ctx,
+				   struct nftnl_rule *r)
+{
+	if (!ctx->recycle) {
+		nftnl_rule_free(r);
+		return;
+	}
+
+	nftnl_rule_reset(r);
+}
+
+static void nftnl_ruleset_ctx_release(struct nftnl_parse_ctx *ctx)
+{
+	if (ctx->scratch_table != NULL)
+		nftnl_table_free(ctx->scratch_table);
+	if (ctx->scratch_chain != NULL)
+		nftnl_chain_free(ctx->scratch_chain);
+	if (ctx->scratch_rule != NULL)
+		nftnl_rule_free(ctx->scratch_rule);
+
+	nftnl_set_list_free(ctx->set_list);
+}
+
 static int nftnl_ruleset_parse_tables(struct nftnl_parse_ctx *ctx,
 				    struct nftnl_parse_err *err)
 {
 	struct nftnl_table *table;
 
-	table = nftnl_table_alloc();
+	table = nftnl_ruleset_table_get(ctx);
 	if (table == NULL)
 		return -1;
 
@@ -275,9 +380,12 @@ static int nftnl_ruleset_parse_tables(struct nftnl_parse_ctx *ctx,
 	if (ctx->cb(ctx) < 0)
 		goto err;
 
+	if (ctx->recycle)
+		nftnl_ruleset_table_put(ctx, table);
+
 	return 0;
 err:
-	nftnl_table_free(table);
+	nftnl_ruleset_table_put(ctx, table);
 	return -1;
 }
 
@@ -286,7 +394,7 @@ static int nftnl_ruleset_parse_chains(struct nftnl_parse_ctx *ctx,
 {
 	struct nftnl_chain *chain;
 
-	chain = nftnl_chain_alloc();
+	chain = nftnl_ruleset_chain_get(ctx);
 	if (chain == NULL)
 		return -1;
 
@@ -308,31 +416,53 @@ static int nftnl_ruleset_parse_chains(struct nftnl_parse_ctx *ctx,
 	if (ctx->cb(ctx) < 0)
 		goto err;
 
+	if (ctx->recycle)
+		nftnl_ruleset_chain_put(ctx, chain);
+
 	return 0;
 err:
-	nftnl_chain_free(chain);
+	nftnl_ruleset_chain_put(ctx, chain);
 	return -1;
 }
 
+/* Rules refer to sets by name, elements are not needed to resolve their
+ * identifier.
+ */
+static int nftnl_ruleset_set_register(struct nftnl_set_list *set_list,
+				      const struct nftnl_set *set)
+{
+	struct nftnl_set *newset;
+
+	newset = nftnl_set_alloc();
+	if (newset == NULL)
+		return -1;
+	if (nftnl_set_set_str(newset, NFTNL_SET_NAME, set->name) < 0) {
+		nftnl_set_free(newset);
+		return -1;
+	}
+	nftnl_set_set_u32(newset, NFTNL_SET_ID, set->id);
+
+	nftnl_set_list_add_tail(newset, set_list);
+	return 0;
+}
+
 static int nftnl_ruleset_parse_set(struct nftnl_parse_ctx *ctx,
 				 struct nftnl_set *set, uint32_t type,
 				 struct nftnl_parse_err *err)
 {
-	struct nftnl_set *newset;
-
 	nftnl_set_set_u32(set, NFTNL_SET_ID, ctx->set_id++);
 
-	newset = nftnl_set_clone(set);
-	if (newset == NULL)
+	if (nftnl_ruleset_set_register(ctx->set_list, set) < 0)
 		goto err;
 
-	nftnl_set_list_add_tail(newset, ctx->set_list);
-
 	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE, type);
 	nftnl_ruleset_ctx_set(ctx, NFTNL_RULESET_CTX_SET, set);
 	if (ctx->cb(ctx) < 0)
 		goto err;
 
+	if (ctx->recycle)
+		nftnl_set_free(set);
+
 	return 0;
 err:
 	return -1;
@@ -405,7 +535,7 @@ static int nftnl_ruleset_parse_rules(struct nftnl_parse_ctx *ctx,
 {
 	struct nftnl_rule *rule;
 
-	rule = nftnl_rule_alloc();
+	rule = nftnl_ruleset_rule_get(ctx);
 	if (rule == NULL)
 		return -1;
 
@@ -428,14 +558,36 @@ static int nftnl_ruleset_parse_rules(struct nftnl_parse_ctx *ctx,
 	if (ctx->cb(ctx) < 0)
 		goto err;
 
+	if (ctx->recycle)
+		nftnl_ruleset_rule_put(ctx, rule);
+
 	return 0;
 err:
-	nftnl_rule_free(rule);
+	nftnl_ruleset_rule_put(ctx, rule);
 	return -1;
 }
 #endif
 
 #ifdef JSON_PARSING
+static int nftnl_ruleset_json_parse_node(struct nftnl_parse_ctx *ctx,
+					 struct nftnl_parse_err *err)
+{
+	json_t *node = ctx->json;
+
+	if (nftnl_jansson_node_exist(node, "table"))
+		return nftnl_ruleset_parse_tables(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "chain"))
+		return nftnl_ruleset_parse_chains(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "set"))
+		return nftnl_ruleset_parse_sets(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "rule"))
+		return nftnl_ruleset_parse_rules(ctx, err);
+	else if (nftnl_jansson_node_exist(node, "element"))
+		return nftnl_ruleset_parse_set_elems(ctx, err);
+
+	return -1;
+}
+
 static int nftnl_ruleset_json_parse_ruleset(struct nftnl_parse_ctx *ctx,
 					  struct nftnl_parse_err *err)
 {
@@ -451,19 +603,7 @@ static int nftnl_ruleset_json_parse_ruleset(struct nftnl_parse_ctx *ctx,
 		}
 
 		ctx->json = node;
-		if (nftnl_jansson_node_exist(node, "table"))
-			ret = nftnl_ruleset_parse_tables(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "chain"))
-			ret = nftnl_ruleset_parse_chains(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "set"))
-			ret = nftnl_ruleset_parse_sets(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "rule"))
-			ret = nftnl_ruleset_parse_rules(ctx, err);
-		else if (nftnl_jansson_node_exist(node, "element"))
-			ret = nftnl_ruleset_parse_set_elems(ctx, err);
-		else
-			return -1;
-
+		ret = nftnl_ruleset_json_parse_node(ctx, err);
 		if (ret < 0)
 			return ret;
 	}
@@ -506,32 +646,381 @@ static int nftnl_ruleset_json_parse_cmd(const char *cmd,
 err:
 	return -1;
 }
+
+/* Elements that are reported at once when a set is streamed. */
+#define NFTNL_RULESET_STREAM_ELEMS	4096
+
+struct nftnl_ruleset_stream_set {
+	json_t			*attrs;		/* all but the elements */
+	json_t			*node;		/* {"set": attrs} */
+	struct nftnl_set	*set;		/* elements not reported yet */
+	uint32_t		num_elems;
+	uint32_t		type;
+	uint32_t		id;
+	bool			reported;
+};
+
+static int nftnl_ruleset_stream_set_flush(struct nftnl_parse_ctx *ctx,
+					  struct nftnl_ruleset_stream_set *ss,
+					  struct nftnl_parse_err *err)
+{
+	struct nftnl_set *set = ss->set;
+
+	if (set == NULL) {
+		set = nftnl_set_alloc();
+		if (set == NULL)
+			return -1;
+	}
+	ss->set = NULL;
+	ss->num_elems = 0;
+
+	if (nftnl_jansson_parse_set(set, ss->node, err) < 0)
+		goto err;
+
+	if (!ss->reported) {
+		ss->id = ctx->set_id;
+		ss->reported = true;
+		if (nftnl_ruleset_parse_set(ctx, set, ss->type, err) < 0)
+			goto err;
+
+		return 0;
+	}
+
+	/* Further elements are reported as if they were added to the set by
+	 * a separate command.
+	 */
+	nftnl_set_set_u32(set, NFTNL_SET_ID, ss->id);
+	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE,
+				  NFTNL_RULESET_SET_ELEMS);
+	nftnl_ruleset_ctx_set(ctx, NFTNL_RULESET_CTX_SET, set);
+	if (ctx->cb(ctx) < 0)
+		goto err;
+
+	if (ctx->recycle)
+		nftnl_set_free(set);
+
+	return 0;
+err:
+	nftnl_set_free(set);
+	return -1;
+}
+
+static int nftnl_ruleset_stream_set_elems(struct nftnl_parse_ctx *ctx,
+					  struct nftnl_jansson_stream *s,
+					  struct nftnl_ruleset_stream_set *ss,
+					  struct nftnl_parse_err *err)
+{
+	struct nftnl_set_elem *elem;
+	json_t *node;
+	int more, ret;
+
+	more = nftnl_jansson_stream_open(s, '[', ']', err);
+	while (more > 0) {
+		node = nftnl_jansson_stream_value(s, err);
+		if (node == NULL)
+			return -1;
+
+		elem = nftnl_set_elem_alloc();
+		if (elem == NULL) {
+			json_decref(node);
+			return -1;
+		}
+		ret = nftnl_jansson_set_elem_parse(elem, node, err);
+		json_decref(node);
+		if (ret < 0) {
+			nftnl_set_elem_free(elem);
+			return -1;
+		}
+
+		if (ss->set == NULL) {
+			ss->set = nftnl_set_alloc();
+			if (ss->set == NULL) {
+				nftnl_set_elem_free(elem);
+				return -1;
+			}
+		}
+		nftnl_set_elem_add(ss->set, elem);
+
+		/* Elements can only be reported once the set they belong to
+		 * is known, attributes are expected to come first.
+		 */
+		if (++ss->num_elems >= NFTNL_RULESET_STREAM_ELEMS &&
+		    json_object_get(ss->attrs, "name") &&
+		    json_object_get(ss->attrs, "table") &&
+		    nftnl_ruleset_stream_set_flush(ctx, ss, err) < 0)
+			return -1;
+
+		more = nftnl_jansson_stream_next(s, ']', err);
+	}
+
+	return more;
+}
+
+/* Sets are reported as soon as their first NFTNL_RULESET_STREAM_ELEMS
+ * elements are read. The remaining ones follow in NFTNL_RULESET_SET_ELEMS
+ * contexts of the same size, so that large sets are never held in memory.
+ */
+static int nftnl_ruleset_stream_set(struct nftnl_parse_ctx *ctx,
+				    struct nftnl_jansson_stream *s,
+				    uint32_t type, struct nftnl_parse_err *err)
+{
+	struct nftnl_ruleset_stream_set ss = {
+		.type	= type,
+	};
+	char *key = NULL;
+	json_t *node;
+	int more, ret = -1;
+
+	ss.attrs = json_object();
+	ss.node = json_object();
+	if (ss.attrs == NULL || ss.node == NULL ||
+	    json_object_set_new(ss.node, "set",
+				json_incref(ss.attrs)) < 0)
+		goto out;
+
+	more = nftnl_jansson_stream_open(s, '{', '}', err);
+	while (more > 0) {
+		key = nftnl_jansson_stream_key(s, err);
+		if (key == NULL)
+			goto out;
+
+		if (strcmp(key, "set_elem") == 0) {
+			/* Deleting a set does not need its elements. */
+			if (ctx->cmd == NFTNL_CMD_DELETE &&
+			    type == NFTNL_RULESET_SET) {
+				if (nftnl_jansson_stream_skip(s, err) < 0)
+					goto out;
+			} else if (nftnl_ruleset_stream_set_elems(ctx, s, &ss,
+								  err) < 0) {
+				goto out;
+			}
+		} else if (ss.reported) {
+			/* Too late, the set was reported already. */
+			err->error = NFTNL_PARSE_EBADINPUT;
+			err->node_name = "set_elem";
+			err->line = s->line;
+			err->column = s->column;
+			errno = EINVAL;
+			goto out;
+		} else {
+			node = nftnl_jansson_stream_value(s, err);
+			if (node == NULL ||
+			    json_object_set_new(ss.attrs, key, node) < 0)
+				goto out;
+		}
+		free(key);
+		key = NULL;
+		more = nftnl_jansson_stream_next(s, '}', err);
+	}
+	if (more < 0)
+		goto out;
+
+	if ((!ss.reported || ss.set != NULL) &&
+	    nftnl_ruleset_stream_set_flush(ctx, &ss, err) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	xfree(key);
+	if (ss.set != NULL)
+		nftnl_set_free(ss.set);
+	json_decref(ss.node);
+	json_decref(ss.attrs);
+	return ret;
+}
+
+/* Skips the members of an object that follow the one already read. */
+static int nftnl_ruleset_stream_skip(struct nftnl_jansson_stream *s,
+				     struct nftnl_parse_err *err)
+{
+	char *key;
+	int more;
+
+	while ((more = nftnl_jansson_stream_next(s, '}', err)) > 0) {
+		key = nftnl_jansson_stream_key(s, err);
+		if (key == NULL)
+			return -1;
+
+		xfree(key);
+		if (nftnl_jansson_stream_skip(s, err) < 0)
+			return -1;
+	}
+
+	return more;
+}
+
+static int nftnl_ruleset_stream_obj(struct nftnl_parse_ctx *ctx,
+				    struct nftnl_jansson_stream *s,
+				    struct nftnl_parse_err *err)
+{
+	json_t *node, *value;
+	char *key;
+	int ret;
+
+	ret = nftnl_jansson_stream_open(s, '{', '}', err);
+	if (ret <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	key = nftnl_jansson_stream_key(s, err);
+	if (key == NULL)
+		return -1;
+
+	if (strcmp(key, "set") == 0) {
+		ret = nftnl_ruleset_stream_set(ctx, s, NFTNL_RULESET_SET, err);
+	} else if (strcmp(key, "element") == 0) {
+		ret = nftnl_ruleset_stream_set(ctx, s, NFTNL_RULESET_SET_ELEMS,
+					       err);
+	} else {
+		value = nftnl_jansson_stream_value(s, err);
+		node = json_object();
+		if (value == NULL || node == NULL ||
+		    json_object_set_new(node, key, value) < 0) {
+			json_decref(node);
+			xfree(key);
+			return -1;
+		}
+		ctx->json = node;
+		ret = nftnl_ruleset_json_parse_node(ctx, err);
+		json_decref(node);
+	}
+	xfree(key);
+	if (ret < 0)
+		return -1;
+
+	return nftnl_ruleset_stream_skip(s, err);
+}
+
+static int nftnl_ruleset_stream_cmd(struct nftnl_parse_ctx *ctx,
+				    struct nftnl_jansson_stream *s,
+				    struct nftnl_parse_err *err)
+{
+	uint32_t cmdnum;
+	char *cmd;
+	int more;
+
+	more = nftnl_jansson_stream_open(s, '{', '}', err);
+	if (more <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	cmd = nftnl_jansson_stream_key(s, err);
+	if (cmd == NULL)
+		return -1;
+
+	cmdnum = nftnl_str2cmd(cmd);
+	if (cmdnum == NFTNL_CMD_UNSPEC) {
+		err->error = NFTNL_PARSE_EMISSINGNODE;
+		err->node_name = cmd;
+		return -1;
+	}
+	xfree(cmd);
+	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_CMD, cmdnum);
+
+	more = nftnl_jansson_stream_open(s, '[', ']', err);
+	if (more == 0 && cmdnum == NFTNL_CMD_FLUSH) {
+		nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_TYPE,
+					  NFTNL_RULESET_RULESET);
+		if (ctx->cb(ctx) < 0)
+			return -1;
+	}
+	while (more > 0) {
+		if (nftnl_ruleset_stream_obj(ctx, s, err) < 0)
+			return -1;
+
+		more = nftnl_jansson_stream_next(s, ']', err);
+	}
+	if (more < 0)
+		return -1;
+
+	return nftnl_ruleset_stream_skip(s, err);
+}
+
+/* Same as walking the tree of the whole document, but objects are reported
+ * as soon as they are read from @fp.
+ */
+static int nftnl_ruleset_json_stream(struct nftnl_parse_ctx *ctx, FILE *fp,
+				     struct nftnl_parse_err *err)
+{
+	struct nftnl_jansson_stream s;
+	bool found = false, array;
+	int more, ret = -1;
+	char *key;
+
+	nftnl_jansson_stream_init(&s, fp);
+
+	more = nftnl_jansson_stream_open(&s, '{', '}', err);
+	while (more > 0) {
+		key = nftnl_jansson_stream_key(&s, err);
+		if (key == NULL)
+			goto out;
+
+		array = strcmp(key, "nftables") == 0;
+		xfree(key);
+		if (array) {
+			found = true;
+			more = nftnl_jansson_stream_open(&s, '[', ']', err);
+			while (more > 0) {
+				if (nftnl_ruleset_stream_cmd(ctx, &s, err) < 0)
+					goto out;
+
+				more = nftnl_jansson_stream_next(&s, ']', err);
+			}
+			if (more < 0)
+				goto out;
+		} else if (nftnl_jansson_stream_skip(&s, err) < 0) {
+			goto out;
+		}
+		more = nftnl_jansson_stream_next(&s, '}', err);
+	}
+	if (more < 0)
+		goto out;
+
+	if (!found) {
+		errno = EINVAL;
+		goto out;
+	}
+	ret = 0;
+out:
+	nftnl_jansson_stream_release(&s);
+	return ret;
+}
 #endif
 
 static int nftnl_ruleset_json_parse(const void *json,
 				  struct nftnl_parse_err *err,
 				  enum nftnl_parse_input input,
 				  enum nftnl_parse_type type, void *arg,
-				  int (*cb)(const struct nftnl_parse_ctx *ctx))
+				  int (*cb)(const struct nftnl_parse_ctx *ctx),
+				  bool recycle)
 {
 #ifdef JSON_PARSING
 	json_t *root, *array, *node;
 	json_error_t error;
-	int i, len;
+	int i, len, ret;
 	const char *key;
 	struct nftnl_parse_ctx ctx = {
 		.cb = cb,
 		.format = type,
 		.flags = 0,
+		.recycle = recycle,
 	};
 
 	ctx.set_list = nftnl_set_list_alloc();
 	if (ctx.set_list == NULL)
 		return -1;
+	if (nftnl_set_list_hash_enable(ctx.set_list) < 0)
+		goto err1;
 
 	if (arg != NULL)
 		nftnl_ruleset_ctx_set(&ctx, NFTNL_RULESET_CTX_DATA, arg);
 
+	if (input == NFTNL_PARSE_STREAM) {
+		ret = nftnl_ruleset_json_stream(&ctx, (FILE *)json, err);
+		nftnl_ruleset_ctx_release(&ctx);
+		return ret;
+	}
+
 	root = nftnl_jansson_create_root(json, &error, err, input);
 	if (root == NULL)
 		goto err1;
@@ -558,13 +1047,13 @@ static int nftnl_ruleset_json_parse(const void *json,
 			goto err2;
 	}
 
-	nftnl_set_list_free(ctx.set_list);
+	nftnl_ruleset_ctx_release(&ctx);
 	nftnl_jansson_free_root(root);
 	return 0;
 err2:
 	nftnl_jansson_free_root(root);
 err1:
-	nftnl_set_list_free(ctx.set_list);
+	nftnl_ruleset_ctx_release(&ctx);
 	return -1;
 #else
 	errno = EOPNOTSUPP;
@@ -575,13 +1064,15 @@ err1:
 static int
 nftnl_ruleset_do_parse(enum nftnl_parse_type type, const void *data,
 		     struct nftnl_parse_err *err, enum nftnl_parse_input input,
-		     void *arg, int (*cb)(const struct nftnl_parse_ctx *ctx))
+		     void *arg, int (*cb)(const struct nftnl_parse_ctx *ctx),
+		     bool recycle)
 {
 	int ret;
 
 	switch (type) {
 	case NFTNL_PARSE_JSON:
-		ret = nftnl_ruleset_json_parse(data, err, input, type, arg, cb);
+		ret = nftnl_ruleset_json_parse(data, err, input, type, arg, cb,
+					       recycle);
 		break;
 	case NFTNL_PARSE_XML:
 	default:
@@ -598,7 +1089,27 @@ int nftnl_ruleset_parse_file_cb(enum nftnl_parse_type type, FILE *fp,
 			      struct nftnl_parse_err *err, void *data,
 			      int (*cb)(const struct nftnl_parse_ctx *ctx))
 {
-	return nftnl_ruleset_do_parse(type, fp, err, NFTNL_PARSE_FILE, data, cb);
+	return nftnl_ruleset_do_parse(type, fp, err, NFTNL_PARSE_FILE, data, cb,
+				      false);
+}
+
+/* Same as nftnl_ruleset_parse_file_cb(), but the file is not loaded as a
+ * whole, objects are reported as soon as they are read. Files of any size can
+ * be parsed with little memory, in exchange:
+ *
+ * - Sets are reported along with their first elements, the rest follow in
+ *   NFTNL_RULESET_SET_ELEMS contexts, as if they were added by an "element"
+ *   command. Sets that are deleted are reported without elements.
+ * - Set attributes have to come before the elements, as written by the
+ *   library. Attributes that follow reported elements are an error.
+ */
+EXPORT_SYMBOL(nftnl_ruleset_parse_file_stream_cb);
+int nftnl_ruleset_parse_file_stream_cb(enum nftnl_parse_type type, FILE *fp,
+				       struct nftnl_parse_err *err, void *data,
+				       int (*cb)(const struct nftnl_parse_ctx *ctx))
+{
+	return nftnl_ruleset_do_parse(type, fp, err, NFTNL_PARSE_STREAM, data,
+				      cb, false);
 }
 
 EXPORT_SYMBOL(nftnl_ruleset_parse_buffer_cb);
@@ -607,7 +1118,45 @@ int nftnl_ruleset_parse_buffer_cb(enum nftnl_parse_type type, const char *buffer
 				int (*cb)(const struct nftnl_parse_ctx *ctx))
 {
 	return nftnl_ruleset_do_parse(type, buffer, err, NFTNL_PARSE_BUFFER, data,
-				    cb);
+				    cb, false);
+}
+
+static struct nftnl_set *nftnl_ruleset_set_lookup(const struct nftnl_ruleset *rs,
+						  const struct nftnl_set *s)
+{
+	return nftnl_set_list_lookup(rs->set_list, s->family, s->table,
+				     s->name);
+}
+
+/* Elements of a set that was already reported are merged into it. */
+static int nftnl_ruleset_cb_set_elems(struct nftnl_ruleset *r,
+				      struct nftnl_set *s)
+{
+	struct nftnl_set_elem *e, *tmp;
+	struct nftnl_set *target = NULL;
+
+	if (r->set_list == NULL) {
+		r->set_list = nftnl_set_list_alloc();
+		if (r->set_list == NULL)
+			return -1;
+
+		nftnl_ruleset_set(r, NFTNL_RULESET_SETLIST, r->set_list);
+	} else {
+		target = nftnl_ruleset_set_lookup(r, s);
+	}
+
+	if (target == NULL) {
+		nftnl_set_list_add_tail(s, r->set_list);
+		return 0;
+	}
+
+	list_for_each_entry_safe(e, tmp, &s->element_list, head) {
+		nftnl_set_elem_del(s, e);
+		nftnl_set_elem_add(target, e);
+	}
+	nftnl_set_free(s);
+
+	return 0;
 }
 
 static int nftnl_ruleset_cb(const struct nftnl_parse_ctx *ctx)
@@ -651,6 +1200,10 @@ static int nftnl_ruleset_cb(const struct nftnl_parse_ctx *ctx)
 		}
 		nftnl_set_list_add_tail(ctx->set, r->set_list);
 		break;
+	case NFTNL_RULESET_SET_ELEMS:
+		if (nftnl_ruleset_cb_set_elems(r, ctx->set) < 0)
+			return -1;
+		break;
 	case NFTNL_RULESET_RULE:
 		if (r->rule_list == NULL) {
 			r->rule_list = nftnl_rule_list_alloc();
@@ -685,39 +1238,1816 @@ int nftnl_ruleset_parse_file(struct nftnl_ruleset *rs, enum nftnl_parse_type typ
 	return nftnl_ruleset_parse_file_cb(type, fp, err, rs, nftnl_ruleset_cb);
 }
 
-static const char *nftnl_ruleset_o_opentag(uint32_t type)
+#ifdef JSON_PARSING
+/* Records handed out to a worker at once. */
+#define NFTNL_RULESET_PARALLEL_CHUNK	64
+
+/* One object of the "nftables" array, and what it turned into. */
+struct nftnl_ruleset_record {
+	const char	*data;
+	size_t		len;
+	int		line;
+	uint32_t	cmd;
+	bool		set;
+	uint32_t	set_id;
+	uint32_t	type;
+	void		*obj;
+};
+
+struct nftnl_ruleset_split {
+	struct nftnl_ruleset_record	*records;
+	uint32_t			num_records;
+	uint32_t			size;
+	uint32_t			num_sets;
+	uint32_t			format;
+	/* rules look up their sets here once all sets are parsed */
+	struct nftnl_set_list		*set_list;
+	bool				set_phase;
+	uint32_t			next;
+	bool				failed;
+};
+
+struct nftnl_ruleset_worker {
+	struct nftnl_ruleset_split	*split;
+	pthread_t			thread;
+	bool				started;
+	uint32_t			failed_record;
+	int				errnum;
+	struct nftnl_parse_err		err;
+};
+
+static struct nftnl_ruleset_record *
+nftnl_ruleset_record_add(struct nftnl_ruleset_split *sp)
 {
-	switch (type) {
-	case NFTNL_OUTPUT_JSON:
-		return "{\"nftables\":[";
-	case NFTNL_OUTPUT_XML:
-	default:
-		return "";
+	struct nftnl_ruleset_record *records;
+	uint32_t size;
+
+	if (sp->num_records == sp->size) {
+		size = sp->size ? sp->size * 2 : 1024;
+		records = realloc(sp->records, size * sizeof(*records));
+		if (records == NULL)
+			return NULL;
+
+		sp->records = records;
+		sp->size = size;
 	}
+
+	records = &sp->records[sp->num_records++];
+	memset(records, 0, sizeof(*records));
+
+	return records;
 }
 
-static const char *nftnl_ruleset_o_separator(void *obj, uint32_t type)
+static int nftnl_ruleset_split_obj(struct nftnl_ruleset_split *sp,
+				   struct nftnl_jansson_stream *s,
+				   uint32_t cmd, struct nftnl_parse_err *err)
 {
-	if (obj == NULL)
-		return "";
+	struct nftnl_ruleset_record *rec;
+	struct nftnl_jansson_stream obj;
+	char *key = NULL;
 
-	switch (type) {
-	case NFTNL_OUTPUT_JSON:
-		return ",";
-	case NFTNL_OUTPUT_DEFAULT:
-		return "\n";
-	default:
-		return "";
+	rec = nftnl_ruleset_record_add(sp);
+	if (rec == NULL)
+		return -1;
+
+	rec->cmd = cmd;
+	rec->line = s->line;
+	rec->data = nftnl_jansson_stream_span(s, &rec->len, err);
+	if (rec->data == NULL)
+		return -1;
+
+	/* Rules need the identifiers of the sets they refer to, sets are
+	 * parsed first.
+	 */
+	nftnl_jansson_stream_init_buffer(&obj, rec->data, rec->len);
+	if (nftnl_jansson_stream_open(&obj, '{', '}', err) > 0)
+		key = nftnl_jansson_stream_key(&obj, err);
+	if (key != NULL &&
+	    (strcmp(key, "set") == 0 || strcmp(key, "element") == 0)) {
+		rec->set = true;
+		rec->set_id = sp->num_sets++;
 	}
+	xfree(key);
+	nftnl_jansson_stream_release(&obj);
+
+	return 0;
 }
 
-static const char *nftnl_ruleset_o_closetag(uint32_t type)
+static int nftnl_ruleset_split_cmd(struct nftnl_ruleset_split *sp,
+				   struct nftnl_jansson_stream *s,
+				   struct nftnl_parse_err *err)
 {
-	switch (type) {
-	case NFTNL_OUTPUT_JSON:
-		return "]}";
-	case NFTNL_OUTPUT_XML:
-	default:
+	struct nftnl_ruleset_record *rec;
+	uint32_t cmdnum;
+	size_t len;
+	char *cmd;
+	int more;
+
+	more = nftnl_jansson_stream_open(s, '{', '}', err);
+	if (more <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	cmd = nftnl_jansson_stream_key(s, err);
+	if (cmd == NULL)
+		return -1;
+
+	cmdnum = nftnl_str2cmd(cmd);
+	if (cmdnum == NFTNL_CMD_UNSPEC) {
+		err->error = NFTNL_PARSE_EMISSINGNODE;
+		err->node_name = cmd;
+		return -1;
+	}
+	xfree(cmd);
+
+	more = nftnl_jansson_stream_open(s, '[', ']', err);
+	if (more == 0 && cmdnum == NFTNL_CMD_FLUSH) {
+		rec = nftnl_ruleset_record_add(sp);
+		if (rec == NULL)
+			return -1;
+
+		rec->cmd = cmdnum;
+		rec->type = NFTNL_RULESET_RULESET;
+	}
+	while (more > 0) {
+		if (nftnl_ruleset_split_obj(sp, s, cmdnum, err) < 0)
+			return -1;
+
+		more = nftnl_jansson_stream_next(s, ']', err);
+	}
+	if (more < 0)
+		return -1;
+
+	while ((more = nftnl_jansson_stream_next(s, '}', err)) > 0) {
+		cmd = nftnl_jansson_stream_key(s, err);
+		if (cmd == NULL)
+			return -1;
+
+		xfree(cmd);
+		if (nftnl_jansson_stream_span(s, &len, err) == NULL)
+			return -1;
+	}
+
+	return more;
+}
+
+/* Locates the objects of the document without decoding them. */
+static int nftnl_ruleset_split(struct nftnl_ruleset_split *sp,
+			       const char *data, struct nftnl_parse_err *err)
+{
+	struct nftnl_jansson_stream s;
+	bool found = false, array;
+	int more, ret = -1;
+	size_t len;
+	char *key;
+
+	nftnl_jansson_stream_init_buffer(&s, data, strlen(data));
+
+	more = nftnl_jansson_stream_open(&s, '{', '}', err);
+	while (more > 0) {
+		key = nftnl_jansson_stream_key(&s, err);
+		if (key == NULL)
+			goto out;
+
+		array = strcmp(key, "nftables") == 0;
+		xfree(key);
+		if (array) {
+			found = true;
+			more = nftnl_jansson_stream_open(&s, '[', ']', err);
+			while (more > 0) {
+				if (nftnl_ruleset_split_cmd(sp, &s, err) < 0)
+					goto out;
+
+				more = nftnl_jansson_stream_next(&s, ']', err);
+			}
+			if (more < 0)
+				goto out;
+		} else if (nftnl_jansson_stream_span(&s, &len, err) == NULL) {
+			goto out;
+		}
+		more = nftnl_jansson_stream_next(&s, '}', err);
+	}
+	if (more < 0)
+		goto out;
+
+	if (!found) {
+		errno = EINVAL;
+		goto out;
+	}
+	ret = 0;
+out:
+	nftnl_jansson_stream_release(&s);
+	return ret;
+}
+
+static uint16_t nftnl_ruleset_ctx_obj_attr(uint32_t type)
+{
+	switch (type) {
+	case NFTNL_RULESET_TABLE:
+		return NFTNL_RULESET_CTX_TABLE;
+	case NFTNL_RULESET_CHAIN:
+		return NFTNL_RULESET_CTX_CHAIN;
+	case NFTNL_RULESET_RULE:
+		return NFTNL_RULESET_CTX_RULE;
+	default:
+		return NFTNL_RULESET_CTX_SET;
+	}
+}
+
+static int nftnl_ruleset_record_cb(const struct nftnl_parse_ctx *ctx)
+{
+	struct nftnl_ruleset_record *rec = ctx->data;
+
+	rec->type = ctx->type;
+	rec->obj = nftnl_ruleset_ctx_get(ctx,
+					 nftnl_ruleset_ctx_obj_attr(ctx->type));
+	return 0;
+}
+
+static int nftnl_ruleset_record_parse(struct nftnl_parse_ctx *ctx,
+				      struct nftnl_ruleset_record *rec,
+				      struct nftnl_parse_err *err)
+{
+	json_error_t error;
+	json_t *node;
+	int ret;
+
+	node = json_loadb(rec->data, rec->len, 0, &error);
+	if (node == NULL) {
+		err->error = NFTNL_PARSE_EBADINPUT;
+		err->line = rec->line + error.line - 1;
+		err->column = error.column;
+		errno = EINVAL;
+		return -1;
+	}
+
+	nftnl_ruleset_ctx_set_u32(ctx, NFTNL_RULESET_CTX_CMD, rec->cmd);
+	ctx->set_id = rec->set_id;
+	ctx->data = rec;
+	ctx->json = node;
+	ret = nftnl_ruleset_json_parse_node(ctx, err);
+	json_decref(node);
+
+	return ret;
+}
+
+static void nftnl_ruleset_worker_run(struct nftnl_ruleset_worker *w)
+{
+	struct nftnl_ruleset_split *sp = w->split;
+	struct nftnl_ruleset_record *rec;
+	struct nftnl_parse_ctx ctx = {
+		.cb	= nftnl_ruleset_record_cb,
+		.format	= sp->format,
+	};
+	uint32_t i, last;
+
+	/* Sets register themselves for the rules that follow, this is done
+	 * once all of them are parsed instead.
+	 */
+	if (sp->set_phase) {
+		ctx.set_list = nftnl_set_list_alloc();
+		if (ctx.set_list == NULL)
+			goto err;
+	} else {
+		ctx.set_list = sp->set_list;
+	}
+
+	for (;;) {
+		i = __atomic_fetch_add(&sp->next, NFTNL_RULESET_PARALLEL_CHUNK,
+				       __ATOMIC_RELAXED);
+		if (i >= sp->num_records ||
+		    __atomic_load_n(&sp->failed, __ATOMIC_RELAXED))
+			break;
+
+		last = i + NFTNL_RULESET_PARALLEL_CHUNK;
+		if (last > sp->num_records)
+			last = sp->num_records;
+
+		for (; i < last; i++) {
+			rec = &sp->records[i];
+			if (rec->data == NULL || rec->set != sp->set_phase)
+				continue;
+
+			if (nftnl_ruleset_record_parse(&ctx, rec, &w->err) < 0) {
+				w->failed_record = i;
+				goto err;
+			}
+		}
+	}
+
+	if (sp->set_phase)
+		nftnl_set_list_free(ctx.set_list);
+	return;
+err:
+	w->errnum = errno;
+	__atomic_store_n(&sp->failed, true, __ATOMIC_RELAXED);
+	if (sp->set_phase && ctx.set_list != NULL)
+		nftnl_set_list_free(ctx.set_list);
+}
+
+static void *nftnl_ruleset_worker_thread(void *data)
+{
+	nftnl_ruleset_worker_run(data);
+
+	/* Expressions released by this thread are not reachable anymore. */
+	nftnl_expr_cache_flush();
+	return NULL;
+}
+
+static int nftnl_ruleset_parallel_run(struct nftnl_ruleset_split *sp,
+				      struct nftnl_ruleset_worker *workers,
+				      uint32_t num_workers, bool set_phase)
+{
+	struct nftnl_str_pool *pool;
+	uint32_t i;
+
+	sp->set_phase = set_phase;
+	sp->next = 0;
+
+	/* The calling thread is the first worker, the others are extra
+	 * help: if they cannot be started, it does their share.
+	 */
+	for (i = 1; i < num_workers; i++) {
+		workers[i].started =
+			pthread_create(&workers[i].thread, NULL,
+				       nftnl_ruleset_worker_thread,
+				       &workers[i]) == 0;
+	}
+	/* Like the other workers, it does not intern names. */
+	pool = nftnl_str_pool_attach(NULL);
+	nftnl_ruleset_worker_run(&workers[0]);
+	nftnl_str_pool_attach(pool);
+
+	for (i = 1; i < num_workers; i++) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+	}
+
+	return sp->failed ? -1 : 0;
+}
+
+/* Reports the error of the first record that failed. */
+static void nftnl_ruleset_parallel_err(struct nftnl_ruleset_worker *workers,
+				       uint32_t num_workers,
+				       struct nftnl_parse_err *err)
+{
+	struct nftnl_ruleset_worker *first = NULL;
+	uint32_t i;
+
+	for (i = 0; i < num_workers; i++) {
+		if (workers[i].failed_record == UINT32_MAX)
+			continue;
+		if (first == NULL ||
+		    workers[i].failed_record < first->failed_record)
+			first = &workers[i];
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (&workers[i] != first)
+			xfree(workers[i].err.node_name);
+	}
+	if (first == NULL)
+		return;
+
+	*err = first->err;
+	errno = first->errnum;
+}
+
+static int nftnl_ruleset_parallel_sets(struct nftnl_ruleset_split *sp)
+{
+	struct nftnl_ruleset_record *rec;
+	uint32_t i;
+
+	sp->set_list = nftnl_set_list_alloc();
+	if (sp->set_list == NULL ||
+	    nftnl_set_list_hash_enable(sp->set_list) < 0)
+		return -1;
+
+	for (i = 0; i < sp->num_records; i++) {
+		rec = &sp->records[i];
+		if (rec->set && rec->obj != NULL &&
+		    nftnl_ruleset_set_register(sp->set_list, rec->obj) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Objects are added to @rs in the order of the document, as if it was
+ * parsed by a single thread.
+ */
+static int nftnl_ruleset_parallel_replay(struct nftnl_ruleset *rs,
+					 struct nftnl_ruleset_split *sp)
+{
+	struct nftnl_ruleset_record *rec;
+	struct nftnl_parse_ctx ctx = {};
+	uint32_t i;
+
+	nftnl_ruleset_ctx_set(&ctx, NFTNL_RULESET_CTX_DATA, rs);
+	for (i = 0; i < sp->num_records; i++) {
+		rec = &sp->records[i];
+		nftnl_ruleset_ctx_set_u32(&ctx, NFTNL_RULESET_CTX_CMD, rec->cmd);
+		nftnl_ruleset_ctx_set_u32(&ctx, NFTNL_RULESET_CTX_TYPE,
+					  rec->type);
+		nftnl_ruleset_ctx_set(&ctx,
+				      nftnl_ruleset_ctx_obj_attr(rec->type),
+				      rec->obj);
+		if (nftnl_ruleset_cb(&ctx) < 0)
+			return -1;
+
+		rec->obj = NULL;
+	}
+
+	return 0;
+}
+
+static void nftnl_ruleset_split_free(struct nftnl_ruleset_split *sp)
+{
+	struct nftnl_ruleset_record *rec;
+	struct nftnl_parse_ctx ctx = {};
+	uint32_t i;
+
+	for (i = 0; i < sp->num_records; i++) {
+		rec = &sp->records[i];
+		if (rec->obj == NULL)
+			continue;
+
+		nftnl_ruleset_ctx_set_u32(&ctx, NFTNL_RULESET_CTX_TYPE,
+					  rec->type);
+		nftnl_ruleset_ctx_set(&ctx,
+				      nftnl_ruleset_ctx_obj_attr(rec->type),
+				      rec->obj);
+		nftnl_ruleset_ctx_free(&ctx);
+	}
+	xfree(sp->records);
+
+	if (sp->set_list != NULL)
+		nftnl_set_list_free(sp->set_list);
+}
+
+static int nftnl_ruleset_json_parse_parallel(struct nftnl_ruleset *rs,
+					     const char *data,
+					     struct nftnl_parse_err *err,
+					     uint32_t num_threads)
+{
+	struct nftnl_ruleset_split sp = {
+		.format	= NFTNL_OUTPUT_JSON,
+	};
+	struct nftnl_ruleset_worker *workers;
+	uint32_t i, max_workers;
+	long num_cpus;
+	int ret = -1;
+
+	if (nftnl_ruleset_split(&sp, data, err) < 0)
+		goto err1;
+
+	if (num_threads == 0) {
+		num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_threads = num_cpus > 0 ? num_cpus : 1;
+	}
+	max_workers = sp.num_records / NFTNL_RULESET_PARALLEL_CHUNK + 1;
+	if (num_threads > max_workers)
+		num_threads = max_workers;
+
+	workers = calloc(num_threads, sizeof(*workers));
+	if (workers == NULL)
+		goto err1;
+
+	for (i = 0; i < num_threads; i++) {
+		workers[i].split = &sp;
+		workers[i].failed_record = UINT32_MAX;
+	}
+
+	if (nftnl_ruleset_parallel_run(&sp, workers, num_threads, true) < 0 ||
+	    nftnl_ruleset_parallel_sets(&sp) < 0 ||
+	    nftnl_ruleset_parallel_run(&sp, workers, num_threads, false) < 0) {
+		nftnl_ruleset_parallel_err(workers, num_threads, err);
+		goto err2;
+	}
+
+	ret = nftnl_ruleset_parallel_replay(rs, &sp);
+err2:
+	xfree(workers);
+err1:
+	nftnl_ruleset_split_free(&sp);
+	return ret;
+}
+#endif
+
+/* Same as nftnl_ruleset_parse(), the objects of the document are parsed by
+ * @num_threads threads, or as many as online CPUs if zero. Names are not
+ * interned, not even by the calling thread, which parses its share too.
+ */
+EXPORT_SYMBOL(nftnl_ruleset_parse_parallel);
+int nftnl_ruleset_parse_parallel(struct nftnl_ruleset *rs,
+				 enum nftnl_parse_type type, const char *data,
+				 struct nftnl_parse_err *err,
+				 uint32_t num_threads)
+{
+#ifdef JSON_PARSING
+	if (type == NFTNL_PARSE_JSON)
+		return nftnl_ruleset_json_parse_parallel(rs, data, err,
+							 num_threads);
+#endif
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+/* The file is loaded as a whole to be split among threads. */
+EXPORT_SYMBOL(nftnl_ruleset_parse_file_parallel);
+int nftnl_ruleset_parse_file_parallel(struct nftnl_ruleset *rs,
+				      enum nftnl_parse_type type, FILE *fp,
+				      struct nftnl_parse_err *err,
+				      uint32_t num_threads)
+{
+	size_t len = 0, size = 0;
+	char *data = NULL, *tmp;
+	int ret;
+
+	do {
+		if (size - len < 2) {
+			size = size ? size * 2 : 65536;
+			tmp = realloc(data, size);
+			if (tmp == NULL) {
+				xfree(data);
+				return -1;
+			}
+			data = tmp;
+		}
+		len += fread(data + len, 1, size - len - 1, fp);
+	} while (!feof(fp) && !ferror(fp));
+
+	if (ferror(fp)) {
+		xfree(data);
+		return -1;
+	}
+	data[len] = '\0';
+
+	ret = nftnl_ruleset_parse_parallel(rs, type, data, err, num_threads);
+	xfree(data);
+
+	return ret;
+}
+
+static int nftnl_ruleset_lists_init(struct nftnl_ruleset *rs)
+{
+	if (!(rs->flags & (1 << NFTNL_RULESET_TABLELIST))) {
+		rs->table_list = nftnl_table_list_alloc();
+		if (rs->table_list == NULL)
+			return -1;
+		rs->flags |= (1 << NFTNL_RULESET_TABLELIST);
+	}
+	if (!(rs->flags & (1 << NFTNL_RULESET_CHAINLIST))) {
+		rs->chain_list = nftnl_chain_list_alloc();
+		if (rs->chain_list == NULL)
+			return -1;
+		rs->flags |= (1 << NFTNL_RULESET_CHAINLIST);
+	}
+	if (!(rs->flags & (1 << NFTNL_RULESET_SETLIST))) {
+		rs->set_list = nftnl_set_list_alloc();
+		if (rs->set_list == NULL)
+			return -1;
+		rs->flags |= (1 << NFTNL_RULESET_SETLIST);
+	}
+	if (!(rs->flags & (1 << NFTNL_RULESET_RULELIST))) {
+		rs->rule_list = nftnl_rule_list_alloc();
+		if (rs->rule_list == NULL)
+			return -1;
+		rs->flags |= (1 << NFTNL_RULESET_RULELIST);
+	}
+
+	if (nftnl_chain_list_hash_enable(rs->chain_list) < 0 ||
+	    nftnl_set_list_hash_enable(rs->set_list) < 0 ||
+	    nftnl_rule_list_hash_enable(rs->rule_list) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* Objects of one table, or of one chain if @chain is set. */
+struct nftnl_ruleset_match {
+	uint32_t	family;
+	const char	*table;
+	const char	*chain;
+};
+
+static bool nftnl_ruleset_match(const struct nftnl_ruleset_match *m,
+				uint32_t family, const char *table)
+{
+	return family == m->family && table && !strcmp(table, m->table);
+}
+
+static int nftnl_ruleset_del_chain_cb(struct nftnl_chain *c, void *data)
+{
+	if (nftnl_ruleset_match(data, nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE))) {
+		nftnl_chain_list_del(c);
+		nftnl_chain_free(c);
+	}
+	return 0;
+}
+
+static int nftnl_ruleset_del_set_cb(struct nftnl_set *s, void *data)
+{
+	if (nftnl_ruleset_match(data, nftnl_set_get_u32(s, NFTNL_SET_FAMILY),
+				nftnl_set_get_str(s, NFTNL_SET_TABLE))) {
+		nftnl_set_list_del(s);
+		nftnl_set_free(s);
+	}
+	return 0;
+}
+
+static int nftnl_ruleset_del_rule_cb(struct nftnl_rule *r, void *data)
+{
+	if (data == NULL ||
+	    nftnl_ruleset_match(data, nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+				nftnl_rule_get_str(r, NFTNL_RULE_TABLE))) {
+		nftnl_rule_list_del(r);
+		nftnl_rule_free(r);
+	}
+	return 0;
+}
+
+static struct nftnl_table *
+nftnl_ruleset_table_find(const struct nftnl_ruleset *rs, uint32_t family,
+			 const char *name)
+{
+	struct nftnl_table_list_iter *iter;
+	struct nftnl_ruleset_match m = {
+		.family	= family,
+		.table	= name,
+	};
+	struct nftnl_table *cur;
+
+	iter = nftnl_table_list_iter_create(rs->table_list);
+	if (iter == NULL)
+		return NULL;
+
+	while ((cur = nftnl_table_list_iter_next(iter)) != NULL) {
+		if (nftnl_ruleset_match(&m,
+				nftnl_table_get_u32(cur, NFTNL_TABLE_FAMILY),
+				nftnl_table_get_str(cur, NFTNL_TABLE_NAME)))
+			break;
+	}
+	nftnl_table_list_iter_destroy(iter);
+
+	return cur;
+}
+
+static struct nftnl_table *
+nftnl_ruleset_table_lookup(const struct nftnl_ruleset *rs,
+			   const struct nftnl_table *t)
+{
+	return nftnl_ruleset_table_find(rs,
+				nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				nftnl_table_get_str(t, NFTNL_TABLE_NAME));
+}
+
+static int nftnl_ruleset_apply_table(struct nftnl_ruleset *rs,
+				     const struct nlmsghdr *nlh, bool del)
+{
+	struct nftnl_ruleset_match m;
+	struct nftnl_table *t, *old;
+
+	t = nftnl_table_alloc();
+	if (t == NULL)
+		return -1;
+
+	if (nftnl_table_nlmsg_parse(nlh, t) < 0 ||
+	    !nftnl_table_is_set(t, NFTNL_TABLE_NAME))
+		goto err;
+
+	old = nftnl_ruleset_table_lookup(rs, t);
+	if (old != NULL) {
+		nftnl_table_list_del(old);
+		nftnl_table_free(old);
+	}
+	if (!del) {
+		nftnl_table_list_add_tail(t, rs->table_list);
+		return 0;
+	}
+
+	/* The kernel also reports the objects of the table as deleted, do not
+	 * rely on it though.
+	 */
+	m.family = nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY);
+	m.table = nftnl_table_get_str(t, NFTNL_TABLE_NAME);
+	m.chain = NULL;
+	nftnl_rule_list_foreach(rs->rule_list, nftnl_ruleset_del_rule_cb, &m);
+	nftnl_set_list_foreach(rs->set_list, nftnl_ruleset_del_set_cb, &m);
+	nftnl_chain_list_foreach(rs->chain_list, nftnl_ruleset_del_chain_cb,
+				 &m);
+	nftnl_table_free(t);
+	return 0;
+err:
+	nftnl_table_free(t);
+	return -1;
+}
+
+static int nftnl_ruleset_apply_chain(struct nftnl_ruleset *rs,
+				     const struct nlmsghdr *nlh, bool del)
+{
+	struct nftnl_chain *c, *old;
+	const char *table, *name;
+	uint32_t family;
+
+	c = nftnl_chain_alloc();
+	if (c == NULL)
+		return -1;
+
+	if (nftnl_chain_nlmsg_parse(nlh, c) < 0 ||
+	    !nftnl_chain_is_set(c, NFTNL_CHAIN_TABLE) ||
+	    !nftnl_chain_is_set(c, NFTNL_CHAIN_NAME))
+		goto err;
+
+	family = nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY);
+	table = nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE);
+	name = nftnl_chain_get_str(c, NFTNL_CHAIN_NAME);
+
+	old = nftnl_chain_list_lookup_byname(rs->chain_list, family, table,
+					     name);
+	if (old != NULL) {
+		nftnl_chain_list_del(old);
+		nftnl_chain_free(old);
+	}
+	if (!del) {
+		nftnl_chain_list_add_tail(c, rs->chain_list);
+		return 0;
+	}
+
+	nftnl_rule_list_chain_foreach(rs->rule_list, family, table, name,
+				      nftnl_ruleset_del_rule_cb, NULL);
+	nftnl_chain_free(c);
+	return 0;
+err:
+	nftnl_chain_free(c);
+	return -1;
+}
+
+static struct nftnl_rule *
+nftnl_ruleset_rule_lookup(const struct nftnl_ruleset *rs,
+			  const struct nftnl_rule *r, uint16_t attr)
+{
+	return nftnl_rule_list_lookup_byhandle(rs->rule_list,
+				nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+				nftnl_rule_get_str(r, NFTNL_RULE_TABLE),
+				nftnl_rule_get_u64(r, attr));
+}
+
+static int nftnl_ruleset_apply_rule(struct nftnl_ruleset *rs,
+				    const struct nlmsghdr *nlh, bool del,
+				    bool dump)
+{
+	struct nftnl_rule *r, *old, *prev = NULL;
+
+	r = nftnl_rule_alloc();
+	if (r == NULL)
+		return -1;
+
+	/* Expressions are only decoded if the user looks at them. */
+	if (nftnl_rule_nlmsg_parse_lazy(nlh, r) < 0 ||
+	    !nftnl_rule_is_set(r, NFTNL_RULE_TABLE) ||
+	    !nftnl_rule_is_set(r, NFTNL_RULE_CHAIN) ||
+	    !nftnl_rule_is_set(r, NFTNL_RULE_HANDLE))
+		goto err;
+
+	old = nftnl_ruleset_rule_lookup(rs, r, NFTNL_RULE_HANDLE);
+	if (old != NULL) {
+		nftnl_rule_list_del(old);
+		nftnl_rule_free(old);
+	}
+	if (del) {
+		nftnl_rule_free(r);
+		return 0;
+	}
+
+	/* Dumps come in chain order. Events tell which rule comes before the
+	 * new one, if none does it goes first in its chain. A rule that is not
+	 * in the ruleset means some message was missed.
+	 */
+	if (dump) {
+		nftnl_rule_list_add_tail(r, rs->rule_list);
+		return 0;
+	}
+	if (nftnl_rule_is_set(r, NFTNL_RULE_POSITION)) {
+		prev = nftnl_ruleset_rule_lookup(rs, r, NFTNL_RULE_POSITION);
+		if (prev == NULL) {
+			nftnl_rule_free(r);
+			rs->stale = true;
+			errno = ESTALE;
+			return -1;
+		}
+	}
+	nftnl_rule_list_insert(rs->rule_list, r, prev);
+	return 0;
+err:
+	nftnl_rule_free(r);
+	return -1;
+}
+
+static int nftnl_ruleset_apply_set(struct nftnl_ruleset *rs,
+				   const struct nlmsghdr *nlh, bool del)
+{
+	struct nftnl_set *s, *old;
+
+	s = nftnl_set_alloc();
+	if (s == NULL)
+		return -1;
+
+	if (nftnl_set_nlmsg_parse(nlh, s) < 0 ||
+	    !(s->flags & (1 << NFTNL_SET_TABLE)) ||
+	    !(s->flags & (1 << NFTNL_SET_NAME)))
+		goto err;
+
+	old = nftnl_ruleset_set_lookup(rs, s);
+	if (old != NULL) {
+		nftnl_set_list_del(old);
+		/* An updated set keeps its elements. */
+		if (!del)
+			list_splice_init(&old->element_list, &s->element_list);
+		nftnl_set_free(old);
+	}
+	if (del) {
+		nftnl_set_free(s);
+		return 0;
+	}
+
+	if (nftnl_set_elem_hash_enable(s) < 0)
+		goto err;
+
+	nftnl_set_list_add_tail(s, rs->set_list);
+	return 0;
+err:
+	nftnl_set_free(s);
+	return -1;
+}
+
+static int nftnl_ruleset_apply_set_elems(struct nftnl_ruleset *rs,
+					 const struct nlmsghdr *nlh, bool del)
+{
+	struct nftnl_set_elem *e, *tmp, *old;
+	struct nftnl_set *s, *target;
+
+	s = nftnl_set_alloc();
+	if (s == NULL)
+		return -1;
+
+	if (nftnl_set_elems_nlmsg_parse(nlh, s) < 0 ||
+	    !(s->flags & (1 << NFTNL_SET_TABLE)) ||
+	    !(s->flags & (1 << NFTNL_SET_NAME))) {
+		nftnl_set_free(s);
+		return -1;
+	}
+
+	/* Elements of sets we do not know about are of no use. */
+	target = nftnl_ruleset_set_lookup(rs, s);
+	if (target == NULL)
+		goto out;
+
+	/* An interval end may share its key with the start of the next
+	 * interval, so elements are matched on the interval end flag too.
+	 */
+	list_for_each_entry_safe(e, tmp, &s->element_list, head) {
+		if (!(e->flags & (1 << NFTNL_SET_ELEM_KEY)))
+			continue;
+
+		old = nftnl_set_elem_lookup_id(target, e);
+		if (old != NULL) {
+			nftnl_set_elem_del(target, old);
+			nftnl_set_elem_free(old);
+		}
+		if (del)
+			continue;
+
+		nftnl_set_elem_del(s, e);
+		nftnl_set_elem_add(target, e);
+	}
+out:
+	nftnl_set_free(s);
+	return 0;
+}
+
+static int nftnl_ruleset_apply_gen(struct nftnl_ruleset *rs,
+				   const struct nlmsghdr *nlh)
+{
+	struct nftnl_gen *gen;
+	uint32_t id;
+
+	gen = nftnl_gen_alloc();
+	if (gen == NULL)
+		return -1;
+
+	if (nftnl_gen_nlmsg_parse(nlh, gen) < 0 ||
+	    !nftnl_gen_is_set(gen, NFTNL_GEN_ID)) {
+		nftnl_gen_free(gen);
+		return -1;
+	}
+	id = nftnl_gen_get_u32(gen, NFTNL_GEN_ID);
+	nftnl_gen_free(gen);
+
+	if (!rs->has_genid || id == rs->genid + 1) {
+		rs->genid = id;
+		rs->has_genid = true;
+		return 0;
+	}
+	/* We are past this generation already. */
+	if ((int32_t)(id - rs->genid) <= 0)
+		return 0;
+
+	rs->stale = true;
+	errno = ESTALE;
+	return -1;
+}
+
+/* Apply a message from a dump or a monitor event to the ruleset. The usual
+ * sequence is:
+ *
+ * 1) subscribe to NFNLGRP_NFTABLES, so no event is lost from now on,
+ * 2) apply the reply to NFT_MSG_GETGEN, this has to be done only once,
+ * 3) dump tables, chains, sets, set elements and rules, apply each message,
+ * 4) apply every event that is received from then on.
+ *
+ * Dumps and events carry the generation they belong to in res_id. Events that
+ * are older than the ruleset are skipped, and a dump that does not match the
+ * generation, an event that is newer than the next one or a rule event that
+ * refers to a position the ruleset does not have mark the ruleset as stale. From then on, this returns -1 and sets errno to ESTALE, the ruleset
+ * has to be released and dumped again. So has to be done if messages are lost,
+ * e.g. the socket reports ENOBUFS. Messages of other kinds are ignored.
+ */
+EXPORT_SYMBOL(nftnl_ruleset_nlmsg_apply);
+int nftnl_ruleset_nlmsg_apply(struct nftnl_ruleset *rs,
+			      const struct nlmsghdr *nlh)
+{
+	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
+	bool dump = nlh->nlmsg_flags & NLM_F_MULTI;
+	uint16_t res_id;
+
+	if (rs->stale)
+		goto stale;
+
+	if (NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES)
+		return 0;
+
+	if (dump && nlh->nlmsg_flags & NLM_F_DUMP_INTR)
+		goto stale;
+
+	if (NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_NEWGEN)
+		return nftnl_ruleset_apply_gen(rs, nlh);
+
+	if (rs->has_genid) {
+		res_id = ntohs(nfg->res_id);
+		if (dump) {
+			if (res_id != (uint16_t)rs->genid)
+				goto stale;
+		} else if (res_id != (uint16_t)(rs->genid + 1)) {
+			/* Already in the ruleset. */
+			if ((int16_t)(res_id - rs->genid) <= 0)
+				return 0;
+			goto stale;
+		}
+	}
+
+	if (nftnl_ruleset_lists_init(rs) < 0)
+		return -1;
+
+	switch (NFNL_MSG_TYPE(nlh->nlmsg_type)) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		return nftnl_ruleset_apply_table(rs, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_DELTABLE);
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		return nftnl_ruleset_apply_chain(rs, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_DELCHAIN);
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		return nftnl_ruleset_apply_rule(rs, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_DELRULE,
+			dump);
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_DELSET:
+		return nftnl_ruleset_apply_set(rs, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_DELSET);
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		return nftnl_ruleset_apply_set_elems(rs, nlh,
+			NFNL_MSG_TYPE(nlh->nlmsg_type) == NFT_MSG_DELSETELEM);
+	}
+	return 0;
+stale:
+	rs->stale = true;
+	errno = ESTALE;
+	return -1;
+}
+
+static enum nftnl_cmd_type nftnl_ruleset_nlmsg_cmd(const struct nlmsghdr *nlh)
+{
+	switch (NFNL_MSG_TYPE(nlh->nlmsg_type)) {
+	case NFT_MSG_DELTABLE:
+	case NFT_MSG_DELCHAIN:
+	case NFT_MSG_DELRULE:
+	case NFT_MSG_DELSET:
+	case NFT_MSG_DELSETELEM:
+		return NFTNL_CMD_DELETE;
+	case NFT_MSG_NEWRULE:
+		if (nlh->nlmsg_flags & NLM_F_REPLACE)
+			return NFTNL_CMD_REPLACE;
+		if (!(nlh->nlmsg_flags & (NLM_F_APPEND | NLM_F_MULTI)))
+			return NFTNL_CMD_INSERT;
+		break;
+	}
+	return NFTNL_CMD_ADD;
+}
+
+/* Decodes the object in @nlh and passes it to @cb, as the parsers do for the
+ * commands of a document. Messages of other kinds, such as batch delimiters,
+ * are skipped.
+ */
+EXPORT_SYMBOL(nftnl_ruleset_nlmsg_parse_cb);
+int nftnl_ruleset_nlmsg_parse_cb(const struct nlmsghdr *nlh, void *data,
+				 int (*cb)(const struct nftnl_parse_ctx *ctx))
+{
+	struct nftnl_parse_ctx ctx = {
+		.data	= data,
+		.flags	= (1 << NFTNL_RULESET_CTX_CMD) |
+			  (1 << NFTNL_RULESET_CTX_TYPE) |
+			  (1 << NFTNL_RULESET_CTX_DATA),
+	};
+	int ret;
+
+	if (NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_NFTABLES)
+		return 0;
+
+	ctx.cmd = nftnl_ruleset_nlmsg_cmd(nlh);
+
+	switch (NFNL_MSG_TYPE(nlh->nlmsg_type)) {
+	case NFT_MSG_NEWTABLE:
+	case NFT_MSG_DELTABLE:
+		ctx.type = NFTNL_RULESET_TABLE;
+		ctx.table = nftnl_table_alloc();
+		if (ctx.table == NULL)
+			return -1;
+		ctx.flags |= (1 << NFTNL_RULESET_CTX_TABLE);
+		ret = nftnl_table_nlmsg_parse(nlh, ctx.table);
+		break;
+	case NFT_MSG_NEWCHAIN:
+	case NFT_MSG_DELCHAIN:
+		ctx.type = NFTNL_RULESET_CHAIN;
+		ctx.chain = nftnl_chain_alloc();
+		if (ctx.chain == NULL)
+			return -1;
+		ctx.flags |= (1 << NFTNL_RULESET_CTX_CHAIN);
+		ret = nftnl_chain_nlmsg_parse(nlh, ctx.chain);
+		break;
+	case NFT_MSG_NEWRULE:
+	case NFT_MSG_DELRULE:
+		ctx.type = NFTNL_RULESET_RULE;
+		ctx.rule = nftnl_rule_alloc();
+		if (ctx.rule == NULL)
+			return -1;
+		ctx.flags |= (1 << NFTNL_RULESET_CTX_RULE);
+		ret = nftnl_rule_nlmsg_parse(nlh, ctx.rule);
+		break;
+	case NFT_MSG_NEWSET:
+	case NFT_MSG_DELSET:
+		ctx.type = NFTNL_RULESET_SET;
+		ctx.set = nftnl_set_alloc();
+		if (ctx.set == NULL)
+			return -1;
+		ctx.flags |= (1 << NFTNL_RULESET_CTX_SET);
+		ret = nftnl_set_nlmsg_parse(nlh, ctx.set);
+		break;
+	case NFT_MSG_NEWSETELEM:
+	case NFT_MSG_DELSETELEM:
+		ctx.type = NFTNL_RULESET_SET_ELEMS;
+		ctx.set = nftnl_set_alloc();
+		if (ctx.set == NULL)
+			return -1;
+		ctx.flags |= (1 << NFTNL_RULESET_CTX_SET);
+		ret = nftnl_set_elems_nlmsg_parse(nlh, ctx.set);
+		break;
+	default:
+		return 0;
+	}
+
+	if (ret < 0 || cb(&ctx) < 0) {
+		nftnl_ruleset_ctx_free(&ctx);
+		return -1;
+	}
+
+	return 0;
+}
+
+struct nftnl_ruleset_diff {
+	struct nftnl_batch	*batch;
+	struct nftnl_ruleset	*cur;
+	struct nftnl_ruleset	*want;
+	uint32_t		*seq;
+	int			num_msgs;
+};
+
+static bool nftnl_ruleset_str_eq(const char *s1, const char *s2)
+{
+	if (s1 == NULL || s2 == NULL)
+		return s1 == s2;
+
+	return !strcmp(s1, s2);
+}
+
+static struct nlmsghdr *nftnl_ruleset_diff_hdr(struct nftnl_ruleset_diff *d,
+					       uint16_t type, uint32_t family,
+					       uint16_t flags)
+{
+	return nftnl_nlmsg_build_hdr(nftnl_batch_buffer(d->batch), type,
+				     family, flags, *d->seq);
+}
+
+static int nftnl_ruleset_diff_end(struct nftnl_ruleset_diff *d)
+{
+	if (nftnl_batch_update(d->batch) < 0)
+		return -1;
+
+	(*d->seq)++;
+	d->num_msgs++;
+	return 0;
+}
+
+/* Delete an object by table and name, or a table if @name is NULL. */
+static int nftnl_ruleset_diff_del(struct nftnl_ruleset_diff *d, uint16_t type,
+				  uint32_t family, uint16_t table_attr,
+				  const char *table, uint16_t name_attr,
+				  const char *name)
+{
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_ruleset_diff_hdr(d, type, family, 0);
+	mnl_attr_put_strz(nlh, table_attr, table);
+	if (name != NULL)
+		mnl_attr_put_strz(nlh, name_attr, name);
+
+	return nftnl_ruleset_diff_end(d);
+}
+
+/* Objects of tables that go away are deleted along with their table. */
+static bool nftnl_ruleset_diff_wanted(struct nftnl_ruleset_diff *d,
+				      uint32_t family, const char *table)
+{
+	return table && nftnl_ruleset_table_find(d->want, family, table);
+}
+
+static int nftnl_ruleset_diff_table_cb(struct nftnl_table *t, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+	struct nftnl_table *old;
+	struct nlmsghdr *nlh;
+
+	if (!nftnl_table_is_set(t, NFTNL_TABLE_NAME)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	old = nftnl_ruleset_table_lookup(d->cur, t);
+	if (old != NULL &&
+	    (!nftnl_table_is_set(t, NFTNL_TABLE_FLAGS) ||
+	     nftnl_table_get_u32(t, NFTNL_TABLE_FLAGS) ==
+	     nftnl_table_get_u32(old, NFTNL_TABLE_FLAGS)))
+		return 0;
+
+	nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWTABLE,
+				     nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				     NLM_F_CREATE);
+	nftnl_table_nlmsg_build_payload(nlh, t);
+
+	return nftnl_ruleset_diff_end(d);
+}
+
+/* Hook, priority, type and device of a base chain cannot be updated. */
+static bool nftnl_ruleset_chain_hook_eq(const struct nftnl_chain *old,
+					const struct nftnl_chain *c)
+{
+	if (nftnl_chain_is_set(c, NFTNL_CHAIN_HOOKNUM) !=
+	    nftnl_chain_is_set(old, NFTNL_CHAIN_HOOKNUM))
+		return false;
+	if (!nftnl_chain_is_set(c, NFTNL_CHAIN_HOOKNUM))
+		return true;
+
+	return nftnl_chain_get_u32(c, NFTNL_CHAIN_HOOKNUM) ==
+	       nftnl_chain_get_u32(old, NFTNL_CHAIN_HOOKNUM) &&
+	       nftnl_chain_get_s32(c, NFTNL_CHAIN_PRIO) ==
+	       nftnl_chain_get_s32(old, NFTNL_CHAIN_PRIO) &&
+	       nftnl_ruleset_str_eq(nftnl_chain_get_str(c, NFTNL_CHAIN_TYPE),
+				    nftnl_chain_get_str(old, NFTNL_CHAIN_TYPE)) &&
+	       nftnl_ruleset_str_eq(nftnl_chain_get_str(c, NFTNL_CHAIN_DEV),
+				    nftnl_chain_get_str(old, NFTNL_CHAIN_DEV));
+}
+
+/* Current version of the wanted chain @c, NULL if it has to be created. */
+static struct nftnl_chain *
+nftnl_ruleset_diff_chain_lookup(struct nftnl_ruleset_diff *d,
+				const struct nftnl_chain *c)
+{
+	struct nftnl_chain *old;
+
+	old = nftnl_chain_list_lookup_byname(d->cur->chain_list,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+	if (old != NULL && !nftnl_ruleset_chain_hook_eq(old, c))
+		return NULL;
+
+	return old;
+}
+
+static int nftnl_ruleset_diff_chain_cb(struct nftnl_chain *c, void *data)
+{
+	uint32_t family = nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY);
+	const char *table = nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE);
+	const char *name = nftnl_chain_get_str(c, NFTNL_CHAIN_NAME);
+	struct nftnl_ruleset_diff *d = data;
+	struct nftnl_chain *old;
+	struct nlmsghdr *nlh;
+
+	if (table == NULL || name == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	old = nftnl_ruleset_diff_chain_lookup(d, c);
+	if (old == NULL &&
+	    nftnl_chain_list_lookup_byname(d->cur->chain_list, family,
+					   table, name) != NULL) {
+		/* Flush the chain, so it can be deleted and created again. */
+		if (nftnl_ruleset_diff_del(d, NFT_MSG_DELRULE, family,
+					   NFTA_RULE_TABLE, table,
+					   NFTA_RULE_CHAIN, name) < 0 ||
+		    nftnl_ruleset_diff_del(d, NFT_MSG_DELCHAIN, family,
+					   NFTA_CHAIN_TABLE, table,
+					   NFTA_CHAIN_NAME, name) < 0)
+			return -1;
+	}
+
+	if (old != NULL &&
+	    (!nftnl_chain_is_set(c, NFTNL_CHAIN_POLICY) ||
+	     nftnl_chain_get_u32(c, NFTNL_CHAIN_POLICY) ==
+	     nftnl_chain_get_u32(old, NFTNL_CHAIN_POLICY)))
+		return 0;
+
+	nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWCHAIN, family, NLM_F_CREATE);
+	nftnl_chain_nlmsg_build_payload(nlh, c);
+
+	return nftnl_ruleset_diff_end(d);
+}
+
+static bool nftnl_ruleset_set_def_eq(const struct nftnl_set *old,
+				     const struct nftnl_set *s)
+{
+	if (s->flags & (1 << NFTNL_SET_FLAGS) &&
+	    s->set_flags != old->set_flags)
+		return false;
+	if (s->flags & (1 << NFTNL_SET_KEY_TYPE) &&
+	    s->key_type != old->key_type)
+		return false;
+	if (s->flags & (1 << NFTNL_SET_KEY_LEN) &&
+	    s->key_len != old->key_len)
+		return false;
+	if (s->flags & (1 << NFTNL_SET_DATA_TYPE) &&
+	    s->data_type != old->data_type)
+		return false;
+	if (s->flags & (1 << NFTNL_SET_DATA_LEN) &&
+	    s->data_len != old->data_len)
+		return false;
+	if (s->flags & (1 << NFTNL_SET_OBJ_TYPE) &&
+	    s->obj_type != old->obj_type)
+		return false;
+
+	return true;
+}
+
+static int nftnl_ruleset_diff_set_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+	struct nftnl_set *old, *empty;
+	struct nlmsghdr *nlh;
+	int ret;
+
+	if (!(s->flags & (1 << NFTNL_SET_TABLE)) ||
+	    !(s->flags & (1 << NFTNL_SET_NAME))) {
+		errno = EINVAL;
+		return -1;
+	}
+	old = nftnl_ruleset_set_lookup(d->cur, s);
+	if (s->set_flags & NFT_SET_ANONYMOUS) {
+		/* The rule that is bound to it stays, so must it. */
+		if (old != NULL && nftnl_ruleset_set_def_eq(old, s) &&
+		    nftnl_set_elems_eq(old, s))
+			return 0;
+
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	if (old != NULL) {
+		if (nftnl_ruleset_set_def_eq(old, s)) {
+			ret = nftnl_set_elems_diff_batch(d->batch, old, s, 0,
+							 d->seq);
+			if (ret < 0)
+				return -1;
+			d->num_msgs += ret;
+			return 0;
+		}
+		if (nftnl_ruleset_diff_del(d, NFT_MSG_DELSET, s->family,
+					   NFTA_SET_TABLE, s->table,
+					   NFTA_SET_NAME, s->name) < 0)
+			return -1;
+	}
+
+	nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWSET, s->family,
+				     NLM_F_CREATE);
+	nftnl_set_nlmsg_build_payload(nlh, s);
+	if (nftnl_ruleset_diff_end(d) < 0)
+		return -1;
+
+	empty = nftnl_set_alloc();
+	if (empty == NULL)
+		return -1;
+
+	ret = nftnl_set_elems_diff_batch(d->batch, empty, s, 0, d->seq);
+	nftnl_set_free(empty);
+	if (ret < 0)
+		return -1;
+
+	d->num_msgs += ret;
+	return 0;
+}
+
+struct nftnl_ruleset_diff_anon {
+	struct nftnl_ruleset_diff	*d;
+	const struct nftnl_rule		*r;
+};
+
+static int nftnl_ruleset_diff_anon_expr_cb(struct nftnl_expr *e, void *data)
+{
+	const char *name = nftnl_expr_get_str(e, NFTNL_EXPR_NAME);
+	struct nftnl_ruleset_diff_anon *a = data;
+	struct nftnl_set *s;
+	const char *set;
+
+	if (!strcmp(name, "lookup"))
+		set = nftnl_expr_get_str(e, NFTNL_EXPR_LOOKUP_SET);
+	else if (!strcmp(name, "dynset"))
+		set = nftnl_expr_get_str(e, NFTNL_EXPR_DYNSET_SET_NAME);
+	else if (!strcmp(name, "objref"))
+		set = nftnl_expr_get_str(e, NFTNL_EXPR_OBJREF_SET_NAME);
+	else
+		return 0;
+
+	if (set == NULL)
+		return 0;
+
+	s = nftnl_set_list_lookup(a->d->want->set_list,
+				  nftnl_rule_get_u32(a->r, NFTNL_RULE_FAMILY),
+				  nftnl_rule_get_str(a->r, NFTNL_RULE_TABLE),
+				  set);
+	if (s == NULL || !(s->set_flags & NFT_SET_ANONYMOUS))
+		return 0;
+
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+/* Anonymous sets are created along with the rule they are bound to, which
+ * the diff cannot do.
+ */
+static int nftnl_ruleset_diff_anon_cb(struct nftnl_rule *r, void *data)
+{
+	struct nftnl_ruleset_diff_anon a = {
+		.d	= data,
+		.r	= r,
+	};
+
+	return nftnl_expr_foreach(r, nftnl_ruleset_diff_anon_expr_cb, &a);
+}
+
+static int nftnl_ruleset_diff_rules_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+	struct nftnl_chain *old;
+	int ret;
+
+	old = nftnl_ruleset_diff_chain_lookup(d, c);
+	ret = __nftnl_rule_list_diff_batch(d->batch,
+				old ? d->cur->rule_list : NULL,
+				d->want->rule_list,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+				nftnl_chain_get_str(c, NFTNL_CHAIN_NAME),
+				d->seq, nftnl_ruleset_diff_anon_cb, d);
+	if (ret < 0)
+		return -1;
+
+	d->num_msgs += ret;
+	return 0;
+}
+
+/* Current chain that is not wanted anymore, within a table that stays. */
+static bool nftnl_ruleset_diff_chain_gone(struct nftnl_ruleset_diff *d,
+					  const struct nftnl_chain *c)
+{
+	uint32_t family = nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY);
+	const char *table = nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE);
+	const char *name = nftnl_chain_get_str(c, NFTNL_CHAIN_NAME);
+
+	return name && nftnl_ruleset_diff_wanted(d, family, table) &&
+	       !nftnl_chain_list_lookup_byname(d->want->chain_list, family,
+					       table, name);
+}
+
+static int nftnl_ruleset_diff_flush_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+
+	if (!nftnl_ruleset_diff_chain_gone(d, c))
+		return 0;
+
+	return nftnl_ruleset_diff_del(d, NFT_MSG_DELRULE,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				NFTA_RULE_TABLE,
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+				NFTA_RULE_CHAIN,
+				nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+}
+
+static int nftnl_ruleset_diff_del_chain_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+
+	if (!nftnl_ruleset_diff_chain_gone(d, c))
+		return 0;
+
+	return nftnl_ruleset_diff_del(d, NFT_MSG_DELCHAIN,
+				nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				NFTA_CHAIN_TABLE,
+				nftnl_chain_get_str(c, NFTNL_CHAIN_TABLE),
+				NFTA_CHAIN_NAME,
+				nftnl_chain_get_str(c, NFTNL_CHAIN_NAME));
+}
+
+static int nftnl_ruleset_diff_del_set_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+
+	if (!(s->flags & (1 << NFTNL_SET_NAME)) ||
+	    s->set_flags & NFT_SET_ANONYMOUS ||
+	    !nftnl_ruleset_diff_wanted(d, s->family, s->table) ||
+	    nftnl_ruleset_set_lookup(d->want, s))
+		return 0;
+
+	return nftnl_ruleset_diff_del(d, NFT_MSG_DELSET, s->family,
+				      NFTA_SET_TABLE, s->table,
+				      NFTA_SET_NAME, s->name);
+}
+
+static int nftnl_ruleset_diff_del_table_cb(struct nftnl_table *t, void *data)
+{
+	struct nftnl_ruleset_diff *d = data;
+
+	if (!nftnl_table_is_set(t, NFTNL_TABLE_NAME) ||
+	    nftnl_ruleset_table_lookup(d->want, t))
+		return 0;
+
+	return nftnl_ruleset_diff_del(d, NFT_MSG_DELTABLE,
+				nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				NFTA_TABLE_NAME,
+				nftnl_table_get_str(t, NFTNL_TABLE_NAME),
+				0, NULL);
+}
+
+/* Append to @batch the messages that turn the ruleset @cur, as dumped from
+ * the kernel, into @want, leaving alone what is already in place:
+ *
+ * - Tables, chains and sets are identified by family, table and name. Only
+ *   the attributes that are set in @want are compared. Chains whose hook
+ *   changed and sets whose key or data definition changed are deleted and
+ *   created again, the kernel refuses the latter while rules refer to them.
+ * - Rules are diffed chain by chain, see nftnl_rule_list_diff_batch().
+ * - Set elements are diffed set by set, see nftnl_set_elems_diff_batch().
+ *   Anonymous sets come and go with their rules, so the diff fails with
+ *   EOPNOTSUPP if a rule that refers to one has to be created or replaced,
+ *   or if one has to be created or updated.
+ *
+ * Objects are created before the rules are updated and deleted after, so
+ * that rules never refer to missing chains or sets. Objects of a deleted
+ * table go away with it. The lists of both rulesets get indexed and the
+ * caller is in charge of the batch begin and end messages. Set element
+ * messages are sized after the overrun area of @batch, as described in
+ * nftnl_set_elems_diff_batch().
+ *
+ * Returns the number of messages, or -1 on error.
+ */
+EXPORT_SYMBOL(nftnl_ruleset_diff_batch);
+int nftnl_ruleset_diff_batch(struct nftnl_batch *batch,
+			     struct nftnl_ruleset *cur,
+			     struct nftnl_ruleset *want, uint32_t *seq)
+{
+	struct nftnl_ruleset_diff d = {
+		.batch	= batch,
+		.cur	= cur,
+		.want	= want,
+		.seq	= seq,
+	};
+
+	if (nftnl_ruleset_lists_init(cur) < 0 ||
+	    nftnl_ruleset_lists_init(want) < 0)
+		return -1;
+
+	if (nftnl_table_list_foreach(want->table_list,
+				     nftnl_ruleset_diff_table_cb, &d) < 0 ||
+	    nftnl_chain_list_foreach(want->chain_list,
+				     nftnl_ruleset_diff_chain_cb, &d) < 0 ||
+	    nftnl_set_list_foreach(want->set_list,
+				   nftnl_ruleset_diff_set_cb, &d) < 0 ||
+	    nftnl_chain_list_foreach(want->chain_list,
+				     nftnl_ruleset_diff_rules_cb, &d) < 0 ||
+	    nftnl_chain_list_foreach(cur->chain_list,
+				     nftnl_ruleset_diff_flush_cb, &d) < 0 ||
+	    nftnl_set_list_foreach(cur->set_list,
+				   nftnl_ruleset_diff_del_set_cb, &d) < 0 ||
+	    nftnl_chain_list_foreach(cur->chain_list,
+				     nftnl_ruleset_diff_del_chain_cb, &d) < 0 ||
+	    nftnl_table_list_foreach(cur->table_list,
+				     nftnl_ruleset_diff_del_table_cb, &d) < 0)
+		return -1;
+
+	return d.num_msgs;
+}
+
+static int nftnl_ruleset_batch_add(struct nftnl_ruleset_diff *d,
+				   const struct nftnl_parse_ctx *ctx,
+				   uint16_t flags)
+{
+	struct nftnl_set *s = ctx->set;
+	struct nlmsghdr *nlh;
+	int ret;
+
+	switch (ctx->type) {
+	case NFTNL_RULESET_TABLE:
+		nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWTABLE,
+				nftnl_table_get_u32(ctx->table,
+						    NFTNL_TABLE_FAMILY),
+				NLM_F_CREATE);
+		nftnl_table_nlmsg_build_payload(nlh, ctx->table);
+		return nftnl_ruleset_diff_end(d);
+	case NFTNL_RULESET_CHAIN:
+		nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWCHAIN,
+				nftnl_chain_get_u32(ctx->chain,
+						    NFTNL_CHAIN_FAMILY),
+				NLM_F_CREATE);
+		nftnl_chain_nlmsg_build_payload(nlh, ctx->chain);
+		return nftnl_ruleset_diff_end(d);
+	case NFTNL_RULESET_RULE:
+		/* Handles of the dump do not exist in the kernel the batch is
+		 * sent to, only a replacement refers to an existing rule.
+		 */
+		if (!(flags & NLM_F_REPLACE)) {
+			nftnl_rule_unset(ctx->rule, NFTNL_RULE_HANDLE);
+			nftnl_rule_unset(ctx->rule, NFTNL_RULE_POSITION);
+		}
+		nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWRULE,
+				nftnl_rule_get_u32(ctx->rule,
+						   NFTNL_RULE_FAMILY),
+				flags);
+		nftnl_rule_nlmsg_build_payload(nlh, ctx->rule);
+		return nftnl_ruleset_diff_end(d);
+	case NFTNL_RULESET_SET:
+		nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_NEWSET, s->family,
+					     NLM_F_CREATE);
+		nftnl_set_nlmsg_build_payload(nlh, s);
+		if (nftnl_ruleset_diff_end(d) < 0)
+			return -1;
+		/* fall through */
+	case NFTNL_RULESET_SET_ELEMS:
+		ret = nftnl_set_elems_batch(d->batch, s, NFT_MSG_NEWSETELEM,
+					    NLM_F_CREATE, d->seq);
+		if (ret < 0)
+			return -1;
+
+		d->num_msgs += ret;
+		return 0;
+	default:
+		break;
+	}
+
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+static int nftnl_ruleset_batch_del(struct nftnl_ruleset_diff *d,
+				   const struct nftnl_parse_ctx *ctx)
+{
+	struct nftnl_rule *r = ctx->rule;
+	struct nftnl_set *s = ctx->set;
+	struct nlmsghdr *nlh;
+	int ret;
+
+	switch (ctx->type) {
+	case NFTNL_RULESET_TABLE:
+		return nftnl_ruleset_diff_del(d, NFT_MSG_DELTABLE,
+				nftnl_table_get_u32(ctx->table,
+						    NFTNL_TABLE_FAMILY),
+				NFTA_TABLE_NAME,
+				nftnl_table_get_str(ctx->table,
+						    NFTNL_TABLE_NAME),
+				0, NULL);
+	case NFTNL_RULESET_CHAIN:
+		return nftnl_ruleset_diff_del(d, NFT_MSG_DELCHAIN,
+				nftnl_chain_get_u32(ctx->chain,
+						    NFTNL_CHAIN_FAMILY),
+				NFTA_CHAIN_TABLE,
+				nftnl_chain_get_str(ctx->chain,
+						    NFTNL_CHAIN_TABLE),
+				NFTA_CHAIN_NAME,
+				nftnl_chain_get_str(ctx->chain,
+						    NFTNL_CHAIN_NAME));
+	case NFTNL_RULESET_RULE:
+		if (!nftnl_rule_is_set(r, NFTNL_RULE_HANDLE))
+			break;
+
+		nlh = nftnl_ruleset_diff_hdr(d, NFT_MSG_DELRULE,
+				nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY), 0);
+		mnl_attr_put_strz(nlh, NFTA_RULE_TABLE,
+				  nftnl_rule_get_str(r, NFTNL_RULE_TABLE));
+		mnl_attr_put_strz(nlh, NFTA_RULE_CHAIN,
+				  nftnl_rule_get_str(r, NFTNL_RULE_CHAIN));
+		mnl_attr_put_u64(nlh, NFTA_RULE_HANDLE,
+				 htobe64(nftnl_rule_get_u64(r,
+							    NFTNL_RULE_HANDLE)));
+		return nftnl_ruleset_diff_end(d);
+	case NFTNL_RULESET_SET:
+		return nftnl_ruleset_diff_del(d, NFT_MSG_DELSET, s->family,
+					      NFTA_SET_TABLE, s->table,
+					      NFTA_SET_NAME, s->name);
+	case NFTNL_RULESET_SET_ELEMS:
+		ret = nftnl_set_elems_batch(d->batch, s, NFT_MSG_DELSETELEM, 0,
+					    d->seq);
+		if (ret < 0)
+			return -1;
+
+		d->num_msgs += ret;
+		return 0;
+	default:
+		break;
+	}
+
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+static int nftnl_ruleset_batch_flush(struct nftnl_ruleset_diff *d,
+				     const struct nftnl_parse_ctx *ctx)
+{
+	struct nftnl_set *s = ctx->set;
+
+	switch (ctx->type) {
+	case NFTNL_RULESET_RULESET:
+		nftnl_ruleset_diff_hdr(d, NFT_MSG_DELTABLE, NFPROTO_UNSPEC, 0);
+		return nftnl_ruleset_diff_end(d);
+	case NFTNL_RULESET_TABLE:
+		return nftnl_ruleset_diff_del(d, NFT_MSG_DELRULE,
+				nftnl_table_get_u32(ctx->table,
+						    NFTNL_TABLE_FAMILY),
+				NFTA_RULE_TABLE,
+				nftnl_table_get_str(ctx->table,
+						    NFTNL_TABLE_NAME),
+				0, NULL);
+	case NFTNL_RULESET_CHAIN:
+		return nftnl_ruleset_diff_del(d, NFT_MSG_DELRULE,
+				nftnl_chain_get_u32(ctx->chain,
+						    NFTNL_CHAIN_FAMILY),
+				NFTA_RULE_TABLE,
+				nftnl_chain_get_str(ctx->chain,
+						    NFTNL_CHAIN_TABLE),
+				NFTA_RULE_CHAIN,
+				nftnl_chain_get_str(ctx->chain,
+						    NFTNL_CHAIN_NAME));
+	case NFTNL_RULESET_SET:
+		return nftnl_ruleset_diff_del(d, NFT_MSG_DELSETELEM, s->family,
+					      NFTA_SET_ELEM_LIST_TABLE,
+					      s->table, NFTA_SET_ELEM_LIST_SET,
+					      s->name);
+	default:
+		break;
+	}
+
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+/* Turns every command of the document into the messages that carry it out,
+ * objects are not kept once their messages are built.
+ */
+static int nftnl_ruleset_batch_cb(const struct nftnl_parse_ctx *ctx)
+{
+	struct nftnl_ruleset_diff *d = ctx->data;
+
+	switch (ctx->cmd) {
+	case NFTNL_CMD_ADD:
+		return nftnl_ruleset_batch_add(d, ctx,
+					       NLM_F_CREATE | NLM_F_APPEND);
+	case NFTNL_CMD_INSERT:
+		return nftnl_ruleset_batch_add(d, ctx, NLM_F_CREATE);
+	case NFTNL_CMD_REPLACE:
+		if (ctx->type == NFTNL_RULESET_RULE &&
+		    !nftnl_rule_is_set(ctx->rule, NFTNL_RULE_HANDLE))
+			break;
+
+		return nftnl_ruleset_batch_add(d, ctx, NLM_F_REPLACE);
+	case NFTNL_CMD_DELETE:
+		return nftnl_ruleset_batch_del(d, ctx);
+	case NFTNL_CMD_FLUSH:
+		return nftnl_ruleset_batch_flush(d, ctx);
+	default:
+		break;
+	}
+
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+static int nftnl_ruleset_parse_batch(enum nftnl_parse_type type,
+				     const void *data,
+				     struct nftnl_parse_err *err,
+				     enum nftnl_parse_input input,
+				     struct nftnl_batch *batch, uint32_t *seq)
+{
+	struct nftnl_ruleset_diff d = {
+		.batch	= batch,
+		.seq	= seq,
+	};
+
+	if (nftnl_ruleset_do_parse(type, data, err, input, &d,
+				   nftnl_ruleset_batch_cb, true) < 0)
+		return -1;
+
+	return d.num_msgs;
+}
+
+/* Same as nftnl_ruleset_diff_batch(), with regard to the batch begin and end
+ * messages and to the overrun area of @batch that set element messages
+ * need. The file is read as in nftnl_ruleset_parse_file_stream_cb(). Returns
+ * the number of messages, or -1 on error.
+ */
+EXPORT_SYMBOL(nftnl_ruleset_parse_file_batch);
+int nftnl_ruleset_parse_file_batch(enum nftnl_parse_type type, FILE *fp,
+				   struct nftnl_parse_err *err,
+				   struct nftnl_batch *batch, uint32_t *seq)
+{
+	return nftnl_ruleset_parse_batch(type, fp, err, NFTNL_PARSE_STREAM,
+					 batch, seq);
+}
+
+EXPORT_SYMBOL(nftnl_ruleset_parse_buffer_batch);
+int nftnl_ruleset_parse_buffer_batch(enum nftnl_parse_type type,
+				     const char *buffer,
+				     struct nftnl_parse_err *err,
+				     struct nftnl_batch *batch, uint32_t *seq)
+{
+	return nftnl_ruleset_parse_batch(type, buffer, err, NFTNL_PARSE_BUFFER,
+					 batch, seq);
+}
+
+static const char *nftnl_ruleset_o_opentag(uint32_t type)
+{
+	switch (type) {
+	case NFTNL_OUTPUT_JSON:
+		return "{\"nftables\":[";
+	case NFTNL_OUTPUT_XML:
+	default:
+		return "";
+	}
+}
+
+static const char *nftnl_ruleset_o_separator(void *obj, uint32_t type)
+{
+	if (obj == NULL)
+		return "";
+
+	switch (type) {
+	case NFTNL_OUTPUT_JSON:
+		return ",";
+	case NFTNL_OUTPUT_DEFAULT:
+		return "\n";
+	default:
+		return "";
+	}
+}
+
+static const char *nftnl_ruleset_o_closetag(uint32_t type)
+{
+	switch (type) {
+	case NFTNL_OUTPUT_JSON:
+		return "]}";
+	case NFTNL_OUTPUT_XML:
+	default:
 		return "";
 	}
 }
@@ -950,10 +3280,25 @@ int nftnl_ruleset_snprintf(char *buf, size_t size, const struct nftnl_ruleset *r
 	}
 }
 
-static int nftnl_ruleset_fprintf_tables(FILE *fp, const struct nftnl_ruleset *rs,
-				      uint32_t type, uint32_t flags)
+static int nftnl_ruleset_table_snprintf(char *buf, size_t size,
+					const void *t, uint32_t cmd,
+					uint32_t type, uint32_t flags)
+{
+	return nftnl_table_snprintf(buf, size, t, type, flags);
+}
+
+static int nftnl_ruleset_chain_snprintf(char *buf, size_t size,
+					const void *c, uint32_t cmd,
+					uint32_t type, uint32_t flags)
+{
+	return nftnl_chain_snprintf(buf, size, c, type, flags);
+}
+
+static int nftnl_ruleset_buf_tables(struct nftnl_buf *b,
+				    const struct nftnl_ruleset *rs,
+				    uint32_t type, uint32_t flags)
 {
-	int len = 0, ret = 0;
+	uint32_t off = b->off;
 	struct nftnl_table *t;
 	struct nftnl_table_list_iter *ti;
 
@@ -963,32 +3308,27 @@ static int nftnl_ruleset_fprintf_tables(FILE *fp, const struct nftnl_ruleset *rs
 
 	t = nftnl_table_list_iter_next(ti);
 	while (t != NULL) {
-		ret = nftnl_table_fprintf(fp, t, type, flags);
-		if (ret < 0)
+		if (nftnl_buf_snprintf(b, t, NFTNL_CMD_UNSPEC, type, flags,
+				       nftnl_ruleset_table_snprintf) < 0)
 			goto err;
 
-		len += ret;
-
 		t = nftnl_table_list_iter_next(ti);
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(t, type));
-		if (ret < 0)
-			goto err;
-
-		len += ret;
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(t, type));
 	}
 	nftnl_table_list_iter_destroy(ti);
 
-	return len;
+	return b->off - off;
 err:
 	nftnl_table_list_iter_destroy(ti);
 	return -1;
 }
 
-static int nftnl_ruleset_fprintf_chains(FILE *fp, const struct nftnl_ruleset *rs,
-				      uint32_t type, uint32_t flags)
+static int nftnl_ruleset_buf_chains(struct nftnl_buf *b,
+				    const struct nftnl_ruleset *rs,
+				    uint32_t type, uint32_t flags)
 {
-	int len = 0, ret = 0;
+	uint32_t off = b->off;
 	struct nftnl_chain *o;
 	struct nftnl_chain_list_iter *i;
 
@@ -998,32 +3338,27 @@ static int nftnl_ruleset_fprintf_chains(FILE *fp, const struct nftnl_ruleset *rs
 
 	o = nftnl_chain_list_iter_next(i);
 	while (o != NULL) {
-		ret = nftnl_chain_fprintf(fp, o, type, flags);
-		if (ret < 0)
+		if (nftnl_buf_snprintf(b, o, NFTNL_CMD_UNSPEC, type, flags,
+				       nftnl_ruleset_chain_snprintf) < 0)
 			goto err;
 
-		len += ret;
-
 		o = nftnl_chain_list_iter_next(i);
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(o, type));
-		if (ret < 0)
-			goto err;
-
-		len += ret;
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(o, type));
 	}
 	nftnl_chain_list_iter_destroy(i);
 
-	return len;
+	return b->off - off;
 err:
 	nftnl_chain_list_iter_destroy(i);
 	return -1;
 }
 
-static int nftnl_ruleset_fprintf_sets(FILE *fp, const struct nftnl_ruleset *rs,
-				    uint32_t type, uint32_t flags)
+static int nftnl_ruleset_buf_sets(struct nftnl_buf *b,
+				  const struct nftnl_ruleset *rs,
+				  uint32_t type, uint32_t flags)
 {
-	int len = 0, ret = 0;
+	uint32_t off = b->off;
 	struct nftnl_set *o;
 	struct nftnl_set_list_iter *i;
 
@@ -1033,32 +3368,27 @@ static int nftnl_ruleset_fprintf_sets(FILE *fp, const struct nftnl_ruleset *rs,
 
 	o = nftnl_set_list_iter_next(i);
 	while (o != NULL) {
-		ret = nftnl_set_fprintf(fp, o, type, flags);
-		if (ret < 0)
+		if (nftnl_set_buf_snprintf(b, o, nftnl_flag2cmd(flags), type,
+					   flags) < 0)
 			goto err;
 
-		len += ret;
-
 		o = nftnl_set_list_iter_next(i);
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(o, type));
-		if (ret < 0)
-			goto err;
-
-		len += ret;
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(o, type));
 	}
 	nftnl_set_list_iter_destroy(i);
 
-	return len;
+	return b->off - off;
 err:
 	nftnl_set_list_iter_destroy(i);
 	return -1;
 }
 
-static int nftnl_ruleset_fprintf_rules(FILE *fp, const struct nftnl_ruleset *rs,
-				    uint32_t type, uint32_t flags)
+static int nftnl_ruleset_buf_rules(struct nftnl_buf *b,
+				   const struct nftnl_ruleset *rs,
+				   uint32_t type, uint32_t flags)
 {
-	int len = 0, ret = 0;
+	uint32_t off = b->off;
 	struct nftnl_rule *o;
 	struct nftnl_rule_list_iter *i;
 
@@ -1068,53 +3398,48 @@ static int nftnl_ruleset_fprintf_rules(FILE *fp, const struct nftnl_ruleset *rs,
 
 	o = nftnl_rule_list_iter_next(i);
 	while (o != NULL) {
-		ret = nftnl_rule_fprintf(fp, o, type, flags);
-		if (ret < 0)
+		if (nftnl_rule_buf_snprintf(b, o, nftnl_flag2cmd(flags), type,
+					    flags) < 0)
 			goto err;
 
-		len += ret;
-
 		o = nftnl_rule_list_iter_next(i);
 
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(o, type));
-		if (ret < 0)
-			goto err;
-
-		len += ret;
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(o, type));
 	}
 	nftnl_rule_list_iter_destroy(i);
 
-	return len;
+	return b->off - off;
 err:
 	nftnl_rule_list_iter_destroy(i);
 	return -1;
 }
 
-#define NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len)	\
+#define NFTNL_BUF_RETURN_ON_ERROR(ret)		\
 	if (ret < 0)				\
-		return -1;			\
-	len += ret;
+		return -1;
 
-static int nftnl_ruleset_cmd_fprintf(FILE *fp, const struct nftnl_ruleset *rs,
-				   uint32_t cmd, uint32_t type, uint32_t flags)
+/* Every object is formatted once, straight into the sink of @b. */
+static int nftnl_ruleset_buf_snprintf(struct nftnl_buf *b, const void *obj,
+				      uint32_t cmd, uint32_t type,
+				      uint32_t flags)
 {
-	int len = 0, ret = 0;
-	void *prev = NULL;
+	const struct nftnl_ruleset *rs = obj;
 	uint32_t inner_flags = flags;
+	void *prev = NULL;
+	int ret;
 
 	/* dont pass events flags to child calls of _snprintf() */
 	inner_flags &= ~NFTNL_OF_EVENT_ANY;
 
-	ret = fprintf(fp, "%s", nftnl_ruleset_o_opentag(type));
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	nftnl_buf_put(b, "%s", nftnl_ruleset_o_opentag(type));
 
-	ret = nftnl_cmd_header_fprintf(fp, cmd, type, flags);
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	ret = nftnl_cmd_header_buf(b, cmd, type, flags);
+	NFTNL_BUF_RETURN_ON_ERROR(ret);
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_TABLELIST)) &&
 	    (!nftnl_table_list_is_empty(rs->table_list))) {
-		ret = nftnl_ruleset_fprintf_tables(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		ret = nftnl_ruleset_buf_tables(b, rs, type, inner_flags);
+		NFTNL_BUF_RETURN_ON_ERROR(ret);
 
 		if (ret > 0)
 			prev = rs->table_list;
@@ -1122,11 +3447,10 @@ static int nftnl_ruleset_cmd_fprintf(FILE *fp, const struct nftnl_ruleset *rs,
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_CHAINLIST)) &&
 	    (!nftnl_chain_list_is_empty(rs->chain_list))) {
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(prev, type));
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(prev, type));
 
-		ret = nftnl_ruleset_fprintf_chains(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		ret = nftnl_ruleset_buf_chains(b, rs, type, inner_flags);
+		NFTNL_BUF_RETURN_ON_ERROR(ret);
 
 		if (ret > 0)
 			prev = rs->chain_list;
@@ -1134,11 +3458,10 @@ static int nftnl_ruleset_cmd_fprintf(FILE *fp, const struct nftnl_ruleset *rs,
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_SETLIST)) &&
 	    (!nftnl_set_list_is_empty(rs->set_list))) {
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(prev, type));
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(prev, type));
 
-		ret = nftnl_ruleset_fprintf_sets(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		ret = nftnl_ruleset_buf_sets(b, rs, type, inner_flags);
+		NFTNL_BUF_RETURN_ON_ERROR(ret);
 
 		if (ret > 0)
 			prev = rs->set_list;
@@ -1146,26 +3469,32 @@ static int nftnl_ruleset_cmd_fprintf(FILE *fp, const struct nftnl_ruleset *rs,
 
 	if ((nftnl_ruleset_is_set(rs, NFTNL_RULESET_RULELIST)) &&
 	    (!nftnl_rule_list_is_empty(rs->rule_list))) {
-		ret = fprintf(fp, "%s", nftnl_ruleset_o_separator(prev, type));
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		nftnl_buf_put(b, "%s", nftnl_ruleset_o_separator(prev, type));
 
-		ret = nftnl_ruleset_fprintf_rules(fp, rs, type, inner_flags);
-		NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+		ret = nftnl_ruleset_buf_rules(b, rs, type, inner_flags);
+		NFTNL_BUF_RETURN_ON_ERROR(ret);
 	}
 
-	ret = nftnl_cmd_footer_fprintf(fp, cmd, type, flags);
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	ret = nftnl_cmd_footer_buf(b, cmd, type, flags);
+	NFTNL_BUF_RETURN_ON_ERROR(ret);
 
-	ret = fprintf(fp, "%s", nftnl_ruleset_o_closetag(type));
-	NFTNL_FPRINTF_RETURN_OR_FIXLEN(ret, len);
+	nftnl_buf_put(b, "%s", nftnl_ruleset_o_closetag(type));
 
-	return len;
+	return 0;
 }
 
 EXPORT_SYMBOL(nftnl_ruleset_fprintf);
 int nftnl_ruleset_fprintf(FILE *fp, const struct nftnl_ruleset *rs, uint32_t type,
 			uint32_t flags)
 {
-	return nftnl_ruleset_cmd_fprintf(fp, rs, nftnl_flag2cmd(flags), type,
-				       flags);
+	return nftnl_fprintf_buf(fp, rs, nftnl_flag2cmd(flags), type, flags,
+				 nftnl_ruleset_buf_snprintf);
+}
+
+EXPORT_SYMBOL(nftnl_ruleset_asprintf);
+int nftnl_ruleset_asprintf(char **buf, const struct nftnl_ruleset *rs,
+			   uint32_t type, uint32_t flags)
+{
+	return nftnl_asprintf_buf(buf, rs, nftnl_flag2cmd(flags), type, flags,
+				  nftnl_ruleset_buf_snprintf);
 }
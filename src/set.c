@@ -9,6 +9,7 @@
  * This code has been sponsored by Sophos Astaro <http://www.sophos.com>
  */
 #include "internal.h"
+#include "arena.h"
 
 #include <time.h>
 #include <endian.h>
@@ -46,9 +47,9 @@ void nftnl_set_free(const struct nftnl_set *s)
 	struct nftnl_set_elem *elem, *tmp;
 
 	if (s->flags & (1 << NFTNL_SET_TABLE))
-		xfree(s->table);
+		nftnl_str_release(s->table, s->interned, NFTNL_SET_TABLE);
 	if (s->flags & (1 << NFTNL_SET_NAME))
-		xfree(s->name);
+		nftnl_str_release(s->name, s->interned, NFTNL_SET_NAME);
 	if (s->flags & (1 << NFTNL_SET_USERDATA))
 		xfree(s->user.data);
 
@@ -56,6 +57,9 @@ void nftnl_set_free(const struct nftnl_set *s)
 		list_del(&elem->head);
 		nftnl_set_elem_free(elem);
 	}
+	nftnl_set_elem_hash_free((struct nftnl_set *)s);
+	if (s->elem_arena)
+		nftnl_arena_free(s->elem_arena);
 	xfree(s);
 }
 
@@ -73,10 +77,10 @@ void nftnl_set_unset(struct nftnl_set *s, uint16_t attr)
 
 	switch (attr) {
 	case NFTNL_SET_TABLE:
-		xfree(s->table);
+		nftnl_str_release(s->table, s->interned, NFTNL_SET_TABLE);
 		break;
 	case NFTNL_SET_NAME:
-		xfree(s->name);
+		nftnl_str_release(s->name, s->interned, NFTNL_SET_NAME);
 		break;
 	case NFTNL_SET_FLAGS:
 	case NFTNL_SET_KEY_TYPE:
@@ -125,17 +129,19 @@ int nftnl_set_set_data(struct nftnl_set *s, uint16_t attr, const void *data,
 	switch(attr) {
 	case NFTNL_SET_TABLE:
 		if (s->flags & (1 << NFTNL_SET_TABLE))
-			xfree(s->table);
+			nftnl_str_release(s->table, s->interned, NFTNL_SET_TABLE);
 
 		s->table = strdup(data);
+		s->interned &= ~(1 << NFTNL_SET_TABLE);
 		if (!s->table)
 			return -1;
 		break;
 	case NFTNL_SET_NAME:
 		if (s->flags & (1 << NFTNL_SET_NAME))
-			xfree(s->name);
+			nftnl_str_release(s->name, s->interned, NFTNL_SET_NAME);
 
 		s->name = strdup(data);
+		s->interned &= ~(1 << NFTNL_SET_NAME);
 		if (!s->name)
 			return -1;
 		break;
@@ -316,6 +322,12 @@ struct nftnl_set *nftnl_set_clone(const struct nftnl_set *set)
 		return NULL;
 
 	memcpy(newset, set, sizeof(*set));
+	INIT_HLIST_NODE(&newset->name_hnode);
+	newset->name_list = NULL;
+	INIT_LIST_HEAD(&newset->element_list);
+	memset(&newset->elem_hash, 0, sizeof(newset->elem_hash));
+	newset->elem_arena = NULL;
+	newset->interned = 0;
 
 	if (set->flags & (1 << NFTNL_SET_TABLE)) {
 		newset->table = strdup(set->table);
@@ -328,13 +340,17 @@ struct nftnl_set *nftnl_set_clone(const struct nftnl_set *set)
 			goto err;
 	}
 
-	INIT_LIST_HEAD(&newset->element_list);
+	if (set->elem_hash.size && nftnl_set_elem_hash_enable(newset) < 0)
+		goto err;
+	if (set->elem_arena && nftnl_set_elem_arena_enable(newset) < 0)
+		goto err;
+
 	list_for_each_entry(elem, &set->element_list, head) {
 		newelem = nftnl_set_elem_clone(elem);
 		if (newelem == NULL)
 			goto err;
 
-		list_add_tail(&newelem->head, &newset->element_list);
+		nftnl_set_elem_add(newset, newelem);
 	}
 
 	return newset;
@@ -478,16 +494,18 @@ int nftnl_set_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
 
 	if (tb[NFTA_SET_TABLE]) {
 		if (s->flags & (1 << NFTNL_SET_TABLE))
-			xfree(s->table);
-		s->table = strdup(mnl_attr_get_str(tb[NFTA_SET_TABLE]));
+			nftnl_str_release(s->table, s->interned, NFTNL_SET_TABLE);
+		s->table = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_SET_TABLE]),
+						&s->interned, NFTNL_SET_TABLE);
 		if (!s->table)
 			return -1;
 		s->flags |= (1 << NFTNL_SET_TABLE);
 	}
 	if (tb[NFTA_SET_NAME]) {
 		if (s->flags & (1 << NFTNL_SET_NAME))
-			xfree(s->name);
-		s->name = strdup(mnl_attr_get_str(tb[NFTA_SET_NAME]));
+			nftnl_str_release(s->name, s->interned, NFTNL_SET_NAME);
+		s->name = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_SET_NAME]),
+						&s->interned, NFTNL_SET_NAME);
 		if (!s->name)
 			return -1;
 		s->flags |= (1 << NFTNL_SET_NAME);
@@ -642,7 +660,7 @@ static int nftnl_jansson_parse_set_info(struct nftnl_set *s, json_t *tree,
 				return -1;
 			}
 
-			list_add_tail(&elem->head, &s->element_list);
+			nftnl_set_elem_add(s, elem);
 		}
 
 	}
@@ -736,229 +754,246 @@ int nftnl_set_parse_file(struct nftnl_set *s, enum nftnl_parse_type type,
 	return nftnl_set_do_parse(s, type, fp, err, NFTNL_PARSE_FILE);
 }
 
-static int nftnl_set_snprintf_json(char *buf, size_t size,
-				   const struct nftnl_set *s,
-				   uint32_t type, uint32_t flags)
+static void nftnl_set_buf_json(struct nftnl_buf *b, const struct nftnl_set *s,
+			       uint32_t type, uint32_t flags)
 {
-	int remain = size, offset = 0, ret;
 	struct nftnl_set_elem *elem;
+	const char *sep = "";
 
-	ret = snprintf(buf, remain, "{\"set\":{");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_buf_put(b, "{\"set\":{");
 
-	if (s->flags & (1 << NFTNL_SET_NAME)) {
-		ret = snprintf(buf + offset, remain, "\"name\":\"%s\"",
-			       s->name);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (s->flags & (1 << NFTNL_SET_TABLE)) {
-		ret = snprintf(buf + offset, remain, ",\"table\":\"%s\"",
-			       s->table);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (s->flags & (1 << NFTNL_SET_FLAGS)) {
-		ret = snprintf(buf + offset, remain, ",\"flags\":%u",
-			       s->set_flags);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (s->flags & (1 << NFTNL_SET_FAMILY)) {
-		ret = snprintf(buf + offset, remain, ",\"family\":\"%s\"",
-			       nftnl_family2str(s->family));
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (s->flags & (1 << NFTNL_SET_KEY_TYPE)) {
-		ret = snprintf(buf + offset, remain, ",\"key_type\":%u",
-			       s->key_type);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (s->flags & (1 << NFTNL_SET_KEY_LEN)) {
-		ret = snprintf(buf + offset, remain, ",\"key_len\":%u",
-			       s->key_len);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if(s->flags & (1 << NFTNL_SET_DATA_TYPE)) {
-		ret = snprintf(buf + offset, remain,
-				  ",\"data_type\":%u", s->data_type);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if(s->flags & (1 << NFTNL_SET_DATA_LEN)) {
-		ret = snprintf(buf + offset, remain, ",\"data_len\":%u",
-			       s->data_len);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
-	if (s->flags & (1 << NFTNL_SET_OBJ_TYPE)) {
-		ret = snprintf(buf + offset, remain,
-				  ",\"obj_type\":%u", s->obj_type);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_NAME))
+		nftnl_buf_put(b, "\"name\":\"%s\"", s->name);
+	if (s->flags & (1 << NFTNL_SET_TABLE))
+		nftnl_buf_put(b, ",\"table\":\"%s\"", s->table);
+	if (s->flags & (1 << NFTNL_SET_FLAGS))
+		nftnl_buf_put(b, ",\"flags\":%u", s->set_flags);
+	if (s->flags & (1 << NFTNL_SET_FAMILY))
+		nftnl_buf_put(b, ",\"family\":\"%s\"",
+			      nftnl_family2str(s->family));
+	if (s->flags & (1 << NFTNL_SET_KEY_TYPE))
+		nftnl_buf_put(b, ",\"key_type\":%u", s->key_type);
+	if (s->flags & (1 << NFTNL_SET_KEY_LEN))
+		nftnl_buf_put(b, ",\"key_len\":%u", s->key_len);
+	if(s->flags & (1 << NFTNL_SET_DATA_TYPE))
+		nftnl_buf_put(b, ",\"data_type\":%u", s->data_type);
+	if(s->flags & (1 << NFTNL_SET_DATA_LEN))
+		nftnl_buf_put(b, ",\"data_len\":%u", s->data_len);
+	if (s->flags & (1 << NFTNL_SET_OBJ_TYPE))
+		nftnl_buf_put(b, ",\"obj_type\":%u", s->obj_type);
 
-	if (s->flags & (1 << NFTNL_SET_POLICY)) {
-		ret = snprintf(buf + offset, remain, ",\"policy\":%u",
-			       s->policy);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_POLICY))
+		nftnl_buf_put(b, ",\"policy\":%u", s->policy);
 
-	if (s->flags & (1 << NFTNL_SET_DESC_SIZE)) {
-		ret = snprintf(buf + offset, remain, ",\"desc_size\":%u",
-			       s->desc.size);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_DESC_SIZE))
+		nftnl_buf_put(b, ",\"desc_size\":%u", s->desc.size);
 
 	/* Empty set? Skip printinf of elements */
 	if (list_empty(&s->element_list)){
-		ret = snprintf(buf + offset, remain, "}}");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-		return offset;
+		nftnl_buf_put(b, "}}");
+		return;
 	}
 
-	ret = snprintf(buf + offset, remain, ",\"set_elem\":[");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_buf_put(b, ",\"set_elem\":[");
 
 	list_for_each_entry(elem, &s->element_list, head) {
-		ret = snprintf(buf + offset, remain, "{");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-		ret = nftnl_set_elem_snprintf(buf + offset, remain, elem, type,
-					    flags);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-		ret = snprintf(buf + offset, remain, "},");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+		nftnl_buf_put(b, "%s{", sep);
+		nftnl_buf_snprintf(b, elem, NFTNL_CMD_UNSPEC, type, flags,
+				   nftnl_set_elem_do_snprintf);
+		nftnl_buf_put(b, "}");
+		sep = ",";
 	}
-	/* Overwrite trailing ", " from last set element */
-	offset --;
 
-	ret = snprintf(buf + offset, remain, "]}}");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-	return offset;
+	nftnl_buf_put(b, "]}}");
 }
 
-static int nftnl_set_snprintf_default(char *buf, size_t size,
-				      const struct nftnl_set *s,
-				      uint32_t type, uint32_t flags)
+static void nftnl_set_buf_default(struct nftnl_buf *b,
+				  const struct nftnl_set *s,
+				  uint32_t type, uint32_t flags)
 {
-	int ret;
-	int remain = size, offset = 0;
 	struct nftnl_set_elem *elem;
 
-	ret = snprintf(buf, remain, "%s %s %x",
-			s->name, s->table, s->set_flags);
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_buf_put(b, "%s %s %x", s->name, s->table, s->set_flags);
 
-	if (s->flags & (1 << NFTNL_SET_TIMEOUT)) {
-		ret = snprintf(buf + offset, remain, " timeout %"PRIu64"ms",
-			       s->timeout);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_TIMEOUT))
+		nftnl_buf_put(b, " timeout %"PRIu64"ms", s->timeout);
 
-	if (s->flags & (1 << NFTNL_SET_GC_INTERVAL)) {
-		ret = snprintf(buf + offset, remain, " gc_interval %ums",
-			       s->gc_interval);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_GC_INTERVAL))
+		nftnl_buf_put(b, " gc_interval %ums", s->gc_interval);
 
-	if (s->flags & (1 << NFTNL_SET_POLICY)) {
-		ret = snprintf(buf + offset, remain, " policy %u", s->policy);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_POLICY))
+		nftnl_buf_put(b, " policy %u", s->policy);
 
-	if (s->flags & (1 << NFTNL_SET_DESC_SIZE)) {
-		ret = snprintf(buf + offset, remain, " size %u", s->desc.size);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	if (s->flags & (1 << NFTNL_SET_DESC_SIZE))
+		nftnl_buf_put(b, " size %u", s->desc.size);
 
 	/* Empty set? Skip printinf of elements */
 	if (list_empty(&s->element_list))
-		return offset;
+		return;
 
-	ret = snprintf(buf + offset, remain, "\n");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_buf_put(b, "\n");
 
 	list_for_each_entry(elem, &s->element_list, head) {
-		ret = snprintf(buf + offset, remain, "\t");
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-		ret = nftnl_set_elem_snprintf(buf + offset, remain, elem, type,
-					      flags);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+		nftnl_buf_put(b, "\t");
+		nftnl_buf_snprintf(b, elem, NFTNL_CMD_UNSPEC, type, flags,
+				   nftnl_set_elem_do_snprintf);
 	}
-
-	return offset;
 }
 
-static int nftnl_set_cmd_snprintf(char *buf, size_t size,
-				  const struct nftnl_set *s, uint32_t cmd,
-				  uint32_t type, uint32_t flags)
+/* Elements are formatted one at a time, so that sets of any size are streamed
+ * to the sink of @b without being formatted twice. Returns 0 on success, the
+ * length of the output is accounted in @b.
+ */
+int nftnl_set_buf_snprintf(struct nftnl_buf *b, const void *obj, uint32_t cmd,
+			   uint32_t type, uint32_t flags)
 {
-	int ret, remain = size, offset = 0;
+	const struct nftnl_set *s = obj;
 	uint32_t inner_flags = flags;
 
 	if (type == NFTNL_OUTPUT_XML)
 		return 0;
+	if (type != NFTNL_OUTPUT_DEFAULT && type != NFTNL_OUTPUT_JSON)
+		return -1;
 
 	/* prevent set_elems to print as events */
 	inner_flags &= ~NFTNL_OF_EVENT_ANY;
 
-	ret = nftnl_cmd_header_snprintf(buf + offset, remain, cmd, type, flags);
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_cmd_header_buf(b, cmd, type, flags);
 
 	switch(type) {
 	case NFTNL_OUTPUT_DEFAULT:
-		ret = nftnl_set_snprintf_default(buf + offset, remain, s, type,
-					       inner_flags);
+		nftnl_set_buf_default(b, s, type, inner_flags);
 		break;
 	case NFTNL_OUTPUT_JSON:
-		ret = nftnl_set_snprintf_json(buf + offset, remain, s, type,
-					    inner_flags);
+		nftnl_set_buf_json(b, s, type, inner_flags);
 		break;
-	default:
-		return -1;
 	}
 
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	nftnl_cmd_footer_buf(b, cmd, type, flags);
 
-	ret = nftnl_cmd_footer_snprintf(buf + offset, remain, cmd, type, flags);
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-	return offset;
+	return 0;
 }
 
 EXPORT_SYMBOL(nftnl_set_snprintf);
 int nftnl_set_snprintf(char *buf, size_t size, const struct nftnl_set *s,
 		       uint32_t type, uint32_t flags)
 {
+	NFTNL_BUF_INIT(b, buf, size);
+	int ret;
+
 	if (size)
 		buf[0] = '\0';
 
-	return nftnl_set_cmd_snprintf(buf, size, s, nftnl_flag2cmd(flags), type,
-				    flags);
-}
+	ret = nftnl_set_buf_snprintf(&b, s, nftnl_flag2cmd(flags), type, flags);
+	if (ret < 0)
+		return ret;
 
-static int nftnl_set_do_snprintf(char *buf, size_t size, const void *s,
-				 uint32_t cmd, uint32_t type, uint32_t flags)
-{
-	return nftnl_set_snprintf(buf, size, s, type, flags);
+	return b.off;
 }
 
 EXPORT_SYMBOL(nftnl_set_fprintf);
 int nftnl_set_fprintf(FILE *fp, const struct nftnl_set *s, uint32_t type,
 		      uint32_t flags)
 {
-	return nftnl_fprintf(fp, s, NFTNL_CMD_UNSPEC, type, flags,
-			   nftnl_set_do_snprintf);
+	return nftnl_fprintf_buf(fp, s, nftnl_flag2cmd(flags), type, flags,
+				 nftnl_set_buf_snprintf);
+}
+
+EXPORT_SYMBOL(nftnl_set_asprintf);
+int nftnl_set_asprintf(char **buf, const struct nftnl_set *s, uint32_t type,
+		       uint32_t flags)
+{
+	return nftnl_asprintf_buf(buf, s, nftnl_flag2cmd(flags), type, flags,
+				  nftnl_set_buf_snprintf);
 }
 
 EXPORT_SYMBOL(nftnl_set_elem_add);
 void nftnl_set_elem_add(struct nftnl_set *s, struct nftnl_set_elem *elem)
 {
 	list_add_tail(&elem->head, &s->element_list);
+	nftnl_set_elem_hash_add(s, elem);
 }
 
 struct nftnl_set_list {
 	struct list_head list;
+	struct {
+		struct hlist_head	*buckets;
+		uint32_t		size;
+		uint32_t		count;
+	} name_hash;
 };
 
+#define NFTNL_SET_LIST_HSIZE_MIN	64
+
+static uint32_t nftnl_set_name_hash(const char *name)
+{
+	return nftnl_hash(name, strlen(name), 0);
+}
+
+/* Sets that share a name are kept in the order of the list, so that lookups
+ * return the same set whether the list is indexed or not.
+ */
+static void nftnl_set_list_hash_insert(struct hlist_head *buckets,
+				       uint32_t size, struct nftnl_set *s,
+				       bool tail)
+{
+	uint32_t hash = nftnl_set_name_hash(s->name);
+	struct hlist_head *bucket = &buckets[hash & (size - 1)];
+	struct hlist_node *last;
+
+	if (!tail || hlist_empty(bucket)) {
+		hlist_add_head(&s->name_hnode, bucket);
+		return;
+	}
+
+	for (last = bucket->first; last->next; last = last->next)
+		;
+	hlist_add_after(last, &s->name_hnode);
+}
+
+static int nftnl_set_list_hash_resize(struct nftnl_set_list *list,
+				      uint32_t size)
+{
+	struct hlist_node *pos, *n;
+	struct hlist_head *buckets;
+	struct nftnl_set *s;
+	uint32_t i;
+
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < list->name_hash.size; i++) {
+		hlist_for_each_entry_safe(s, pos, n,
+					  &list->name_hash.buckets[i],
+					  name_hnode)
+			nftnl_set_list_hash_insert(buckets, size, s, true);
+	}
+	xfree(list->name_hash.buckets);
+
+	list->name_hash.buckets = buckets;
+	list->name_hash.size = size;
+
+	return 0;
+}
+
+static void nftnl_set_list_hash_add(struct nftnl_set_list *list,
+				    struct nftnl_set *s, bool tail)
+{
+	if (list->name_hash.size == 0 ||
+	    !(s->flags & (1 << NFTNL_SET_NAME)))
+		return;
+
+	/* If we cannot grow, keep going with a higher load factor. */
+	if (list->name_hash.count >= list->name_hash.size)
+		nftnl_set_list_hash_resize(list, list->name_hash.size * 2);
+
+	nftnl_set_list_hash_insert(list->name_hash.buckets,
+				   list->name_hash.size, s, tail);
+	s->name_list = list;
+	list->name_hash.count++;
+}
+
 EXPORT_SYMBOL(nftnl_set_list_alloc);
 struct nftnl_set_list *nftnl_set_list_alloc(void)
 {
@@ -982,6 +1017,7 @@ void nftnl_set_list_free(struct nftnl_set_list *list)
 		list_del(&s->head);
 		nftnl_set_free(s);
 	}
+	xfree(list->name_hash.buckets);
 	xfree(list);
 }
 
@@ -995,20 +1031,124 @@ EXPORT_SYMBOL(nftnl_set_list_add);
 void nftnl_set_list_add(struct nftnl_set *s, struct nftnl_set_list *list)
 {
 	list_add(&s->head, &list->list);
+	nftnl_set_list_hash_add(list, s, false);
 }
 
 EXPORT_SYMBOL(nftnl_set_list_add_tail);
 void nftnl_set_list_add_tail(struct nftnl_set *s, struct nftnl_set_list *list)
 {
 	list_add_tail(&s->head, &list->list);
+	nftnl_set_list_hash_add(list, s, true);
 }
 
 EXPORT_SYMBOL(nftnl_set_list_del);
 void nftnl_set_list_del(struct nftnl_set *s)
 {
+	if (!hlist_unhashed(&s->name_hnode)) {
+		hlist_del_init(&s->name_hnode);
+		s->name_list->name_hash.count--;
+		s->name_list = NULL;
+	}
 	list_del(&s->head);
 }
 
+/* Sets are indexed by name when they are added to the list, hence the name of
+ * a set must not be updated while it is in an indexed list.
+ */
+EXPORT_SYMBOL(nftnl_set_list_hash_enable);
+int nftnl_set_list_hash_enable(struct nftnl_set_list *list)
+{
+	uint32_t size = NFTNL_SET_LIST_HSIZE_MIN;
+	struct nftnl_set *s;
+	uint32_t count = 0;
+
+	if (list->name_hash.size)
+		return 0;
+
+	list_for_each_entry(s, &list->list, head)
+		count++;
+
+	while (size < count)
+		size <<= 1;
+
+	if (nftnl_set_list_hash_resize(list, size) < 0)
+		return -1;
+
+	list_for_each_entry(s, &list->list, head)
+		nftnl_set_list_hash_add(list, s, true);
+
+	return 0;
+}
+
+/* If several sets in the list share this name, e.g. because they belong to
+ * different tables, the first one in the list is returned.
+ */
+EXPORT_SYMBOL(nftnl_set_list_lookup_byname);
+struct nftnl_set *
+nftnl_set_list_lookup_byname(const struct nftnl_set_list *list,
+			     const char *name)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *pos;
+	struct nftnl_set *s;
+	uint32_t hash;
+
+	/* No index on this list, fall back to walking it. */
+	if (list->name_hash.size == 0) {
+		list_for_each_entry(s, &list->list, head) {
+			if (s->flags & (1 << NFTNL_SET_NAME) &&
+			    !strcmp(s->name, name))
+				return s;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_set_name_hash(name);
+	bucket = &list->name_hash.buckets[hash & (list->name_hash.size - 1)];
+	hlist_for_each_entry(s, pos, bucket, name_hnode) {
+		if (!strcmp(s->name, name))
+			return s;
+	}
+	return NULL;
+}
+
+static bool nftnl_set_key_eq(const struct nftnl_set *s, uint32_t family,
+			     const char *table, const char *name)
+{
+	return s->flags & (1 << NFTNL_SET_NAME) &&
+	       s->flags & (1 << NFTNL_SET_TABLE) &&
+	       s->family == family &&
+	       !strcmp(s->name, name) &&
+	       !strcmp(s->table, table);
+}
+
+/* Same as nftnl_set_list_lookup_byname(), for sets of one table. */
+struct nftnl_set *nftnl_set_list_lookup(const struct nftnl_set_list *list,
+					uint32_t family, const char *table,
+					const char *name)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *pos;
+	struct nftnl_set *s;
+	uint32_t hash;
+
+	if (list->name_hash.size == 0) {
+		list_for_each_entry(s, &list->list, head) {
+			if (nftnl_set_key_eq(s, family, table, name))
+				return s;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_set_name_hash(name);
+	bucket = &list->name_hash.buckets[hash & (list->name_hash.size - 1)];
+	hlist_for_each_entry(s, pos, bucket, name_hnode) {
+		if (nftnl_set_key_eq(s, family, table, name))
+			return s;
+	}
+	return NULL;
+}
+
 EXPORT_SYMBOL(nftnl_set_list_foreach);
 int nftnl_set_list_foreach(struct nftnl_set_list *set_list,
 			 int (*cb)(struct nftnl_set *t, void *data), void *data)
@@ -1077,30 +1217,6 @@ void nftnl_set_list_iter_destroy(const struct nftnl_set_list_iter *iter)
 	xfree(iter);
 }
 
-static struct nftnl_set *nftnl_set_lookup(const char *this_set_name,
-				      struct nftnl_set_list *set_list)
-{
-	struct nftnl_set_list_iter *iter;
-	struct nftnl_set *s;
-	const char *set_name;
-
-	iter = nftnl_set_list_iter_create(set_list);
-	if (iter == NULL)
-		return NULL;
-
-	s = nftnl_set_list_iter_cur(iter);
-	while (s != NULL) {
-		set_name  = nftnl_set_get_str(s, NFTNL_SET_NAME);
-		if (strcmp(this_set_name, set_name) == 0)
-			break;
-
-		s = nftnl_set_list_iter_next(iter);
-	}
-	nftnl_set_list_iter_destroy(iter);
-
-	return s;
-}
-
 int nftnl_set_lookup_id(struct nftnl_expr *e,
 		      struct nftnl_set_list *set_list, uint32_t *set_id)
 {
@@ -1111,7 +1227,7 @@ int nftnl_set_lookup_id(struct nftnl_expr *e,
 	if (set_name == NULL)
 		return 0;
 
-	s = nftnl_set_lookup(set_name, set_list);
+	s = nftnl_set_list_lookup_byname(set_list, set_name);
 	if (s == NULL)
 		return 0;
 
@@ -9,6 +9,7 @@
  * This code has been sponsored by Sophos Astaro <http://www.sophos.com>
  */
 #include "internal.h"
+#include "arena.h"
 
 #include <time.h>
 #include <endian.h>
@@ -26,35 +27,125 @@
 #include <libnftnl/set.h>
 #include <libnftnl/rule.h>
 #include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
 
-EXPORT_SYMBOL(nftnl_set_elem_alloc);
-struct nftnl_set_elem *nftnl_set_elem_alloc(void)
+/* Room for keys and data up to the size of an IPv6 address. */
+#define NFTNL_SET_ELEM_INLINE_SIZE	16
+
+struct nftnl_set_elem *nftnl_set_elem_alloc_size(struct nftnl_arena *arena,
+						 uint32_t key_size,
+						 uint32_t data_size)
 {
 	struct nftnl_set_elem *s;
+	size_t size;
+
+	key_size = div_round_up(key_size, sizeof(uint32_t)) * sizeof(uint32_t);
+	data_size = div_round_up(data_size, sizeof(uint32_t)) * sizeof(uint32_t);
+	size = sizeof(struct nftnl_set_elem) + key_size + data_size;
 
-	s = calloc(1, sizeof(struct nftnl_set_elem));
+	if (arena)
+		s = nftnl_arena_zalloc(arena, size);
+	else
+		s = calloc(1, size);
 	if (s == NULL)
 		return NULL;
 
+	if (arena)
+		s->arena_flags = NFTNL_SET_ELEM_ARENA_ELEM;
+
+	s->key_size = key_size;
+	s->data_size = data_size;
+	s->key = s->buf;
+	s->data = s->buf + key_size / sizeof(uint32_t);
+
 	return s;
 }
 
+EXPORT_SYMBOL(nftnl_set_elem_alloc);
+struct nftnl_set_elem *nftnl_set_elem_alloc(void)
+{
+	return nftnl_set_elem_alloc_size(NULL, NFTNL_SET_ELEM_INLINE_SIZE,
+					 NFTNL_SET_ELEM_INLINE_SIZE);
+}
+
+static uint32_t *nftnl_set_elem_key_inline(struct nftnl_set_elem *s)
+{
+	return s->buf;
+}
+
+static uint32_t *nftnl_set_elem_data_inline(struct nftnl_set_elem *s)
+{
+	return s->buf + s->key_size / sizeof(uint32_t);
+}
+
+static struct nftnl_set_elem_ext *nftnl_set_elem_ext(struct nftnl_set_elem *s)
+{
+	if (s->ext == NULL)
+		s->ext = calloc(1, sizeof(struct nftnl_set_elem_ext));
+
+	return s->ext;
+}
+
+static int nftnl_set_elem_reg_set(uint32_t **reg, uint8_t *len,
+				  uint32_t size, const uint32_t *inline_buf,
+				  const void *data, uint32_t data_len)
+{
+	uint32_t *buf;
+
+	if (data_len > NFT_DATA_VALUE_MAXLEN) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (data_len > size && *reg == inline_buf) {
+		buf = malloc(NFT_DATA_VALUE_MAXLEN);
+		if (buf == NULL)
+			return -1;
+
+		*reg = buf;
+	}
+	memcpy(*reg, data, data_len);
+	*len = data_len;
+
+	return 0;
+}
+
+/* Memory that comes from the arena is released with the set. */
+static void nftnl_set_elem_release(struct nftnl_set_elem *s,
+				   uint32_t arena_flag, const void *ptr)
+{
+	if (s->arena_flags & arena_flag) {
+		s->arena_flags &= ~arena_flag;
+		return;
+	}
+	xfree(ptr);
+}
+
 EXPORT_SYMBOL(nftnl_set_elem_free);
 void nftnl_set_elem_free(struct nftnl_set_elem *s)
 {
 	if (s->flags & (1 << NFTNL_SET_ELEM_CHAIN))
-		xfree(s->data.chain);
+		nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_CHAIN,
+				       s->ext->chain);
 
 	if (s->flags & (1 << NFTNL_SET_ELEM_EXPR))
-		nftnl_expr_free(s->expr);
+		nftnl_expr_free(s->ext->expr);
 
 	if (s->flags & (1 << NFTNL_SET_ELEM_USERDATA))
-		xfree(s->user.data);
+		nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_USERDATA,
+				       s->ext->user.data);
 
 	if (s->flags & (1 << NFTNL_SET_ELEM_OBJREF))
-		xfree(s->objref);
+		nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_OBJREF,
+				       s->ext->objref);
+
+	if (s->key != nftnl_set_elem_key_inline(s))
+		xfree(s->key);
+	if (s->data != nftnl_set_elem_data_inline(s))
+		xfree(s->data);
 
-	xfree(s);
+	nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_EXT, s->ext);
+	nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_ELEM, s);
 }
 
 EXPORT_SYMBOL(nftnl_set_elem_is_set);
@@ -69,9 +160,15 @@ void nftnl_set_elem_unset(struct nftnl_set_elem *s, uint16_t attr)
 	if (!(s->flags & (1 << attr)))
 		return;
 
+	if (s->ext == NULL) {
+		s->flags &= ~(1 << attr);
+		return;
+	}
+
 	switch (attr) {
 	case NFTNL_SET_ELEM_CHAIN:
-		xfree(s->data.chain);
+		nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_CHAIN,
+				       s->ext->chain);
 		break;
 	case NFTNL_SET_ELEM_FLAGS:
 	case NFTNL_SET_ELEM_KEY:	/* NFTA_SET_ELEM_KEY */
@@ -81,13 +178,15 @@ void nftnl_set_elem_unset(struct nftnl_set_elem *s, uint16_t attr)
 	case NFTNL_SET_ELEM_EXPIRATION:	/* NFTA_SET_ELEM_EXPIRATION */
 		break;
 	case NFTNL_SET_ELEM_USERDATA:	/* NFTA_SET_ELEM_USERDATA */
-		xfree(s->user.data);
+		nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_USERDATA,
+				       s->ext->user.data);
 		break;
 	case NFTNL_SET_ELEM_EXPR:
-		nftnl_expr_free(s->expr);
+		nftnl_expr_free(s->ext->expr);
 		break;
 	case NFTNL_SET_ELEM_OBJREF:
-		xfree(s->objref);
+		nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_OBJREF,
+				       s->ext->objref);
 		break;
 	default:
 		return;
@@ -100,53 +199,89 @@ EXPORT_SYMBOL(nftnl_set_elem_set);
 int nftnl_set_elem_set(struct nftnl_set_elem *s, uint16_t attr,
 		       const void *data, uint32_t data_len)
 {
+	struct nftnl_set_elem_ext *ext = NULL;
+
+	switch(attr) {
+	case NFTNL_SET_ELEM_CHAIN:
+	case NFTNL_SET_ELEM_TIMEOUT:
+	case NFTNL_SET_ELEM_EXPIRATION:
+	case NFTNL_SET_ELEM_USERDATA:
+	case NFTNL_SET_ELEM_EXPR:
+	case NFTNL_SET_ELEM_OBJREF:
+		ext = nftnl_set_elem_ext(s);
+		if (ext == NULL)
+			return -1;
+		break;
+	}
+
 	switch(attr) {
 	case NFTNL_SET_ELEM_FLAGS:
 		s->set_elem_flags = *((uint32_t *)data);
 		break;
 	case NFTNL_SET_ELEM_KEY:	/* NFTA_SET_ELEM_KEY */
-		memcpy(&s->key.val, data, data_len);
-		s->key.len = data_len;
+		if (nftnl_set_elem_reg_set(&s->key, &s->key_len, s->key_size,
+					   nftnl_set_elem_key_inline(s),
+					   data, data_len) < 0)
+			return -1;
 		break;
 	case NFTNL_SET_ELEM_VERDICT:	/* NFTA_SET_ELEM_DATA */
-		s->data.verdict = *((uint32_t *)data);
+		if (nftnl_set_elem_reg_set(&s->data, &s->data_len,
+					   s->data_size,
+					   nftnl_set_elem_data_inline(s),
+					   data, sizeof(uint32_t)) < 0)
+			return -1;
 		break;
 	case NFTNL_SET_ELEM_CHAIN:	/* NFTA_SET_ELEM_DATA */
 		if (s->flags & (1 << NFTNL_SET_ELEM_CHAIN))
-			xfree(s->data.chain);
+			nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_CHAIN,
+					       ext->chain);
 
-		s->data.chain = strdup(data);
-		if (!s->data.chain)
+		ext->chain = strdup(data);
+		if (!ext->chain)
 			return -1;
 		break;
 	case NFTNL_SET_ELEM_DATA:	/* NFTA_SET_ELEM_DATA */
-		memcpy(s->data.val, data, data_len);
-		s->data.len = data_len;
+		if (nftnl_set_elem_reg_set(&s->data, &s->data_len,
+					   s->data_size,
+					   nftnl_set_elem_data_inline(s),
+					   data, data_len) < 0)
+			return -1;
 		break;
 	case NFTNL_SET_ELEM_TIMEOUT:	/* NFTA_SET_ELEM_TIMEOUT */
-		s->timeout = *((uint64_t *)data);
+		ext->timeout = *((uint64_t *)data);
+		break;
+	case NFTNL_SET_ELEM_EXPIRATION:	/* NFTA_SET_ELEM_EXPIRATION */
+		ext->expiration = *((uint64_t *)data);
 		break;
 	case NFTNL_SET_ELEM_USERDATA: /* NFTA_SET_ELEM_USERDATA */
 		if (s->flags & (1 << NFTNL_SET_ELEM_USERDATA))
-			xfree(s->user.data);
+			nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_USERDATA,
+					       ext->user.data);
 
-		s->user.data = malloc(data_len);
-		if (!s->user.data)
+		ext->user.data = malloc(data_len);
+		if (!ext->user.data)
 			return -1;
-		memcpy(s->user.data, data, data_len);
-		s->user.len = data_len;
+		memcpy(ext->user.data, data, data_len);
+		ext->user.len = data_len;
 		break;
 	case NFTNL_SET_ELEM_OBJREF:
 		if (s->flags & (1 << NFTNL_SET_ELEM_OBJREF))
-			xfree(s->objref);
+			nftnl_set_elem_release(s, NFTNL_SET_ELEM_ARENA_OBJREF,
+					       ext->objref);
 
-		s->objref = strdup(data);
-		if (!s->objref)
+		ext->objref = strdup(data);
+		if (!ext->objref)
 			return -1;
 		break;
+	case NFTNL_SET_ELEM_EXPR:
+		if (s->flags & (1 << NFTNL_SET_ELEM_EXPR))
+			nftnl_expr_free(ext->expr);
+
+		ext->expr = (void *)data;
+		break;
 	}
 	s->flags |= (1 << attr);
-	return -1;
+	return 0;
 }
 
 EXPORT_SYMBOL(nftnl_set_elem_set_u32);
@@ -178,31 +313,38 @@ const void *nftnl_set_elem_get(struct nftnl_set_elem *s, uint16_t attr, uint32_t
 		*data_len = sizeof(s->set_elem_flags);
 		return &s->set_elem_flags;
 	case NFTNL_SET_ELEM_KEY:	/* NFTA_SET_ELEM_KEY */
-		*data_len = s->key.len;
-		return &s->key.val;
+		*data_len = s->key_len;
+		return s->key;
 	case NFTNL_SET_ELEM_VERDICT:	/* NFTA_SET_ELEM_DATA */
-		*data_len = sizeof(s->data.verdict);
-		return &s->data.verdict;
-	case NFTNL_SET_ELEM_CHAIN:	/* NFTA_SET_ELEM_DATA */
-		*data_len = strlen(s->data.chain) + 1;
-		return s->data.chain;
+		*data_len = sizeof(uint32_t);
+		return s->data;
 	case NFTNL_SET_ELEM_DATA:	/* NFTA_SET_ELEM_DATA */
-		*data_len = s->data.len;
-		return &s->data.val;
+		*data_len = s->data_len;
+		return s->data;
+	}
+
+	/* The remaining attributes are stored in the ext area. */
+	if (s->ext == NULL)
+		return NULL;
+
+	switch(attr) {
+	case NFTNL_SET_ELEM_CHAIN:	/* NFTA_SET_ELEM_DATA */
+		*data_len = strlen(s->ext->chain) + 1;
+		return s->ext->chain;
 	case NFTNL_SET_ELEM_TIMEOUT:	/* NFTA_SET_ELEM_TIMEOUT */
-		*data_len = sizeof(s->timeout);
-		return &s->timeout;
+		*data_len = sizeof(s->ext->timeout);
+		return &s->ext->timeout;
 	case NFTNL_SET_ELEM_EXPIRATION:	/* NFTA_SET_ELEM_EXPIRATION */
-		*data_len = sizeof(s->expiration);
-		return &s->expiration;
+		*data_len = sizeof(s->ext->expiration);
+		return &s->ext->expiration;
 	case NFTNL_SET_ELEM_USERDATA:
-		*data_len = s->user.len;
-		return s->user.data;
+		*data_len = s->ext->user.len;
+		return s->ext->user.data;
 	case NFTNL_SET_ELEM_EXPR:
-		return s->expr;
+		return s->ext->expr;
 	case NFTNL_SET_ELEM_OBJREF:
-		*data_len = strlen(s->objref) + 1;
-		return s->objref;
+		*data_len = strlen(s->ext->objref) + 1;
+		return s->ext->objref;
 	}
 	return NULL;
 }
@@ -234,18 +376,45 @@ uint64_t nftnl_set_elem_get_u64(struct nftnl_set_elem *s, uint16_t attr)
 struct nftnl_set_elem *nftnl_set_elem_clone(struct nftnl_set_elem *elem)
 {
 	struct nftnl_set_elem *newelem;
+	struct nftnl_set_elem_ext *ext;
 
-	newelem = nftnl_set_elem_alloc();
+	newelem = nftnl_set_elem_alloc_size(NULL, elem->key_len, elem->data_len);
 	if (newelem == NULL)
 		return NULL;
 
-	memcpy(newelem, elem, sizeof(*elem));
-
-	if (elem->flags & (1 << NFTNL_SET_ELEM_CHAIN)) {
-		newelem->data.chain = strdup(elem->data.chain);
-		if (!newelem->data.chain)
-			goto err;
-	}
+	newelem->flags = elem->flags &
+			 ~((1 << NFTNL_SET_ELEM_CHAIN) |
+			   (1 << NFTNL_SET_ELEM_USERDATA) |
+			   (1 << NFTNL_SET_ELEM_OBJREF));
+	newelem->set_elem_flags = elem->set_elem_flags;
+	newelem->key_len = elem->key_len;
+	newelem->data_len = elem->data_len;
+	memcpy(newelem->key, elem->key, elem->key_len);
+	memcpy(newelem->data, elem->data, elem->data_len);
+
+	if (elem->ext == NULL)
+		return newelem;
+
+	ext = nftnl_set_elem_ext(newelem);
+	if (ext == NULL)
+		goto err;
+
+	ext->timeout = elem->ext->timeout;
+	ext->expiration = elem->ext->expiration;
+	ext->expr = elem->ext->expr;
+
+	if (elem->flags & (1 << NFTNL_SET_ELEM_CHAIN) &&
+	    nftnl_set_elem_set_str(newelem, NFTNL_SET_ELEM_CHAIN,
+				   elem->ext->chain) < 0)
+		goto err;
+	if (elem->flags & (1 << NFTNL_SET_ELEM_USERDATA) &&
+	    nftnl_set_elem_set(newelem, NFTNL_SET_ELEM_USERDATA,
+			       elem->ext->user.data, elem->ext->user.len) < 0)
+		goto err;
+	if (elem->flags & (1 << NFTNL_SET_ELEM_OBJREF) &&
+	    nftnl_set_elem_set_str(newelem, NFTNL_SET_ELEM_OBJREF,
+				   elem->ext->objref) < 0)
+		goto err;
 
 	return newelem;
 err:
@@ -253,18 +422,195 @@ err:
 	return NULL;
 }
 
+#define NFTNL_SET_ELEM_HSIZE_MIN	64
+
+static uint32_t nftnl_set_elem_key_hash(const void *key, uint32_t key_len)
+{
+	return nftnl_hash(key, key_len, 0);
+}
+
+static void nftnl_set_elem_hash_insert(struct hlist_head *buckets,
+				       uint32_t size, struct nftnl_set_elem *e)
+{
+	uint32_t hash = nftnl_set_elem_key_hash(e->key, e->key_len);
+
+	hlist_add_head(&e->hnode, &buckets[hash & (size - 1)]);
+}
+
+static int nftnl_set_elem_hash_resize(struct nftnl_set *s, uint32_t size)
+{
+	struct hlist_node *pos, *n;
+	struct hlist_head *buckets;
+	struct nftnl_set_elem *e;
+	uint32_t i;
+
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < s->elem_hash.size; i++) {
+		hlist_for_each_entry_safe(e, pos, n, &s->elem_hash.buckets[i],
+					  hnode)
+			nftnl_set_elem_hash_insert(buckets, size, e);
+	}
+	xfree(s->elem_hash.buckets);
+
+	s->elem_hash.buckets = buckets;
+	s->elem_hash.size = size;
+
+	return 0;
+}
+
+void nftnl_set_elem_hash_add(struct nftnl_set *s, struct nftnl_set_elem *e)
+{
+	if (s->elem_hash.size == 0 ||
+	    !(e->flags & (1 << NFTNL_SET_ELEM_KEY)))
+		return;
+
+	/* If we cannot grow, keep going with a higher load factor. */
+	if (s->elem_hash.count >= s->elem_hash.size)
+		nftnl_set_elem_hash_resize(s, s->elem_hash.size * 2);
+
+	nftnl_set_elem_hash_insert(s->elem_hash.buckets, s->elem_hash.size, e);
+	s->elem_hash.count++;
+}
+
+static void nftnl_set_elem_hash_del(struct nftnl_set *s,
+				    struct nftnl_set_elem *e)
+{
+	if (hlist_unhashed(&e->hnode))
+		return;
+
+	hlist_del_init(&e->hnode);
+	s->elem_hash.count--;
+}
+
+void nftnl_set_elem_hash_free(struct nftnl_set *s)
+{
+	xfree(s->elem_hash.buckets);
+	s->elem_hash.buckets = NULL;
+	s->elem_hash.size = 0;
+	s->elem_hash.count = 0;
+}
+
+/* Elements are indexed by key when they are added to the set, hence the key
+ * of an element must not be updated while it is in an indexed set.
+ */
+EXPORT_SYMBOL(nftnl_set_elem_hash_enable);
+int nftnl_set_elem_hash_enable(struct nftnl_set *s)
+{
+	struct nftnl_set_elem *e;
+	uint32_t size = NFTNL_SET_ELEM_HSIZE_MIN;
+	uint32_t count = 0;
+
+	if (s->elem_hash.size)
+		return 0;
+
+	list_for_each_entry(e, &s->element_list, head)
+		count++;
+
+	while (size < count)
+		size <<= 1;
+
+	if (nftnl_set_elem_hash_resize(s, size) < 0)
+		return -1;
+
+	list_for_each_entry(e, &s->element_list, head)
+		nftnl_set_elem_hash_add(s, e);
+
+	return 0;
+}
+
+/* Elements parsed from netlink into this set, and their chain, user data and
+ * object reference, are allocated from large chunks that are released along
+ * with the set. Memory of these elements is not given back before that, even
+ * if they are removed and freed. Expressions are still allocated one by one.
+ */
+EXPORT_SYMBOL(nftnl_set_elem_arena_enable);
+int nftnl_set_elem_arena_enable(struct nftnl_set *s)
+{
+	if (s->elem_arena)
+		return 0;
+
+	s->elem_arena = nftnl_arena_alloc(NFTNL_ARENA_CHUNK_SIZE);
+	if (s->elem_arena == NULL)
+		return -1;
+
+	return 0;
+}
+
+static bool nftnl_set_elem_key_eq(const struct nftnl_set_elem *e,
+				  const void *key, uint32_t key_len)
+{
+	return e->flags & (1 << NFTNL_SET_ELEM_KEY) &&
+	       e->key_len == key_len &&
+	       memcmp(e->key, key, key_len) == 0;
+}
+
+EXPORT_SYMBOL(nftnl_set_elem_lookup);
+struct nftnl_set_elem *nftnl_set_elem_lookup(const struct nftnl_set *s,
+					     const void *key, uint32_t key_len)
+{
+	struct nftnl_set_elem *e;
+	struct hlist_node *pos;
+	uint32_t hash;
+
+	/* No index on this set, fall back to walking the element list. */
+	if (s->elem_hash.size == 0) {
+		list_for_each_entry(e, &s->element_list, head) {
+			if (nftnl_set_elem_key_eq(e, key, key_len))
+				return e;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_set_elem_key_hash(key, key_len);
+	hlist_for_each_entry(e, pos,
+			     &s->elem_hash.buckets[hash & (s->elem_hash.size - 1)],
+			     hnode) {
+		if (nftnl_set_elem_key_eq(e, key, key_len))
+			return e;
+	}
+	return NULL;
+}
+
+EXPORT_SYMBOL(nftnl_set_elem_del);
+void nftnl_set_elem_del(struct nftnl_set *s, struct nftnl_set_elem *e)
+{
+	nftnl_set_elem_hash_del(s, e);
+	list_del(&e->head);
+}
+
+EXPORT_SYMBOL(nftnl_set_elem_del_key);
+int nftnl_set_elem_del_key(struct nftnl_set *s, const void *key,
+			   uint32_t key_len)
+{
+	struct nftnl_set_elem *e;
+
+	e = nftnl_set_elem_lookup(s, key, key_len);
+	if (e == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	nftnl_set_elem_del(s, e);
+	nftnl_set_elem_free(e);
+
+	return 0;
+}
+
 void nftnl_set_elem_nlmsg_build_payload(struct nlmsghdr *nlh,
 				      struct nftnl_set_elem *e)
 {
 	if (e->flags & (1 << NFTNL_SET_ELEM_FLAGS))
 		mnl_attr_put_u32(nlh, NFTA_SET_ELEM_FLAGS, htonl(e->set_elem_flags));
 	if (e->flags & (1 << NFTNL_SET_ELEM_TIMEOUT))
-		mnl_attr_put_u64(nlh, NFTA_SET_ELEM_TIMEOUT, htobe64(e->timeout));
+		mnl_attr_put_u64(nlh, NFTA_SET_ELEM_TIMEOUT, htobe64(e->ext->timeout));
 	if (e->flags & (1 << NFTNL_SET_ELEM_KEY)) {
 		struct nlattr *nest1;
 
 		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_KEY);
-		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->key.len, e->key.val);
+		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->key_len, e->key);
 		mnl_attr_nest_end(nlh, nest1);
 	}
 	if (e->flags & (1 << NFTNL_SET_ELEM_VERDICT)) {
@@ -272,9 +618,9 @@ void nftnl_set_elem_nlmsg_build_payload(struct nlmsghdr *nlh,
 
 		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_DATA);
 		nest2 = mnl_attr_nest_start(nlh, NFTA_DATA_VERDICT);
-		mnl_attr_put_u32(nlh, NFTA_VERDICT_CODE, htonl(e->data.verdict));
+		mnl_attr_put_u32(nlh, NFTA_VERDICT_CODE, htonl(e->data[0]));
 		if (e->flags & (1 << NFTNL_SET_ELEM_CHAIN))
-			mnl_attr_put_strz(nlh, NFTA_VERDICT_CHAIN, e->data.chain);
+			mnl_attr_put_strz(nlh, NFTA_VERDICT_CHAIN, e->ext->chain);
 
 		mnl_attr_nest_end(nlh, nest1);
 		mnl_attr_nest_end(nlh, nest2);
@@ -283,13 +629,14 @@ void nftnl_set_elem_nlmsg_build_payload(struct nlmsghdr *nlh,
 		struct nlattr *nest1;
 
 		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_DATA);
-		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->data.len, e->data.val);
+		mnl_attr_put(nlh, NFTA_DATA_VALUE, e->data_len, e->data);
 		mnl_attr_nest_end(nlh, nest1);
 	}
 	if (e->flags & (1 << NFTNL_SET_ELEM_USERDATA))
-		mnl_attr_put(nlh, NFTA_SET_ELEM_USERDATA, e->user.len, e->user.data);
+		mnl_attr_put(nlh, NFTA_SET_ELEM_USERDATA, e->ext->user.len,
+			     e->ext->user.data);
 	if (e->flags & (1 << NFTNL_SET_ELEM_OBJREF))
-		mnl_attr_put_strz(nlh, NFTA_SET_ELEM_OBJREF, e->objref);
+		mnl_attr_put_strz(nlh, NFTA_SET_ELEM_OBJREF, e->ext->objref);
 }
 
 static void nftnl_set_elem_nlmsg_build_def(struct nlmsghdr *nlh,
@@ -304,11 +651,11 @@ static void nftnl_set_elem_nlmsg_build_def(struct nlmsghdr *nlh,
 }
 
 static struct nlattr *nftnl_set_elem_build(struct nlmsghdr *nlh,
-					      struct nftnl_set_elem *elem, int i)
+					      struct nftnl_set_elem *elem)
 {
 	struct nlattr *nest2;
 
-	nest2 = mnl_attr_nest_start(nlh, i);
+	nest2 = mnl_attr_nest_start(nlh, NFTA_LIST_ELEM);
 	nftnl_set_elem_nlmsg_build_payload(nlh, elem);
 	mnl_attr_nest_end(nlh, nest2);
 
@@ -320,7 +667,6 @@ void nftnl_set_elems_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_set
 {
 	struct nftnl_set_elem *elem;
 	struct nlattr *nest1;
-	int i = 0;
 
 	nftnl_set_elem_nlmsg_build_def(nlh, s);
 
@@ -329,7 +675,7 @@ void nftnl_set_elems_nlmsg_build_payload(struct nlmsghdr *nlh, struct nftnl_set
 
 	nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_LIST_ELEMENTS);
 	list_for_each_entry(elem, &s->element_list, head)
-		nftnl_set_elem_build(nlh, elem, ++i);
+		nftnl_set_elem_build(nlh, elem);
 
 	mnl_attr_nest_end(nlh, nest1);
 }
@@ -368,19 +714,79 @@ static int nftnl_set_elem_parse_attr_cb(const struct nlattr *attr, void *data)
 	return MNL_CB_OK;
 }
 
+/* Copy variable-length attributes from the arena of the set, if any. */
+static void *nftnl_set_elem_memdup(struct nftnl_set_elem *e,
+				   struct nftnl_arena *arena,
+				   uint32_t arena_flag,
+				   const void *data, size_t len)
+{
+	void *ptr;
+
+	if (arena) {
+		ptr = nftnl_arena_memdup(arena, data, len);
+		if (ptr)
+			e->arena_flags |= arena_flag;
+		return ptr;
+	}
+
+	ptr = malloc(len);
+	if (ptr)
+		memcpy(ptr, data, len);
+	return ptr;
+}
+
 static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest)
 {
 	struct nlattr *tb[NFTA_SET_ELEM_MAX+1] = {};
+	struct nftnl_data_ref key = {}, data = {};
+	struct nftnl_arena *arena = s->elem_arena;
+	struct nftnl_set_elem_ext *ext = NULL;
+	int ret, type, data_type = DATA_NONE;
 	struct nftnl_set_elem *e;
-	int ret, type;
+	uint32_t data_size = 0;
+
+	ret = mnl_attr_parse_nested(nest, nftnl_set_elem_parse_attr_cb, tb);
+	if (ret < 0)
+		return ret;
+
+	/* Decode key and data first, so the element is allocated with the
+	 * exact room they need.
+	 */
+	if (tb[NFTA_SET_ELEM_KEY]) {
+		ret = nftnl_parse_data_ref(&key, tb[NFTA_SET_ELEM_KEY], &type);
+		if (ret < 0)
+			return ret;
+	}
+	if (tb[NFTA_SET_ELEM_DATA]) {
+		ret = nftnl_parse_data_ref(&data, tb[NFTA_SET_ELEM_DATA],
+					   &data_type);
+		if (ret < 0)
+			return ret;
+
+		if (data_type == DATA_VALUE)
+			data_size = data.len;
+		else
+			data_size = sizeof(uint32_t);
+	}
 
-	e = nftnl_set_elem_alloc();
+	e = nftnl_set_elem_alloc_size(arena, key.len, data_size);
 	if (e == NULL)
 		return -1;
 
-	ret = mnl_attr_parse_nested(nest, nftnl_set_elem_parse_attr_cb, tb);
-	if (ret < 0)
-		goto out_set_elem;
+	if (tb[NFTA_SET_ELEM_TIMEOUT] || tb[NFTA_SET_ELEM_EXPIRATION] ||
+	    tb[NFTA_SET_ELEM_EXPR] || tb[NFTA_SET_ELEM_USERDATA] ||
+	    tb[NFTA_SET_ELEM_OBJREF] || data_type == DATA_CHAIN) {
+		if (arena) {
+			e->ext = nftnl_arena_zalloc(arena, sizeof(*ext));
+			if (e->ext)
+				e->arena_flags |= NFTNL_SET_ELEM_ARENA_EXT;
+		}
+		ext = nftnl_set_elem_ext(e);
+		if (ext == NULL) {
+			ret = -1;
+			goto out_set_elem;
+		}
+	}
 
 	if (tb[NFTA_SET_ELEM_FLAGS]) {
 		e->set_elem_flags =
@@ -388,39 +794,47 @@ static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest
 		e->flags |= (1 << NFTNL_SET_ELEM_FLAGS);
 	}
 	if (tb[NFTA_SET_ELEM_TIMEOUT]) {
-		e->timeout = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_TIMEOUT]));
+		ext->timeout = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_TIMEOUT]));
 		e->flags |= (1 << NFTNL_SET_ELEM_TIMEOUT);
 	}
 	if (tb[NFTA_SET_ELEM_EXPIRATION]) {
-		e->expiration = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_EXPIRATION]));
+		ext->expiration = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_EXPIRATION]));
 		e->flags |= (1 << NFTNL_SET_ELEM_EXPIRATION);
 	}
-        if (tb[NFTA_SET_ELEM_KEY]) {
-		ret = nftnl_parse_data(&e->key, tb[NFTA_SET_ELEM_KEY], &type);
-		if (ret < 0)
-			goto out_set_elem;
+	if (key.val) {
+		memcpy(e->key, key.val, key.len);
+		e->key_len = key.len;
 		e->flags |= (1 << NFTNL_SET_ELEM_KEY);
-        }
-        if (tb[NFTA_SET_ELEM_DATA]) {
-		ret = nftnl_parse_data(&e->data, tb[NFTA_SET_ELEM_DATA], &type);
-		if (ret < 0)
+	}
+	switch(data_type) {
+	case DATA_VERDICT:
+		e->data[0] = data.verdict;
+		e->data_len = sizeof(uint32_t);
+		e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
+		break;
+	case DATA_CHAIN:
+		e->data[0] = data.verdict;
+		e->data_len = sizeof(uint32_t);
+		ext->chain = nftnl_set_elem_memdup(e, arena,
+						   NFTNL_SET_ELEM_ARENA_CHAIN,
+						   data.chain,
+						   strlen(data.chain) + 1);
+		if (ext->chain == NULL) {
+			ret = -1;
 			goto out_set_elem;
-		switch(type) {
-		case DATA_VERDICT:
-			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
-			break;
-		case DATA_CHAIN:
-			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT) |
-				    (1 << NFTNL_SET_ELEM_CHAIN);
-			break;
-		case DATA_VALUE:
-			e->flags |= (1 << NFTNL_SET_ELEM_DATA);
-			break;
 		}
-        }
+		e->flags |= (1 << NFTNL_SET_ELEM_VERDICT) |
+			    (1 << NFTNL_SET_ELEM_CHAIN);
+		break;
+	case DATA_VALUE:
+		memcpy(e->data, data.val, data.len);
+		e->data_len = data.len;
+		e->flags |= (1 << NFTNL_SET_ELEM_DATA);
+		break;
+	}
 	if (tb[NFTA_SET_ELEM_EXPR]) {
-		e->expr = nftnl_expr_parse(tb[NFTA_SET_ELEM_EXPR]);
-		if (e->expr == NULL) {
+		ext->expr = nftnl_expr_parse(tb[NFTA_SET_ELEM_EXPR]);
+		if (ext->expr == NULL) {
 			ret = -1;
 			goto out_set_elem;
 		}
@@ -430,21 +844,23 @@ static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest
 		const void *udata =
 			mnl_attr_get_payload(tb[NFTA_SET_ELEM_USERDATA]);
 
-		if (e->flags & (1 << NFTNL_RULE_USERDATA))
-			xfree(e->user.data);
-
-		e->user.len  = mnl_attr_get_payload_len(tb[NFTA_SET_ELEM_USERDATA]);
-		e->user.data = malloc(e->user.len);
-		if (e->user.data == NULL) {
+		ext->user.len  = mnl_attr_get_payload_len(tb[NFTA_SET_ELEM_USERDATA]);
+		ext->user.data = nftnl_set_elem_memdup(e, arena,
+						NFTNL_SET_ELEM_ARENA_USERDATA,
+						udata, ext->user.len);
+		if (ext->user.data == NULL) {
 			ret = -1;
-			goto out_expr;
+			goto out_set_elem;
 		}
-		memcpy(e->user.data, udata, e->user.len);
-		e->flags |= (1 << NFTNL_RULE_USERDATA);
+		e->flags |= (1 << NFTNL_SET_ELEM_USERDATA);
 	}
 	if (tb[NFTA_SET_ELEM_OBJREF]) {
-		e->objref = strdup(mnl_attr_get_str(tb[NFTA_SET_ELEM_OBJREF]));
-		if (e->objref == NULL) {
+		const char *objref = mnl_attr_get_str(tb[NFTA_SET_ELEM_OBJREF]);
+
+		ext->objref = nftnl_set_elem_memdup(e, arena,
+						NFTNL_SET_ELEM_ARENA_OBJREF,
+						objref, strlen(objref) + 1);
+		if (ext->objref == NULL) {
 			ret = -1;
 			goto out_set_elem;
 		}
@@ -452,16 +868,91 @@ static int nftnl_set_elems_parse2(struct nftnl_set *s, const struct nlattr *nest
 	}
 
 	/* Add this new element to this set */
-	list_add_tail(&e->head, &s->element_list);
+	nftnl_set_elem_add(s, e);
 
 	return 0;
-out_expr:
-	nftnl_expr_free(e->expr);
 out_set_elem:
 	nftnl_set_elem_free(e);
 	return ret;
 }
 
+/* Fill an element on the stack that points to the netlink message. */
+static int nftnl_set_elem_parse_view(struct nftnl_set_elem *e,
+				     struct nftnl_set_elem_ext *ext,
+				     uint32_t *verdict,
+				     const struct nlattr *nest)
+{
+	struct nlattr *tb[NFTA_SET_ELEM_MAX+1] = {};
+	struct nftnl_data_ref ref;
+	int type;
+
+	if (mnl_attr_parse_nested(nest, nftnl_set_elem_parse_attr_cb, tb) < 0)
+		return -1;
+
+	memset(e, 0, sizeof(*e));
+	memset(ext, 0, sizeof(*ext));
+	e->ext = ext;
+
+	if (tb[NFTA_SET_ELEM_FLAGS]) {
+		e->set_elem_flags =
+			ntohl(mnl_attr_get_u32(tb[NFTA_SET_ELEM_FLAGS]));
+		e->flags |= (1 << NFTNL_SET_ELEM_FLAGS);
+	}
+	if (tb[NFTA_SET_ELEM_TIMEOUT]) {
+		ext->timeout = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_TIMEOUT]));
+		e->flags |= (1 << NFTNL_SET_ELEM_TIMEOUT);
+	}
+	if (tb[NFTA_SET_ELEM_EXPIRATION]) {
+		ext->expiration = be64toh(mnl_attr_get_u64(tb[NFTA_SET_ELEM_EXPIRATION]));
+		e->flags |= (1 << NFTNL_SET_ELEM_EXPIRATION);
+	}
+	if (tb[NFTA_SET_ELEM_KEY]) {
+		memset(&ref, 0, sizeof(ref));
+		if (nftnl_parse_data_ref(&ref, tb[NFTA_SET_ELEM_KEY], &type) < 0 ||
+		    ref.val == NULL)
+			return -1;
+
+		e->key = (uint32_t *)ref.val;
+		e->key_len = ref.len;
+		e->flags |= (1 << NFTNL_SET_ELEM_KEY);
+	}
+	if (tb[NFTA_SET_ELEM_DATA]) {
+		memset(&ref, 0, sizeof(ref));
+		type = DATA_NONE;
+		if (nftnl_parse_data_ref(&ref, tb[NFTA_SET_ELEM_DATA], &type) < 0)
+			return -1;
+
+		switch(type) {
+		case DATA_CHAIN:
+			ext->chain = ref.chain;
+			e->flags |= (1 << NFTNL_SET_ELEM_CHAIN);
+			/* fall through */
+		case DATA_VERDICT:
+			*verdict = ref.verdict;
+			e->data = verdict;
+			e->data_len = sizeof(uint32_t);
+			e->flags |= (1 << NFTNL_SET_ELEM_VERDICT);
+			break;
+		case DATA_VALUE:
+			e->data = (uint32_t *)ref.val;
+			e->data_len = ref.len;
+			e->flags |= (1 << NFTNL_SET_ELEM_DATA);
+			break;
+		}
+	}
+	if (tb[NFTA_SET_ELEM_USERDATA]) {
+		ext->user.data = mnl_attr_get_payload(tb[NFTA_SET_ELEM_USERDATA]);
+		ext->user.len = mnl_attr_get_payload_len(tb[NFTA_SET_ELEM_USERDATA]);
+		e->flags |= (1 << NFTNL_SET_ELEM_USERDATA);
+	}
+	if (tb[NFTA_SET_ELEM_OBJREF]) {
+		ext->objref = mnl_attr_get_str(tb[NFTA_SET_ELEM_OBJREF]);
+		e->flags |= (1 << NFTNL_SET_ELEM_OBJREF);
+	}
+
+	return 0;
+}
+
 static int
 nftnl_set_elem_list_parse_attr_cb(const struct nlattr *attr, void *data)
 {
@@ -516,18 +1007,20 @@ int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
 
 	if (tb[NFTA_SET_ELEM_LIST_TABLE]) {
 		if (s->flags & (1 << NFTNL_SET_TABLE))
-			xfree(s->table);
+			nftnl_str_release(s->table, s->interned, NFTNL_SET_TABLE);
 		s->table =
-			strdup(mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_TABLE]));
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_TABLE]),
+					 &s->interned, NFTNL_SET_TABLE);
 		if (!s->table)
 			return -1;
 		s->flags |= (1 << NFTNL_SET_TABLE);
 	}
 	if (tb[NFTA_SET_ELEM_LIST_SET]) {
 		if (s->flags & (1 << NFTNL_SET_NAME))
-			xfree(s->name);
+			nftnl_str_release(s->name, s->interned, NFTNL_SET_NAME);
 		s->name =
-			strdup(mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_SET]));
+			nftnl_str_intern(mnl_attr_get_str(tb[NFTA_SET_ELEM_LIST_SET]),
+					 &s->interned, NFTNL_SET_NAME);
 		if (!s->name)
 			return -1;
 		s->flags |= (1 << NFTNL_SET_NAME);
@@ -548,6 +1041,47 @@ int nftnl_set_elems_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_set *s)
 	return 0;
 }
 
+/* Call @cb for each element in the message without building a set. The
+ * element handed to @cb lives on the stack and points to the netlink message,
+ * so it is only valid until @cb returns and it must not be modified, added to
+ * a set nor released. Expressions attached to elements are not decoded, since
+ * that would require allocating them.
+ */
+EXPORT_SYMBOL(nftnl_set_elems_nlmsg_foreach);
+int nftnl_set_elems_nlmsg_foreach(const struct nlmsghdr *nlh,
+				  int (*cb)(struct nftnl_set_elem *e,
+					    void *data),
+				  void *data)
+{
+	struct nlattr *tb[NFTA_SET_ELEM_LIST_MAX+1] = {};
+	struct nfgenmsg *nfg = mnl_nlmsg_get_payload(nlh);
+	struct nftnl_set_elem_ext ext;
+	struct nftnl_set_elem e;
+	struct nlattr *attr;
+	uint32_t verdict;
+	int ret;
+
+	if (mnl_attr_parse(nlh, sizeof(*nfg),
+			   nftnl_set_elem_list_parse_attr_cb, tb) < 0)
+		return -1;
+
+	if (!tb[NFTA_SET_ELEM_LIST_ELEMENTS])
+		return 0;
+
+	mnl_attr_for_each_nested(attr, tb[NFTA_SET_ELEM_LIST_ELEMENTS]) {
+		if (mnl_attr_get_type(attr) != NFTA_LIST_ELEM)
+			return -1;
+
+		if (nftnl_set_elem_parse_view(&e, &ext, &verdict, attr) < 0)
+			return -1;
+
+		ret = cb(&e, data);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
 static int nftnl_set_elem_json_parse(struct nftnl_set_elem *e, const void *json,
 				   struct nftnl_parse_err *err,
 				   enum nftnl_parse_input input)
@@ -607,6 +1141,7 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 					uint32_t flags)
 {
 	int ret, remain = size, offset = 0, type = -1;
+	union nftnl_data_reg reg = {};
 
 	if (e->flags & (1 << NFTNL_SET_ELEM_FLAGS)) {
 		ret = snprintf(buf, remain, "\"flags\":%u,", e->set_elem_flags);
@@ -616,7 +1151,9 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 	ret = snprintf(buf + offset, remain, "\"key\":{");
 	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
-	ret = nftnl_data_reg_snprintf(buf + offset, remain, &e->key,
+	memcpy(reg.val, e->key, e->key_len);
+	reg.len = e->key_len;
+	ret = nftnl_data_reg_snprintf(buf + offset, remain, &reg,
 				    NFTNL_OUTPUT_JSON, flags, DATA_VALUE);
 	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
@@ -634,7 +1171,16 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 		ret = snprintf(buf + offset, remain, ",\"data\":{");
 		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
-		ret = nftnl_data_reg_snprintf(buf + offset, remain, &e->data,
+		memset(&reg, 0, sizeof(reg));
+		if (type == DATA_VALUE) {
+			memcpy(reg.val, e->data, e->data_len);
+			reg.len = e->data_len;
+		} else {
+			reg.verdict = e->data[0];
+			if (type == DATA_CHAIN)
+				reg.chain = e->ext->chain;
+		}
+		ret = nftnl_data_reg_snprintf(buf + offset, remain, &reg,
 					    NFTNL_OUTPUT_JSON, flags, type);
 			SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
@@ -645,36 +1191,53 @@ static int nftnl_set_elem_snprintf_json(char *buf, size_t size,
 	return offset;
 }
 
-static int nftnl_set_elem_snprintf_default(char *buf, size_t size,
-					   const struct nftnl_set_elem *e)
-{
-	int ret, remain = size, offset = 0, i;
+/* "element ", key and data words, " : " and flags followed by " [end]" */
+#define NFTNL_SET_ELEM_DEFAULT_LEN					\
+	(8 + 2 * (NFT_DATA_VALUE_MAXLEN / sizeof(uint32_t)) *		\
+	 (NFTNL_FMT_HEX32_LEN + 1) + 3 + NFTNL_FMT_U64_LEN + 6)
 
-	ret = snprintf(buf, remain, "element ");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+/* Same as "%.8x " for every word of @len bytes of key or data. */
+static int nftnl_set_elem_fmt_words(char *out, const uint32_t *words,
+				    uint32_t len)
+{
+	int i, n = 0;
 
-	for (i = 0; i < div_round_up(e->key.len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf + offset, remain, "%.8x ", e->key.val[i]);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
+	for (i = 0; i < div_round_up(len, sizeof(uint32_t)); i++) {
+		n += nftnl_fmt_hex32(out + n, words[i]);
+		out[n++] = ' ';
 	}
 
-	ret = snprintf(buf + offset, remain, " : ");
-	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-
-	for (i = 0; i < div_round_up(e->data.len, sizeof(uint32_t)); i++) {
-		ret = snprintf(buf + offset, remain, "%.8x ", e->data.val[i]);
-		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
-	}
+	return n;
+}
 
-	ret = snprintf(buf + offset, remain, "%u [end]", e->set_elem_flags);
+static int nftnl_set_elem_snprintf_default(char *buf, size_t size,
+					   const struct nftnl_set_elem *e)
+{
+	int ret, remain = size, offset = 0, i, n;
+	char tmp[NFTNL_SET_ELEM_DEFAULT_LEN];
+
+	memcpy(tmp, "element ", 8);
+	n = 8;
+	n += nftnl_set_elem_fmt_words(tmp + n, e->key, e->key_len);
+	memcpy(tmp + n, " : ", 3);
+	n += 3;
+	/* Verdicts share the data storage, they are not printed as data. */
+	if (!(e->flags & ((1 << NFTNL_SET_ELEM_VERDICT) |
+			  (1 << NFTNL_SET_ELEM_CHAIN))))
+		n += nftnl_set_elem_fmt_words(tmp + n, e->data, e->data_len);
+	n += nftnl_fmt_u64(tmp + n, e->set_elem_flags);
+	memcpy(tmp + n, " [end]", 6);
+	n += 6;
+
+	ret = nftnl_fmt_copy(buf, remain, tmp, n);
 	SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
-	if (e->user.len) {
+	if (e->flags & (1 << NFTNL_SET_ELEM_USERDATA) && e->ext->user.len) {
 		ret = snprintf(buf + offset, remain, "  userdata = {");
 		SNPRINTF_BUFFER_SIZE(ret, remain, offset);
 
-		for (i = 0; i < e->user.len; i++) {
-			char *c = e->user.data;
+		for (i = 0; i < e->ext->user.len; i++) {
+			char *c = e->ext->user.data;
 
 			ret = snprintf(buf + offset, remain, "%c",
 				       isalnum(c[i]) ? c[i] : 0);
@@ -733,9 +1296,8 @@ int nftnl_set_elem_snprintf(char *buf, size_t size,
 					 type, flags);
 }
 
-static int nftnl_set_elem_do_snprintf(char *buf, size_t size, const void *e,
-				      uint32_t cmd, uint32_t type,
-				      uint32_t flags)
+int nftnl_set_elem_do_snprintf(char *buf, size_t size, const void *e,
+			       uint32_t cmd, uint32_t type, uint32_t flags)
 {
 	return nftnl_set_elem_snprintf(buf, size, e, type, flags);
 }
@@ -842,7 +1404,7 @@ int nftnl_set_elems_nlmsg_build_payload_iter(struct nlmsghdr *nlh,
 {
 	struct nftnl_set_elem *elem;
 	struct nlattr *nest1, *nest2;
-	int i = 0, ret = 0;
+	int ret = 0;
 
 	nftnl_set_elem_nlmsg_build_def(nlh, iter->set);
 
@@ -853,7 +1415,7 @@ int nftnl_set_elems_nlmsg_build_payload_iter(struct nlmsghdr *nlh,
 	nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_LIST_ELEMENTS);
 	elem = nftnl_set_elems_iter_next(iter);
 	while (elem != NULL) {
-		nest2 = nftnl_set_elem_build(nlh, elem, ++i);
+		nest2 = nftnl_set_elem_build(nlh, elem);
 		if (nftnl_attr_nest_overflow(nlh, nest1, nest2)) {
 			/* Go back to previous not to miss this element */
 			iter->cur = list_entry(iter->cur->head.prev,
@@ -867,3 +1429,379 @@ int nftnl_set_elems_nlmsg_build_payload_iter(struct nlmsghdr *nlh,
 
 	return ret;
 }
+
+struct nftnl_set_elem_slot {
+	struct nftnl_set_elem	*elem;
+	bool			seen;
+};
+
+struct nftnl_set_elem_diff {
+	struct nftnl_set_elem_slot	*slots;
+	uint32_t			size;
+	struct nftnl_set_elem		**add;
+	uint32_t			num_add;
+	struct nftnl_set_elem		**del;
+	uint32_t			num_del;
+};
+
+/* The end of an interval may have the same key as the start of the next
+ * one, hence the interval end flag is part of the element identity.
+ */
+static uint32_t nftnl_set_elem_id_flags(const struct nftnl_set_elem *e)
+{
+	return e->set_elem_flags & NFT_SET_ELEM_INTERVAL_END;
+}
+
+static bool nftnl_set_elem_id_eq(const struct nftnl_set_elem *e1,
+				 const struct nftnl_set_elem *e2)
+{
+	return nftnl_set_elem_id_flags(e1) == nftnl_set_elem_id_flags(e2) &&
+	       nftnl_set_elem_key_eq(e1, e2->key, e2->key_len);
+}
+
+/* Element of @s with the same identity as @e. */
+struct nftnl_set_elem *nftnl_set_elem_lookup_id(const struct nftnl_set *s,
+						const struct nftnl_set_elem *e)
+{
+	struct nftnl_set_elem *cur;
+	struct hlist_node *pos;
+	uint32_t hash;
+
+	if (s->elem_hash.size == 0) {
+		list_for_each_entry(cur, &s->element_list, head) {
+			if (nftnl_set_elem_id_eq(cur, e))
+				return cur;
+		}
+		return NULL;
+	}
+
+	hash = nftnl_set_elem_key_hash(e->key, e->key_len);
+	hlist_for_each_entry(cur, pos,
+			     &s->elem_hash.buckets[hash & (s->elem_hash.size - 1)],
+			     hnode) {
+		if (nftnl_set_elem_id_eq(cur, e))
+			return cur;
+	}
+	return NULL;
+}
+
+static bool nftnl_set_elem_data_eq(const struct nftnl_set_elem *e1,
+				   const struct nftnl_set_elem *e2)
+{
+	uint32_t mask = (1 << NFTNL_SET_ELEM_VERDICT) |
+			(1 << NFTNL_SET_ELEM_CHAIN) |
+			(1 << NFTNL_SET_ELEM_DATA) |
+			(1 << NFTNL_SET_ELEM_OBJREF);
+
+	if ((e1->flags & mask) != (e2->flags & mask))
+		return false;
+
+	if (e1->flags & (1 << NFTNL_SET_ELEM_DATA) &&
+	    (e1->data_len != e2->data_len ||
+	     memcmp(e1->data, e2->data, e1->data_len) != 0))
+		return false;
+	if (e1->flags & (1 << NFTNL_SET_ELEM_VERDICT) &&
+	    e1->data[0] != e2->data[0])
+		return false;
+	if (e1->flags & (1 << NFTNL_SET_ELEM_CHAIN) &&
+	    strcmp(e1->ext->chain, e2->ext->chain) != 0)
+		return false;
+	if (e1->flags & (1 << NFTNL_SET_ELEM_OBJREF) &&
+	    strcmp(e1->ext->objref, e2->ext->objref) != 0)
+		return false;
+
+	return true;
+}
+
+static struct nftnl_set_elem_slot *
+nftnl_set_elem_diff_slot(struct nftnl_set_elem_diff *diff,
+			 const struct nftnl_set_elem *e)
+{
+	uint32_t i;
+
+	i = nftnl_hash(e->key, e->key_len, nftnl_set_elem_id_flags(e));
+	for (;; i++) {
+		i &= diff->size - 1;
+		if (diff->slots[i].elem == NULL ||
+		    nftnl_set_elem_id_eq(diff->slots[i].elem, e))
+			return &diff->slots[i];
+	}
+}
+
+static uint32_t nftnl_set_elem_count(const struct nftnl_set *s)
+{
+	struct nftnl_set_elem *e;
+	uint32_t count = 0;
+
+	list_for_each_entry(e, &s->element_list, head)
+		count++;
+
+	return count;
+}
+
+/* Same elements, with the same data, in @s1 and @s2. */
+bool nftnl_set_elems_eq(const struct nftnl_set *s1, const struct nftnl_set *s2)
+{
+	struct nftnl_set_elem *e, *old;
+
+	if (nftnl_set_elem_count(s1) != nftnl_set_elem_count(s2))
+		return false;
+
+	list_for_each_entry(e, &s2->element_list, head) {
+		old = nftnl_set_elem_lookup_id(s1, e);
+		if (old == NULL || !nftnl_set_elem_data_eq(old, e))
+			return false;
+	}
+	return true;
+}
+
+static int nftnl_set_elem_diff_init(struct nftnl_set_elem_diff *diff,
+				    const struct nftnl_set *cur,
+				    const struct nftnl_set *want)
+{
+	uint32_t num_cur = nftnl_set_elem_count(cur);
+	uint32_t num_want = nftnl_set_elem_count(want);
+
+	/* Keep the load factor of the open addressing table below 0.5 */
+	diff->size = 16;
+	while (diff->size < num_cur * 2)
+		diff->size <<= 1;
+
+	diff->slots = calloc(diff->size, sizeof(struct nftnl_set_elem_slot));
+	/* an updated element is deleted and added again */
+	diff->add = calloc(num_want + 1, sizeof(struct nftnl_set_elem *));
+	diff->del = calloc(num_cur + 1, sizeof(struct nftnl_set_elem *));
+	if (diff->slots == NULL || diff->add == NULL || diff->del == NULL)
+		return -1;
+
+	return 0;
+}
+
+static void nftnl_set_elem_diff_fini(struct nftnl_set_elem_diff *diff)
+{
+	xfree(diff->slots);
+	xfree(diff->add);
+	xfree(diff->del);
+}
+
+static void nftnl_set_elem_diff_compute(struct nftnl_set_elem_diff *diff,
+					const struct nftnl_set *cur,
+					const struct nftnl_set *want)
+{
+	struct nftnl_set_elem_slot *slot;
+	struct nftnl_set_elem *e;
+	uint32_t i;
+
+	list_for_each_entry(e, &cur->element_list, head) {
+		if (!(e->flags & (1 << NFTNL_SET_ELEM_KEY)))
+			continue;
+
+		slot = nftnl_set_elem_diff_slot(diff, e);
+		/* Duplicated element in the dump, delete it only once. */
+		if (slot->elem != NULL)
+			continue;
+
+		slot->elem = e;
+	}
+
+	list_for_each_entry(e, &want->element_list, head) {
+		if (!(e->flags & (1 << NFTNL_SET_ELEM_KEY)))
+			continue;
+
+		slot = nftnl_set_elem_diff_slot(diff, e);
+		if (slot->elem == NULL) {
+			diff->add[diff->num_add++] = e;
+			continue;
+		}
+		if (slot->seen)
+			continue;
+
+		slot->seen = true;
+		if (!nftnl_set_elem_data_eq(slot->elem, e)) {
+			diff->del[diff->num_del++] = slot->elem;
+			diff->add[diff->num_add++] = e;
+		}
+	}
+
+	for (i = 0; i < diff->size; i++) {
+		slot = &diff->slots[i];
+		if (slot->elem != NULL && !slot->seen)
+			diff->del[diff->num_del++] = slot->elem;
+	}
+}
+
+/* Bytes that nftnl_set_elem_build() takes for @e. */
+static uint32_t nftnl_set_elem_build_len(const struct nftnl_set_elem *e)
+{
+	uint32_t len = NLA_HDRLEN;
+
+	if (e->flags & (1 << NFTNL_SET_ELEM_FLAGS))
+		len += MNL_ALIGN(NLA_HDRLEN + sizeof(uint32_t));
+	if (e->flags & (1 << NFTNL_SET_ELEM_TIMEOUT))
+		len += MNL_ALIGN(NLA_HDRLEN + sizeof(uint64_t));
+	if (e->flags & (1 << NFTNL_SET_ELEM_KEY))
+		len += NLA_HDRLEN + MNL_ALIGN(NLA_HDRLEN + e->key_len);
+	if (e->flags & (1 << NFTNL_SET_ELEM_VERDICT)) {
+		len += 2 * NLA_HDRLEN +
+		       MNL_ALIGN(NLA_HDRLEN + sizeof(uint32_t));
+		if (e->flags & (1 << NFTNL_SET_ELEM_CHAIN))
+			len += MNL_ALIGN(NLA_HDRLEN +
+					 strlen(e->ext->chain) + 1);
+	}
+	if (e->flags & (1 << NFTNL_SET_ELEM_DATA))
+		len += NLA_HDRLEN + MNL_ALIGN(NLA_HDRLEN + e->data_len);
+	if (e->flags & (1 << NFTNL_SET_ELEM_USERDATA))
+		len += MNL_ALIGN(NLA_HDRLEN + e->ext->user.len);
+	if (e->flags & (1 << NFTNL_SET_ELEM_OBJREF))
+		len += MNL_ALIGN(NLA_HDRLEN + strlen(e->ext->objref) + 1);
+
+	return len;
+}
+
+/* Bytes that a message takes before its first element. */
+static uint32_t nftnl_set_elems_hdr_len(const struct nftnl_set *s)
+{
+	uint32_t len = MNL_NLMSG_HDRLEN + MNL_ALIGN(sizeof(struct nfgenmsg)) +
+		       NLA_HDRLEN;
+
+	if (s->flags & (1 << NFTNL_SET_NAME))
+		len += MNL_ALIGN(NLA_HDRLEN + strlen(s->name) + 1);
+	if (s->flags & (1 << NFTNL_SET_ID))
+		len += MNL_ALIGN(NLA_HDRLEN + sizeof(uint32_t));
+	if (s->flags & (1 << NFTNL_SET_TABLE))
+		len += MNL_ALIGN(NLA_HDRLEN + strlen(s->table) + 1);
+
+	return len;
+}
+
+/* Messages are built in place, so each one is stopped before it goes beyond
+ * the room left in the batch page, overrun area included, or beyond the 16-bit
+ * length of the element list attribute. A batch page has to hold the largest
+ * message with a single element.
+ */
+static int nftnl_set_elems_batch_build(struct nftnl_batch *batch,
+				       const struct nftnl_set *s,
+				       uint16_t type, uint16_t flags,
+				       uint32_t *seq,
+				       struct nftnl_set_elem **elems,
+				       uint32_t num_elems)
+{
+	uint32_t i = 0, first, hdr_len, room, elem_len;
+	struct nlattr *nest1;
+	struct nlmsghdr *nlh;
+	int num_msgs = 0;
+
+	hdr_len = nftnl_set_elems_hdr_len(s);
+
+	while (i < num_elems) {
+		if (nftnl_batch_buffer_reserve(batch, hdr_len +
+				nftnl_set_elem_build_len(elems[i])) < 0)
+			return -1;
+		room = nftnl_batch_buffer_room(batch);
+
+		nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch), type,
+					    s->family, flags, *seq);
+		nftnl_set_elem_nlmsg_build_def(nlh, s);
+
+		nest1 = mnl_attr_nest_start(nlh, NFTA_SET_ELEM_LIST_ELEMENTS);
+		for (first = i; i < num_elems; i++) {
+			elem_len = nftnl_set_elem_build_len(elems[i]);
+			if (nlh->nlmsg_len + elem_len > room ||
+			    (char *)mnl_nlmsg_get_payload_tail(nlh) -
+			    (char *)nest1 + elem_len > UINT16_MAX)
+				break;
+
+			nftnl_set_elem_build(nlh, elems[i]);
+		}
+		/* This element does not fit into a message on its own. */
+		if (i == first) {
+			errno = EMSGSIZE;
+			return -1;
+		}
+		mnl_attr_nest_end(nlh, nest1);
+
+		if (nftnl_batch_update(batch) < 0)
+			return -1;
+
+		(*seq)++;
+		num_msgs++;
+	}
+
+	return num_msgs;
+}
+
+/* Append to @batch the @type messages that carry all the elements of @s,
+ * split so that each message fits into the room left in the batch page and
+ * its overrun area. Returns the number of messages, or -1 on error.
+ */
+int nftnl_set_elems_batch(struct nftnl_batch *batch, const struct nftnl_set *s,
+			  uint16_t type, uint16_t flags, uint32_t *seq)
+{
+	struct nftnl_set_elem **elems, *e;
+	uint32_t num_elems = 0;
+	int ret;
+
+	list_for_each_entry(e, &s->element_list, head)
+		num_elems++;
+	if (num_elems == 0)
+		return 0;
+
+	elems = malloc(num_elems * sizeof(*elems));
+	if (elems == NULL)
+		return -1;
+
+	num_elems = 0;
+	list_for_each_entry(e, &s->element_list, head)
+		elems[num_elems++] = e;
+
+	ret = nftnl_set_elems_batch_build(batch, s, type, flags, seq, elems,
+					  num_elems);
+	xfree(elems);
+
+	return ret;
+}
+
+/* Append to @batch the DELSETELEM and NEWSETELEM messages that turn the
+ * elements in @cur into the ones in @want. Table, set and family are taken
+ * from @want. Messages carry as many elements as fit into the room left in
+ * the batch page, overrun area included, up to UINT16_MAX bytes: an overrun
+ * area of UINT16_MAX bytes or more makes the most of each message. Returns
+ * the number of messages, or -1 on error, errno is EMSGSIZE if a single
+ * element does not fit into a batch page and its overrun area.
+ */
+EXPORT_SYMBOL(nftnl_set_elems_diff_batch);
+int nftnl_set_elems_diff_batch(struct nftnl_batch *batch,
+			       const struct nftnl_set *cur,
+			       const struct nftnl_set *want,
+			       uint16_t flags, uint32_t *seq)
+{
+	struct nftnl_set_elem_diff diff = {};
+	int ret, num_msgs;
+
+	if (nftnl_set_elem_diff_init(&diff, cur, want) < 0) {
+		nftnl_set_elem_diff_fini(&diff);
+		return -1;
+	}
+
+	nftnl_set_elem_diff_compute(&diff, cur, want);
+
+	/* Deletions go first, so updated elements can be added again. */
+	ret = nftnl_set_elems_batch_build(batch, want, NFT_MSG_DELSETELEM,
+					  flags, seq, diff.del, diff.num_del);
+	if (ret < 0)
+		goto err;
+	num_msgs = ret;
+
+	ret = nftnl_set_elems_batch_build(batch, want, NFT_MSG_NEWSETELEM,
+					  NLM_F_CREATE | flags, seq,
+					  diff.add, diff.num_add);
+	if (ret < 0)
+		goto err;
+	num_msgs += ret;
+
+	nftnl_set_elem_diff_fini(&diff);
+	return num_msgs;
+err:
+	nftnl_set_elem_diff_fini(&diff);
+	return -1;
+}
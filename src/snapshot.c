@@ -0,0 +1,696 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "internal.h"
+#include <libmnl/libmnl.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <libnftnl/snapshot.h>
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/set.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/batch.h>
+
+/*
+ * A snapshot is a list of netlink messages in host byte order:
+ *
+ *	header | messages ... | padding | index | trailer
+ *
+ * Messages are stored back to back, as they are laid out in the pages of the
+ * batch they were built in. The index locates every message and marks those
+ * that start a page, it is written last so that the file is produced in one
+ * pass, and the trailer at the end of the file locates the index.
+ *
+ * A ruleset snapshot describes tables first, then chains, sets each followed
+ * by their elements, and rules. A batch capture holds the messages of a batch
+ * as they are sent to the kernel.
+ */
+#define NFTNL_SNAPSHOT_MAGIC		"NFTS"
+#define NFTNL_SNAPSHOT_VERSION		1
+#define NFTNL_SNAPSHOT_BYTEORDER	0x01020304
+
+struct nftnl_snapshot_hdr {
+	char		magic[4];
+	uint16_t	version;
+	uint16_t	reserved;
+	uint32_t	byteorder;
+	uint32_t	reserved2;
+};
+
+#define NFTNL_SNAPSHOT_ENTRY_F_PAGE	(1 << 0)
+
+struct nftnl_snapshot_entry {
+	uint64_t	offset;
+	uint32_t	len;
+	uint16_t	type;
+	uint16_t	flags;
+};
+
+struct nftnl_snapshot_trailer {
+	uint64_t	index_offset;
+	uint32_t	num_msgs;
+	char		magic[4];
+};
+
+struct nftnl_snapshot {
+	const char				*data;
+	size_t					len;
+	const struct nftnl_snapshot_entry	*index;
+	uint32_t				num_msgs;
+	uint32_t				num_pages;
+};
+
+struct nftnl_snapshot_writer {
+	FILE				*fp;
+	struct nftnl_batch		*batch;
+	uint64_t			offset;
+	struct nftnl_snapshot_entry	*index;
+	uint32_t			num_msgs;
+	uint32_t			size;
+};
+
+static int nftnl_snapshot_index_add(struct nftnl_snapshot_writer *w,
+				    const struct nlmsghdr *nlh,
+				    uint64_t offset, uint16_t flags)
+{
+	struct nftnl_snapshot_entry *index;
+	uint32_t size;
+
+	if (w->num_msgs == w->size) {
+		size = w->size ? w->size * 2 : 1024;
+		index = realloc(w->index, size * sizeof(*index));
+		if (index == NULL)
+			return -1;
+
+		w->index = index;
+		w->size = size;
+	}
+
+	index = &w->index[w->num_msgs++];
+	memset(index, 0, sizeof(*index));
+	index->offset = offset;
+	index->len = nlh->nlmsg_len;
+	index->type = NFNL_MSG_TYPE(nlh->nlmsg_type);
+	index->flags = flags;
+
+	return 0;
+}
+
+/* Writes the pages of @batch out, indexing the messages on the way. */
+static int nftnl_snapshot_write_pages(struct nftnl_snapshot_writer *w,
+				      struct nftnl_batch *batch)
+{
+	const struct msghdr *msg = nftnl_batch_msghdr(batch);
+	const struct nlmsghdr *nlh;
+	uint16_t flags;
+	size_t i;
+	int len;
+
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		nlh = msg->msg_iov[i].iov_base;
+		len = msg->msg_iov[i].iov_len;
+		flags = NFTNL_SNAPSHOT_ENTRY_F_PAGE;
+		while (mnl_nlmsg_ok(nlh, len)) {
+			if (nftnl_snapshot_index_add(w, nlh, w->offset +
+				((char *)nlh -
+				 (char *)msg->msg_iov[i].iov_base),
+				flags) < 0)
+				return -1;
+
+			flags = 0;
+			nlh = mnl_nlmsg_next(nlh, &len);
+		}
+		/* Trailing bytes would not be covered by the index. */
+		if (len != 0) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		if (fwrite(msg->msg_iov[i].iov_base, 1,
+			   msg->msg_iov[i].iov_len, w->fp) !=
+		    msg->msg_iov[i].iov_len)
+			return -1;
+
+		w->offset += msg->msg_iov[i].iov_len;
+	}
+
+	return 0;
+}
+
+static int nftnl_snapshot_flush(struct nftnl_snapshot_writer *w)
+{
+	if (nftnl_snapshot_write_pages(w, w->batch) < 0)
+		return -1;
+
+	nftnl_batch_reset(w->batch);
+	return 0;
+}
+
+static int nftnl_snapshot_end(struct nftnl_snapshot_writer *w)
+{
+	if (nftnl_batch_update(w->batch) < 0)
+		return -1;
+
+	/* Full pages go to the file as soon as there are some. */
+	if (nftnl_batch_iovec_len(w->batch) > 1)
+		return nftnl_snapshot_flush(w);
+
+	return 0;
+}
+
+static int nftnl_snapshot_table_cb(struct nftnl_table *t, void *data)
+{
+	struct nftnl_snapshot_writer *w = data;
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(w->batch),
+				    NFT_MSG_NEWTABLE,
+				    nftnl_table_get_u32(t, NFTNL_TABLE_FAMILY),
+				    NLM_F_CREATE, 0);
+	nftnl_table_nlmsg_build_payload(nlh, t);
+
+	return nftnl_snapshot_end(w);
+}
+
+static int nftnl_snapshot_chain_cb(struct nftnl_chain *c, void *data)
+{
+	struct nftnl_snapshot_writer *w = data;
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(w->batch),
+				    NFT_MSG_NEWCHAIN,
+				    nftnl_chain_get_u32(c, NFTNL_CHAIN_FAMILY),
+				    NLM_F_CREATE, 0);
+	nftnl_chain_nlmsg_build_payload(nlh, c);
+
+	return nftnl_snapshot_end(w);
+}
+
+static int nftnl_snapshot_set_cb(struct nftnl_set *s, void *data)
+{
+	struct nftnl_snapshot_writer *w = data;
+	struct nlmsghdr *nlh;
+	uint32_t seq = 0;
+
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(w->batch),
+				    NFT_MSG_NEWSET, s->family, NLM_F_CREATE, 0);
+	nftnl_set_nlmsg_build_payload(nlh, s);
+	if (nftnl_snapshot_end(w) < 0)
+		return -1;
+
+	if (nftnl_set_elems_batch(w->batch, s, NFT_MSG_NEWSETELEM,
+				  NLM_F_CREATE, &seq) < 0)
+		return -1;
+
+	if (nftnl_batch_iovec_len(w->batch) > 1)
+		return nftnl_snapshot_flush(w);
+
+	return 0;
+}
+
+static int nftnl_snapshot_rule_cb(struct nftnl_rule *r, void *data)
+{
+	struct nftnl_snapshot_writer *w = data;
+	struct nlmsghdr *nlh;
+
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(w->batch),
+				    NFT_MSG_NEWRULE,
+				    nftnl_rule_get_u32(r, NFTNL_RULE_FAMILY),
+				    NLM_F_CREATE | NLM_F_APPEND, 0);
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+
+	return nftnl_snapshot_end(w);
+}
+
+static int nftnl_snapshot_write_index(struct nftnl_snapshot_writer *w)
+{
+	static const char pad[8];
+	struct nftnl_snapshot_trailer trailer = {
+		.magic	= NFTNL_SNAPSHOT_MAGIC,
+	};
+	size_t len;
+
+	/* Index entries are read in place, they have to be aligned. */
+	len = -w->offset & (sizeof(uint64_t) - 1);
+	if (fwrite(pad, 1, len, w->fp) != len)
+		return -1;
+
+	trailer.index_offset = w->offset + len;
+	trailer.num_msgs = w->num_msgs;
+
+	len = w->num_msgs * sizeof(*w->index);
+	if (fwrite(w->index, 1, len, w->fp) != len ||
+	    fwrite(&trailer, sizeof(trailer), 1, w->fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+static int nftnl_snapshot_write_hdr(FILE *fp)
+{
+	struct nftnl_snapshot_hdr hdr = {
+		.magic		= NFTNL_SNAPSHOT_MAGIC,
+		.version	= NFTNL_SNAPSHOT_VERSION,
+		.byteorder	= NFTNL_SNAPSHOT_BYTEORDER,
+	};
+
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+EXPORT_SYMBOL(nftnl_snapshot_write);
+int nftnl_snapshot_write(FILE *fp, const struct nftnl_ruleset *rs)
+{
+	struct nftnl_snapshot_writer w = {
+		.fp	= fp,
+		.offset	= sizeof(struct nftnl_snapshot_hdr),
+	};
+	struct nftnl_table_list *tl;
+	struct nftnl_chain_list *cl;
+	struct nftnl_set_list *sl;
+	struct nftnl_rule_list *rl;
+	int ret = -1;
+
+	/* Set elements are sent in messages of up to UINT16_MAX bytes. */
+	w.batch = nftnl_batch_alloc(getpagesize() * 32,
+				    UINT16_MAX + getpagesize());
+	if (w.batch == NULL)
+		return -1;
+
+	if (nftnl_snapshot_write_hdr(fp) < 0)
+		goto out;
+
+	tl = nftnl_ruleset_get(rs, NFTNL_RULESET_TABLELIST);
+	cl = nftnl_ruleset_get(rs, NFTNL_RULESET_CHAINLIST);
+	sl = nftnl_ruleset_get(rs, NFTNL_RULESET_SETLIST);
+	rl = nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST);
+
+	if ((tl && nftnl_table_list_foreach(tl, nftnl_snapshot_table_cb,
+					    &w) < 0) ||
+	    (cl && nftnl_chain_list_foreach(cl, nftnl_snapshot_chain_cb,
+					    &w) < 0) ||
+	    (sl && nftnl_set_list_foreach(sl, nftnl_snapshot_set_cb,
+					  &w) < 0) ||
+	    (rl && nftnl_rule_list_foreach(rl, nftnl_snapshot_rule_cb,
+					   &w) < 0))
+		goto out;
+
+	if (nftnl_snapshot_flush(&w) < 0 ||
+	    nftnl_snapshot_write_index(&w) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	xfree(w.index);
+	nftnl_batch_free(w.batch);
+	return ret;
+}
+
+/* Captures the messages in @batch as they would be sent to the kernel, one
+ * page after another. The batch is left untouched.
+ */
+EXPORT_SYMBOL(nftnl_snapshot_write_batch);
+int nftnl_snapshot_write_batch(FILE *fp, struct nftnl_batch *batch)
+{
+	struct nftnl_snapshot_writer w = {
+		.fp	= fp,
+		.offset	= sizeof(struct nftnl_snapshot_hdr),
+	};
+	int ret = -1;
+
+	if (nftnl_snapshot_write_hdr(fp) < 0 ||
+	    nftnl_snapshot_write_pages(&w, batch) < 0 ||
+	    nftnl_snapshot_write_index(&w) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	xfree(w.index);
+	return ret;
+}
+
+/* Checks the layout of the mapping and sets up the index of @snap. */
+static bool nftnl_snapshot_valid(struct nftnl_snapshot *snap)
+{
+	const struct nftnl_snapshot_hdr *hdr = (const void *)snap->data;
+	const struct nftnl_snapshot_trailer *trailer;
+	const struct nftnl_snapshot_entry *e;
+	uint64_t index_len, offset;
+	uint32_t i;
+
+	/* All parts of a snapshot are 64-bit aligned, the trailer can only be
+	 * read from a mapping of such length.
+	 */
+	if (snap->len < sizeof(*hdr) + sizeof(*trailer) ||
+	    snap->len % sizeof(uint64_t))
+		return false;
+
+	if (memcmp(hdr->magic, NFTNL_SNAPSHOT_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != NFTNL_SNAPSHOT_VERSION ||
+	    hdr->byteorder != NFTNL_SNAPSHOT_BYTEORDER)
+		return false;
+
+	trailer = (const void *)(snap->data + snap->len - sizeof(*trailer));
+	if (memcmp(trailer->magic, NFTNL_SNAPSHOT_MAGIC,
+		   sizeof(trailer->magic)))
+		return false;
+
+	/* The index must fill the room between its offset and the trailer. */
+	index_len = (uint64_t)trailer->num_msgs * sizeof(*e);
+	if (trailer->index_offset < sizeof(*hdr) ||
+	    trailer->index_offset % sizeof(uint64_t) ||
+	    trailer->index_offset > snap->len - sizeof(*trailer) ||
+	    snap->len - sizeof(*trailer) - trailer->index_offset != index_len)
+		return false;
+
+	/* Messages themselves are only checked once they are read. */
+	e = (const void *)(snap->data + trailer->index_offset);
+	offset = sizeof(*hdr);
+	for (i = 0; i < trailer->num_msgs; i++) {
+		if (e[i].offset != offset ||
+		    e[i].len < sizeof(struct nlmsghdr) ||
+		    e[i].offset + e[i].len > trailer->index_offset)
+			return false;
+
+		if (i == 0 && !(e[i].flags & NFTNL_SNAPSHOT_ENTRY_F_PAGE))
+			return false;
+		if (e[i].flags & NFTNL_SNAPSHOT_ENTRY_F_PAGE)
+			snap->num_pages++;
+
+		offset += NLMSG_ALIGN(e[i].len);
+	}
+	if (offset > trailer->index_offset)
+		return false;
+
+	snap->index = e;
+	snap->num_msgs = trailer->num_msgs;
+
+	return true;
+}
+
+/* Maps the snapshot in @fd. Objects are read from the mapping, as they are
+ * requested.
+ */
+EXPORT_SYMBOL(nftnl_snapshot_map);
+struct nftnl_snapshot *nftnl_snapshot_map(int fd)
+{
+	struct nftnl_snapshot *snap;
+	struct stat st;
+	void *data;
+
+	if (fstat(fd, &st) < 0)
+		return NULL;
+
+	if (st.st_size < (off_t)(sizeof(struct nftnl_snapshot_hdr) +
+				 sizeof(struct nftnl_snapshot_trailer))) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	snap = calloc(1, sizeof(struct nftnl_snapshot));
+	if (snap == NULL)
+		return NULL;
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		xfree(snap);
+		return NULL;
+	}
+	snap->data = data;
+	snap->len = st.st_size;
+
+	if (!nftnl_snapshot_valid(snap)) {
+		nftnl_snapshot_unmap(snap);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return snap;
+}
+
+EXPORT_SYMBOL(nftnl_snapshot_unmap);
+void nftnl_snapshot_unmap(struct nftnl_snapshot *snap)
+{
+	munmap((void *)snap->data, snap->len);
+	xfree(snap);
+}
+
+EXPORT_SYMBOL(nftnl_snapshot_num_msgs);
+uint32_t nftnl_snapshot_num_msgs(const struct nftnl_snapshot *snap)
+{
+	return snap->num_msgs;
+}
+
+/* Type of the message at @index, without reading the message. */
+EXPORT_SYMBOL(nftnl_snapshot_msg_type);
+uint16_t nftnl_snapshot_msg_type(const struct nftnl_snapshot *snap,
+				 uint32_t index)
+{
+	if (index >= snap->num_msgs)
+		return 0;
+
+	return snap->index[index].type;
+}
+
+/* The message at @index, in place. It is valid until the snapshot is
+ * unmapped.
+ */
+EXPORT_SYMBOL(nftnl_snapshot_msg);
+const struct nlmsghdr *nftnl_snapshot_msg(const struct nftnl_snapshot *snap,
+					  uint32_t index)
+{
+	const struct nftnl_snapshot_entry *e;
+	const struct nlmsghdr *nlh;
+
+	if (index >= snap->num_msgs) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	e = &snap->index[index];
+	nlh = (const void *)(snap->data + e->offset);
+	if (nlh->nlmsg_len != e->len ||
+	    NFNL_MSG_TYPE(nlh->nlmsg_type) != e->type) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return nlh;
+}
+
+/* Number of pages the messages were written from, see nftnl_snapshot_iovec().
+ */
+EXPORT_SYMBOL(nftnl_snapshot_iovec_len);
+int nftnl_snapshot_iovec_len(const struct nftnl_snapshot *snap)
+{
+	return snap->num_pages;
+}
+
+/* Same as nftnl_batch_iovec(), one iovec per page points to the messages in
+ * the mapping, so they can be sent again as they were captured.
+ */
+EXPORT_SYMBOL(nftnl_snapshot_iovec);
+void nftnl_snapshot_iovec(const struct nftnl_snapshot *snap, struct iovec *iov,
+			  uint32_t iovlen)
+{
+	const struct nftnl_snapshot_entry *e;
+	uint32_t i, n = 0;
+
+	for (i = 0; i < snap->num_msgs; i++) {
+		e = &snap->index[i];
+		if (e->flags & NFTNL_SNAPSHOT_ENTRY_F_PAGE) {
+			if (n == iovlen)
+				break;
+
+			iov[n].iov_base = (void *)(snap->data + e->offset);
+			iov[n].iov_len = 0;
+			n++;
+		}
+		iov[n - 1].iov_len += NLMSG_ALIGN(e->len);
+	}
+}
+
+/* Passes the objects in @snap to @cb, one message at a time, see
+ * nftnl_ruleset_nlmsg_parse_cb().
+ */
+EXPORT_SYMBOL(nftnl_snapshot_parse_cb);
+int nftnl_snapshot_parse_cb(const struct nftnl_snapshot *snap, void *data,
+			    int (*cb)(const struct nftnl_parse_ctx *ctx))
+{
+	const struct nlmsghdr *nlh;
+	uint32_t i;
+
+	for (i = 0; i < snap->num_msgs; i++) {
+		nlh = nftnl_snapshot_msg(snap, i);
+		if (nlh == NULL ||
+		    nftnl_ruleset_nlmsg_parse_cb(nlh, data, cb) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int nftnl_snapshot_lists_init(struct nftnl_ruleset *rs)
+{
+	if (nftnl_ruleset_get(rs, NFTNL_RULESET_TABLELIST) == NULL)
+		nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST,
+				  nftnl_table_list_alloc());
+	if (nftnl_ruleset_get(rs, NFTNL_RULESET_CHAINLIST) == NULL)
+		nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST,
+				  nftnl_chain_list_alloc());
+	if (nftnl_ruleset_get(rs, NFTNL_RULESET_SETLIST) == NULL)
+		nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST,
+				  nftnl_set_list_alloc());
+	if (nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST) == NULL)
+		nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST,
+				  nftnl_rule_list_alloc());
+
+	if (nftnl_ruleset_get(rs, NFTNL_RULESET_TABLELIST) == NULL ||
+	    nftnl_ruleset_get(rs, NFTNL_RULESET_CHAINLIST) == NULL ||
+	    nftnl_ruleset_get(rs, NFTNL_RULESET_SETLIST) == NULL ||
+	    nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST) == NULL)
+		return -1;
+
+	return 0;
+}
+
+static int nftnl_snapshot_table(struct nftnl_ruleset *rs,
+				const struct nlmsghdr *nlh)
+{
+	struct nftnl_table *t;
+
+	t = nftnl_table_alloc();
+	if (t == NULL)
+		return -1;
+
+	if (nftnl_table_nlmsg_parse(nlh, t) < 0) {
+		nftnl_table_free(t);
+		return -1;
+	}
+	nftnl_table_list_add_tail(t, nftnl_ruleset_get(rs,
+						NFTNL_RULESET_TABLELIST));
+	return 0;
+}
+
+static int nftnl_snapshot_chain(struct nftnl_ruleset *rs,
+				const struct nlmsghdr *nlh)
+{
+	struct nftnl_chain *c;
+
+	c = nftnl_chain_alloc();
+	if (c == NULL)
+		return -1;
+
+	if (nftnl_chain_nlmsg_parse(nlh, c) < 0) {
+		nftnl_chain_free(c);
+		return -1;
+	}
+	nftnl_chain_list_add_tail(c, nftnl_ruleset_get(rs,
+						NFTNL_RULESET_CHAINLIST));
+	return 0;
+}
+
+static int nftnl_snapshot_rule(struct nftnl_ruleset *rs,
+			       const struct nlmsghdr *nlh)
+{
+	struct nftnl_rule *r;
+
+	r = nftnl_rule_alloc();
+	if (r == NULL)
+		return -1;
+
+	if (nftnl_rule_nlmsg_parse(nlh, r) < 0) {
+		nftnl_rule_free(r);
+		return -1;
+	}
+	nftnl_rule_list_add_tail(r, nftnl_ruleset_get(rs,
+						NFTNL_RULESET_RULELIST));
+	return 0;
+}
+
+/* Sets are added to @rs once all their elements are read. */
+static void nftnl_snapshot_set_done(struct nftnl_ruleset *rs,
+				    struct nftnl_set **s)
+{
+	if (*s == NULL)
+		return;
+
+	nftnl_set_list_add_tail(*s, nftnl_ruleset_get(rs,
+						NFTNL_RULESET_SETLIST));
+	*s = NULL;
+}
+
+/* Adds all the objects of @snap to @rs. */
+EXPORT_SYMBOL(nftnl_snapshot_ruleset);
+int nftnl_snapshot_ruleset(const struct nftnl_snapshot *snap,
+			   struct nftnl_ruleset *rs)
+{
+	const struct nlmsghdr *nlh;
+	struct nftnl_set *s = NULL;
+	uint32_t i;
+	int ret;
+
+	if (nftnl_snapshot_lists_init(rs) < 0)
+		return -1;
+
+	for (i = 0; i < snap->num_msgs; i++) {
+		nlh = nftnl_snapshot_msg(snap, i);
+		if (nlh == NULL)
+			goto err;
+
+		if (snap->index[i].type == NFT_MSG_NEWSETELEM) {
+			if (s == NULL ||
+			    nftnl_set_elems_nlmsg_parse(nlh, s) < 0)
+				goto err;
+			continue;
+		}
+		nftnl_snapshot_set_done(rs, &s);
+
+		switch (snap->index[i].type) {
+		case NFT_MSG_NEWTABLE:
+			ret = nftnl_snapshot_table(rs, nlh);
+			break;
+		case NFT_MSG_NEWCHAIN:
+			ret = nftnl_snapshot_chain(rs, nlh);
+			break;
+		case NFT_MSG_NEWSET:
+			s = nftnl_set_alloc();
+			if (s == NULL)
+				return -1;
+			ret = nftnl_set_nlmsg_parse(nlh, s);
+			break;
+		case NFT_MSG_NEWRULE:
+			ret = nftnl_snapshot_rule(rs, nlh);
+			break;
+		default:
+			errno = EINVAL;
+			ret = -1;
+			break;
+		}
+		if (ret < 0)
+			goto err;
+	}
+	nftnl_snapshot_set_done(rs, &s);
+
+	return 0;
+err:
+	if (s != NULL)
+		nftnl_set_free(s);
+	return -1;
+}
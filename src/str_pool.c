@@ -0,0 +1,159 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "internal.h"
+#include "arena.h"
+#include "str_pool.h"
+
+struct nftnl_str_pool_entry {
+	struct hlist_node	hnode;
+	uint32_t		hash;
+	char			str[];
+};
+
+struct nftnl_str_pool {
+	struct nftnl_arena	*arena;
+	struct hlist_head	*buckets;
+	uint32_t		size;
+	uint32_t		count;
+};
+
+#define NFTNL_STR_POOL_HSIZE_MIN	64
+
+static __thread struct nftnl_str_pool *nftnl_str_pool_cur;
+
+EXPORT_SYMBOL(nftnl_str_pool_alloc);
+struct nftnl_str_pool *nftnl_str_pool_alloc(void)
+{
+	struct nftnl_str_pool *pool;
+
+	pool = calloc(1, sizeof(struct nftnl_str_pool));
+	if (pool == NULL)
+		return NULL;
+
+	pool->arena = nftnl_arena_alloc(NFTNL_ARENA_CHUNK_SIZE);
+	if (pool->arena == NULL)
+		goto err1;
+
+	pool->buckets = calloc(NFTNL_STR_POOL_HSIZE_MIN,
+			       sizeof(struct hlist_head));
+	if (pool->buckets == NULL)
+		goto err2;
+
+	pool->size = NFTNL_STR_POOL_HSIZE_MIN;
+
+	return pool;
+err2:
+	nftnl_arena_free(pool->arena);
+err1:
+	xfree(pool);
+	return NULL;
+}
+
+EXPORT_SYMBOL(nftnl_str_pool_free);
+void nftnl_str_pool_free(struct nftnl_str_pool *pool)
+{
+	if (nftnl_str_pool_cur == pool)
+		nftnl_str_pool_cur = NULL;
+
+	nftnl_arena_free(pool->arena);
+	xfree(pool->buckets);
+	xfree(pool);
+}
+
+/* Names parsed by the calling thread are interned in @pool from now on, pass
+ * NULL to stop. The pool must outlive the objects that refer to its strings.
+ */
+EXPORT_SYMBOL(nftnl_str_pool_attach);
+struct nftnl_str_pool *nftnl_str_pool_attach(struct nftnl_str_pool *pool)
+{
+	struct nftnl_str_pool *prev = nftnl_str_pool_cur;
+
+	nftnl_str_pool_cur = pool;
+
+	return prev;
+}
+
+static void nftnl_str_pool_resize(struct nftnl_str_pool *pool, uint32_t size)
+{
+	struct nftnl_str_pool_entry *entry;
+	struct hlist_node *pos, *n;
+	struct hlist_head *buckets;
+	uint32_t i;
+
+	/* If we cannot grow, keep going with a higher load factor. */
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return;
+
+	for (i = 0; i < pool->size; i++) {
+		hlist_for_each_entry_safe(entry, pos, n, &pool->buckets[i],
+					  hnode)
+			hlist_add_head(&entry->hnode,
+				       &buckets[entry->hash & (size - 1)]);
+	}
+	xfree(pool->buckets);
+
+	pool->buckets = buckets;
+	pool->size = size;
+}
+
+static const char *nftnl_str_pool_get(struct nftnl_str_pool *pool,
+				      const char *str)
+{
+	struct nftnl_str_pool_entry *entry;
+	size_t len = strlen(str);
+	struct hlist_node *pos;
+	uint32_t hash;
+
+	hash = nftnl_hash(str, len, 0);
+	hlist_for_each_entry(entry, pos, &pool->buckets[hash & (pool->size - 1)],
+			     hnode) {
+		if (entry->hash == hash && !strcmp(entry->str, str))
+			return entry->str;
+	}
+
+	entry = nftnl_arena_zalloc(pool->arena,
+				   sizeof(struct nftnl_str_pool_entry) + len + 1);
+	if (entry == NULL)
+		return NULL;
+
+	entry->hash = hash;
+	memcpy(entry->str, str, len);
+
+	if (pool->count >= pool->size)
+		nftnl_str_pool_resize(pool, pool->size * 2);
+
+	hlist_add_head(&entry->hnode, &pool->buckets[hash & (pool->size - 1)]);
+	pool->count++;
+
+	return entry->str;
+}
+
+const char *nftnl_str_intern(const char *str, uint32_t *interned,
+			     uint16_t attr)
+{
+	if (nftnl_str_pool_cur == NULL) {
+		*interned &= ~(1 << attr);
+		return strdup(str);
+	}
+
+	*interned |= (1 << attr);
+	return nftnl_str_pool_get(nftnl_str_pool_cur, str);
+}
+
+void nftnl_str_release(const char *str, uint32_t interned, uint16_t attr)
+{
+	if (interned & (1 << attr))
+		return;
+
+	xfree(str);
+}
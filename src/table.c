@@ -34,6 +34,7 @@ struct nftnl_table {
 	uint32_t	table_flags;
 	uint32_t	use;
 	uint32_t	flags;
+	uint32_t	interned;
 };
 
 EXPORT_SYMBOL(nftnl_table_alloc);
@@ -46,7 +47,7 @@ EXPORT_SYMBOL(nftnl_table_free);
 void nftnl_table_free(const struct nftnl_table *t)
 {
 	if (t->flags & (1 << NFTNL_TABLE_NAME))
-		xfree(t->name);
+		nftnl_str_release(t->name, t->interned, NFTNL_TABLE_NAME);
 
 	xfree(t);
 }
@@ -65,7 +66,7 @@ void nftnl_table_unset(struct nftnl_table *t, uint16_t attr)
 
 	switch (attr) {
 	case NFTNL_TABLE_NAME:
-		xfree(t->name);
+		nftnl_str_release(t->name, t->interned, NFTNL_TABLE_NAME);
 		break;
 	case NFTNL_TABLE_FLAGS:
 	case NFTNL_TABLE_FAMILY:
@@ -91,9 +92,10 @@ int nftnl_table_set_data(struct nftnl_table *t, uint16_t attr,
 	switch (attr) {
 	case NFTNL_TABLE_NAME:
 		if (t->flags & (1 << NFTNL_TABLE_NAME))
-			xfree(t->name);
+			nftnl_str_release(t->name, t->interned, NFTNL_TABLE_NAME);
 
 		t->name = strdup(data);
+		t->interned &= ~(1 << NFTNL_TABLE_NAME);
 		if (!t->name)
 			return -1;
 		break;
@@ -230,8 +232,9 @@ int nftnl_table_nlmsg_parse(const struct nlmsghdr *nlh, struct nftnl_table *t)
 
 	if (tb[NFTA_TABLE_NAME]) {
 		if (t->flags & (1 << NFTNL_TABLE_NAME))
-			xfree(t->name);
-		t->name = strdup(mnl_attr_get_str(tb[NFTA_TABLE_NAME]));
+			nftnl_str_release(t->name, t->interned, NFTNL_TABLE_NAME);
+		t->name = nftnl_str_intern(mnl_attr_get_str(tb[NFTA_TABLE_NAME]),
+						&t->interned, NFTNL_TABLE_NAME);
 		if (!t->name)
 			return -1;
 		t->flags |= (1 << NFTNL_TABLE_NAME);
@@ -240,35 +240,194 @@ int nftnl_fprintf(FILE *fp, const void *obj, uint32_t cmd, uint32_t type,
 				     uint32_t flags))
 {
 	char _buf[NFTNL_SNPRINTF_BUFSIZ];
-	char *buf = _buf;
-	size_t bufsiz = sizeof(_buf);
+	struct nftnl_buf b;
 	int ret;
 
-	ret = snprintf_cb(buf, bufsiz, obj, cmd, type, flags);
-	if (ret <= 0)
-		goto out;
+	nftnl_buf_init_file(&b, _buf, sizeof(_buf), fp);
+	ret = nftnl_buf_snprintf(&b, obj, cmd, type, flags, snprintf_cb);
+	if (ret > 0)
+		ret = nftnl_buf_flush(&b);
+	nftnl_buf_release(&b);
 
-	if (ret >= NFTNL_SNPRINTF_BUFSIZ) {
-		bufsiz = ret + 1;
+	return ret;
+}
 
-		buf = malloc(bufsiz);
-		if (buf == NULL)
-			return -1;
+/* Same as nftnl_fprintf(), for objects that are made of many others, which
+ * are streamed to @fp as they are formatted.
+ */
+int nftnl_fprintf_buf(FILE *fp, const void *obj, uint32_t cmd, uint32_t type,
+		      uint32_t flags,
+		      int (*buf_cb)(struct nftnl_buf *b, const void *obj,
+				    uint32_t cmd, uint32_t type,
+				    uint32_t flags))
+{
+	char _buf[NFTNL_SNPRINTF_BUFSIZ];
+	struct nftnl_buf b;
+	int ret;
 
-		ret = snprintf_cb(buf, bufsiz, obj, cmd, type, flags);
-		if (ret <= 0)
-			goto out;
-	}
+	nftnl_buf_init_file(&b, _buf, sizeof(_buf), fp);
+	ret = buf_cb(&b, obj, cmd, type, flags);
+	if (ret >= 0)
+		ret = nftnl_buf_flush(&b);
+	nftnl_buf_release(&b);
 
-	ret = fprintf(fp, "%s", buf);
+	return ret;
+}
 
-out:
-	if (buf != _buf)
-		xfree(buf);
+/* Formats @obj in one pass into a buffer that is allocated as it grows. On
+ * success, @buf is set to the nul-terminated output, to be released with
+ * free(), and its length is returned.
+ */
+int nftnl_asprintf_buf(char **buf, const void *obj, uint32_t cmd,
+		       uint32_t type, uint32_t flags,
+		       int (*buf_cb)(struct nftnl_buf *b, const void *obj,
+				     uint32_t cmd, uint32_t type,
+				     uint32_t flags))
+{
+	struct nftnl_buf b;
+	int ret;
 
+	nftnl_buf_init_alloc(&b);
+	ret = buf_cb(&b, obj, cmd, type, flags);
+	if (ret >= 0)
+		ret = nftnl_buf_flush(&b);
+	if (ret < 0) {
+		nftnl_buf_release(&b);
+		return -1;
+	}
+
+	*buf = b.buf;
 	return ret;
 }
 
+/* Formatters for the hot output paths, which print every word of every set
+ * element. They are table driven and write to @out without nul-terminating
+ * it, so callers assemble a token in a small stack buffer and hand it to
+ * nftnl_fmt_copy(), which has the same semantics as snprintf().
+ */
+static const char nftnl_hex_pairs[512] =
+	"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+	"202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+	"404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+	"606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+	"808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+	"a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+	"c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+	"e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static const char nftnl_dec_pairs[200] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/* Same as "%.8x", writes NFTNL_FMT_HEX32_LEN characters. */
+int nftnl_fmt_hex32(char *out, uint32_t val)
+{
+	memcpy(out, &nftnl_hex_pairs[(val >> 24) * 2], 2);
+	memcpy(out + 2, &nftnl_hex_pairs[((val >> 16) & 0xff) * 2], 2);
+	memcpy(out + 4, &nftnl_hex_pairs[((val >> 8) & 0xff) * 2], 2);
+	memcpy(out + 6, &nftnl_hex_pairs[(val & 0xff) * 2], 2);
+
+	return NFTNL_FMT_HEX32_LEN;
+}
+
+/* Same as "%"PRIu64, writes at most NFTNL_FMT_U64_LEN characters. */
+int nftnl_fmt_u64(char *out, uint64_t val)
+{
+	char tmp[NFTNL_FMT_U64_LEN];
+	char *p = tmp + sizeof(tmp);
+	int len;
+
+	while (val >= 100) {
+		p -= 2;
+		memcpy(p, &nftnl_dec_pairs[(val % 100) * 2], 2);
+		val /= 100;
+	}
+	if (val >= 10) {
+		p -= 2;
+		memcpy(p, &nftnl_dec_pairs[val * 2], 2);
+	} else {
+		*--p = '0' + val;
+	}
+
+	len = tmp + sizeof(tmp) - p;
+	memcpy(out, p, len);
+
+	return len;
+}
+
+int nftnl_fmt_copy(char *buf, size_t size, const char *str, int len)
+{
+	size_t n = len;
+
+	if (size == 0)
+		return len;
+
+	if (n >= size)
+		n = size - 1;
+	memcpy(buf, str, n);
+	buf[n] = '\0';
+
+	return len;
+}
+
+/* FNV-1a with a final avalanche so that the low bits, which are the ones
+ * used to pick a bucket, depend on every byte of the input.
+ */
+uint32_t nftnl_hash(const void *data, size_t len, uint32_t seed)
+{
+	const uint8_t *p = data;
+	uint32_t h = 2166136261U ^ seed;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/* 64-bit FNV-1a with the MurmurHash3 finalizer. The result only depends on
+ * the input, so hashes can be stored and compared across runs.
+ */
+uint64_t nftnl_hash64(const void *data, size_t len, uint64_t seed)
+{
+	const uint8_t *p = data;
+	uint64_t h = 14695981039346656037ULL ^ seed;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+/* Hash of an object that is identified by family, table and name. */
+uint32_t nftnl_name_hash(uint32_t family, const char *table, const char *name)
+{
+	uint32_t h;
+
+	h = nftnl_hash(table, strlen(table), family);
+	return nftnl_hash(name, strlen(name), h);
+}
+
 void __nftnl_assert_attr_exists(uint16_t attr, uint16_t attr_max,
 				const char *filename, int line)
 {
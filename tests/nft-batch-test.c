@@ -0,0 +1,194 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <linux/netfilter/nf_tables.h>
+#include <libmnl/libmnl.h>
+#include <libnftnl/common.h>
+#include <libnftnl/batch.h>
+#include <libnftnl/table.h>
+
+#define TEST_PAGE_SIZE	512
+#define TEST_NUM_MSGS	64
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static void fill_batch(struct nftnl_batch *batch, struct nftnl_table *t)
+{
+	struct nlmsghdr *nlh;
+	int i;
+
+	for (i = 0; i < TEST_NUM_MSGS; i++) {
+		nlh = nftnl_table_nlmsg_build_hdr(nftnl_batch_buffer(batch),
+						  NFT_MSG_NEWTABLE, AF_INET,
+						  NLM_F_CREATE, i);
+		nftnl_table_nlmsg_build_payload(nlh, t);
+		if (nftnl_batch_update(batch) < 0)
+			print_err("batch update failed");
+	}
+}
+
+static int iov_has_base(const struct iovec *iov, int iovlen, const void *base)
+{
+	int i;
+
+	for (i = 0; i < iovlen; i++) {
+		if (iov[i].iov_base == base)
+			return 1;
+	}
+	return 0;
+}
+
+static void test_batch_reset(struct nftnl_table *t)
+{
+	struct iovec iov1[TEST_NUM_MSGS], iov2[TEST_NUM_MSGS];
+	uint32_t seq[TEST_NUM_MSGS];
+	struct nftnl_batch *batch;
+	struct nlmsghdr *nlh;
+	int len1, len2, i;
+
+	batch = nftnl_batch_alloc(TEST_PAGE_SIZE, MNL_SOCKET_BUFFER_SIZE);
+	if (batch == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	fill_batch(batch, t);
+	len1 = nftnl_batch_iovec_len(batch);
+	if (len1 < 2)
+		print_err("batch did not span several pages");
+	nftnl_batch_iovec(batch, iov1, len1);
+	for (i = 0; i < len1; i++) {
+		nlh = iov1[i].iov_base;
+		seq[i] = nlh->nlmsg_seq;
+	}
+
+	nftnl_batch_reset(batch);
+	if (nftnl_batch_iovec_len(batch) != 0)
+		print_err("batch is not empty after reset");
+	if (nftnl_batch_buffer_len(batch) != 0)
+		print_err("first page is not empty after reset");
+
+	fill_batch(batch, t);
+	len2 = nftnl_batch_iovec_len(batch);
+	if (len1 != len2)
+		print_err("number of pages mismatches after reset");
+	nftnl_batch_iovec(batch, iov2, len2);
+
+	for (i = 0; i < len2; i++) {
+		if (!iov_has_base(iov1, len1, iov2[i].iov_base))
+			print_err("page was not recycled from the pool");
+		nlh = iov2[i].iov_base;
+		if (iov1[i].iov_len != iov2[i].iov_len ||
+		    nlh->nlmsg_seq != seq[i])
+			print_err("page content mismatches after reset");
+	}
+
+	/* Without a pool, pages beyond the first one are released. */
+	nftnl_batch_set_pool_size(batch, 0);
+	nftnl_batch_reset(batch);
+	fill_batch(batch, t);
+	if (nftnl_batch_iovec_len(batch) != len1)
+		print_err("number of pages mismatches with empty pool");
+
+	nftnl_batch_free(batch);
+}
+
+static void check_msghdr(const struct msghdr *msg, uint32_t max_page_len)
+{
+	const struct nlmsghdr *nlh;
+	uint32_t seq = 0;
+	int i, len;
+
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		if (msg->msg_iov[i].iov_len > max_page_len)
+			print_err("page is larger than expected");
+
+		nlh = msg->msg_iov[i].iov_base;
+		len = msg->msg_iov[i].iov_len;
+		while (mnl_nlmsg_ok(nlh, len)) {
+			if (nlh->nlmsg_seq != seq++)
+				print_err("message out of order");
+			nlh = mnl_nlmsg_next(nlh, &len);
+		}
+		if (len != 0)
+			print_err("page is not made of whole messages");
+	}
+	if (seq != TEST_NUM_MSGS)
+		print_err("wrong number of messages in msghdr");
+}
+
+static void test_batch_msghdr(struct nftnl_table *t, uint32_t flags)
+{
+	struct nftnl_batch *batch;
+	const struct msghdr *msg;
+	uint32_t max_page_len;
+
+	batch = nftnl_batch_alloc(TEST_PAGE_SIZE, MNL_SOCKET_BUFFER_SIZE);
+	if (batch == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_batch_set_flags(batch, flags);
+
+	max_page_len = TEST_PAGE_SIZE;
+	if (flags & NFTNL_BATCH_F_NOCOPY)
+		max_page_len += MNL_SOCKET_BUFFER_SIZE;
+
+	fill_batch(batch, t);
+	msg = nftnl_batch_msghdr(batch);
+	if (msg->msg_iovlen != nftnl_batch_iovec_len(batch))
+		print_err("msghdr does not cover all pages");
+	check_msghdr(msg, max_page_len);
+
+	nftnl_batch_reset(batch);
+	msg = nftnl_batch_msghdr(batch);
+	if (msg->msg_iovlen != 0)
+		print_err("msghdr is not empty after reset");
+
+	fill_batch(batch, t);
+	check_msghdr(nftnl_batch_msghdr(batch), max_page_len);
+
+	nftnl_batch_free(batch);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_table *t;
+
+	t = nftnl_table_alloc();
+	if (t == NULL)
+		print_err("OOM");
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "test");
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, AF_INET);
+
+	test_batch_reset(t);
+	test_batch_msghdr(t, 0);
+	test_batch_msghdr(t, NFTNL_BATCH_F_NOCOPY);
+
+	nftnl_table_free(t);
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
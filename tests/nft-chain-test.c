@@ -64,6 +64,98 @@ static void cmp_nftnl_chain(struct nftnl_chain *a, struct nftnl_chain *b)
 		print_err("Chain device mismatches");
 }
 
+#define TEST_NUM_CHAINS	200
+
+static void test_chain_list_lookup(void)
+{
+	struct nftnl_chain *c[TEST_NUM_CHAINS];
+	struct nftnl_chain_list *list;
+	char name[32];
+	int i;
+
+	list = nftnl_chain_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	/* Same chain names in two tables and two families. */
+	for (i = 0; i < TEST_NUM_CHAINS; i++) {
+		if (i == TEST_NUM_CHAINS / 2 &&
+		    nftnl_chain_list_hash_enable(list) < 0)
+			print_err("cannot enable chain list hash");
+
+		c[i] = nftnl_chain_alloc();
+		if (c[i] == NULL) {
+			print_err("OOM");
+			return;
+		}
+		snprintf(name, sizeof(name), "chain%d", i / 4);
+		nftnl_chain_set_str(c[i], NFTNL_CHAIN_NAME, name);
+		nftnl_chain_set_str(c[i], NFTNL_CHAIN_TABLE,
+				    i % 2 ? "filter" : "nat");
+		nftnl_chain_set_u32(c[i], NFTNL_CHAIN_FAMILY,
+				    i % 4 < 2 ? AF_INET : AF_INET6);
+		nftnl_chain_list_add_tail(c[i], list);
+	}
+
+	for (i = 0; i < TEST_NUM_CHAINS; i++) {
+		snprintf(name, sizeof(name), "chain%d", i / 4);
+		if (nftnl_chain_list_lookup_byname(list,
+				i % 4 < 2 ? AF_INET : AF_INET6,
+				i % 2 ? "filter" : "nat", name) != c[i])
+			print_err("chain lookup mismatches");
+	}
+	if (nftnl_chain_list_lookup_byname(list, AF_INET, "raw",
+					   "chain0") != NULL)
+		print_err("unexpected chain found");
+
+	nftnl_chain_list_del(c[0]);
+	if (nftnl_chain_list_lookup_byname(list, AF_INET, "nat",
+					   "chain0") != NULL)
+		print_err("deleted chain found");
+	nftnl_chain_free(c[0]);
+
+	/* Chains sharing a key are found in list order. */
+	c[0] = nftnl_chain_alloc();
+	if (c[0] == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_chain_set_str(c[0], NFTNL_CHAIN_NAME, "chain0");
+	nftnl_chain_set_str(c[0], NFTNL_CHAIN_TABLE, "filter");
+	nftnl_chain_set_u32(c[0], NFTNL_CHAIN_FAMILY, AF_INET);
+	nftnl_chain_list_add_tail(c[0], list);
+	if (nftnl_chain_list_lookup_byname(list, AF_INET, "filter",
+					   "chain0") != c[1])
+		print_err("appended duplicate chain found first");
+	nftnl_chain_list_del(c[0]);
+	nftnl_chain_list_add(c[0], list);
+	if (nftnl_chain_list_lookup_byname(list, AF_INET, "filter",
+					   "chain0") != c[0])
+		print_err("prepended duplicate chain not found first");
+
+	/* Deleted chains must not be accounted in the index anymore. */
+	for (i = 0; i < TEST_NUM_CHAINS * 100; i++) {
+		c[0] = nftnl_chain_alloc();
+		if (c[0] == NULL) {
+			print_err("OOM");
+			return;
+		}
+		nftnl_chain_set_str(c[0], NFTNL_CHAIN_NAME, "churn");
+		nftnl_chain_set_str(c[0], NFTNL_CHAIN_TABLE, "filter");
+		nftnl_chain_set_u32(c[0], NFTNL_CHAIN_FAMILY, AF_INET);
+		nftnl_chain_list_add_tail(c[0], list);
+		if (nftnl_chain_list_lookup_byname(list, AF_INET, "filter",
+						   "churn") != c[0])
+			print_err("chain lookup mismatches after churn");
+		nftnl_chain_list_del(c[0]);
+		nftnl_chain_free(c[0]);
+	}
+
+	nftnl_chain_list_free(list);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_chain *a, *b;
@@ -101,6 +193,8 @@ int main(int argc, char *argv[])
 	nftnl_chain_free(a);
 	nftnl_chain_free(b);
 
+	test_chain_list_lookup();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <netinet/in.h>
 #include <netinet/ip.h>
@@ -38,6 +39,38 @@ static void cmp_nftnl_expr(struct nftnl_expr *rule_a,
 		print_err("Expr NFTNL_EXPR_CTR_PACKETS mismatches");
 }
 
+static void check_counter_snprintf(uint64_t pkts, uint64_t bytes)
+{
+	char out[256], exp[256];
+	struct nftnl_expr *ex;
+	int len;
+
+	ex = nftnl_expr_alloc("counter");
+	if (ex == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_expr_set_u64(ex, NFTNL_EXPR_CTR_PACKETS, pkts);
+	nftnl_expr_set_u64(ex, NFTNL_EXPR_CTR_BYTES, bytes);
+
+	snprintf(exp, sizeof(exp), "pkts %"PRIu64" bytes %"PRIu64" ",
+		 pkts, bytes);
+	len = nftnl_expr_snprintf(out, sizeof(out), ex, NFTNL_OUTPUT_DEFAULT, 0);
+	if (len != strlen(exp) || strcmp(out, exp) != 0)
+		print_err("counter output mismatches");
+
+	snprintf(exp, sizeof(exp), "\"pkts\":%"PRIu64",\"bytes\":%"PRIu64,
+		 pkts, bytes);
+	/* The trailing comma is not part of the output, but it is left in
+	 * the buffer.
+	 */
+	len = nftnl_expr_snprintf(out, sizeof(out), ex, NFTNL_OUTPUT_JSON, 0);
+	if (len != strlen(exp) || strncmp(out, exp, len) != 0)
+		print_err("counter json output mismatches");
+
+	nftnl_expr_free(ex);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_rule *a, *b;
@@ -81,6 +114,12 @@ int main(int argc, char *argv[])
 	    nftnl_expr_iter_next(iter_b) != NULL)
 		print_err("More 1 expr.");
 
+	check_counter_snprintf(0, 0);
+	check_counter_snprintf(9, 10);
+	check_counter_snprintf(99, 100);
+	check_counter_snprintf(0x123456789abcdef0, 0xf0123456789abcde);
+	check_counter_snprintf(UINT64_MAX, 10000000000000000000ULL);
+
 	nftnl_expr_iter_destroy(iter_a);
 	nftnl_expr_iter_destroy(iter_b);
 	nftnl_rule_free(a);
@@ -0,0 +1,141 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+/* Time spent printing a large set and a long rule to /dev/null. Not part of
+ * the test suite, build it with "make nft-output-bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <libnftnl/set.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
+
+#define BENCH_NUM_ELEMS		1000000
+#define BENCH_NUM_EXPRS		100
+#define BENCH_NUM_RULES		10000
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Elements with a 4-word key and 2-word data. */
+static struct nftnl_set *bench_set(void)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+	struct nftnl_set_elem *e;
+	uint32_t key[4], data[2];
+	int i;
+
+	if (s == NULL)
+		return NULL;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "bench");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV6);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(key));
+	nftnl_set_set_u32(s, NFTNL_SET_DATA_LEN, sizeof(data));
+	nftnl_set_set_u32(s, NFTNL_SET_FLAGS, NFT_SET_MAP);
+
+	for (i = 0; i < BENCH_NUM_ELEMS; i++) {
+		key[0] = 0x20010db8;
+		key[1] = i;
+		key[2] = ~i;
+		key[3] = i * 2654435761u;
+		data[0] = i;
+		data[1] = ~i;
+
+		e = nftnl_set_elem_alloc();
+		if (e == NULL) {
+			nftnl_set_free(s);
+			return NULL;
+		}
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, key, sizeof(key));
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, data, sizeof(data));
+		nftnl_set_elem_add(s, e);
+	}
+
+	return s;
+}
+
+static struct nftnl_rule *bench_rule(void)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	struct nftnl_expr *e;
+	uint32_t data;
+	int i;
+
+	if (r == NULL)
+		return NULL;
+
+	nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, 1);
+
+	for (i = 0; i < BENCH_NUM_EXPRS; i++) {
+		data = i;
+		e = nftnl_expr_alloc("cmp");
+		if (e == NULL) {
+			nftnl_rule_free(r);
+			return NULL;
+		}
+		nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_SREG, NFT_REG_1);
+		nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+		nftnl_expr_set(e, NFTNL_EXPR_CMP_DATA, &data, sizeof(data));
+		nftnl_rule_add_expr(r, e);
+	}
+
+	return r;
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	double start;
+	FILE *fp;
+	int i;
+
+	fp = fopen("/dev/null", "w");
+	s = bench_set();
+	r = bench_rule();
+	if (fp == NULL || s == NULL || r == NULL) {
+		perror("bench");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now_ms();
+	nftnl_set_fprintf(fp, s, NFTNL_OUTPUT_DEFAULT, 0);
+	printf("set, text\t%8.0f ms\n", now_ms() - start);
+
+	start = now_ms();
+	nftnl_set_fprintf(fp, s, NFTNL_OUTPUT_JSON, 0);
+	printf("set, json\t%8.0f ms\n", now_ms() - start);
+
+	start = now_ms();
+	for (i = 0; i < BENCH_NUM_RULES; i++)
+		nftnl_rule_fprintf(fp, r, NFTNL_OUTPUT_JSON, 0);
+	printf("rule, json\t%8.0f ms\n", now_ms() - start);
+
+	nftnl_rule_free(r);
+	nftnl_set_free(s);
+	fclose(fp);
+
+	return EXIT_SUCCESS;
+}
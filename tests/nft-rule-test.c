@@ -11,10 +11,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
 #include <linux/netfilter/nf_tables.h>
+#include <libmnl/libmnl.h>
 #include <libnftnl/rule.h>
+#include <libnftnl/expr.h>
 #include <libnftnl/udata.h>
 
 static int test_ok = 1;
@@ -59,6 +64,786 @@ static void cmp_nftnl_rule(struct nftnl_rule *a, struct nftnl_rule *b)
 		print_err("Rule userdata mismatches");
 }
 
+static const char *test_exprs[] = { "payload", "cmp", "counter", "immediate" };
+
+static void add_test_exprs(struct nftnl_rule *r)
+{
+	struct nftnl_expr *e;
+	uint16_t port = htons(22);
+
+	e = nftnl_expr_alloc("payload");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_BASE,
+			   NFT_PAYLOAD_TRANSPORT_HEADER);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_DREG, NFT_REG_1);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_OFFSET, 2);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_PAYLOAD_LEN, sizeof(port));
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("cmp");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_SREG, NFT_REG_1);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+	nftnl_expr_set(e, NFTNL_EXPR_CMP_DATA, &port, sizeof(port));
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("counter");
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("immediate");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_IMM_DREG, NFT_REG_VERDICT);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_IMM_VERDICT, NF_ACCEPT);
+	nftnl_rule_add_expr(r, e);
+}
+
+/* Whether two readers of @r see the same expressions. */
+static bool shared_exprs(const struct nftnl_rule *r)
+{
+	struct nftnl_expr_iter *it1, *it2;
+	bool ret;
+
+	it1 = nftnl_expr_iter_create(r);
+	it2 = nftnl_expr_iter_create(r);
+	ret = it1 && it2 &&
+	      nftnl_expr_iter_next(it1) == nftnl_expr_iter_next(it2);
+	if (it1)
+		nftnl_expr_iter_destroy(it1);
+	if (it2)
+		nftnl_expr_iter_destroy(it2);
+
+	return ret;
+}
+
+static int nop_expr_cb(struct nftnl_expr *e, void *data)
+{
+	return 0;
+}
+
+static void test_rule_lazy(void)
+{
+	char buf1[4096] = {}, buf2[4096] = {};
+	struct nlmsghdr *nlh1, *nlh2;
+	struct nftnl_rule *a, *b, *c;
+	struct nftnl_expr_iter *iter;
+	struct nftnl_expr *e;
+	int i = 0;
+
+	a = nftnl_rule_alloc();
+	b = nftnl_rule_alloc();
+	c = nftnl_rule_alloc();
+	if (a == NULL || b == NULL || c == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_rule_set_str(a, NFTNL_RULE_TABLE, "table");
+	nftnl_rule_set_str(a, NFTNL_RULE_CHAIN, "chain");
+	nftnl_rule_set_u64(a, NFTNL_RULE_HANDLE, 10);
+	add_test_exprs(a);
+
+	nlh1 = nftnl_rule_nlmsg_build_hdr(buf1, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh1, a);
+
+	if (nftnl_rule_nlmsg_parse_lazy(nlh1, b) < 0)
+		print_err("lazy parsing problems");
+	if (nftnl_rule_nlmsg_parse(nlh1, c) < 0)
+		print_err("parsing problems");
+
+	/* Untouched expressions are built back as they were received. */
+	nlh2 = nftnl_rule_nlmsg_build_hdr(buf2, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh2, b);
+	if (nlh1->nlmsg_len != nlh2->nlmsg_len ||
+	    memcmp(nlh1, nlh2, nlh1->nlmsg_len) != 0)
+		print_err("lazy rule is not built back verbatim");
+
+	iter = nftnl_expr_iter_create(b);
+	if (iter == NULL) {
+		print_err("cannot decode lazy expressions");
+	} else {
+		while ((e = nftnl_expr_iter_next(iter)) != NULL) {
+			if (i >= 4 ||
+			    strcmp(nftnl_expr_get_str(e, NFTNL_EXPR_NAME),
+				   test_exprs[i]) != 0)
+				print_err("lazy expression mismatches");
+			i++;
+		}
+		nftnl_expr_iter_destroy(iter);
+	}
+	if (i != 4)
+		print_err("wrong number of lazy expressions");
+
+	if (!nftnl_rule_cmp(b, c))
+		print_err("lazy rule mismatches eager rule");
+
+	/* Const readers decode expressions for themselves, updates decode
+	 * them into the rule.
+	 */
+	if (shared_exprs(b))
+		print_err("lazy rule was updated by a reader");
+	nftnl_expr_foreach(b, nop_expr_cb, NULL);
+	if (!shared_exprs(b))
+		print_err("lazy rule was not decoded by an update");
+
+	nlh2 = nftnl_rule_nlmsg_build_hdr(buf2, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh2, b);
+	if (nlh1->nlmsg_len != nlh2->nlmsg_len ||
+	    memcmp(nlh1, nlh2, nlh1->nlmsg_len) != 0)
+		print_err("decoded lazy rule is not built back properly");
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+	nftnl_rule_free(c);
+}
+
+static int count_exprs(struct nlmsghdr *nlh, const char *last)
+{
+	struct nftnl_expr_iter *iter;
+	struct nftnl_expr *e, *prev = NULL;
+	struct nftnl_rule *r;
+	int n = 0;
+
+	r = nftnl_rule_alloc();
+	if (r == NULL)
+		return -1;
+	if (nftnl_rule_nlmsg_parse(nlh, r) < 0)
+		goto err;
+
+	iter = nftnl_expr_iter_create(r);
+	if (iter == NULL)
+		goto err;
+	while ((e = nftnl_expr_iter_next(iter)) != NULL) {
+		prev = e;
+		n++;
+	}
+	nftnl_expr_iter_destroy(iter);
+
+	if (prev == NULL ||
+	    strcmp(nftnl_expr_get_str(prev, NFTNL_EXPR_NAME), last) != 0)
+		goto err;
+
+	nftnl_rule_free(r);
+	return n;
+err:
+	nftnl_rule_free(r);
+	return -1;
+}
+
+/* Names of the expressions in @nlh, whether this library knows them or not. */
+static int expr_names(struct nlmsghdr *nlh, const char **names, int max)
+{
+	struct nlattr *attr, *elem, *nest;
+	int n = 0;
+
+	mnl_attr_for_each(attr, nlh, sizeof(struct nfgenmsg)) {
+		if (mnl_attr_get_type(attr) != NFTA_RULE_EXPRESSIONS)
+			continue;
+
+		mnl_attr_for_each_nested(elem, attr) {
+			mnl_attr_for_each_nested(nest, elem) {
+				if (mnl_attr_get_type(nest) == NFTA_EXPR_NAME &&
+				    n < max)
+					names[n++] = mnl_attr_get_str(nest);
+			}
+		}
+	}
+	return n;
+}
+
+static void test_rule_lazy_add_expr(void)
+{
+	char buf1[4096] = {}, buf2[4096] = {};
+	struct nlmsghdr *nlh1, *nlh2;
+	struct nlattr *nest, *nest2;
+	struct nftnl_rule *a, *b;
+	const char *names[4];
+
+	a = nftnl_rule_alloc();
+	b = nftnl_rule_alloc();
+	if (a == NULL || b == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_rule_set_str(a, NFTNL_RULE_TABLE, "table");
+	nftnl_rule_set_str(a, NFTNL_RULE_CHAIN, "chain");
+	add_test_exprs(a);
+
+	nlh1 = nftnl_rule_nlmsg_build_hdr(buf1, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh1, a);
+	if (nftnl_rule_nlmsg_parse_lazy(nlh1, b) < 0)
+		print_err("lazy parsing problems");
+
+	nftnl_rule_add_expr(b, nftnl_expr_alloc("counter"));
+	nlh2 = nftnl_rule_nlmsg_build_hdr(buf2, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh2, b);
+	if (count_exprs(nlh2, "counter") != 5)
+		print_err("expression added to lazy rule is not built");
+	nftnl_rule_free(b);
+
+	/* Received expressions that cannot be decoded. */
+	b = nftnl_rule_alloc();
+	if (b == NULL) {
+		print_err("OOM");
+		nftnl_rule_free(a);
+		return;
+	}
+	nlh1 = nftnl_rule_nlmsg_build_hdr(buf1, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	mnl_attr_put_strz(nlh1, NFTA_RULE_TABLE, "table");
+	mnl_attr_put_strz(nlh1, NFTA_RULE_CHAIN, "chain");
+	nest = mnl_attr_nest_start(nlh1, NFTA_RULE_EXPRESSIONS);
+	nest2 = mnl_attr_nest_start(nlh1, NFTA_LIST_ELEM);
+	mnl_attr_put_strz(nlh1, NFTA_EXPR_NAME, "unknown");
+	mnl_attr_nest_end(nlh1, nest2);
+	mnl_attr_nest_end(nlh1, nest);
+	if (nftnl_rule_nlmsg_parse_lazy(nlh1, b) < 0)
+		print_err("lazy parsing problems");
+
+	nftnl_rule_add_expr(b, nftnl_expr_alloc("counter"));
+	nlh2 = nftnl_rule_nlmsg_build_hdr(buf2, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh2, b);
+	if (expr_names(nlh2, names, 4) != 2 ||
+	    strcmp(names[0], "unknown") != 0 ||
+	    strcmp(names[1], "counter") != 0)
+		print_err("expression added to broken lazy rule is not built");
+
+	/* Once decoded, the expressions keep their order. */
+	nlh1 = nftnl_rule_nlmsg_build_hdr(buf1, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh1, a);
+	nftnl_rule_free(b);
+	b = nftnl_rule_alloc();
+	if (b == NULL) {
+		print_err("OOM");
+		nftnl_rule_free(a);
+		return;
+	}
+	if (nftnl_rule_nlmsg_parse_lazy(nlh1, b) < 0)
+		print_err("lazy parsing problems");
+	nftnl_rule_add_expr(b, nftnl_expr_alloc("log"));
+	nftnl_rule_add_expr(b, nftnl_expr_alloc("counter"));
+	nlh2 = nftnl_rule_nlmsg_build_hdr(buf2, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh2, b);
+	if (expr_names(nlh2, names, 4) != 4 ||
+	    strcmp(names[0], "payload") != 0 ||
+	    strcmp(names[3], "immediate") != 0 ||
+	    count_exprs(nlh2, "counter") != 6)
+		print_err("expressions added to lazy rule are out of order");
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+}
+
+static void test_expr_alloc_type(void)
+{
+	struct nftnl_expr *e1, *e2;
+	uint32_t type;
+
+	for (type = 0; type <= NFTNL_EXPR_TYPE_MAX; type++) {
+		e1 = nftnl_expr_alloc_type(type);
+		if (e1 == NULL) {
+			print_err("cannot allocate expression by type");
+			continue;
+		}
+		e2 = nftnl_expr_alloc(nftnl_expr_get_str(e1, NFTNL_EXPR_NAME));
+		if (e2 == NULL) {
+			print_err("cannot allocate expression by name");
+		} else {
+			if (strcmp(nftnl_expr_get_str(e1, NFTNL_EXPR_NAME),
+				   nftnl_expr_get_str(e2, NFTNL_EXPR_NAME)))
+				print_err("expression name mismatches");
+			nftnl_expr_free(e2);
+		}
+		nftnl_expr_free(e1);
+	}
+
+	if (nftnl_expr_alloc_type(NFTNL_EXPR_TYPE_MAX + 1) != NULL)
+		print_err("allocated expression of unknown type");
+	if (nftnl_expr_alloc("payloa") != NULL ||
+	    nftnl_expr_alloc("Payload") != NULL ||
+	    nftnl_expr_alloc("") != NULL)
+		print_err("allocated expression of unknown name");
+}
+
+static void test_rule_str_pool(void)
+{
+	struct nftnl_str_pool *pool;
+	struct nftnl_rule *a, *b, *c;
+	struct nlmsghdr *nlh;
+	char buf[4096];
+
+	pool = nftnl_str_pool_alloc();
+	a = nftnl_rule_alloc();
+	b = nftnl_rule_alloc();
+	c = nftnl_rule_alloc();
+	if (pool == NULL || a == NULL || b == NULL || c == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_rule_set_str(a, NFTNL_RULE_TABLE, "table");
+	nftnl_rule_set_str(a, NFTNL_RULE_CHAIN, "chain");
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh, a);
+
+	if (nftnl_str_pool_attach(pool) != NULL)
+		print_err("unexpected string pool attached");
+	if (nftnl_rule_nlmsg_parse(nlh, b) < 0 ||
+	    nftnl_rule_nlmsg_parse(nlh, c) < 0)
+		print_err("parsing problems");
+
+	if (nftnl_rule_get_str(b, NFTNL_RULE_TABLE) !=
+	    nftnl_rule_get_str(c, NFTNL_RULE_TABLE) ||
+	    nftnl_rule_get_str(b, NFTNL_RULE_CHAIN) !=
+	    nftnl_rule_get_str(c, NFTNL_RULE_CHAIN))
+		print_err("names are not interned");
+	if (strcmp(nftnl_rule_get_str(b, NFTNL_RULE_CHAIN), "chain"))
+		print_err("interned name mismatches");
+	if (!nftnl_rule_cmp(a, b))
+		print_err("rule with interned names mismatches");
+
+	/* Names set by the user are still owned by the rule. */
+	nftnl_rule_set_str(c, NFTNL_RULE_CHAIN, "other");
+	if (nftnl_rule_nlmsg_parse(nlh, c) < 0)
+		print_err("parsing problems");
+
+	if (nftnl_str_pool_attach(NULL) != pool)
+		print_err("wrong string pool attached");
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+	nftnl_rule_free(c);
+	nftnl_str_pool_free(pool);
+}
+
+#define TEST_NUM_RULES	300
+
+struct chain_walk {
+	uint64_t	prev;
+	int		n;
+};
+
+static int chain_walk_cb(struct nftnl_rule *r, void *data)
+{
+	struct chain_walk *w = data;
+
+	if (nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE) <= w->prev)
+		print_err("rules of chain are out of order");
+	w->prev = nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE);
+	w->n++;
+	return 0;
+}
+
+static int chain_del_cb(struct nftnl_rule *r, void *data)
+{
+	nftnl_rule_list_del(r);
+	nftnl_rule_free(r);
+	return 0;
+}
+
+static void test_rule_list_index(void)
+{
+	struct nftnl_rule *r[TEST_NUM_RULES], *found;
+	struct nftnl_rule_list *list;
+	struct chain_walk w;
+	char chain[32];
+	int i, pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		list = nftnl_rule_list_alloc();
+		if (list == NULL) {
+			print_err("OOM");
+			return;
+		}
+		if (pass && nftnl_rule_list_hash_enable(list) < 0)
+			print_err("cannot enable rule list hash");
+
+		for (i = 0; i < TEST_NUM_RULES; i++) {
+			r[i] = nftnl_rule_alloc();
+			if (r[i] == NULL) {
+				print_err("OOM");
+				return;
+			}
+			snprintf(chain, sizeof(chain), "chain%d", i % 3);
+			nftnl_rule_set_u32(r[i], NFTNL_RULE_FAMILY, AF_INET);
+			nftnl_rule_set_str(r[i], NFTNL_RULE_TABLE, "filter");
+			nftnl_rule_set_str(r[i], NFTNL_RULE_CHAIN, chain);
+			nftnl_rule_set_u64(r[i], NFTNL_RULE_HANDLE, i + 1);
+			nftnl_rule_list_add_tail(r[i], list);
+		}
+
+		for (i = 0; i < TEST_NUM_RULES; i++) {
+			found = nftnl_rule_list_lookup_byhandle(list, AF_INET,
+								"filter", i + 1);
+			if (found != r[i])
+				print_err("rule lookup by handle mismatches");
+		}
+		if (nftnl_rule_list_lookup_byhandle(list, AF_INET, "nat",
+						    1) != NULL ||
+		    nftnl_rule_list_lookup_byhandle(list, AF_INET6, "filter",
+						    1) != NULL)
+			print_err("unexpected rule found");
+
+		nftnl_rule_list_del(r[0]);
+		nftnl_rule_free(r[0]);
+		if (nftnl_rule_list_lookup_byhandle(list, AF_INET, "filter",
+						    1) != NULL)
+			print_err("deleted rule found");
+
+		memset(&w, 0, sizeof(w));
+		if (nftnl_rule_list_chain_foreach(list, AF_INET, "filter",
+						  "chain1", chain_walk_cb,
+						  &w) < 0 ||
+		    w.n != TEST_NUM_RULES / 3)
+			print_err("wrong rules in chain");
+		memset(&w, 0, sizeof(w));
+		nftnl_rule_list_chain_foreach(list, AF_INET, "filter",
+					      "chain0", chain_walk_cb, &w);
+		if (w.n != TEST_NUM_RULES / 3 - 1)
+			print_err("deleted rule still in chain");
+		memset(&w, 0, sizeof(w));
+		nftnl_rule_list_chain_foreach(list, AF_INET, "filter",
+					      "none", chain_walk_cb, &w);
+		if (w.n != 0)
+			print_err("rules found in missing chain");
+
+		/* Emptying a chain and filling it again. */
+		nftnl_rule_list_chain_foreach(list, AF_INET, "filter",
+					      "chain2", chain_del_cb, NULL);
+		memset(&w, 0, sizeof(w));
+		nftnl_rule_list_chain_foreach(list, AF_INET, "filter",
+					      "chain2", chain_walk_cb, &w);
+		if (w.n != 0)
+			print_err("rules left in emptied chain");
+
+		for (i = 0; i < TEST_NUM_RULES; i++) {
+			r[0] = nftnl_rule_alloc();
+			if (r[0] == NULL) {
+				print_err("OOM");
+				return;
+			}
+			nftnl_rule_set_u32(r[0], NFTNL_RULE_FAMILY, AF_INET);
+			nftnl_rule_set_str(r[0], NFTNL_RULE_TABLE, "filter");
+			nftnl_rule_set_str(r[0], NFTNL_RULE_CHAIN, "chain2");
+			nftnl_rule_set_u64(r[0], NFTNL_RULE_HANDLE, 1);
+			nftnl_rule_list_add_tail(r[0], list);
+
+			memset(&w, 0, sizeof(w));
+			nftnl_rule_list_chain_foreach(list, AF_INET, "filter",
+						      "chain2", chain_walk_cb,
+						      &w);
+			if (w.n != 1 ||
+			    nftnl_rule_list_lookup_byhandle(list, AF_INET,
+							    "filter",
+							    1) != r[0])
+				print_err("rule lookup mismatches after churn");
+
+			nftnl_rule_list_del(r[0]);
+			nftnl_rule_free(r[0]);
+		}
+
+		nftnl_rule_list_free(list);
+	}
+}
+
+#define TEST_NUM_EXPRS	16
+
+static void test_expr_cache(void)
+{
+	struct nftnl_expr *e[TEST_NUM_EXPRS];
+	uint64_t mallocs;
+	int i;
+
+	nftnl_expr_cache_set_size(TEST_NUM_EXPRS);
+
+	for (i = 0; i < TEST_NUM_EXPRS; i++) {
+		e[i] = nftnl_expr_alloc(i % 2 ? "payload" : "cmp");
+		if (e[i] == NULL) {
+			print_err("OOM");
+			return;
+		}
+		nftnl_expr_set_u32(e[i], NFTNL_EXPR_PAYLOAD_LEN, 4);
+	}
+	for (i = 0; i < TEST_NUM_EXPRS; i++)
+		nftnl_expr_free(e[i]);
+
+	if (nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_OBJS) != TEST_NUM_EXPRS)
+		print_err("released expressions are not cached");
+
+	mallocs = nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_MALLOC);
+	for (i = 0; i < TEST_NUM_EXPRS; i++) {
+		e[i] = nftnl_expr_alloc(i % 2 ? "cmp" : "payload");
+		if (e[i] == NULL) {
+			print_err("OOM");
+			return;
+		}
+		if (nftnl_expr_is_set(e[i], NFTNL_EXPR_PAYLOAD_LEN))
+			print_err("recycled expression is not clean");
+	}
+	if (nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_MALLOC) != mallocs)
+		print_err("cached expressions are not reused");
+	if (nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_OBJS) != 0)
+		print_err("wrong number of cached expressions");
+
+	for (i = 0; i < TEST_NUM_EXPRS; i++)
+		nftnl_expr_free(e[i]);
+
+	nftnl_expr_cache_set_size(0);
+	if (nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_OBJS) != 0)
+		print_err("cache is not empty after disabling it");
+}
+
+static pthread_barrier_t cache_barrier;
+
+static void *expr_cache_thread(void *data)
+{
+	struct nftnl_expr *e[TEST_NUM_EXPRS];
+	bool *disable = data;
+	int i;
+
+	for (i = 0; i < TEST_NUM_EXPRS; i++)
+		e[i] = nftnl_expr_alloc("cmp");
+	for (i = 0; i < TEST_NUM_EXPRS; i++)
+		nftnl_expr_free(e[i]);
+	if (nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_OBJS) != TEST_NUM_EXPRS)
+		print_err("expressions of thread are not cached");
+
+	if (!*disable)
+		return NULL;
+
+	/* Turned off by another thread. */
+	pthread_barrier_wait(&cache_barrier);
+	pthread_barrier_wait(&cache_barrier);
+	nftnl_expr_free(nftnl_expr_alloc("cmp"));
+	if (nftnl_expr_cache_get_u64(NFTNL_EXPR_CACHE_OBJS) != 0)
+		print_err("cache of thread is not empty after disabling it");
+
+	return NULL;
+}
+
+/* Expressions cached by exiting threads are released, which the leak
+ * checker of the sanitizers tells.
+ */
+static void test_expr_cache_threads(void)
+{
+	bool disable = false;
+	pthread_t thread;
+
+	nftnl_expr_cache_set_size(TEST_NUM_EXPRS);
+	pthread_create(&thread, NULL, expr_cache_thread, &disable);
+	pthread_join(thread, NULL);
+
+	disable = true;
+	pthread_barrier_init(&cache_barrier, NULL, 2);
+	pthread_create(&thread, NULL, expr_cache_thread, &disable);
+	pthread_barrier_wait(&cache_barrier);
+	nftnl_expr_cache_set_size(0);
+	pthread_barrier_wait(&cache_barrier);
+	pthread_join(thread, NULL);
+	pthread_barrier_destroy(&cache_barrier);
+}
+
+static void test_rule_hash(void)
+{
+	struct nftnl_rule *a, *b, *c;
+	struct nftnl_expr *e1, *e2;
+	struct nlmsghdr *nlh;
+	char buf[4096] = {};
+	uint16_t port = htons(23);
+
+	a = nftnl_rule_alloc();
+	b = nftnl_rule_alloc();
+	c = nftnl_rule_alloc();
+	if (a == NULL || b == NULL || c == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	add_test_exprs(a);
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh, a);
+	if (nftnl_rule_nlmsg_parse_lazy(nlh, b) < 0)
+		print_err("lazy parsing problems");
+
+	/* Only expressions are hashed. */
+	nftnl_rule_set_str(c, NFTNL_RULE_TABLE, "table");
+	nftnl_rule_set_u64(c, NFTNL_RULE_HANDLE, 10);
+	add_test_exprs(c);
+
+	if (nftnl_rule_hash(a) != nftnl_rule_hash(b) ||
+	    nftnl_rule_hash(a) != nftnl_rule_hash(c))
+		print_err("equal rules have different hashes");
+
+	e1 = nftnl_expr_alloc("cmp");
+	nftnl_expr_set_u32(e1, NFTNL_EXPR_CMP_SREG, NFT_REG_1);
+	nftnl_expr_set_u32(e1, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+	nftnl_expr_set(e1, NFTNL_EXPR_CMP_DATA, &port, sizeof(port));
+	nftnl_rule_add_expr(c, e1);
+	if (nftnl_rule_hash(a) == nftnl_rule_hash(c))
+		print_err("different rules have the same hash");
+
+	e2 = nftnl_expr_alloc("cmp");
+	nftnl_expr_set_u32(e2, NFTNL_EXPR_CMP_SREG, NFT_REG_1);
+	nftnl_expr_set_u32(e2, NFTNL_EXPR_CMP_OP, NFT_CMP_NEQ);
+	nftnl_expr_set(e2, NFTNL_EXPR_CMP_DATA, &port, sizeof(port));
+	if (nftnl_expr_hash(e1) == nftnl_expr_hash(e2))
+		print_err("different expressions have the same hash");
+	nftnl_expr_set_u32(e2, NFTNL_EXPR_CMP_OP, NFT_CMP_EQ);
+	if (!nftnl_expr_cmp(e1, e2) ||
+	    nftnl_expr_hash(e1) != nftnl_expr_hash(e2))
+		print_err("equal expressions have different hashes");
+	nftnl_expr_free(e2);
+
+	/* Attributes that are not set are not hashed. */
+	e1 = nftnl_expr_alloc("counter");
+	e2 = nftnl_expr_alloc("counter");
+	nftnl_expr_set_u64(e2, NFTNL_EXPR_CTR_BYTES, 0);
+	if (nftnl_expr_hash(e1) == nftnl_expr_hash(e2))
+		print_err("set attribute is not hashed");
+	nftnl_expr_set_u64(e1, NFTNL_EXPR_CTR_BYTES, 1);
+	if (nftnl_expr_cmp(e1, e2) ||
+	    nftnl_expr_hash(e1) == nftnl_expr_hash(e2))
+		print_err("counter bytes are not compared");
+	nftnl_expr_free(e1);
+	nftnl_expr_free(e2);
+
+	e1 = nftnl_expr_alloc("quota");
+	e2 = nftnl_expr_alloc("quota");
+	nftnl_expr_set_u64(e1, NFTNL_EXPR_QUOTA_BYTES, 100);
+	nftnl_expr_set_u64(e2, NFTNL_EXPR_QUOTA_BYTES, 100);
+	if (!nftnl_expr_cmp(e1, e2) ||
+	    nftnl_expr_hash(e1) != nftnl_expr_hash(e2))
+		print_err("equal quotas have different hashes");
+	nftnl_expr_set_u64(e2, NFTNL_EXPR_QUOTA_BYTES, 200);
+	if (nftnl_expr_cmp(e1, e2) ||
+	    nftnl_expr_hash(e1) == nftnl_expr_hash(e2))
+		print_err("quota bytes are not compared");
+	nftnl_expr_free(e1);
+	nftnl_expr_free(e2);
+
+	e1 = nftnl_expr_alloc("range");
+	e2 = nftnl_expr_alloc("range");
+	nftnl_expr_set_u32(e1, NFTNL_EXPR_RANGE_SREG, NFT_REG_1);
+	nftnl_expr_set(e1, NFTNL_EXPR_RANGE_FROM_DATA, &port, sizeof(port));
+	nftnl_expr_set_u32(e2, NFTNL_EXPR_RANGE_SREG, NFT_REG_1);
+	nftnl_expr_set(e2, NFTNL_EXPR_RANGE_FROM_DATA, &port, sizeof(port));
+	if (!nftnl_expr_cmp(e1, e2) ||
+	    nftnl_expr_hash(e1) != nftnl_expr_hash(e2))
+		print_err("equal ranges have different hashes");
+	port = htons(24);
+	nftnl_expr_set(e2, NFTNL_EXPR_RANGE_FROM_DATA, &port, sizeof(port));
+	if (nftnl_expr_cmp(e1, e2) ||
+	    nftnl_expr_hash(e1) == nftnl_expr_hash(e2))
+		print_err("range data is not compared");
+	nftnl_expr_free(e1);
+	nftnl_expr_free(e2);
+
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+	nftnl_rule_free(c);
+}
+
+static struct nftnl_expr *rule_expr(struct nftnl_rule *r, const char *name)
+{
+	struct nftnl_expr_iter *iter;
+	struct nftnl_expr *e;
+
+	iter = nftnl_expr_iter_create(r);
+	while ((e = nftnl_expr_iter_next(iter)) != NULL) {
+		if (strcmp(nftnl_expr_get_str(e, NFTNL_EXPR_NAME), name) == 0)
+			break;
+	}
+	nftnl_expr_iter_destroy(iter);
+
+	return e;
+}
+
+static void test_rule_tmpl(void)
+{
+	char buf[4096] = {}, ref[4096] = {};
+	struct nlmsghdr *nlh, *nlh_ref;
+	struct nftnl_rule_tmpl *t;
+	struct nftnl_rule *a, *b;
+	struct nftnl_expr *e;
+	uint16_t port = htons(80);
+	int data_hole, verdict_hole;
+
+	a = nftnl_rule_alloc();
+	b = nftnl_rule_alloc();
+	t = nftnl_rule_tmpl_alloc();
+	if (a == NULL || b == NULL || t == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	if (nftnl_rule_tmpl_nlmsg_build_payload(nlh, t) == 0)
+		print_err("template that was not built was used");
+
+	nftnl_rule_set_str(a, NFTNL_RULE_TABLE, "table");
+	nftnl_rule_set_str(a, NFTNL_RULE_CHAIN, "chain");
+	add_test_exprs(a);
+	data_hole = nftnl_rule_tmpl_add_hole(t, rule_expr(a, "cmp"),
+					     NFTNL_EXPR_CMP_DATA);
+	verdict_hole = nftnl_rule_tmpl_add_hole(t, rule_expr(a, "immediate"),
+						NFTNL_EXPR_IMM_VERDICT);
+	if (nftnl_rule_tmpl_build(t, a) < 0)
+		print_err("cannot build rule template");
+	if (nftnl_expr_get_u16(rule_expr(a, "cmp"),
+			       NFTNL_EXPR_CMP_DATA) != htons(22) ||
+	    nftnl_expr_get_u32(rule_expr(a, "immediate"),
+			       NFTNL_EXPR_IMM_VERDICT) != NF_ACCEPT)
+		print_err("hole values are not restored");
+
+	/* Unpatched holes keep the values of the rule. */
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	if (nftnl_rule_tmpl_nlmsg_build_payload(nlh, t) < 0)
+		print_err("cannot use rule template");
+	nlh_ref = nftnl_rule_nlmsg_build_hdr(ref, NFT_MSG_NEWRULE, AF_INET, 0, 1);
+	nftnl_rule_nlmsg_build_payload(nlh_ref, a);
+	if (nlh->nlmsg_len != nlh_ref->nlmsg_len ||
+	    memcmp(nlh, nlh_ref, nlh->nlmsg_len) != 0)
+		print_err("template mismatches rule");
+
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 2);
+	if (nftnl_rule_tmpl_nlmsg_build_payload(nlh, t) < 0)
+		print_err("cannot use rule template");
+	if (nftnl_rule_tmpl_nlmsg_patch(nlh, t, data_hole,
+					&port, sizeof(port)) < 0 ||
+	    nftnl_rule_tmpl_nlmsg_patch_u32(nlh, t, verdict_hole, NF_DROP) < 0)
+		print_err("cannot patch rule template");
+	if (nftnl_rule_tmpl_nlmsg_patch_u32(nlh, t, data_hole, 0) == 0)
+		print_err("hole patched with a value of the wrong size");
+
+	nftnl_expr_set(rule_expr(a, "cmp"), NFTNL_EXPR_CMP_DATA,
+		       &port, sizeof(port));
+	nftnl_expr_set_u32(rule_expr(a, "immediate"), NFTNL_EXPR_IMM_VERDICT,
+			   NF_DROP);
+	nlh_ref = nftnl_rule_nlmsg_build_hdr(ref, NFT_MSG_NEWRULE, AF_INET, 0, 2);
+	nftnl_rule_nlmsg_build_payload(nlh_ref, a);
+	if (nlh->nlmsg_len != nlh_ref->nlmsg_len ||
+	    memcmp(nlh, nlh_ref, nlh->nlmsg_len) != 0)
+		print_err("patched template mismatches rule");
+
+	if (nftnl_rule_nlmsg_parse(nlh, b) < 0 || !nftnl_rule_cmp(a, b))
+		print_err("patched template does not parse back");
+
+	/* Strings have no fixed size. */
+	e = nftnl_expr_alloc("log");
+	nftnl_expr_set_str(e, NFTNL_EXPR_LOG_PREFIX, "test");
+	nftnl_rule_add_expr(a, e);
+	nftnl_rule_tmpl_add_hole(t, e, NFTNL_EXPR_LOG_PREFIX);
+	if (nftnl_rule_tmpl_build(t, a) == 0)
+		print_err("string attribute accepted as a hole");
+	if (strcmp(nftnl_expr_get_str(e, NFTNL_EXPR_LOG_PREFIX), "test") != 0)
+		print_err("string attribute is not restored");
+	if (nftnl_rule_tmpl_nlmsg_patch_u32(nlh, t, verdict_hole, NF_DROP) == 0)
+		print_err("template that failed to build was patched");
+	nlh = nftnl_rule_nlmsg_build_hdr(buf, NFT_MSG_NEWRULE, AF_INET, 0, 3);
+	if (nftnl_rule_tmpl_nlmsg_build_payload(nlh, t) == 0)
+		print_err("template that failed to build was used");
+
+	nftnl_rule_tmpl_free(t);
+	nftnl_rule_free(a);
+	nftnl_rule_free(b);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_udata_buf *udata;
@@ -100,6 +885,17 @@ int main(int argc, char *argv[])
 
 	nftnl_rule_free(a);
 	nftnl_rule_free(b);
+
+	test_rule_lazy();
+	test_rule_lazy_add_expr();
+	test_rule_str_pool();
+	test_rule_list_index();
+	test_expr_alloc_type();
+	test_expr_cache();
+	test_expr_cache_threads();
+	test_rule_hash();
+	test_rule_tmpl();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
@@ -0,0 +1,1166 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <libmnl/libmnl.h>
+#include <libnftnl/common.h>
+#include <libnftnl/ruleset.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static char buf[8192];
+
+static struct nlmsghdr *msg_hdr(uint16_t type, bool dump, uint16_t res_id)
+{
+	struct nlmsghdr *nlh;
+	struct nfgenmsg *nfg;
+
+	nlh = nftnl_nlmsg_build_hdr(buf, type, NFPROTO_IPV4,
+				    dump ? NLM_F_MULTI : 0, 0);
+	nfg = mnl_nlmsg_get_payload(nlh);
+	nfg->res_id = htons(res_id);
+
+	return nlh;
+}
+
+static int apply(struct nftnl_ruleset *rs, struct nlmsghdr *nlh)
+{
+	int ret;
+
+	ret = nftnl_ruleset_nlmsg_apply(rs, nlh);
+	if (ret < 0 && errno != ESTALE)
+		print_err("cannot apply message");
+
+	return ret;
+}
+
+static void apply_gen(struct nftnl_ruleset *rs, uint32_t id)
+{
+	struct nlmsghdr *nlh = msg_hdr(NFT_MSG_NEWGEN, false, id);
+
+	mnl_attr_put_u32(nlh, NFTA_GEN_ID, htonl(id));
+	if (apply(rs, nlh) < 0)
+		print_err("cannot apply generation");
+}
+
+static void apply_table(struct nftnl_ruleset *rs, uint16_t type, bool dump,
+			uint16_t res_id)
+{
+	struct nftnl_table *t = nftnl_table_alloc();
+
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_nlmsg_build_payload(msg_hdr(type, dump, res_id), t);
+	apply(rs, (struct nlmsghdr *)buf);
+	nftnl_table_free(t);
+}
+
+static void apply_chain(struct nftnl_ruleset *rs, uint16_t type, bool dump,
+			uint16_t res_id, const char *name)
+{
+	struct nftnl_chain *c = nftnl_chain_alloc();
+
+	nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+	nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, name);
+	nftnl_chain_nlmsg_build_payload(msg_hdr(type, dump, res_id), c);
+	apply(rs, (struct nlmsghdr *)buf);
+	nftnl_chain_free(c);
+}
+
+static int apply_rule(struct nftnl_ruleset *rs, uint16_t type, bool dump,
+		      uint16_t res_id, const char *chain, uint64_t handle,
+		      uint64_t position)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+	int ret;
+
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, chain);
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle);
+	if (position)
+		nftnl_rule_set_u64(r, NFTNL_RULE_POSITION, position);
+	nftnl_rule_nlmsg_build_payload(msg_hdr(type, dump, res_id), r);
+	ret = apply(rs, (struct nlmsghdr *)buf);
+	nftnl_rule_free(r);
+
+	return ret;
+}
+
+static void apply_set(struct nftnl_ruleset *rs, uint16_t type, bool dump,
+		      uint16_t res_id, uint32_t key)
+{
+	struct nftnl_set_elem *e;
+	struct nftnl_set *s = nftnl_set_alloc();
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "blacklist");
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(key));
+	if (type == NFT_MSG_NEWSET) {
+		nftnl_set_nlmsg_build_payload(msg_hdr(type, dump, res_id), s);
+	} else {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+		nftnl_set_elem_add(s, e);
+		nftnl_set_elems_nlmsg_build_payload(msg_hdr(type, dump, res_id),
+						    s);
+	}
+	apply(rs, (struct nlmsghdr *)buf);
+	nftnl_set_free(s);
+}
+
+static void apply_interval(struct nftnl_ruleset *rs, uint16_t type,
+			   uint16_t res_id, uint32_t key, bool end)
+{
+	struct nftnl_set_elem *e;
+	struct nftnl_set *s = nftnl_set_alloc();
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "blacklist");
+	e = nftnl_set_elem_alloc();
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	if (end)
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_FLAGS,
+				       NFT_SET_ELEM_INTERVAL_END);
+	nftnl_set_elem_add(s, e);
+	nftnl_set_elems_nlmsg_build_payload(msg_hdr(type, false, res_id), s);
+	apply(rs, (struct nlmsghdr *)buf);
+	nftnl_set_free(s);
+}
+
+struct chain_walk {
+	uint64_t	handles[8];
+	int		n;
+};
+
+static int chain_walk_cb(struct nftnl_rule *r, void *data)
+{
+	struct chain_walk *w = data;
+
+	if (w->n < 8)
+		w->handles[w->n] = nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE);
+	w->n++;
+	return 0;
+}
+
+static void check_chain(struct nftnl_ruleset *rs, const char *chain,
+			const uint64_t *handles, int n)
+{
+	struct chain_walk w = {};
+
+	nftnl_rule_list_chain_foreach(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_RULELIST),
+				      NFPROTO_IPV4, "filter", chain,
+				      chain_walk_cb, &w);
+	if (w.n != n ||
+	    (n && memcmp(w.handles, handles, n * sizeof(*handles))))
+		print_err("rules of chain mismatch");
+}
+
+struct interval_walk {
+	uint32_t	key;
+	int		starts;
+	int		ends;
+};
+
+static int interval_walk_cb(struct nftnl_set_elem *e, void *data)
+{
+	struct interval_walk *w = data;
+	uint32_t len;
+
+	if (*(uint32_t *)nftnl_set_elem_get(e, NFTNL_SET_ELEM_KEY, &len) !=
+	    w->key)
+		return 0;
+
+	if (nftnl_set_elem_is_set(e, NFTNL_SET_ELEM_FLAGS) &&
+	    nftnl_set_elem_get_u32(e, NFTNL_SET_ELEM_FLAGS) &
+	    NFT_SET_ELEM_INTERVAL_END)
+		w->ends++;
+	else
+		w->starts++;
+	return 0;
+}
+
+static void check_interval(struct nftnl_ruleset *rs, uint32_t key,
+			   int starts, int ends)
+{
+	struct interval_walk w = { .key = key };
+	struct nftnl_set *s;
+
+	s = nftnl_set_list_lookup_byname(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_SETLIST),
+					 "blacklist");
+	if (s != NULL)
+		nftnl_set_elem_foreach(s, interval_walk_cb, &w);
+	if (w.starts != starts || w.ends != ends)
+		print_err("interval elements mismatch");
+}
+
+static bool has_elem(struct nftnl_ruleset *rs, uint32_t key)
+{
+	struct nftnl_set *s;
+
+	s = nftnl_set_list_lookup_byname(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_SETLIST),
+					 "blacklist");
+	return s && nftnl_set_elem_lookup(s, &key, sizeof(key));
+}
+
+static struct nftnl_rule *diff_rule(uint64_t handle, const char *chain,
+				    const char *udata, const char *expr)
+{
+	struct nftnl_rule *r = nftnl_rule_alloc();
+
+	nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, chain);
+	if (handle)
+		nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, handle);
+	if (udata)
+		nftnl_rule_set_data(r, NFTNL_RULE_USERDATA, udata,
+				    strlen(udata));
+	nftnl_rule_add_expr(r, nftnl_expr_alloc(expr));
+
+	return r;
+}
+
+static struct nftnl_ruleset *diff_ruleset(const char **chains,
+					  uint32_t policy,
+					  const uint32_t *keys, int num_keys)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_chain_list *cl = nftnl_chain_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_set_elem *e;
+	struct nftnl_table *t;
+	struct nftnl_chain *c;
+	struct nftnl_set *s;
+	int i;
+
+	t = nftnl_table_alloc();
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_list_add_tail(t, tl);
+
+	for (i = 0; chains[i]; i++) {
+		c = nftnl_chain_alloc();
+		nftnl_chain_set_u32(c, NFTNL_CHAIN_FAMILY, NFPROTO_IPV4);
+		nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+		nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, chains[i]);
+		if (i == 0) {
+			nftnl_chain_set_u32(c, NFTNL_CHAIN_HOOKNUM,
+					    NF_INET_LOCAL_IN);
+			nftnl_chain_set_s32(c, NFTNL_CHAIN_PRIO, 0);
+			nftnl_chain_set_str(c, NFTNL_CHAIN_TYPE, "filter");
+			nftnl_chain_set_u32(c, NFTNL_CHAIN_POLICY, policy);
+		}
+		nftnl_chain_list_add_tail(c, cl);
+	}
+
+	s = nftnl_set_alloc();
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "blacklist");
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	for (i = 0; i < num_keys; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &keys[i],
+				   sizeof(uint32_t));
+		nftnl_set_elem_add(s, e);
+	}
+	nftnl_set_list_add_tail(s, sl);
+
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST, cl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST,
+			  nftnl_rule_list_alloc());
+
+	return rs;
+}
+
+struct diff_msg {
+	uint16_t	type;
+	uint16_t	flags;
+	uint64_t	handle;
+	uint64_t	position;
+};
+
+static void check_diff(struct nftnl_batch *batch, int num_msgs,
+		       const struct diff_msg *msgs, int num_expected)
+{
+	struct iovec iov[8];
+	struct nftnl_rule *r;
+	struct nlmsghdr *nlh;
+	int i, len, iovlen, n = 0;
+
+	if (num_msgs != num_expected)
+		print_err("wrong number of diff messages");
+
+	iovlen = nftnl_batch_iovec_len(batch);
+	nftnl_batch_iovec(batch, iov, 8);
+	for (i = 0; i < iovlen; i++) {
+		nlh = iov[i].iov_base;
+		len = iov[i].iov_len;
+		for (; mnl_nlmsg_ok(nlh, len); nlh = mnl_nlmsg_next(nlh, &len),
+					       n++) {
+			if (n >= num_expected ||
+			    NFNL_MSG_TYPE(nlh->nlmsg_type) != msgs[n].type ||
+			    (nlh->nlmsg_flags & ~NLM_F_REQUEST) !=
+			    msgs[n].flags) {
+				print_err("unexpected diff message");
+				continue;
+			}
+			if (msgs[n].type != NFT_MSG_NEWRULE &&
+			    msgs[n].type != NFT_MSG_DELRULE)
+				continue;
+
+			r = nftnl_rule_alloc();
+			nftnl_rule_nlmsg_parse(nlh, r);
+			if (nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE) !=
+			    msgs[n].handle ||
+			    nftnl_rule_get_u64(r, NFTNL_RULE_POSITION) !=
+			    msgs[n].position)
+				print_err("wrong rule in diff message");
+			nftnl_rule_free(r);
+		}
+	}
+	if (n != num_expected)
+		print_err("diff messages mismatch");
+}
+
+static void test_ruleset_diff(void)
+{
+	static const char *cur_chains[] = { "input", "output", "old", NULL };
+	static const char *want_chains[] = { "input", "output", NULL };
+	static const struct diff_msg msgs[] = {
+		{ NFT_MSG_NEWCHAIN,	NLM_F_CREATE },
+		{ NFT_MSG_DELSETELEM,	0 },
+		{ NFT_MSG_NEWSETELEM,	NLM_F_CREATE },
+		{ NFT_MSG_NEWRULE,	NLM_F_CREATE, 0, 3 },
+		{ NFT_MSG_NEWRULE,	NLM_F_REPLACE, 4, 0 },
+		{ NFT_MSG_NEWRULE,	NLM_F_CREATE | NLM_F_APPEND, 0, 0 },
+		{ NFT_MSG_DELRULE,	0, 5, 0 },
+		{ NFT_MSG_DELRULE,	0, 0, 0 },
+		{ NFT_MSG_DELCHAIN,	0 },
+	};
+	struct nftnl_ruleset *cur, *want;
+	struct nftnl_rule_list *rl;
+	struct nftnl_batch *batch;
+	uint32_t seq = 0;
+
+	cur = diff_ruleset(cur_chains, NF_ACCEPT, (uint32_t []){ 1, 2 }, 2);
+	rl = nftnl_ruleset_get(cur, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule(2, "input", "a", "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(3, "input", NULL, "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(4, "input", "c", "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(5, "output", NULL, "counter"), rl);
+
+	want = diff_ruleset(want_chains, NF_DROP, (uint32_t []){ 2, 3 }, 2);
+	rl = nftnl_ruleset_get(want, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule(0, "input", "a", "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(0, "input", NULL, "log"), rl);
+	nftnl_rule_list_add_tail(diff_rule(0, "input", NULL, "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(0, "input", "c", "log"), rl);
+	nftnl_rule_list_add_tail(diff_rule(0, "input", NULL, "log"), rl);
+
+	batch = nftnl_batch_alloc(MNL_SOCKET_BUFFER_SIZE,
+				  MNL_SOCKET_BUFFER_SIZE);
+	check_diff(batch, nftnl_ruleset_diff_batch(batch, cur, want, &seq),
+		   msgs, sizeof(msgs) / sizeof(msgs[0]));
+	if (seq != sizeof(msgs) / sizeof(msgs[0]))
+		print_err("sequence number not updated by diff");
+
+	/* Nothing to do if the ruleset is already in place. */
+	nftnl_batch_reset(batch);
+	if (nftnl_ruleset_diff_batch(batch, cur, cur, &seq) != 0 ||
+	    nftnl_batch_buffer_len(batch) != 0)
+		print_err("diff of a ruleset with itself is not empty");
+
+	nftnl_batch_free(batch);
+	nftnl_ruleset_free(cur);
+	nftnl_ruleset_free(want);
+}
+
+static struct nftnl_rule *diff_rule_stateful(uint64_t handle, uint64_t bytes)
+{
+	struct nftnl_rule *r = diff_rule(handle, "input", NULL, "counter");
+	uint16_t from = htons(1024), to = htons(2048);
+	struct nftnl_expr *e;
+
+	e = nftnl_expr_alloc("quota");
+	nftnl_expr_set_u64(e, NFTNL_EXPR_QUOTA_BYTES, bytes);
+	nftnl_rule_add_expr(r, e);
+
+	e = nftnl_expr_alloc("range");
+	nftnl_expr_set_u32(e, NFTNL_EXPR_RANGE_SREG, NFT_REG_1);
+	nftnl_expr_set_u32(e, NFTNL_EXPR_RANGE_OP, NFT_RANGE_EQ);
+	nftnl_expr_set(e, NFTNL_EXPR_RANGE_FROM_DATA, &from, sizeof(from));
+	nftnl_expr_set(e, NFTNL_EXPR_RANGE_TO_DATA, &to, sizeof(to));
+	nftnl_rule_add_expr(r, e);
+
+	return r;
+}
+
+/* Rules are matched by their expressions, whatever these are. */
+static void test_ruleset_diff_exprs(void)
+{
+	static const char *chains[] = { "input", NULL };
+	static const struct diff_msg msgs[] = {
+		{ NFT_MSG_DELRULE,	0, 6, 0 },
+		{ NFT_MSG_NEWRULE,	NLM_F_CREATE | NLM_F_APPEND, 0, 0 },
+	};
+	struct nftnl_ruleset *cur, *want;
+	struct nftnl_rule_list *rl;
+	struct nftnl_batch *batch;
+	uint32_t seq = 0;
+
+	cur = diff_ruleset(chains, NF_ACCEPT, NULL, 0);
+	rl = nftnl_ruleset_get(cur, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule_stateful(5, 100), rl);
+	nftnl_rule_list_add_tail(diff_rule_stateful(6, 200), rl);
+
+	want = diff_ruleset(chains, NF_ACCEPT, NULL, 0);
+	rl = nftnl_ruleset_get(want, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule_stateful(0, 100), rl);
+	nftnl_rule_list_add_tail(diff_rule_stateful(0, 300), rl);
+
+	batch = nftnl_batch_alloc(MNL_SOCKET_BUFFER_SIZE,
+				  MNL_SOCKET_BUFFER_SIZE);
+	check_diff(batch, nftnl_ruleset_diff_batch(batch, cur, want, &seq),
+		   msgs, sizeof(msgs) / sizeof(msgs[0]));
+
+	nftnl_batch_free(batch);
+	nftnl_ruleset_free(cur);
+	nftnl_ruleset_free(want);
+}
+
+static struct nftnl_ruleset *diff_ruleset_anon(const char *expr, uint32_t key)
+{
+	static const char *chains[] = { "input", NULL };
+	struct nftnl_ruleset *rs = diff_ruleset(chains, NF_ACCEPT, NULL, 0);
+	struct nftnl_set_elem *e;
+	struct nftnl_expr *ex;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+
+	s = nftnl_set_alloc();
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "__set0");
+	nftnl_set_set_u32(s, NFTNL_SET_FLAGS,
+			  NFT_SET_ANONYMOUS | NFT_SET_CONSTANT);
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	e = nftnl_set_elem_alloc();
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	nftnl_set_elem_add(s, e);
+	nftnl_set_list_add_tail(s, nftnl_ruleset_get(rs,
+						NFTNL_RULESET_SETLIST));
+
+	r = diff_rule(5, "input", NULL, expr);
+	ex = nftnl_expr_alloc("lookup");
+	nftnl_expr_set_u32(ex, NFTNL_EXPR_LOOKUP_SREG, NFT_REG_1);
+	nftnl_expr_set_str(ex, NFTNL_EXPR_LOOKUP_SET, "__set0");
+	nftnl_rule_add_expr(r, ex);
+	nftnl_rule_list_add_tail(r, nftnl_ruleset_get(rs,
+						NFTNL_RULESET_RULELIST));
+
+	return rs;
+}
+
+/* Anonymous sets cannot be created apart from their rule. */
+static void check_diff_anon(struct nftnl_ruleset *cur, const char *expr,
+			    uint32_t key, int num_msgs)
+{
+	struct nftnl_ruleset *want = diff_ruleset_anon(expr, key);
+	struct nftnl_batch *batch;
+	uint32_t seq = 0;
+	int ret;
+
+	batch = nftnl_batch_alloc(MNL_SOCKET_BUFFER_SIZE,
+				  MNL_SOCKET_BUFFER_SIZE);
+	errno = 0;
+	ret = nftnl_ruleset_diff_batch(batch, cur, want, &seq);
+	if (ret != num_msgs || (ret < 0 && errno != EOPNOTSUPP))
+		print_err("wrong diff of anonymous set");
+	if (ret < 0 && nftnl_batch_buffer_len(batch) != 0)
+		print_err("anonymous set diff left messages in the batch");
+
+	nftnl_batch_free(batch);
+	nftnl_ruleset_free(want);
+}
+
+static void test_ruleset_diff_anon(void)
+{
+	struct nftnl_ruleset *cur = diff_ruleset_anon("counter", 1);
+
+	check_diff_anon(cur, "counter", 1, 0);
+	check_diff_anon(cur, "counter", 2, -1);
+	check_diff_anon(cur, "log", 1, -1);
+
+	nftnl_ruleset_free(cur);
+}
+
+static void test_ruleset_asprintf(void)
+{
+	static const char *chains[] = { "input", "output", NULL };
+	static const uint32_t types[] = { NFTNL_OUTPUT_DEFAULT,
+					  NFTNL_OUTPUT_JSON };
+	struct nftnl_ruleset *rs;
+	struct nftnl_rule_list *rl;
+	uint32_t keys[2000];
+	char *out, *abuf;
+	int i, len, ret;
+
+	for (i = 0; i < 2000; i++)
+		keys[i] = i;
+	rs = diff_ruleset(chains, NF_ACCEPT, keys, 2000);
+	rl = nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule(2, "input", "a", "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(3, "output", NULL, "log"), rl);
+
+	for (i = 0; i < 2; i++) {
+		len = nftnl_ruleset_snprintf(buf, 1, rs, types[i], 0);
+		out = malloc(len + 1);
+		if (out == NULL) {
+			print_err("OOM");
+			break;
+		}
+		nftnl_ruleset_snprintf(out, len + 1, rs, types[i], 0);
+
+		/* The length query is an upper bound: trailing JSON commas that
+		 * do not fit into the buffer cannot be trimmed.
+		 */
+		ret = nftnl_ruleset_asprintf(&abuf, rs, types[i], 0);
+		if (ret != strlen(out) || strcmp(out, abuf) != 0)
+			print_err("ruleset asprintf mismatches snprintf");
+		if (ret >= 0)
+			free(abuf);
+		free(out);
+	}
+
+	nftnl_ruleset_free(rs);
+}
+
+struct stream_stats {
+	int	sets;
+	int	set_elems;
+	int	elems;
+	int	max_elems;
+	int	rules;
+};
+
+static int stream_cb(const struct nftnl_parse_ctx *ctx)
+{
+	struct stream_stats *st = nftnl_ruleset_ctx_get(ctx,
+							NFTNL_RULESET_CTX_DATA);
+	struct nftnl_set_elems_iter *it;
+	int n = 0;
+
+	switch (nftnl_ruleset_ctx_get_u32(ctx, NFTNL_RULESET_CTX_TYPE)) {
+	case NFTNL_RULESET_SET:
+		if (st->sets++ == 0 && st->rules != 0)
+			print_err("set reported after rules");
+		/* fall through */
+	case NFTNL_RULESET_SET_ELEMS:
+		if (nftnl_ruleset_ctx_get_u32(ctx, NFTNL_RULESET_CTX_TYPE) ==
+		    NFTNL_RULESET_SET_ELEMS)
+			st->set_elems++;
+
+		it = nftnl_set_elems_iter_create(
+			nftnl_ruleset_ctx_get(ctx, NFTNL_RULESET_CTX_SET));
+		while (nftnl_set_elems_iter_next(it) != NULL)
+			n++;
+		nftnl_set_elems_iter_destroy(it);
+
+		st->elems += n;
+		if (n > st->max_elems)
+			st->max_elems = n;
+		break;
+	case NFTNL_RULESET_RULE:
+		st->rules++;
+		break;
+	}
+
+	nftnl_ruleset_ctx_free(ctx);
+	return 0;
+}
+
+static int parse_file_stats(FILE *fp, bool stream, struct stream_stats *st)
+{
+	struct nftnl_parse_err *err = nftnl_parse_err_alloc();
+	int ret;
+
+	memset(st, 0, sizeof(*st));
+	rewind(fp);
+	if (stream)
+		ret = nftnl_ruleset_parse_file_stream_cb(NFTNL_PARSE_JSON, fp,
+							 err, st, stream_cb);
+	else
+		ret = nftnl_ruleset_parse_file_cb(NFTNL_PARSE_JSON, fp, err, st,
+						  stream_cb);
+	nftnl_parse_err_free(err);
+
+	return ret;
+}
+
+/* A set with @num_elems elements, and attributes before and after them. */
+static FILE *stream_set_file(const char *before, const char *after,
+			     int num_elems)
+{
+	FILE *fp = tmpfile();
+	int i;
+
+	if (fp == NULL)
+		return NULL;
+
+	fprintf(fp, "{\"nftables\":[{\"add\":[{\"set\":{\"name\":\"s\","
+		    "\"table\":\"filter\",\"family\":\"ip\",%s"
+		    "\"key_len\":4,\"set_elem\":[", before);
+	for (i = 0; i < num_elems; i++)
+		fprintf(fp, "%s{\"flags\":0,\"key\":{\"reg\":{\"type\":"
+			    "\"value\",\"len\":4,\"data0\":\"0x%08x\"}}}",
+			i ? "," : "", i);
+	fprintf(fp, "]%s}}]}]}", after);
+
+	return fp;
+}
+
+/* Streamed files report what the whole document does, in a different way. */
+static void test_ruleset_parse_stream_paths(void)
+{
+	struct stream_stats st;
+	FILE *fp;
+
+	fp = stream_set_file("\"an_attribute_with_a_rather_long_name\":1,",
+			     "", 5000);
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		return;
+	}
+	if (parse_file_stats(fp, false, &st) < 0 || st.sets != 1 ||
+	    st.set_elems != 0 || st.elems != 5000)
+		print_err("set was not parsed as a whole");
+	if (parse_file_stats(fp, true, &st) < 0 || st.sets != 1 ||
+	    st.set_elems == 0 || st.elems != 5000)
+		print_err("set with long attribute names was not streamed");
+	fclose(fp);
+
+	/* Attributes that come too late to be streamed. */
+	fp = stream_set_file("", ",\"flags\":3", 5000);
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		return;
+	}
+	if (parse_file_stats(fp, false, &st) < 0 || st.elems != 5000)
+		print_err("set with trailing attributes was not parsed");
+	if (parse_file_stats(fp, true, &st) == 0)
+		print_err("late set attributes were streamed");
+	fclose(fp);
+}
+
+/* Files are parsed as a stream: large sets are reported in several chunks
+ * that add up to the same ruleset as parsing the whole document at once.
+ */
+static void test_ruleset_parse_stream(void)
+{
+	static const char *chains[] = { "input", "output", NULL };
+	struct nftnl_ruleset *rs, *rs_file, *rs_buf;
+	struct nftnl_parse_err *err;
+	struct stream_stats st = {};
+	struct nftnl_rule_list *rl;
+	char *json, *out_file, *out_buf;
+	uint32_t keys[10000];
+	FILE *fp;
+	int i;
+
+	for (i = 0; i < 10000; i++)
+		keys[i] = i;
+	rs = diff_ruleset(chains, NF_ACCEPT, keys, 10000);
+	rl = nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule(2, "input", NULL, "counter"), rl);
+
+	if (nftnl_ruleset_asprintf(&json, rs, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0) {
+		print_err("cannot export ruleset");
+		nftnl_ruleset_free(rs);
+		return;
+	}
+	nftnl_ruleset_free(rs);
+
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		free(json);
+		return;
+	}
+	fputs(json, fp);
+
+	if (parse_file_stats(fp, true, &st) < 0)
+		print_err("cannot stream ruleset");
+	if (st.sets != 1 || st.set_elems < 2 || st.elems != 10000 ||
+	    st.rules != 1)
+		print_err("streamed ruleset has unexpected objects");
+	if (st.max_elems >= 10000)
+		print_err("set was not streamed in chunks");
+
+	if (parse_file_stats(fp, false, &st) < 0 || st.sets != 1 ||
+	    st.set_elems != 0 || st.max_elems != 10000 || st.rules != 1)
+		print_err("parsed ruleset has unexpected objects");
+
+	err = nftnl_parse_err_alloc();
+
+	rs_file = nftnl_ruleset_alloc();
+	rs_buf = nftnl_ruleset_alloc();
+	rewind(fp);
+	if (nftnl_ruleset_parse_file(rs_file, NFTNL_PARSE_JSON, fp, err) < 0 ||
+	    nftnl_ruleset_parse(rs_buf, NFTNL_PARSE_JSON, json, err) < 0)
+		print_err("cannot parse ruleset");
+
+	if (nftnl_ruleset_asprintf(&out_file, rs_file, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0 ||
+	    nftnl_ruleset_asprintf(&out_buf, rs_buf, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0) {
+		print_err("cannot export parsed ruleset");
+	} else {
+		if (strcmp(out_file, json) != 0 || strcmp(out_buf, json) != 0)
+			print_err("parsed ruleset mismatches the original");
+		free(out_file);
+		free(out_buf);
+	}
+	nftnl_ruleset_free(rs_file);
+	nftnl_ruleset_free(rs_buf);
+
+	/* Syntax errors are reported where they are found. */
+	fclose(fp);
+	fp = tmpfile();
+	fprintf(fp, "{\"nftables\":[{\"add\":[\n{\"table\":{}}}]}");
+	rewind(fp);
+	rs_file = nftnl_ruleset_alloc();
+	if (nftnl_ruleset_parse_file(rs_file, NFTNL_PARSE_JSON, fp, err) == 0)
+		print_err("truncated ruleset was parsed");
+	nftnl_ruleset_free(rs_file);
+
+	nftnl_parse_err_free(err);
+	fclose(fp);
+	free(json);
+
+	/* Sets that are deleted do not need their elements. */
+	rs = diff_ruleset(chains, NF_ACCEPT, keys, 10000);
+	if (nftnl_ruleset_asprintf(&json, rs, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_DEL) < 0) {
+		print_err("cannot export ruleset");
+		nftnl_ruleset_free(rs);
+		return;
+	}
+	nftnl_ruleset_free(rs);
+
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		free(json);
+		return;
+	}
+	fputs(json, fp);
+	if (parse_file_stats(fp, false, &st) < 0 || st.sets != 1 ||
+	    st.elems != 10000)
+		print_err("deleted set was not parsed as a whole");
+	if (parse_file_stats(fp, true, &st) < 0 || st.sets != 1 ||
+	    st.set_elems != 0 || st.elems != 0)
+		print_err("elements of deleted set were streamed");
+	fclose(fp);
+	free(json);
+
+	test_ruleset_parse_stream_paths();
+}
+
+struct batch_stats {
+	int	msgs[NFT_MSG_MAX];
+	int	elems;
+	int	len;
+};
+
+static void batch_stats(struct nftnl_batch *batch, struct batch_stats *st,
+			char *data, int size)
+{
+	struct nftnl_set_elems_iter *it;
+	struct iovec iov[64];
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	struct nlmsghdr *nlh;
+	uint16_t type;
+	int i, len, iovlen;
+
+	memset(st, 0, sizeof(*st));
+	iovlen = nftnl_batch_iovec_len(batch);
+	nftnl_batch_iovec(batch, iov, 64);
+	for (i = 0; i < iovlen; i++) {
+		if (st->len + iov[i].iov_len <= size)
+			memcpy(data + st->len, iov[i].iov_base,
+			       iov[i].iov_len);
+		st->len += iov[i].iov_len;
+
+		nlh = iov[i].iov_base;
+		len = iov[i].iov_len;
+		for (; mnl_nlmsg_ok(nlh, len); nlh = mnl_nlmsg_next(nlh, &len)) {
+			type = NFNL_MSG_TYPE(nlh->nlmsg_type);
+			st->msgs[type]++;
+
+			if (type == NFT_MSG_NEWRULE) {
+				r = nftnl_rule_alloc();
+				nftnl_rule_nlmsg_parse(nlh, r);
+				if (nftnl_rule_is_set(r, NFTNL_RULE_HANDLE) ||
+				    nlh->nlmsg_flags !=
+				    (NLM_F_REQUEST | NLM_F_CREATE | NLM_F_APPEND))
+					print_err("added rule refers to a handle");
+				nftnl_rule_free(r);
+			} else if (type == NFT_MSG_NEWSETELEM) {
+				s = nftnl_set_alloc();
+				nftnl_set_elems_nlmsg_parse(nlh, s);
+				it = nftnl_set_elems_iter_create(s);
+				while (nftnl_set_elems_iter_next(it) != NULL)
+					st->elems++;
+				nftnl_set_elems_iter_destroy(it);
+				nftnl_set_free(s);
+			}
+		}
+	}
+}
+
+/* Documents are compiled into the messages that load them, from buffers and
+ * files alike.
+ */
+static void test_ruleset_parse_batch(void)
+{
+	static const char *chains[] = { "input", "output", NULL };
+	static char data_buf[256 * 1024], data_file[256 * 1024];
+	struct batch_stats st_buf, st_file;
+	struct nftnl_parse_err *err;
+	struct nftnl_batch *batch;
+	struct nftnl_ruleset *rs;
+	struct nftnl_rule_list *rl;
+	uint32_t keys[1000], seq = 0;
+	char *json;
+	FILE *fp;
+	int i, ret;
+
+	for (i = 0; i < 1000; i++)
+		keys[i] = i;
+	rs = diff_ruleset(chains, NF_ACCEPT, keys, 1000);
+	rl = nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST);
+	nftnl_rule_list_add_tail(diff_rule(2, "input", NULL, "counter"), rl);
+	nftnl_rule_list_add_tail(diff_rule(3, "output", "x", "counter"), rl);
+
+	if (nftnl_ruleset_asprintf(&json, rs, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0) {
+		print_err("cannot export ruleset");
+		nftnl_ruleset_free(rs);
+		return;
+	}
+	nftnl_ruleset_free(rs);
+
+	err = nftnl_parse_err_alloc();
+	/* Element messages may take up to UINT16_MAX bytes. */
+	batch = nftnl_batch_alloc(getpagesize() * 32,
+				  UINT16_MAX + getpagesize());
+
+	ret = nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON, json, err,
+					       batch, &seq);
+	batch_stats(batch, &st_buf, data_buf, sizeof(data_buf));
+	if (ret < 0 || ret != seq)
+		print_err("cannot compile ruleset buffer");
+	if (st_buf.msgs[NFT_MSG_NEWTABLE] != 1 ||
+	    st_buf.msgs[NFT_MSG_NEWCHAIN] != 2 ||
+	    st_buf.msgs[NFT_MSG_NEWSET] != 1 ||
+	    st_buf.msgs[NFT_MSG_NEWSETELEM] != 1 ||
+	    st_buf.msgs[NFT_MSG_NEWRULE] != 2 || st_buf.elems != 1000)
+		print_err("compiled ruleset has unexpected messages");
+
+	fp = tmpfile();
+	fputs(json, fp);
+	rewind(fp);
+	nftnl_batch_reset(batch);
+	seq = 0;
+	ret = nftnl_ruleset_parse_file_batch(NFTNL_PARSE_JSON, fp, err, batch,
+					     &seq);
+	batch_stats(batch, &st_file, data_file, sizeof(data_file));
+	if (ret < 0 || st_file.len != st_buf.len ||
+	    memcmp(data_file, data_buf, st_buf.len) != 0)
+		print_err("compiled file mismatches compiled buffer");
+	fclose(fp);
+
+	/* Other commands turn into deletions. */
+	nftnl_batch_reset(batch);
+	ret = nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON,
+		"{\"nftables\":["
+		"{\"delete\":[{\"rule\":{\"family\":\"ip\",\"table\":\"filter\","
+			"\"chain\":\"input\",\"handle\":2,\"expr\":[]}}]},"
+		"{\"flush\":[{\"table\":{\"family\":\"ip\",\"name\":\"filter\"}}]},"
+		"{\"flush\":[]}]}", err, batch, &seq);
+	batch_stats(batch, &st_buf, NULL, 0);
+	if (ret != 3 || st_buf.msgs[NFT_MSG_DELRULE] != 2 ||
+	    st_buf.msgs[NFT_MSG_DELTABLE] != 1)
+		print_err("commands were not compiled");
+
+	/* Replacing a rule needs to know which one. */
+	nftnl_batch_reset(batch);
+	if (nftnl_ruleset_parse_buffer_batch(NFTNL_PARSE_JSON,
+		"{\"nftables\":["
+		"{\"replace\":[{\"rule\":{\"family\":\"ip\",\"table\":\"filter\","
+			"\"chain\":\"input\",\"expr\":[]}}]}]}",
+		err, batch, &seq) >= 0)
+		print_err("rule without handle was replaced");
+
+	nftnl_batch_free(batch);
+	nftnl_parse_err_free(err);
+	free(json);
+}
+
+static void check_parse_err(const char *json, uint32_t num_threads)
+{
+	struct nftnl_parse_err *err1, *err2;
+	struct nftnl_ruleset *rs1, *rs2;
+	int ret1, ret2;
+
+	err1 = nftnl_parse_err_alloc();
+	err2 = nftnl_parse_err_alloc();
+	rs1 = nftnl_ruleset_alloc();
+	rs2 = nftnl_ruleset_alloc();
+
+	ret1 = nftnl_ruleset_parse(rs1, NFTNL_PARSE_JSON, json, err1);
+	ret2 = nftnl_ruleset_parse_parallel(rs2, NFTNL_PARSE_JSON, json, err2,
+					    num_threads);
+	if (ret1 == 0 || ret2 == 0)
+		print_err("broken ruleset was parsed");
+
+	nftnl_ruleset_free(rs1);
+	nftnl_ruleset_free(rs2);
+	nftnl_parse_err_free(err1);
+	nftnl_parse_err_free(err2);
+}
+
+/* Parsing with several threads yields the same ruleset as with one. */
+static void test_ruleset_parse_parallel(void)
+{
+	static const char *chains[] = { "input", "output", NULL };
+	struct nftnl_ruleset *rs, *rs_seq, *rs_par, *rs_file;
+	char *json, *out_seq, *out_par, *out_file;
+	struct nftnl_parse_err *err;
+	struct nftnl_str_pool *pool;
+	struct nftnl_rule_list *rl;
+	struct nftnl_expr *e;
+	struct nftnl_rule *r;
+	uint32_t keys[1000];
+	FILE *fp;
+	int i;
+
+	for (i = 0; i < 1000; i++)
+		keys[i] = i;
+	rs = diff_ruleset(chains, NF_ACCEPT, keys, 1000);
+	rl = nftnl_ruleset_get(rs, NFTNL_RULESET_RULELIST);
+	for (i = 0; i < 3000; i++) {
+		r = diff_rule(i + 1, chains[i % 2], NULL, "counter");
+		if (i % 3 == 0) {
+			e = nftnl_expr_alloc("lookup");
+			nftnl_expr_set_u32(e, NFTNL_EXPR_LOOKUP_SREG,
+					   NFT_REG_1);
+			nftnl_expr_set_str(e, NFTNL_EXPR_LOOKUP_SET,
+					   "blacklist");
+			nftnl_rule_add_expr(r, e);
+		}
+		nftnl_rule_list_add_tail(r, rl);
+	}
+
+	if (nftnl_ruleset_asprintf(&json, rs, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0) {
+		print_err("cannot export ruleset");
+		nftnl_ruleset_free(rs);
+		return;
+	}
+	nftnl_ruleset_free(rs);
+
+	err = nftnl_parse_err_alloc();
+	rs_seq = nftnl_ruleset_alloc();
+	rs_par = nftnl_ruleset_alloc();
+	rs_file = nftnl_ruleset_alloc();
+
+	/* The pool of the calling thread is left alone. */
+	pool = nftnl_str_pool_alloc();
+	nftnl_str_pool_attach(pool);
+
+	fp = tmpfile();
+	fputs(json, fp);
+	rewind(fp);
+	if (nftnl_ruleset_parse(rs_seq, NFTNL_PARSE_JSON, json, err) < 0 ||
+	    nftnl_ruleset_parse_parallel(rs_par, NFTNL_PARSE_JSON, json, err,
+					 4) < 0 ||
+	    nftnl_ruleset_parse_file_parallel(rs_file, NFTNL_PARSE_JSON, fp,
+					      err, 0) < 0)
+		print_err("cannot parse ruleset");
+	fclose(fp);
+
+	if (nftnl_str_pool_attach(NULL) != pool)
+		print_err("string pool was detached");
+	nftnl_str_pool_free(pool);
+
+	if (nftnl_ruleset_asprintf(&out_seq, rs_seq, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0 ||
+	    nftnl_ruleset_asprintf(&out_par, rs_par, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0 ||
+	    nftnl_ruleset_asprintf(&out_file, rs_file, NFTNL_OUTPUT_JSON,
+				   NFTNL_OF_EVENT_NEW) < 0) {
+		print_err("cannot export parsed ruleset");
+	} else {
+		if (strcmp(out_par, out_seq) != 0 ||
+		    strcmp(out_file, out_seq) != 0)
+			print_err("parallel ruleset mismatches");
+		free(out_seq);
+		free(out_par);
+		free(out_file);
+	}
+	nftnl_ruleset_free(rs_seq);
+	nftnl_ruleset_free(rs_par);
+	nftnl_ruleset_free(rs_file);
+	nftnl_parse_err_free(err);
+	free(json);
+
+	check_parse_err("{\"nftables\":[{\"add\":[\n"
+			"{\"table\":{\"name\":\"filter\",\"family\":\"ip\"}},\n"
+			"{\"rule\":{\"family\":\"ip\",\"table\":\"filter\","
+			"\"chain\":\"input\",\"expr\":[{\"type\":\"x\"}]}}]}]}",
+			2);
+	check_parse_err("{\"nftables\":[{\"add\":[\n"
+			"{\"table\":{\"name\":\"filter\",\"family\":\"ip\"}},\n"
+			"{\"chain\":{\"family\":\"ip\",}}]}]}", 2);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nftnl_ruleset *rs;
+
+	rs = nftnl_ruleset_alloc();
+	if (rs == NULL) {
+		print_err("OOM");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Initial dump, at generation 10. */
+	apply_gen(rs, 10);
+	apply_table(rs, NFT_MSG_NEWTABLE, true, 10);
+	apply_chain(rs, NFT_MSG_NEWCHAIN, true, 10, "input");
+	apply_chain(rs, NFT_MSG_NEWCHAIN, true, 10, "output");
+	apply_rule(rs, NFT_MSG_NEWRULE, true, 10, "input", 2, 0);
+	apply_rule(rs, NFT_MSG_NEWRULE, true, 10, "input", 3, 2);
+	apply_rule(rs, NFT_MSG_NEWRULE, true, 10, "output", 4, 0);
+	apply_set(rs, NFT_MSG_NEWSET, true, 10, 0);
+	apply_set(rs, NFT_MSG_NEWSETELEM, true, 10, 1);
+	apply_set(rs, NFT_MSG_NEWSETELEM, true, 10, 2);
+
+	check_chain(rs, "input", (uint64_t []){ 2, 3 }, 2);
+	check_chain(rs, "output", (uint64_t []){ 4 }, 1);
+	if (!has_elem(rs, 1) || !has_elem(rs, 2))
+		print_err("dumped elements are missing");
+
+	/* Events of generation 11. */
+	apply_rule(rs, NFT_MSG_NEWRULE, false, 11, "input", 5, 2);
+	apply_rule(rs, NFT_MSG_NEWRULE, false, 11, "input", 6, 0);
+	apply_rule(rs, NFT_MSG_DELRULE, false, 11, "input", 3, 0);
+	apply_set(rs, NFT_MSG_DELSETELEM, false, 11, 1);
+	apply_set(rs, NFT_MSG_NEWSETELEM, false, 11, 7);
+	apply_interval(rs, NFT_MSG_NEWSETELEM, 11, 8, true);
+	apply_interval(rs, NFT_MSG_NEWSETELEM, 11, 8, false);
+	apply_gen(rs, 11);
+
+	check_chain(rs, "input", (uint64_t []){ 6, 2, 5 }, 3);
+	if (has_elem(rs, 1) || !has_elem(rs, 2) || !has_elem(rs, 7))
+		print_err("elements mismatch after events");
+
+	/* An interval end is not the start of the next interval. */
+	check_interval(rs, 8, 1, 1);
+	apply_interval(rs, NFT_MSG_DELSETELEM, 12, 8, false);
+	check_interval(rs, 8, 0, 1);
+
+	/* Events the ruleset already reflects are skipped. */
+	apply_rule(rs, NFT_MSG_DELRULE, false, 11, "input", 2, 0);
+	apply_gen(rs, 11);
+	check_chain(rs, "input", (uint64_t []){ 6, 2, 5 }, 3);
+
+	/* Deleting a chain deletes its rules. */
+	apply_chain(rs, NFT_MSG_DELCHAIN, false, 12, "output");
+	apply_gen(rs, 12);
+	check_chain(rs, "output", NULL, 0);
+	if (nftnl_rule_list_lookup_byhandle(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_RULELIST),
+					    NFPROTO_IPV4, "filter", 4) != NULL)
+		print_err("rule of deleted chain found");
+
+	/* Deleting a table deletes everything in it. */
+	apply_table(rs, NFT_MSG_DELTABLE, false, 13);
+	apply_gen(rs, 13);
+	check_chain(rs, "input", NULL, 0);
+	if (!nftnl_chain_list_is_empty(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_CHAINLIST)) ||
+	    !nftnl_set_list_is_empty(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_SETLIST)) ||
+	    !nftnl_table_list_is_empty(nftnl_ruleset_get(rs,
+						NFTNL_RULESET_TABLELIST)))
+		print_err("objects of deleted table found");
+
+	/* Generation 14 was missed. */
+	if (apply_rule(rs, NFT_MSG_NEWRULE, false, 15, "input", 8, 0) == 0 ||
+	    errno != ESTALE)
+		print_err("gap in generations not detected");
+	if (apply_rule(rs, NFT_MSG_NEWRULE, false, 14, "input", 8, 0) == 0 ||
+	    errno != ESTALE)
+		print_err("stale ruleset accepted message");
+
+	nftnl_ruleset_free(rs);
+
+	/* The rule to insert after was never seen. */
+	rs = nftnl_ruleset_alloc();
+	apply_gen(rs, 20);
+	apply_rule(rs, NFT_MSG_NEWRULE, true, 20, "input", 1, 0);
+	if (apply_rule(rs, NFT_MSG_NEWRULE, false, 21, "input", 2, 9) == 0 ||
+	    errno != ESTALE)
+		print_err("rule at unknown position accepted");
+	nftnl_ruleset_free(rs);
+
+	test_ruleset_diff();
+	test_ruleset_diff_exprs();
+	test_ruleset_diff_anon();
+	test_ruleset_asprintf();
+	test_ruleset_parse_stream();
+	test_ruleset_parse_batch();
+	test_ruleset_parse_parallel();
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
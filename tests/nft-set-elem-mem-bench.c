@@ -0,0 +1,118 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+/* Heap used per set element parsed from netlink messages, as a dump would
+ * report them. Not part of the test suite, build it with
+ * "make nft-set-elem-mem-bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+
+#include <netinet/in.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <libmnl/libmnl.h>
+#include <libnftnl/common.h>
+#include <libnftnl/set.h>
+
+#define BENCH_NUM_ELEMS		100000
+/* Elements per message, so the element list nest fits. */
+#define BENCH_MSG_ELEMS		512
+
+static char buf[1 << 16];
+
+static struct nftnl_set *bench_set_alloc(void)
+{
+	struct nftnl_set *s = nftnl_set_alloc();
+
+	if (s == NULL)
+		return NULL;
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "bench");
+	return s;
+}
+
+/* Message with elements @first to @first + BENCH_MSG_ELEMS - 1. */
+static struct nlmsghdr *bench_msg(uint32_t first, uint32_t key_len,
+				  uint32_t data_len)
+{
+	struct nftnl_set *s = bench_set_alloc();
+	uint32_t key[4] = {}, data = 0;
+	struct nftnl_set_elem *e;
+	struct nlmsghdr *nlh;
+	uint32_t i;
+
+	if (s == NULL)
+		return NULL;
+
+	for (i = first; i < first + BENCH_MSG_ELEMS; i++) {
+		key[0] = htonl(i);
+		data = i;
+
+		e = nftnl_set_elem_alloc();
+		if (e == NULL) {
+			nftnl_set_free(s);
+			return NULL;
+		}
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, key, key_len);
+		if (data_len)
+			nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, &data,
+					   data_len);
+		nftnl_set_elem_add(s, e);
+	}
+
+	nlh = nftnl_nlmsg_build_hdr(buf, NFT_MSG_NEWSETELEM, NFPROTO_IPV4,
+				    NLM_F_MULTI, 0);
+	nftnl_set_elems_nlmsg_build_payload(nlh, s);
+	nftnl_set_free(s);
+
+	return nlh;
+}
+
+static int bench(const char *name, uint32_t key_len, uint32_t data_len)
+{
+	struct nftnl_set *s = bench_set_alloc();
+	struct nlmsghdr *nlh;
+	size_t before;
+	uint32_t i;
+
+	if (s == NULL)
+		return -1;
+
+	before = mallinfo2().uordblks;
+	for (i = 0; i < BENCH_NUM_ELEMS; i += BENCH_MSG_ELEMS) {
+		nlh = bench_msg(i, key_len, data_len);
+		if (nlh == NULL || nftnl_set_elems_nlmsg_parse(nlh, s) < 0) {
+			nftnl_set_free(s);
+			return -1;
+		}
+	}
+	printf("%-24s%6zu bytes\n", name,
+	       (mallinfo2().uordblks - before) / i);
+
+	nftnl_set_free(s);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (bench("ipv4 key", sizeof(uint32_t), 0) < 0 ||
+	    bench("ipv6 key", 4 * sizeof(uint32_t), 0) < 0 ||
+	    bench("ipv4 key + u32 data", sizeof(uint32_t),
+		  sizeof(uint32_t)) < 0) {
+		perror("bench");
+		exit(EXIT_FAILURE);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -9,12 +9,20 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
 #include <netinet/in.h>
+#include <linux/netfilter.h>
 #include <linux/netfilter/nf_tables.h>
 
+#include <libmnl/libmnl.h>
 #include <libnftnl/set.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
 
 static int test_ok = 1;
 
@@ -52,6 +60,739 @@ static void cmp_nftnl_set(struct nftnl_set *a, struct nftnl_set *b)
 		print_err("Set userdata mismatches");
 }
 
+#define TEST_NUM_ELEMS	1000
+
+static void test_set_elem_hash(void)
+{
+	static char buf[TEST_NUM_ELEMS * 64];
+	struct nftnl_set_elem *e;
+	struct nftnl_set *a, *b;
+	struct nlmsghdr *nlh;
+	uint32_t key;
+
+	a = nftnl_set_alloc();
+	b = nftnl_set_alloc();
+	if (a == NULL || b == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_set_set_str(a, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(a, NFTNL_SET_NAME, "test-name");
+	if (nftnl_set_elem_hash_enable(a) < 0)
+		print_err("cannot enable element hash");
+
+	for (key = 0; key < TEST_NUM_ELEMS; key++) {
+		e = nftnl_set_elem_alloc();
+		if (e == NULL) {
+			print_err("OOM");
+			break;
+		}
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+		nftnl_set_elem_add(a, e);
+	}
+
+	for (key = 0; key < TEST_NUM_ELEMS; key++) {
+		if (nftnl_set_elem_lookup(a, &key, sizeof(key)) == NULL)
+			print_err("element not found");
+	}
+	key = TEST_NUM_ELEMS;
+	if (nftnl_set_elem_lookup(a, &key, sizeof(key)) != NULL)
+		print_err("unexpected element found");
+
+	for (key = 0; key < TEST_NUM_ELEMS; key += 2) {
+		if (nftnl_set_elem_del_key(a, &key, sizeof(key)) < 0)
+			print_err("cannot delete element");
+	}
+	if (nftnl_set_elem_del_key(a, &key, sizeof(key)) == 0)
+		print_err("deleted missing element");
+
+	nlh = nftnl_set_nlmsg_build_hdr(buf, NFT_MSG_NEWSETELEM, AF_INET, 0,
+					1234);
+	nftnl_set_elems_nlmsg_build_payload(nlh, a);
+
+	/* Elements that are parsed from netlink are indexed too. */
+	if (nftnl_set_elem_hash_enable(b) < 0)
+		print_err("cannot enable element hash");
+	if (nftnl_set_elems_nlmsg_parse(nlh, b) < 0)
+		print_err("parsing problems");
+
+	for (key = 0; key < TEST_NUM_ELEMS; key++) {
+		e = nftnl_set_elem_lookup(b, &key, sizeof(key));
+		if ((key % 2 == 0) != (e == NULL))
+			print_err("element lookup mismatches after parsing");
+	}
+
+	nftnl_set_free(a);
+	nftnl_set_free(b);
+}
+
+static void test_set_elem_arena(void)
+{
+	static char buf[TEST_NUM_ELEMS * 128];
+	const char *udata = "userdata", *str;
+	struct nftnl_set_elem *e;
+	struct nftnl_set *a, *b;
+	struct nlmsghdr *nlh;
+	char chain[32];
+	uint32_t key, len;
+
+	a = nftnl_set_alloc();
+	b = nftnl_set_alloc();
+	if (a == NULL || b == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_set_set_str(a, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(a, NFTNL_SET_NAME, "test-name");
+
+	for (key = 0; key < TEST_NUM_ELEMS; key++) {
+		e = nftnl_set_elem_alloc();
+		if (e == NULL) {
+			print_err("OOM");
+			break;
+		}
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_USERDATA, udata,
+				   strlen(udata));
+		if (key % 2) {
+			nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_OBJREF, "obj");
+		} else {
+			snprintf(chain, sizeof(chain), "chain-%u", key);
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT,
+					       NFT_JUMP);
+			nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN, chain);
+		}
+		nftnl_set_elem_add(a, e);
+	}
+
+	nlh = nftnl_set_nlmsg_build_hdr(buf, NFT_MSG_NEWSETELEM, AF_INET, 0,
+					1234);
+	nftnl_set_elems_nlmsg_build_payload(nlh, a);
+
+	if (nftnl_set_elem_arena_enable(b) < 0)
+		print_err("cannot enable element arena");
+	if (nftnl_set_elems_nlmsg_parse(nlh, b) < 0)
+		print_err("parsing problems");
+
+	for (key = 0; key < TEST_NUM_ELEMS; key++) {
+		e = nftnl_set_elem_lookup(b, &key, sizeof(key));
+		if (e == NULL) {
+			print_err("element not found in arena set");
+			continue;
+		}
+		str = nftnl_set_elem_get(e, NFTNL_SET_ELEM_USERDATA, &len);
+		if (str == NULL || len != strlen(udata) ||
+		    memcmp(str, udata, len) != 0)
+			print_err("element userdata mismatches");
+
+		if (key % 2) {
+			str = nftnl_set_elem_get_str(e, NFTNL_SET_ELEM_OBJREF);
+			if (str == NULL || strcmp(str, "obj") != 0)
+				print_err("element objref mismatches");
+			continue;
+		}
+		snprintf(chain, sizeof(chain), "chain-%u", key);
+		str = nftnl_set_elem_get_str(e, NFTNL_SET_ELEM_CHAIN);
+		if (str == NULL || strcmp(str, chain) != 0)
+			print_err("element chain mismatches");
+		if (nftnl_set_elem_get_u32(e, NFTNL_SET_ELEM_VERDICT) != NFT_JUMP)
+			print_err("element verdict mismatches");
+	}
+
+	/* Elements from the arena can still be updated and released. */
+	key = 0;
+	e = nftnl_set_elem_lookup(b, &key, sizeof(key));
+	if (e != NULL) {
+		nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN, "other");
+		nftnl_set_elem_unset(e, NFTNL_SET_ELEM_USERDATA);
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_USERDATA, udata,
+				   strlen(udata));
+	}
+	for (key = 0; key < TEST_NUM_ELEMS; key += 3) {
+		if (nftnl_set_elem_del_key(b, &key, sizeof(key)) < 0)
+			print_err("cannot delete element from arena set");
+	}
+
+	nftnl_set_free(a);
+	nftnl_set_free(b);
+}
+
+struct foreach_ctx {
+	struct nftnl_set	*set;
+	uint32_t		count;
+	uint32_t		stop;
+};
+
+static int foreach_elem_cb(struct nftnl_set_elem *e, void *data)
+{
+	struct foreach_ctx *ctx = data;
+	struct nftnl_set_elem *orig;
+	const void *key, *val;
+	uint32_t len, orig_len;
+
+	if (ctx->count++ == ctx->stop)
+		return -1;
+
+	key = nftnl_set_elem_get(e, NFTNL_SET_ELEM_KEY, &len);
+	if (key == NULL) {
+		print_err("element without key in foreach");
+		return 0;
+	}
+	orig = nftnl_set_elem_lookup(ctx->set, key, len);
+	if (orig == NULL) {
+		print_err("unknown element in foreach");
+		return 0;
+	}
+
+	if (nftnl_set_elem_get_u64(e, NFTNL_SET_ELEM_TIMEOUT) !=
+	    nftnl_set_elem_get_u64(orig, NFTNL_SET_ELEM_TIMEOUT))
+		print_err("element timeout mismatches in foreach");
+
+	if (nftnl_set_elem_is_set(orig, NFTNL_SET_ELEM_DATA)) {
+		val = nftnl_set_elem_get(e, NFTNL_SET_ELEM_DATA, &len);
+		nftnl_set_elem_get(orig, NFTNL_SET_ELEM_DATA, &orig_len);
+		if (val == NULL || len != orig_len ||
+		    memcmp(val, nftnl_set_elem_get(orig, NFTNL_SET_ELEM_DATA,
+						   &orig_len), len) != 0)
+			print_err("element data mismatches in foreach");
+	} else if (!nftnl_set_elem_is_set(e, NFTNL_SET_ELEM_CHAIN) ||
+		   nftnl_set_elem_get_u32(e, NFTNL_SET_ELEM_VERDICT) !=
+		   NFT_GOTO ||
+		   strcmp(nftnl_set_elem_get_str(e, NFTNL_SET_ELEM_CHAIN),
+			  nftnl_set_elem_get_str(orig, NFTNL_SET_ELEM_CHAIN)) != 0) {
+		print_err("element verdict mismatches in foreach");
+	}
+
+	return 0;
+}
+
+static void test_set_elems_foreach(void)
+{
+	static char buf[TEST_NUM_ELEMS * 128];
+	struct foreach_ctx ctx = {};
+	struct nftnl_set_elem *e;
+	struct nlmsghdr *nlh;
+	struct nftnl_set *a;
+	char chain[32];
+	uint32_t key;
+
+	a = nftnl_set_alloc();
+	if (a == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_set_set_str(a, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(a, NFTNL_SET_NAME, "test-name");
+	nftnl_set_elem_hash_enable(a);
+
+	for (key = 0; key < TEST_NUM_ELEMS; key++) {
+		e = nftnl_set_elem_alloc();
+		if (e == NULL) {
+			print_err("OOM");
+			break;
+		}
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+		nftnl_set_elem_set_u64(e, NFTNL_SET_ELEM_TIMEOUT, key * 1000);
+		if (key % 2) {
+			nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, &key,
+					   sizeof(key));
+		} else {
+			snprintf(chain, sizeof(chain), "chain-%u", key);
+			nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT,
+					       NFT_GOTO);
+			nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN, chain);
+		}
+		nftnl_set_elem_add(a, e);
+	}
+
+	nlh = nftnl_set_nlmsg_build_hdr(buf, NFT_MSG_NEWSETELEM, AF_INET, 0,
+					1234);
+	nftnl_set_elems_nlmsg_build_payload(nlh, a);
+
+	ctx.set = a;
+	ctx.stop = UINT32_MAX;
+	if (nftnl_set_elems_nlmsg_foreach(nlh, foreach_elem_cb, &ctx) < 0)
+		print_err("foreach failed");
+	if (ctx.count != TEST_NUM_ELEMS)
+		print_err("foreach did not visit all elements");
+
+	/* The walk stops as soon as the callback fails. */
+	ctx.count = 0;
+	ctx.stop = 10;
+	if (nftnl_set_elems_nlmsg_foreach(nlh, foreach_elem_cb, &ctx) != -1 ||
+	    ctx.count != 11)
+		print_err("foreach did not stop on error");
+
+	nftnl_set_free(a);
+}
+
+#define TEST_DIFF_ELEMS	10000
+
+static void add_map_elem(struct nftnl_set *s, uint32_t key, uint32_t data)
+{
+	struct nftnl_set_elem *e;
+
+	e = nftnl_set_elem_alloc();
+	if (e == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, &data, sizeof(data));
+	nftnl_set_elem_add(s, e);
+}
+
+static void test_set_elems_diff(void)
+{
+	struct nftnl_set *cur, *want, *add, *del, *s;
+	struct nftnl_set_elem *e;
+	const struct msghdr *msg;
+	struct nftnl_batch *batch;
+	const struct nlmsghdr *nlh;
+	uint32_t key, seq = 0;
+	int i, len, num_msgs;
+
+	batch = nftnl_batch_alloc(getpagesize() * 32,
+				  UINT16_MAX + getpagesize());
+	cur = nftnl_set_alloc();
+	want = nftnl_set_alloc();
+	add = nftnl_set_alloc();
+	del = nftnl_set_alloc();
+	if (batch == NULL || cur == NULL || want == NULL ||
+	    add == NULL || del == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_set_set_str(want, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(want, NFTNL_SET_NAME, "test-name");
+	nftnl_set_set_u32(want, NFTNL_SET_FAMILY, AF_INET);
+
+	/* Keys that are in both sets are kept, but the odd ones are updated */
+	for (key = 0; key < TEST_DIFF_ELEMS; key++)
+		add_map_elem(cur, key, 0);
+	for (key = TEST_DIFF_ELEMS / 2; key < TEST_DIFF_ELEMS * 3 / 2; key++)
+		add_map_elem(want, key,
+			     key < TEST_DIFF_ELEMS && key % 2 ? 1 : 0);
+
+	num_msgs = nftnl_set_elems_diff_batch(batch, cur, want, 0, &seq);
+	if (num_msgs < 4)
+		print_err("elements were not split in several messages");
+	if (seq != num_msgs)
+		print_err("sequence number mismatches");
+
+	msg = nftnl_batch_msghdr(batch);
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		nlh = msg->msg_iov[i].iov_base;
+		len = msg->msg_iov[i].iov_len;
+		while (mnl_nlmsg_ok(nlh, len)) {
+			s = (nlh->nlmsg_type & 0xff) == NFT_MSG_NEWSETELEM ?
+				add : del;
+			if (nftnl_set_elems_nlmsg_parse(nlh, s) < 0)
+				print_err("parsing problems");
+			nlh = mnl_nlmsg_next(nlh, &len);
+		}
+	}
+
+	nftnl_set_elem_hash_enable(add);
+	nftnl_set_elem_hash_enable(del);
+	for (key = 0; key < TEST_DIFF_ELEMS * 3 / 2; key++) {
+		bool updated = key >= TEST_DIFF_ELEMS / 2 &&
+			       key < TEST_DIFF_ELEMS && key % 2;
+
+		e = nftnl_set_elem_lookup(del, &key, sizeof(key));
+		if ((e != NULL) != (key < TEST_DIFF_ELEMS / 2 || updated))
+			print_err("wrong set of deleted elements");
+
+		e = nftnl_set_elem_lookup(add, &key, sizeof(key));
+		if ((e != NULL) != (key >= TEST_DIFF_ELEMS || updated))
+			print_err("wrong set of added elements");
+		if (e != NULL && updated &&
+		    nftnl_set_elem_get_u32(e, NFTNL_SET_ELEM_DATA) != 1)
+			print_err("updated element has wrong data");
+	}
+	if (strcmp(nftnl_set_get_str(add, NFTNL_SET_NAME), "test-name") != 0)
+		print_err("set name mismatches in diff");
+
+	nftnl_batch_free(batch);
+	nftnl_set_free(cur);
+	nftnl_set_free(want);
+	nftnl_set_free(add);
+	nftnl_set_free(del);
+}
+
+#define TEST_SMALL_PAGE	512
+#define TEST_SMALL_ELEMS	2000
+#define TEST_SMALL_OVERRUN	8192
+
+static int count_elem_cb(struct nftnl_set_elem *e, void *data)
+{
+	int *num_elems = data;
+
+	(*num_elems)++;
+	return 0;
+}
+
+/* Messages have to fit into a batch with a small overrun area. */
+static void test_set_elems_batch_room(void)
+{
+	static char udata[16384];
+	struct nftnl_set *cur, *want, *parsed;
+	const struct nlmsghdr *nlh;
+	struct nftnl_batch *batch;
+	const struct msghdr *msg;
+	struct nftnl_set_elem *e;
+	uint32_t key, seq = 0;
+	int i, len, num_elems = 0;
+
+	batch = nftnl_batch_alloc(TEST_SMALL_PAGE, TEST_SMALL_OVERRUN);
+	cur = nftnl_set_alloc();
+	want = nftnl_set_alloc();
+	parsed = nftnl_set_alloc();
+	if (batch == NULL || cur == NULL || want == NULL || parsed == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_set_set_str(want, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(want, NFTNL_SET_NAME, "test-name");
+	for (key = 0; key < TEST_SMALL_ELEMS; key++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_USERDATA, udata, 100);
+		nftnl_set_elem_add(want, e);
+	}
+
+	if (nftnl_set_elems_diff_batch(batch, cur, want, 0, &seq) < 2)
+		print_err("elements were not split into several messages");
+
+	msg = nftnl_batch_msghdr(batch);
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		if (msg->msg_iov[i].iov_len >
+		    TEST_SMALL_PAGE + TEST_SMALL_OVERRUN)
+			print_err("page is larger than the batch allows");
+
+		nlh = msg->msg_iov[i].iov_base;
+		len = msg->msg_iov[i].iov_len;
+		while (mnl_nlmsg_ok(nlh, len)) {
+			if (nftnl_set_elems_nlmsg_parse(nlh, parsed) < 0)
+				print_err("cannot parse element message");
+			nlh = mnl_nlmsg_next(nlh, &len);
+		}
+	}
+	nftnl_set_elem_foreach(parsed, count_elem_cb, &num_elems);
+	if (num_elems != TEST_SMALL_ELEMS)
+		print_err("wrong number of elements in the batch");
+
+	/* An element larger than a batch page is rejected. */
+	e = nftnl_set_elem_alloc();
+	key = TEST_SMALL_ELEMS;
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &key, sizeof(key));
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_USERDATA, udata, sizeof(udata));
+	nftnl_set_elem_add(want, e);
+	nftnl_batch_reset(batch);
+	if (nftnl_set_elems_diff_batch(batch, cur, want, 0, &seq) >= 0 ||
+	    errno != EMSGSIZE)
+		print_err("oversized element was not rejected");
+
+	nftnl_batch_free(batch);
+	nftnl_set_free(cur);
+	nftnl_set_free(want);
+	nftnl_set_free(parsed);
+}
+
+#define TEST_NUM_SETS	200
+
+static void test_set_list_lookup(void)
+{
+	struct nftnl_set_list *list;
+	struct nftnl_set *s, *sets[TEST_NUM_SETS];
+	char name[32];
+	int i;
+
+	list = nftnl_set_list_alloc();
+	if (list == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	/* Half of the sets are indexed when the hash is enabled, the other
+	 * half when they are added to the list.
+	 */
+	for (i = 0; i < TEST_NUM_SETS; i++) {
+		if (i == TEST_NUM_SETS / 2 &&
+		    nftnl_set_list_hash_enable(list) < 0)
+			print_err("cannot enable set list hash");
+
+		sets[i] = nftnl_set_alloc();
+		if (sets[i] == NULL) {
+			print_err("OOM");
+			return;
+		}
+		snprintf(name, sizeof(name), "set%d", i);
+		nftnl_set_set_str(sets[i], NFTNL_SET_NAME, name);
+		nftnl_set_list_add_tail(sets[i], list);
+	}
+
+	for (i = 0; i < TEST_NUM_SETS; i++) {
+		snprintf(name, sizeof(name), "set%d", i);
+		if (nftnl_set_list_lookup_byname(list, name) != sets[i])
+			print_err("set lookup by name mismatches");
+	}
+	if (nftnl_set_list_lookup_byname(list, "set") != NULL)
+		print_err("unexpected set found");
+
+	nftnl_set_list_del(sets[0]);
+	if (nftnl_set_list_lookup_byname(list, "set0") != NULL)
+		print_err("deleted set found");
+	nftnl_set_free(sets[0]);
+
+	s = nftnl_set_alloc();
+	if (s == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "set0");
+	nftnl_set_list_add(s, list);
+	if (nftnl_set_list_lookup_byname(list, "set0") != s)
+		print_err("set lookup by name mismatches after re-adding");
+
+	/* Sets sharing a name are found in list order, whether they are
+	 * appended or prepended to the list.
+	 */
+	s = nftnl_set_alloc();
+	if (s == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "set1");
+	nftnl_set_list_add_tail(s, list);
+	if (nftnl_set_list_lookup_byname(list, "set1") != sets[1])
+		print_err("appended duplicate set found first");
+
+	s = nftnl_set_alloc();
+	if (s == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "set2");
+	nftnl_set_list_add(s, list);
+	if (nftnl_set_list_lookup_byname(list, "set2") != s)
+		print_err("prepended duplicate set not found first");
+
+	/* Deleted sets must not be accounted in the index anymore. */
+	for (i = 0; i < TEST_NUM_SETS * 100; i++) {
+		s = nftnl_set_alloc();
+		if (s == NULL) {
+			print_err("OOM");
+			return;
+		}
+		nftnl_set_set_str(s, NFTNL_SET_NAME, "churn");
+		nftnl_set_list_add_tail(s, list);
+		if (nftnl_set_list_lookup_byname(list, "churn") != s)
+			print_err("set lookup by name mismatches after churn");
+		nftnl_set_list_del(s);
+		nftnl_set_free(s);
+	}
+	for (i = 3; i < TEST_NUM_SETS; i++) {
+		snprintf(name, sizeof(name), "set%d", i);
+		if (nftnl_set_list_lookup_byname(list, name) != sets[i])
+			print_err("set lookup by name mismatches after churn");
+	}
+
+	nftnl_set_list_free(list);
+}
+
+static void check_set_fprintf(struct nftnl_set *s, uint32_t type,
+			      uint32_t flags)
+{
+	char *buf, *out, *abuf;
+	int len, ret;
+	FILE *fp;
+
+	len = nftnl_set_snprintf(NULL, 0, s, type, flags);
+	buf = malloc(len + 1);
+	out = malloc(len + 1);
+	fp = tmpfile();
+	if (buf == NULL || out == NULL || fp == NULL) {
+		print_err("OOM");
+		goto out;
+	}
+
+	if (nftnl_set_snprintf(buf, len + 1, s, type, flags) != len ||
+	    strlen(buf) != len)
+		print_err("set length mismatches output");
+
+	ret = nftnl_set_fprintf(fp, s, type, flags);
+	rewind(fp);
+	if (ret != len || fread(out, 1, len + 1, fp) != len ||
+	    memcmp(buf, out, len) != 0)
+		print_err("set fprintf mismatches snprintf");
+
+	ret = nftnl_set_asprintf(&abuf, s, type, flags);
+	if (ret != len || strcmp(buf, abuf) != 0)
+		print_err("set asprintf mismatches snprintf");
+	if (ret >= 0)
+		free(abuf);
+out:
+	if (fp)
+		fclose(fp);
+	free(buf);
+	free(out);
+}
+
+static void test_set_fprintf(void)
+{
+	struct nftnl_set *s;
+	uint32_t i;
+
+	s = nftnl_set_alloc();
+	if (s == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "test-table");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "test-name");
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, AF_INET);
+
+	/* Empty and then much larger than the fprintf buffer. */
+	check_set_fprintf(s, NFTNL_OUTPUT_DEFAULT, 0);
+	check_set_fprintf(s, NFTNL_OUTPUT_JSON, 0);
+	for (i = 0; i < 1000; i++)
+		add_map_elem(s, i, i * 3);
+	check_set_fprintf(s, NFTNL_OUTPUT_DEFAULT, 0);
+	check_set_fprintf(s, NFTNL_OUTPUT_JSON, 0);
+	check_set_fprintf(s, NFTNL_OUTPUT_JSON, NFTNL_OF_EVENT_NEW);
+
+	nftnl_set_free(s);
+}
+
+/* Element output must not depend on how it is formatted, compare it with
+ * what snprintf() gives, including truncation to every buffer size.
+ */
+static void test_set_elem_snprintf(void)
+{
+	static const uint32_t words[] = {
+		0, 1, 0x0a0b0c0d, 0x89abcdef, 0xfffffffe, 0xffffffff,
+		0x10000000, 0x7f, 0x8000, 0xdeadbeef, 0x00c0ffee, 0x12345678,
+		0x80000000, 0x01010101, 0xfedcba98, 0x76543210,
+	};
+	char out[1024], exp[1024];
+	struct nftnl_set_elem *e;
+	int i, j, len, ret, off;
+
+	for (i = 1; i <= 16; i++) {
+		e = nftnl_set_elem_alloc();
+		if (e == NULL) {
+			print_err("OOM");
+			return;
+		}
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, words, i * 4);
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_DATA, words + 16 - i, i * 4);
+		nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_FLAGS, words[i - 1]);
+
+		off = snprintf(exp, sizeof(exp), "element ");
+		for (j = 0; j < i; j++)
+			off += snprintf(exp + off, sizeof(exp) - off, "%.8x ",
+					words[j]);
+		off += snprintf(exp + off, sizeof(exp) - off, " : ");
+		for (j = 0; j < i; j++)
+			off += snprintf(exp + off, sizeof(exp) - off, "%.8x ",
+					words[16 - i + j]);
+		off += snprintf(exp + off, sizeof(exp) - off, "%u [end]",
+				words[i - 1]);
+
+		len = nftnl_set_elem_snprintf(out, sizeof(out), e,
+					      NFTNL_OUTPUT_DEFAULT, 0);
+		if (len != off || strcmp(out, exp) != 0)
+			print_err("element output mismatches snprintf");
+
+		for (j = 0; j <= len + 1; j++) {
+			memset(out, 'x', sizeof(out));
+			ret = nftnl_set_elem_snprintf(out, j, e,
+						      NFTNL_OUTPUT_DEFAULT, 0);
+			if (ret != len ||
+			    (j > 0 && (strncmp(out, exp, j - 1) != 0 ||
+				       out[j <= len ? j - 1 : len] != '\0')) ||
+			    out[j] != 'x')
+				print_err("truncated element output mismatches");
+		}
+
+		nftnl_set_elem_free(e);
+	}
+
+	/* Verdicts are not printed as data words. */
+	e = nftnl_set_elem_alloc();
+	if (e == NULL) {
+		print_err("OOM");
+		return;
+	}
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, words, sizeof(uint32_t));
+	nftnl_set_elem_set_u32(e, NFTNL_SET_ELEM_VERDICT, NF_ACCEPT);
+	nftnl_set_elem_snprintf(out, sizeof(out), e, NFTNL_OUTPUT_DEFAULT, 0);
+	if (strcmp(out, "element 00000000  : 0 [end]") != 0)
+		print_err("verdict element output mismatches");
+	nftnl_set_elem_free(e);
+}
+
+static void test_set_elem_ext(void)
+{
+	static const char udata[] = "testing user data";
+	struct nftnl_set_elem *e;
+	struct nftnl_expr *expr;
+	const void *val;
+	uint32_t len;
+
+	e = nftnl_set_elem_alloc();
+	expr = nftnl_expr_alloc("counter");
+	if (e == NULL || expr == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	/* No ext area yet. */
+	if (nftnl_set_elem_get(e, NFTNL_SET_ELEM_EXPIRATION, &len) != NULL)
+		print_err("unset expiration is returned");
+	nftnl_set_elem_unset(e, NFTNL_SET_ELEM_EXPR);
+
+	nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_CHAIN, "test-chain");
+	nftnl_set_elem_set_u64(e, NFTNL_SET_ELEM_TIMEOUT, 0x1234567890ULL);
+	nftnl_set_elem_set_u64(e, NFTNL_SET_ELEM_EXPIRATION, 0x0987654321ULL);
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_USERDATA, udata, sizeof(udata));
+	nftnl_set_elem_set(e, NFTNL_SET_ELEM_EXPR, expr, 0);
+	nftnl_set_elem_set_str(e, NFTNL_SET_ELEM_OBJREF, "test-obj");
+
+	if (strcmp(nftnl_set_elem_get_str(e, NFTNL_SET_ELEM_CHAIN),
+		   "test-chain") != 0)
+		print_err("chain mismatches");
+	if (nftnl_set_elem_get_u64(e, NFTNL_SET_ELEM_TIMEOUT) !=
+	    0x1234567890ULL)
+		print_err("timeout mismatches");
+	if (nftnl_set_elem_get_u64(e, NFTNL_SET_ELEM_EXPIRATION) !=
+	    0x0987654321ULL)
+		print_err("expiration mismatches");
+	val = nftnl_set_elem_get(e, NFTNL_SET_ELEM_USERDATA, &len);
+	if (val == NULL || len != sizeof(udata) || memcmp(val, udata, len))
+		print_err("user data mismatches");
+	if (nftnl_set_elem_get(e, NFTNL_SET_ELEM_EXPR, &len) != expr)
+		print_err("expression mismatches");
+	if (strcmp(nftnl_set_elem_get_str(e, NFTNL_SET_ELEM_OBJREF),
+		   "test-obj") != 0)
+		print_err("object reference mismatches");
+
+	nftnl_set_elem_unset(e, NFTNL_SET_ELEM_EXPIRATION);
+	nftnl_set_elem_unset(e, NFTNL_SET_ELEM_EXPR);
+	if (nftnl_set_elem_is_set(e, NFTNL_SET_ELEM_EXPIRATION) ||
+	    nftnl_set_elem_get(e, NFTNL_SET_ELEM_EXPR, &len) != NULL)
+		print_err("attribute is still set after unset");
+
+	nftnl_set_elem_free(e);
+}
+
 int main(int argc, char *argv[])
 {
 	struct nftnl_set *a, *b = NULL;
@@ -84,6 +825,16 @@ int main(int argc, char *argv[])
 
 	nftnl_set_free(a); nftnl_set_free(b);
 
+	test_set_elem_hash();
+	test_set_elem_arena();
+	test_set_elems_foreach();
+	test_set_elems_diff();
+	test_set_elems_batch_room();
+	test_set_list_lookup();
+	test_set_fprintf();
+	test_set_elem_snprintf();
+	test_set_elem_ext();
+
 	if (!test_ok)
 		exit(EXIT_FAILURE);
 
@@ -0,0 +1,398 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <libmnl/libmnl.h>
+#include <libnftnl/common.h>
+#include <libnftnl/ruleset.h>
+#include <libnftnl/snapshot.h>
+#include <libnftnl/table.h>
+#include <libnftnl/chain.h>
+#include <libnftnl/rule.h>
+#include <libnftnl/set.h>
+#include <libnftnl/expr.h>
+#include <libnftnl/batch.h>
+
+#define TEST_NUM_ELEMS	5000
+#define TEST_NUM_RULES	100
+#define TEST_PAGE_SIZE	512
+#define TEST_NUM_TABLES	64
+
+static int test_ok = 1;
+
+static void print_err(const char *msg)
+{
+	test_ok = 0;
+	printf("\033[31mERROR:\e[0m %s\n", msg);
+}
+
+static struct nftnl_ruleset *build_ruleset(void)
+{
+	struct nftnl_ruleset *rs = nftnl_ruleset_alloc();
+	struct nftnl_table_list *tl = nftnl_table_list_alloc();
+	struct nftnl_chain_list *cl = nftnl_chain_list_alloc();
+	struct nftnl_set_list *sl = nftnl_set_list_alloc();
+	struct nftnl_rule_list *rl = nftnl_rule_list_alloc();
+	struct nftnl_set_elem *e;
+	struct nftnl_table *t;
+	struct nftnl_chain *c;
+	struct nftnl_rule *r;
+	struct nftnl_set *s;
+	uint32_t i;
+
+	t = nftnl_table_alloc();
+	nftnl_table_set_u32(t, NFTNL_TABLE_FAMILY, NFPROTO_IPV4);
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	nftnl_table_list_add_tail(t, tl);
+
+	c = nftnl_chain_alloc();
+	nftnl_chain_set_u32(c, NFTNL_CHAIN_FAMILY, NFPROTO_IPV4);
+	nftnl_chain_set_str(c, NFTNL_CHAIN_TABLE, "filter");
+	nftnl_chain_set_str(c, NFTNL_CHAIN_NAME, "input");
+	nftnl_chain_set_u32(c, NFTNL_CHAIN_HOOKNUM, NF_INET_LOCAL_IN);
+	nftnl_chain_set_s32(c, NFTNL_CHAIN_PRIO, 0);
+	nftnl_chain_set_str(c, NFTNL_CHAIN_TYPE, "filter");
+	nftnl_chain_set_u32(c, NFTNL_CHAIN_POLICY, NF_ACCEPT);
+	nftnl_chain_list_add_tail(c, cl);
+
+	s = nftnl_set_alloc();
+	nftnl_set_set_u32(s, NFTNL_SET_FAMILY, NFPROTO_IPV4);
+	nftnl_set_set_str(s, NFTNL_SET_TABLE, "filter");
+	nftnl_set_set_str(s, NFTNL_SET_NAME, "blacklist");
+	nftnl_set_set_u32(s, NFTNL_SET_KEY_LEN, sizeof(uint32_t));
+	for (i = 0; i < TEST_NUM_ELEMS; i++) {
+		e = nftnl_set_elem_alloc();
+		nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, &i, sizeof(i));
+		nftnl_set_elem_add(s, e);
+	}
+	nftnl_set_list_add_tail(s, sl);
+
+	for (i = 0; i < TEST_NUM_RULES; i++) {
+		r = nftnl_rule_alloc();
+		nftnl_rule_set_u32(r, NFTNL_RULE_FAMILY, NFPROTO_IPV4);
+		nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+		nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+		nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, i + 1);
+		nftnl_rule_add_expr(r, nftnl_expr_alloc("counter"));
+		nftnl_rule_list_add_tail(r, rl);
+	}
+
+	nftnl_ruleset_set(rs, NFTNL_RULESET_TABLELIST, tl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_CHAINLIST, cl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_SETLIST, sl);
+	nftnl_ruleset_set(rs, NFTNL_RULESET_RULELIST, rl);
+
+	return rs;
+}
+
+static void check_msgs(const struct nftnl_snapshot *snap)
+{
+	uint32_t i, num_msgs, num_elem_msgs = 0;
+	const struct nlmsghdr *nlh;
+	uint16_t type;
+
+	num_msgs = nftnl_snapshot_num_msgs(snap);
+	for (i = 0; i < num_msgs; i++) {
+		type = nftnl_snapshot_msg_type(snap, i);
+		nlh = nftnl_snapshot_msg(snap, i);
+		if (nlh == NULL || NFNL_MSG_TYPE(nlh->nlmsg_type) != type) {
+			print_err("cannot read message from snapshot");
+			return;
+		}
+		if (type == NFT_MSG_NEWSETELEM)
+			num_elem_msgs++;
+	}
+
+	if (nftnl_snapshot_msg_type(snap, 0) != NFT_MSG_NEWTABLE ||
+	    nftnl_snapshot_msg_type(snap, 1) != NFT_MSG_NEWCHAIN ||
+	    nftnl_snapshot_msg_type(snap, 2) != NFT_MSG_NEWSET ||
+	    nftnl_snapshot_msg_type(snap, 3) != NFT_MSG_NEWSETELEM ||
+	    nftnl_snapshot_msg_type(snap, num_msgs - 1) != NFT_MSG_NEWRULE)
+		print_err("snapshot messages out of order");
+	if (num_elem_msgs < 1 ||
+	    num_msgs != 3 + num_elem_msgs + TEST_NUM_RULES)
+		print_err("wrong number of messages in snapshot");
+	if (nftnl_snapshot_msg(snap, num_msgs) != NULL)
+		print_err("message beyond the end of the snapshot");
+}
+
+static void test_snapshot_roundtrip(void)
+{
+	struct nftnl_ruleset *rs, *rs_snap;
+	struct nftnl_snapshot *snap;
+	char *out, *out_snap;
+	FILE *fp;
+
+	rs = build_ruleset();
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		nftnl_ruleset_free(rs);
+		return;
+	}
+
+	if (nftnl_snapshot_write(fp, rs) < 0 || fflush(fp) != 0) {
+		print_err("cannot write snapshot");
+		goto out;
+	}
+
+	snap = nftnl_snapshot_map(fileno(fp));
+	if (snap == NULL) {
+		print_err("cannot map snapshot");
+		goto out;
+	}
+	check_msgs(snap);
+
+	rs_snap = nftnl_ruleset_alloc();
+	if (nftnl_snapshot_ruleset(snap, rs_snap) < 0)
+		print_err("cannot load ruleset from snapshot");
+	nftnl_snapshot_unmap(snap);
+
+	/* Objects do not depend on the mapping once they are loaded. */
+	if (nftnl_ruleset_asprintf(&out, rs, NFTNL_OUTPUT_JSON, 0) < 0 ||
+	    nftnl_ruleset_asprintf(&out_snap, rs_snap, NFTNL_OUTPUT_JSON,
+				   0) < 0) {
+		print_err("cannot export ruleset");
+	} else {
+		if (strcmp(out, out_snap) != 0)
+			print_err("snapshot ruleset mismatches the original");
+		free(out);
+		free(out_snap);
+	}
+	nftnl_ruleset_free(rs_snap);
+out:
+	nftnl_ruleset_free(rs);
+	fclose(fp);
+}
+
+static void check_corrupt(const char *data, size_t len, const char *msg)
+{
+	struct nftnl_snapshot *snap;
+	FILE *fp;
+
+	fp = tmpfile();
+	if (fp == NULL) {
+		print_err("cannot create temporary file");
+		return;
+	}
+	if (len)
+		fwrite(data, 1, len, fp);
+	fflush(fp);
+
+	snap = nftnl_snapshot_map(fileno(fp));
+	if (snap != NULL) {
+		print_err(msg);
+		nftnl_snapshot_unmap(snap);
+	}
+	fclose(fp);
+}
+
+static void test_snapshot_corrupt(void)
+{
+	/* Header of a valid snapshot followed by the trailer. */
+	struct {
+		char		hdr[16];
+		uint64_t	index_offset;
+		uint32_t	num_msgs;
+		char		magic[4];
+	} crafted;
+	struct nftnl_ruleset *rs;
+	char *data;
+	size_t len;
+	FILE *fp;
+
+	rs = build_ruleset();
+	fp = open_memstream(&data, &len);
+	if (nftnl_snapshot_write(fp, rs) < 0)
+		print_err("cannot write snapshot to memory");
+	fclose(fp);
+	nftnl_ruleset_free(rs);
+
+	check_corrupt(data, 0, "empty snapshot was mapped");
+	check_corrupt(data, len - 1, "truncated snapshot was mapped");
+
+	data[0] = 'X';
+	check_corrupt(data, len, "snapshot with bad magic was mapped");
+	data[0] = 'N';
+
+	/* Index offset, in the trailer. */
+	data[len - 16] ^= 0x40;
+	check_corrupt(data, len, "snapshot with bad index was mapped");
+
+	/* Index offset and length that wrap around to the file length. */
+	memcpy(&crafted, data, sizeof(crafted.hdr));
+	crafted.index_offset = -(uint64_t)sizeof(crafted.hdr);
+	crafted.num_msgs = 2;
+	memcpy(crafted.magic, data, sizeof(crafted.magic));
+	check_corrupt((const char *)&crafted, sizeof(crafted),
+		      "snapshot with wrapping index was mapped");
+
+	free(data);
+}
+
+static struct nftnl_batch *build_batch(void)
+{
+	struct nftnl_batch *batch;
+	struct nftnl_table *t;
+	struct nftnl_rule *r;
+	struct nlmsghdr *nlh;
+	uint32_t seq = 0;
+	int i;
+
+	batch = nftnl_batch_alloc(TEST_PAGE_SIZE, MNL_SOCKET_BUFFER_SIZE);
+	if (batch == NULL)
+		return NULL;
+
+	nftnl_batch_begin(nftnl_batch_buffer(batch), seq++);
+	nftnl_batch_update(batch);
+
+	t = nftnl_table_alloc();
+	nftnl_table_set_str(t, NFTNL_TABLE_NAME, "filter");
+	for (i = 0; i < TEST_NUM_TABLES; i++) {
+		nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch),
+					    NFT_MSG_NEWTABLE, NFPROTO_IPV4,
+					    NLM_F_CREATE, seq++);
+		nftnl_table_nlmsg_build_payload(nlh, t);
+		nftnl_batch_update(batch);
+	}
+	nftnl_table_free(t);
+
+	r = nftnl_rule_alloc();
+	nftnl_rule_set_str(r, NFTNL_RULE_TABLE, "filter");
+	nftnl_rule_set_str(r, NFTNL_RULE_CHAIN, "input");
+	nftnl_rule_set_u64(r, NFTNL_RULE_HANDLE, 10);
+	nlh = nftnl_nlmsg_build_hdr(nftnl_batch_buffer(batch), NFT_MSG_DELRULE,
+				    NFPROTO_IPV4, 0, seq++);
+	nftnl_rule_nlmsg_build_payload(nlh, r);
+	nftnl_batch_update(batch);
+	nftnl_rule_free(r);
+
+	nftnl_batch_end(nftnl_batch_buffer(batch), seq++);
+	nftnl_batch_update(batch);
+
+	return batch;
+}
+
+struct capture_stats {
+	int	tables;
+	int	rules;
+	int	others;
+};
+
+static int capture_cb(const struct nftnl_parse_ctx *ctx)
+{
+	struct capture_stats *st = nftnl_ruleset_ctx_get(ctx,
+							 NFTNL_RULESET_CTX_DATA);
+	uint32_t cmd = nftnl_ruleset_ctx_get_u32(ctx, NFTNL_RULESET_CTX_CMD);
+	struct nftnl_rule *r;
+
+	switch (nftnl_ruleset_ctx_get_u32(ctx, NFTNL_RULESET_CTX_TYPE)) {
+	case NFTNL_RULESET_TABLE:
+		if (cmd == NFTNL_CMD_ADD)
+			st->tables++;
+		break;
+	case NFTNL_RULESET_RULE:
+		r = nftnl_ruleset_ctx_get(ctx, NFTNL_RULESET_CTX_RULE);
+		if (cmd == NFTNL_CMD_DELETE &&
+		    nftnl_rule_get_u64(r, NFTNL_RULE_HANDLE) == 10)
+			st->rules++;
+		break;
+	default:
+		st->others++;
+		break;
+	}
+	nftnl_ruleset_ctx_free(ctx);
+
+	return 0;
+}
+
+static void test_snapshot_batch(void)
+{
+	struct capture_stats st = {};
+	struct nftnl_snapshot *snap;
+	struct nftnl_batch *batch;
+	struct iovec *iov, *iov_snap;
+	int i, iovlen;
+	FILE *fp;
+
+	batch = build_batch();
+	fp = tmpfile();
+	if (batch == NULL || fp == NULL) {
+		print_err("OOM");
+		return;
+	}
+
+	if (nftnl_snapshot_write_batch(fp, batch) < 0 || fflush(fp) != 0) {
+		print_err("cannot capture batch");
+		goto out;
+	}
+
+	snap = nftnl_snapshot_map(fileno(fp));
+	if (snap == NULL) {
+		print_err("cannot map batch capture");
+		goto out;
+	}
+
+	iovlen = nftnl_batch_iovec_len(batch);
+	if (iovlen < 2)
+		print_err("batch did not span several pages");
+	if (nftnl_snapshot_iovec_len(snap) != iovlen) {
+		print_err("capture has a different number of pages");
+		nftnl_snapshot_unmap(snap);
+		goto out;
+	}
+
+	iov = calloc(iovlen, sizeof(struct iovec));
+	iov_snap = calloc(iovlen, sizeof(struct iovec));
+	nftnl_batch_iovec(batch, iov, iovlen);
+	nftnl_snapshot_iovec(snap, iov_snap, iovlen);
+	for (i = 0; i < iovlen; i++) {
+		if (iov[i].iov_len != iov_snap[i].iov_len ||
+		    memcmp(iov[i].iov_base, iov_snap[i].iov_base,
+			   iov[i].iov_len) != 0)
+			print_err("captured page mismatches the batch");
+	}
+	free(iov);
+	free(iov_snap);
+
+	if (nftnl_snapshot_num_msgs(snap) != TEST_NUM_TABLES + 3 ||
+	    nftnl_snapshot_msg_type(snap, 0) != NFNL_MSG_BATCH_BEGIN)
+		print_err("wrong messages in capture");
+
+	if (nftnl_snapshot_parse_cb(snap, &st, capture_cb) < 0)
+		print_err("cannot parse capture");
+	if (st.tables != TEST_NUM_TABLES || st.rules != 1 || st.others != 0)
+		print_err("capture has unexpected objects");
+
+	nftnl_snapshot_unmap(snap);
+out:
+	nftnl_batch_free(batch);
+	fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+	test_snapshot_roundtrip();
+	test_snapshot_corrupt();
+	test_snapshot_batch();
+
+	if (!test_ok)
+		exit(EXIT_FAILURE);
+
+	printf("%s: \033[32mOK\e[0m\n", argv[0]);
+	return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+./nft-batch-test
 ./nft-chain-test
 ./nft-expr_bitwise-test
 ./nft-expr_byteorder-test
@@ -26,7 +27,9 @@
 ./nft-expr_target-test
 ./nft-expr_hash-test
 ./nft-rule-test
+./nft-ruleset-test
 ./nft-set-test
+./nft-snapshot-test
 ./nft-table-test
 ./nft-object-test
 ./nft-parsing-test -d jsonfiles